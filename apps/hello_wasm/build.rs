@@ -0,0 +1,15 @@
+// =============================================================================
+// hello_wasm — Build Script
+// =============================================================================
+//
+// wasm-ld reserves 1 MiB of linear memory for the shadow stack by default.
+// The guest needs a few hundred bytes of it, and every instance in init's
+// pool carries (and resets) its whole linear memory, so the .wasm build
+// asks for 64 KiB instead. The native rlib (hello_aot) is unaffected.
+// =============================================================================
+
+fn main() {
+    if std::env::var("CARGO_CFG_TARGET_ARCH").as_deref() == Ok("wasm32") {
+        println!("cargo:rustc-link-arg-cdylib=-zstack-size=65536");
+    }
+}
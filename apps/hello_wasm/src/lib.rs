@@ -8,6 +8,11 @@
 //! The execution chain:
 //!   Wasm run_guest() → host_print(ptr, len) → wasmi host closure
 //!   → read Wasm linear memory → write_byte() → SYS_PORT_OUT → COM1
+//!
+//! The same .wasm is also compiled ahead of time to x86_64 by
+//! tools/wasm_aot.py and run as `user/hello_aot`, which provides
+//! `host_print` natively. `compute(n)` is the kernel both are benchmarked on;
+//! `touch(n)` dirties linear memory for init's instance pool.
 
 #![no_std]
 
@@ -39,3 +44,42 @@ pub extern "C" fn run_guest() {
     let msg = b"Hello from the Wasm Sandbox!\n";
     unsafe { host_print(msg.as_ptr() as i32, msg.len() as i32); }
 }
+
+/// Compute kernel for the interpreter-vs-AOT benchmark: `n` rounds of
+/// xorshift32 folded into a running sum. Integer-only, no memory traffic,
+/// so it measures pure instruction dispatch.
+#[no_mangle]
+pub extern "C" fn compute(n: i32) -> i32 {
+    let mut x: u32 = 0x9E37_79B9;
+    let mut sum: u32 = 0;
+    let mut i = 0;
+    while i < n {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        sum = sum.wrapping_add(x);
+        i += 1;
+    }
+    sum as i32
+}
+
+/// Scratch buffer in linear memory (.bss), dirtied by `touch`.
+static mut SCRATCH: [u8; 16384] = [0; 16384];
+
+/// Increments the first `n` bytes of SCRATCH and returns their sum.
+///
+/// On a fresh instance the result is `n`; on one whose memory was not
+/// reset after a previous call it is a multiple of `n`. init's instance
+/// pool uses it to check that resetting dirty pages restores the
+/// instance exactly.
+#[no_mangle]
+pub extern "C" fn touch(n: i32) -> i32 {
+    let buf = unsafe { &mut *core::ptr::addr_of_mut!(SCRATCH) };
+    let n = (n.max(0) as usize).min(buf.len());
+    let mut sum: i32 = 0;
+    for b in &mut buf[..n] {
+        *b = b.wrapping_add(1);
+        sum += *b as i32;
+    }
+    sum
+}
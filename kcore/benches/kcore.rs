@@ -0,0 +1,193 @@
+// =============================================================================
+// MinimalOS NextGen — kcore Host Microbenchmarks (`make kcore-bench`)
+// =============================================================================
+//
+// Times the kcore hot paths on the development machine, so allocator and
+// parser changes can be compared in seconds instead of a QEMU boot. The
+// numbers are host numbers: use them to compare two versions of the code,
+// not to predict the N3710 (the in-kernel suite in kernel/src/bench.rs
+// does that).
+//
+// OUTPUT FORMAT:
+//   The kernel suite's JSON lines, one per benchmark, timed with
+//   `Instant` instead of the TSC. Each sample is one batch of `batch`
+//   operations; the statistics are per operation:
+//
+//   {"bench":"bitmap_alloc_free","iters":2000,"batch":64,"unit":"ns",
+//    "min":..,"median":..,"p99":..,"max":..,"mean":..}
+//
+// Dependency-free by design (no criterion): kcore has no dependencies and
+// the bench target keeps it that way.
+//
+// =============================================================================
+
+use std::alloc::Layout;
+use std::hint::black_box;
+use std::time::Instant;
+
+use kcore::bitmap::FrameBitmap;
+use kcore::cnode::{CNode, CapObject, CapRights, Capability, CNODE_SLOTS};
+use kcore::elf;
+use kcore::heap::FreeListHeap;
+use kcore::tar;
+
+/// Samples per benchmark.
+const ITERS: usize = 2000;
+
+/// Operations per sample: `Instant` is too coarse for one cheap op.
+const BATCH: usize = 64;
+
+/// Sorts the per-op samples (ns) and prints one JSON result line.
+fn report(name: &str, samples: &mut Vec<f64>) {
+    samples.sort_unstable_by(f64::total_cmp);
+    let n = samples.len();
+    let mean = samples.iter().sum::<f64>() / n as f64;
+    println!(
+        "{{\"bench\":\"{}\",\"iters\":{},\"batch\":{},\"unit\":\"ns\",\"min\":{:.1},\"median\":{:.1},\"p99\":{:.1},\"max\":{:.1},\"mean\":{:.1}}}",
+        name, n, BATCH, samples[0], samples[n / 2], samples[(n * 99) / 100], samples[n - 1], mean
+    );
+}
+
+/// Times `ITERS` batches of `BATCH` calls to `op`; `op` gets a running
+/// index.
+fn run(name: &str, mut op: impl FnMut(usize)) {
+    let mut samples = Vec::with_capacity(ITERS);
+    let mut i = 0;
+    for _ in 0..ITERS {
+        let t0 = Instant::now();
+        for _ in 0..BATCH {
+            op(i);
+            i += 1;
+        }
+        samples.push(t0.elapsed().as_nanos() as f64 / BATCH as f64);
+    }
+    report(name, &mut samples);
+}
+
+fn main() {
+    println!("{{\"bench_suite\":\"kcore_host\"}}");
+    bench_bitmap();
+    bench_heap();
+    bench_cnode();
+    bench_tar();
+    bench_elf();
+}
+
+// =============================================================================
+// Allocators
+// =============================================================================
+
+/// 64 MiB worth of frames, three quarters used: the alloc scan has to skip
+/// full chunks the way the PMM does after boot.
+fn bench_bitmap() {
+    const FRAMES: usize = 16 * 1024;
+    let mut storage = vec![0u64; FrameBitmap::storage_bytes(FRAMES) / 8];
+    let mut bm = unsafe { FrameBitmap::new_all_used(storage.as_mut_ptr() as *mut u8, FRAMES) };
+    bm.mark_free_range(FRAMES * 3 / 4, FRAMES);
+
+    run("bitmap_alloc_free", |_| {
+        let f = bm.alloc().unwrap();
+        black_box(f);
+        bm.free(f).unwrap();
+    });
+    run("bitmap_alloc_contiguous_8", |_| {
+        let f = bm.alloc_contiguous(8).unwrap();
+        for i in 0..8 {
+            bm.free(f + i).unwrap();
+        }
+    });
+    drop(storage);
+}
+
+/// 256 KiB heap (the kernel's size) with 1000 live blocks ahead of the
+/// allocation point, so first-fit walks a realistic list.
+fn bench_heap() {
+    const BYTES: usize = 256 * 1024;
+    let mut storage = vec![0u128; BYTES / 16];
+    let mut heap = FreeListHeap::new();
+    unsafe { heap.init(storage.as_mut_ptr() as usize, BYTES); }
+
+    let small = Layout::from_size_align(48, 8).unwrap();
+    let mut live: Vec<*mut u8> = (0..1000).map(|_| heap.alloc(small)).collect();
+    // Free every other block: a fragmented free list.
+    for p in live.iter_mut().step_by(2) {
+        unsafe { heap.dealloc(*p, small); }
+        *p = std::ptr::null_mut();
+    }
+
+    let layout = Layout::from_size_align(64, 8).unwrap();
+    run("heap_alloc_free_64", |_| unsafe {
+        let p = heap.alloc(layout);
+        black_box(p);
+        heap.dealloc(p, layout);
+    });
+    let page = Layout::from_size_align(4096, 4096).unwrap();
+    run("heap_alloc_free_page", |_| unsafe {
+        let p = heap.alloc(page);
+        black_box(p);
+        heap.dealloc(p, page);
+    });
+    drop(storage);
+}
+
+// =============================================================================
+// Capabilities
+// =============================================================================
+
+fn bench_cnode() {
+    let mut cnode = CNode::new();
+    while cnode.insert(Capability::new(CapObject::PmmAllocator, CapRights::ALL)).is_some() {}
+
+    run("cnode_lookup", |i| {
+        black_box(cnode.lookup(black_box(i % CNODE_SLOTS)));
+    });
+    // Worst case for `insert`: the only free slot is the last one.
+    run("cnode_remove_insert_last", |_| {
+        let cap = cnode.remove(CNODE_SLOTS - 1).unwrap();
+        black_box(cnode.insert(cap));
+    });
+}
+
+// =============================================================================
+// Parsers
+// =============================================================================
+
+/// `find_file` for the last of 32 entries (an initrd-sized archive).
+fn bench_tar() {
+    let mut archive = Vec::new();
+    for i in 0..32 {
+        let mut header = [0u8; 512];
+        let name = format!("bin/prog{:02}", i);
+        header[..name.len()].copy_from_slice(name.as_bytes());
+        header[124..135].copy_from_slice(format!("{:011o}", 1000).as_bytes());
+        header[156] = b'0';
+        header[257..263].copy_from_slice(b"ustar\0");
+        archive.extend_from_slice(&header);
+        archive.resize(archive.len() + 1024, 0);
+    }
+    archive.resize(archive.len() + 1024, 0);
+
+    run("tar_find_file_last_of_32", |_| {
+        black_box(tar::find_file(black_box(&archive), "prog31"));
+    });
+}
+
+/// `validate_header` + `program_headers` on a four-segment image.
+fn bench_elf() {
+    const EHDR: usize = 64;
+    const PHDR: usize = 56;
+    let mut image = vec![0u8; EHDR + 4 * PHDR];
+    image[0..4].copy_from_slice(&elf::ELF_MAGIC);
+    image[4] = elf::ELFCLASS64;
+    image[5] = elf::ELFDATA2LSB;
+    image[16..18].copy_from_slice(&elf::ET_EXEC.to_le_bytes());
+    image[18..20].copy_from_slice(&elf::EM_X86_64.to_le_bytes());
+    image[32..40].copy_from_slice(&(EHDR as u64).to_le_bytes());
+    image[54..56].copy_from_slice(&(PHDR as u16).to_le_bytes());
+    image[56..58].copy_from_slice(&4u16.to_le_bytes());
+
+    run("elf_validate_header", |_| {
+        let ehdr = elf::validate_header(black_box(&image)).unwrap();
+        black_box(elf::program_headers(&image, ehdr).len());
+    });
+}
@@ -0,0 +1,451 @@
+// =============================================================================
+// MinimalOS NextGen — Frame Bitmap (PMM core)
+// =============================================================================
+//
+// The allocation logic of the physical memory manager, with everything
+// platform-specific (Limine memory map, HHDM, PhysAddr, the PMM spinlock)
+// left in the kernel's `memory::pmm`. Frames are plain indices here.
+//
+// BITMAP LAYOUT:
+//   bit = 1 → frame is USED
+//   bit = 0 → frame is FREE
+//   Bit 0 of byte 0 is frame 0, bit 7 of byte 0 is frame 7, and so on.
+//
+// STORAGE:
+//   The bitmap does not own its memory. The kernel points it at frames taken
+//   from the memory map; a host harness can point it at a `Vec<u64>`. The
+//   single-frame scan reads whole u64 chunks, so the storage must be 8-byte
+//   aligned and `storage_bytes(total_frames)` long.
+//
+// =============================================================================
+
+use core::ptr;
+
+/// Returned by `FrameBitmap::free` when the frame was already free.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DoubleFree;
+
+/// Bitmap-based frame allocator over caller-provided storage.
+pub struct FrameBitmap {
+    /// Bitmap storage (8-byte aligned, `storage_bytes(total_frames)` bytes).
+    bits: *mut u8,
+
+    /// Total number of frames tracked.
+    total_frames: usize,
+
+    /// Number of frames currently marked as used.
+    used_frames: usize,
+
+    /// Optimization: start the next allocation scan from this frame index.
+    /// Updated after each alloc/free to avoid rescanning known-used regions.
+    search_start: usize,
+}
+
+// SAFETY: The storage pointer is only dereferenced through `&mut self` /
+// `&self`; the owner (e.g. the kernel PMM) provides the locking.
+unsafe impl Send for FrameBitmap {}
+
+impl FrameBitmap {
+    /// Bytes of backing storage needed to track `total_frames` frames.
+    ///
+    /// Rounded up to whole u64 chunks so the chunked scan never reads past
+    /// the end of the storage.
+    pub const fn storage_bytes(total_frames: usize) -> usize {
+        (total_frames + 63) / 64 * 8
+    }
+
+    /// Creates a bitmap over `bits` with every frame marked USED.
+    ///
+    /// Callers then free the regions that are actually available with
+    /// `mark_free_range` (start pessimistic, free selectively).
+    ///
+    /// # Safety
+    /// `bits` must be 8-byte aligned, valid for reads and writes of
+    /// `storage_bytes(total_frames)` bytes, and not accessed through any
+    /// other path while the bitmap is alive.
+    pub unsafe fn new_all_used(bits: *mut u8, total_frames: usize) -> Self {
+        unsafe {
+            ptr::write_bytes(bits, 0xFF, Self::storage_bytes(total_frames));
+        }
+        Self {
+            bits,
+            total_frames,
+            used_frames: total_frames,
+            search_start: 0,
+        }
+    }
+
+    /// Total number of frames tracked.
+    #[inline]
+    pub fn total_frames(&self) -> usize {
+        self.total_frames
+    }
+
+    /// Number of frames currently marked as used.
+    #[inline]
+    pub fn used_frames(&self) -> usize {
+        self.used_frames
+    }
+
+    // =========================================================================
+    // Allocation
+    // =========================================================================
+
+    /// Allocates a single frame and returns its index.
+    ///
+    /// Scans the bitmap using u64-at-a-time reads for performance:
+    /// if all 64 bits in a u64 are 1, the entire chunk is used and we skip
+    /// ahead by 64 frames. On the N3710, this makes the common case
+    /// (scanning past fully-allocated regions) very fast.
+    pub fn alloc(&mut self) -> Option<usize> {
+        let total_chunks = (self.total_frames + 63) / 64;
+        let start_chunk = self.search_start / 64;
+        let bits_u64 = self.bits as *const u64;
+
+        for i in 0..total_chunks {
+            let chunk_idx = (start_chunk + i) % total_chunks;
+            // SAFETY: storage is 8-byte aligned and rounded up to whole u64
+            // chunks (see `storage_bytes`).
+            let chunk = unsafe { *bits_u64.add(chunk_idx) };
+
+            if chunk == u64::MAX {
+                // All 64 frames in this chunk are used. Skip.
+                continue;
+            }
+
+            // `trailing_zeros` on the inverse gives the index of the
+            // first 0 bit (first free frame in this chunk).
+            let bit_in_chunk = (!chunk).trailing_zeros() as usize;
+            let frame = chunk_idx * 64 + bit_in_chunk;
+
+            if frame >= self.total_frames {
+                continue; // Past the end of tracked memory
+            }
+
+            self.set(frame);
+            self.used_frames += 1;
+            self.search_start = frame + 1;
+
+            return Some(frame);
+        }
+
+        None // Out of memory — all frames used
+    }
+
+    /// Frees a previously allocated frame.
+    ///
+    /// # Panics
+    /// If `frame` is out of range.
+    ///
+    /// # Errors
+    /// `DoubleFree` if the frame is not currently allocated. The bitmap is
+    /// left unchanged; the caller decides how loudly to complain.
+    pub fn free(&mut self, frame: usize) -> Result<(), DoubleFree> {
+        assert!(
+            frame < self.total_frames,
+            "FrameBitmap: frame index {} out of range (max {})",
+            frame,
+            self.total_frames
+        );
+
+        if self.is_free(frame) {
+            return Err(DoubleFree);
+        }
+        self.clear(frame);
+        self.used_frames -= 1;
+
+        // Move the search cursor back so this freed frame can be reused
+        // quickly by the next allocation.
+        if frame < self.search_start {
+            self.search_start = frame;
+        }
+        Ok(())
+    }
+
+    /// Allocates `count` consecutive frames and returns the first index.
+    ///
+    /// Linear scan for `count` consecutive zero bits. Not the fastest
+    /// approach, but contiguous allocation is rare (heap init, DMA buffers).
+    pub fn alloc_contiguous(&mut self, count: usize) -> Option<usize> {
+        if count == 0 {
+            return None;
+        }
+        if count == 1 {
+            return self.alloc();
+        }
+
+        let mut run_start: usize = 0;
+        let mut run_length: usize = 0;
+
+        for frame in 0..self.total_frames {
+            if self.is_free(frame) {
+                if run_length == 0 {
+                    run_start = frame;
+                }
+                run_length += 1;
+
+                if run_length >= count {
+                    // Found enough consecutive free frames. Mark them all used.
+                    for f in run_start..run_start + count {
+                        self.set(f);
+                    }
+                    self.used_frames += count;
+                    return Some(run_start);
+                }
+            } else {
+                run_length = 0;
+            }
+        }
+
+        None
+    }
+
+    // =========================================================================
+    // Range operations (initialization)
+    // =========================================================================
+
+    /// Marks `frame` as used.
+    ///
+    /// Returns `true` if it was previously free.
+    pub fn mark_used(&mut self, frame: usize) -> bool {
+        if self.is_free(frame) {
+            self.set(frame);
+            self.used_frames += 1;
+            true
+        } else {
+            false
+        }
+    }
+
+    /// Marks all frames in `[start, end)` as free (`end` is clamped to the
+    /// tracked range).
+    ///
+    /// Optimized for large ranges: handles unaligned head/tail bit-by-bit,
+    /// and clears aligned middle bytes whole-byte-at-a-time using popcount
+    /// to track how many bits were actually changed.
+    ///
+    /// # Returns
+    /// The number of frames that changed from used to free.
+    pub fn mark_free_range(&mut self, start: usize, end: usize) -> usize {
+        let end = end.min(self.total_frames);
+        if start >= end {
+            return 0;
+        }
+
+        let mut cleared = 0usize;
+        let mut frame = start;
+
+        // --- Unaligned head: clear bits until we reach a byte boundary ---
+        while frame < end && (frame % 8) != 0 {
+            if !self.is_free(frame) {
+                self.clear(frame);
+                cleared += 1;
+            }
+            frame += 1;
+        }
+
+        // --- Aligned middle: clear whole bytes at a time ---
+        while frame + 8 <= end {
+            unsafe {
+                let byte = &mut *self.bits.add(frame / 8);
+                cleared += (*byte).count_ones() as usize;
+                *byte = 0;
+            }
+            frame += 8;
+        }
+
+        // --- Unaligned tail: clear remaining bits ---
+        while frame < end {
+            if !self.is_free(frame) {
+                self.clear(frame);
+                cleared += 1;
+            }
+            frame += 1;
+        }
+
+        self.used_frames -= cleared;
+        cleared
+    }
+
+    /// Returns `true` if `frame` is free (bit is 0).
+    #[inline]
+    pub fn is_free(&self, frame: usize) -> bool {
+        unsafe { *self.bits.add(frame / 8) & (1u8 << (frame % 8)) == 0 }
+    }
+
+    // =========================================================================
+    // Bit helpers (no counter updates)
+    // =========================================================================
+
+    #[inline]
+    fn set(&mut self, frame: usize) {
+        unsafe { *self.bits.add(frame / 8) |= 1u8 << (frame % 8) }
+    }
+
+    #[inline]
+    fn clear(&mut self, frame: usize) {
+        unsafe { *self.bits.add(frame / 8) &= !(1u8 << (frame % 8)) }
+    }
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::testutil::Rng;
+    use std::vec;
+    use std::vec::Vec;
+
+    /// A bitmap over fresh storage with every frame free. The Vec owns the
+    /// storage and must outlive the bitmap.
+    fn free_bitmap(frames: usize) -> (Vec<u64>, FrameBitmap) {
+        let mut storage = vec![0u64; FrameBitmap::storage_bytes(frames) / 8];
+        let mut bm = unsafe { FrameBitmap::new_all_used(storage.as_mut_ptr() as *mut u8, frames) };
+        assert_eq!(bm.mark_free_range(0, frames), frames);
+        (storage, bm)
+    }
+
+    /// The bitmap agrees with `model` (true = used) frame by frame.
+    fn check(bm: &FrameBitmap, model: &[bool]) {
+        for (frame, &used) in model.iter().enumerate() {
+            assert_eq!(bm.is_free(frame), !used, "frame {}", frame);
+        }
+        assert_eq!(bm.used_frames(), model.iter().filter(|&&u| u).count());
+    }
+
+    #[test]
+    fn starts_all_used() {
+        let mut storage = vec![0u64; FrameBitmap::storage_bytes(100) / 8];
+        let mut bm = unsafe { FrameBitmap::new_all_used(storage.as_mut_ptr() as *mut u8, 100) };
+        assert_eq!(bm.used_frames(), 100);
+        assert_eq!(bm.alloc(), None);
+        assert_eq!(bm.alloc_contiguous(2), None);
+    }
+
+    #[test]
+    fn alloc_never_returns_frames_past_the_end() {
+        // 130 frames: the last u64 chunk is mostly padding.
+        let (_storage, mut bm) = free_bitmap(130);
+        let mut seen = vec![false; 130];
+        while let Some(frame) = bm.alloc() {
+            assert!(frame < 130);
+            assert!(!seen[frame], "frame {} handed out twice", frame);
+            seen[frame] = true;
+        }
+        assert!(seen.iter().all(|&s| s));
+        assert_eq!(bm.used_frames(), 130);
+    }
+
+    #[test]
+    fn double_free_is_reported_and_harmless() {
+        let (_storage, mut bm) = free_bitmap(64);
+        let frame = bm.alloc().unwrap();
+        assert_eq!(bm.free(frame), Ok(()));
+        assert_eq!(bm.free(frame), Err(DoubleFree));
+        assert_eq!(bm.used_frames(), 0);
+        // Never-allocated frames are double frees too.
+        assert_eq!(bm.free(63), Err(DoubleFree));
+        assert_eq!(bm.used_frames(), 0);
+    }
+
+    #[test]
+    #[should_panic]
+    fn free_out_of_range_panics() {
+        let (_storage, mut bm) = free_bitmap(64);
+        let _ = bm.free(64);
+    }
+
+    #[test]
+    fn mark_free_range_matches_model() {
+        let mut rng = Rng::new(0xB17);
+        for _ in 0..200 {
+            let frames = 1 + rng.below(300);
+            let mut storage = vec![0u64; FrameBitmap::storage_bytes(frames) / 8];
+            let mut bm = unsafe { FrameBitmap::new_all_used(storage.as_mut_ptr() as *mut u8, frames) };
+            let mut model = vec![true; frames];
+            for _ in 0..8 {
+                let start = rng.below(frames + 8);
+                let end = start + rng.below(80);
+                let expected = (start..end.min(frames)).filter(|&f| model[f]).count();
+                assert_eq!(bm.mark_free_range(start, end), expected);
+                for f in start..end.min(frames) {
+                    model[f] = false;
+                }
+                check(&bm, &model);
+            }
+        }
+    }
+
+    #[test]
+    fn random_alloc_free_matches_model() {
+        let mut rng = Rng::new(0xF4A3E);
+        for frames in [1, 7, 64, 65, 200, 1000] {
+            let (_storage, mut bm) = free_bitmap(frames);
+            let mut model = vec![false; frames];
+            let mut live: Vec<usize> = Vec::new();
+            for _ in 0..4000 {
+                if live.is_empty() || rng.chance(55) {
+                    match bm.alloc() {
+                        Some(frame) => {
+                            assert!(frame < frames);
+                            assert!(!model[frame], "frame {} allocated twice", frame);
+                            model[frame] = true;
+                            live.push(frame);
+                        }
+                        None => assert!(model.iter().all(|&u| u), "alloc failed with free frames"),
+                    }
+                } else {
+                    let frame = live.swap_remove(rng.below(live.len()));
+                    assert_eq!(bm.free(frame), Ok(()));
+                    model[frame] = false;
+                    if rng.chance(10) {
+                        assert_eq!(bm.free(frame), Err(DoubleFree));
+                    }
+                }
+                assert_eq!(bm.used_frames(), live.len());
+            }
+            check(&bm, &model);
+        }
+    }
+
+    #[test]
+    fn contiguous_runs_match_model() {
+        let mut rng = Rng::new(0xC0471);
+        let frames = 256;
+        let (_storage, mut bm) = free_bitmap(frames);
+        let mut model = vec![false; frames];
+        assert_eq!(bm.alloc_contiguous(0), None);
+        for _ in 0..2000 {
+            if rng.chance(50) {
+                // Punch single-frame holes to fragment the map.
+                let frame = rng.below(frames);
+                if model[frame] {
+                    bm.free(frame).unwrap();
+                    model[frame] = false;
+                } else {
+                    assert!(bm.mark_used(frame));
+                    model[frame] = true;
+                }
+                continue;
+            }
+            let count = 1 + rng.below(12);
+            let exists = (0..=frames.saturating_sub(count))
+                .any(|s| model[s..s + count].iter().all(|&u| !u));
+            match bm.alloc_contiguous(count) {
+                Some(start) => {
+                    assert!(start + count <= frames);
+                    assert!(model[start..start + count].iter().all(|&u| !u),
+                        "run {}+{} overlaps used frames", start, count);
+                    for f in start..start + count {
+                        model[f] = true;
+                    }
+                }
+                None => assert!(!exists, "no run of {} found but one exists", count),
+            }
+            check(&bm, &model);
+        }
+    }
+}
@@ -0,0 +1,349 @@
+// =============================================================================
+// MinimalOS NextGen — ELF64 Header Parsing (Pure)
+// =============================================================================
+//
+// Header/program-header definitions and validation for 64-bit ELF images.
+// This half of the ELF code never touches page tables or frames, so it lives
+// here where it can be built and exercised on the host. The kernel's
+// `fs::elf::load` maps the PT_LOAD segments on top of it.
+//
+// =============================================================================
+// =============================================================================
+// ELF64 Constants
+// =============================================================================
+
+/// ELF magic number: \x7FELF
+pub const ELF_MAGIC: [u8; 4] = [0x7F, b'E', b'L', b'F'];
+
+/// ELFCLASS64 — 64-bit object.
+pub const ELFCLASS64: u8 = 2;
+
+/// ELFDATA2LSB — Little-endian byte order.
+pub const ELFDATA2LSB: u8 = 1;
+
+/// ET_EXEC — Executable file (static, non-relocatable).
+pub const ET_EXEC: u16 = 2;
+
+/// ET_DYN — Shared object / Position-Independent Executable.
+/// Rust's linker may produce ET_DYN even with a fixed-address linker script.
+pub const ET_DYN: u16 = 3;
+
+/// EM_X86_64 — AMD x86-64 architecture.
+pub const EM_X86_64: u16 = 62;
+
+/// PT_LOAD — Loadable segment.
+pub const PT_LOAD: u32 = 1;
+
+/// PF_X — Execute permission.
+pub const PF_X: u32 = 1;
+
+/// PF_W — Write permission.
+pub const PF_W: u32 = 2;
+
+/// PF_R — Read permission (always implied on x86_64).
+pub const PF_R: u32 = 4;
+
+// =============================================================================
+// ELF64 Header (Elf64_Ehdr)
+// =============================================================================
+
+/// The main ELF header, located at offset 0 of every ELF binary.
+///
+/// Describes the binary's type, architecture, entry point, and the
+/// location of the program header table.
+#[repr(C, packed)]
+#[derive(Debug, Clone, Copy)]
+pub struct Elf64Ehdr {
+    /// ELF magic: [0x7F, 'E', 'L', 'F'].
+    pub e_ident: [u8; 16],
+    /// Object file type: ET_EXEC (2) for static executables.
+    pub e_type: u16,
+    /// Target architecture: EM_X86_64 (62).
+    pub e_machine: u16,
+    /// ELF version (always 1).
+    pub e_version: u32,
+    /// Virtual address of the entry point — where execution begins.
+    pub e_entry: u64,
+    /// Offset (in bytes from file start) of the program header table.
+    pub e_phoff: u64,
+    /// Offset of the section header table (unused by the loader).
+    pub e_shoff: u64,
+    /// Processor-specific flags (0 for x86_64).
+    pub e_flags: u32,
+    /// Size of this header (should be 64 for ELF64).
+    pub e_ehsize: u16,
+    /// Size of each program header entry.
+    pub e_phentsize: u16,
+    /// Number of program header entries.
+    pub e_phnum: u16,
+    /// Size of each section header entry (unused).
+    pub e_shentsize: u16,
+    /// Number of section header entries (unused).
+    pub e_shnum: u16,
+    /// Section header string table index (unused).
+    pub e_shstrndx: u16,
+}
+
+// Compile-time assertion: Elf64_Ehdr must be exactly 64 bytes.
+const _: () = assert!(core::mem::size_of::<Elf64Ehdr>() == 64);
+
+// =============================================================================
+// ELF64 Program Header (Elf64_Phdr)
+// =============================================================================
+
+/// A program header entry — describes one segment to be loaded into memory.
+///
+/// The loader iterates through the program header table and processes
+/// each PT_LOAD segment. Other segment types (PT_NOTE, PT_GNU_STACK, etc.)
+/// are silently ignored.
+#[repr(C, packed)]
+#[derive(Debug, Clone, Copy)]
+pub struct Elf64Phdr {
+    /// Segment type: PT_LOAD (1) for loadable segments.
+    pub p_type: u32,
+    /// Segment flags: PF_R (4), PF_W (2), PF_X (1).
+    pub p_flags: u32,
+    /// Offset in the file where this segment's data starts.
+    pub p_offset: u64,
+    /// Virtual address where this segment should be loaded.
+    pub p_vaddr: u64,
+    /// Physical address (unused in user-mode loading, mirrors p_vaddr).
+    pub p_paddr: u64,
+    /// Number of bytes in the file for this segment.
+    /// Data range: [p_offset, p_offset + p_filesz).
+    pub p_filesz: u64,
+    /// Number of bytes in memory for this segment.
+    /// If p_memsz > p_filesz, the extra bytes are zeroed (.bss).
+    pub p_memsz: u64,
+    /// Alignment requirement (must be a power of 2).
+    pub p_align: u64,
+}
+
+// Compile-time assertion: Elf64_Phdr must be exactly 56 bytes.
+const _: () = assert!(core::mem::size_of::<Elf64Phdr>() == 56);
+
+// =============================================================================
+// ELF Validation Errors
+// =============================================================================
+
+/// Errors that can occur during ELF parsing and loading.
+#[derive(Debug)]
+pub enum ElfError {
+    /// File is smaller than the minimum ELF header size.
+    TooSmall,
+    /// ELF magic (\x7FELF) mismatch.
+    BadMagic,
+    /// Not a 64-bit ELF (ELFCLASS64).
+    Not64Bit,
+    /// Not little-endian (ELFDATA2LSB).
+    NotLittleEndian,
+    /// Not a static executable (ET_EXEC).
+    NotExecutable,
+    /// Not targeting x86_64 (EM_X86_64).
+    WrongArch,
+    /// Program header table extends beyond the file.
+    PhdrOutOfBounds,
+    /// A PT_LOAD segment's file data extends beyond the file.
+    SegmentOutOfBounds,
+    /// A PT_LOAD segment has an invalid virtual address (kernel range).
+    BadVaddr,
+    /// Physical frame allocation failed during loading.
+    OutOfMemory,
+    /// Page mapping failed.
+    MapError,
+}
+
+// =============================================================================
+// ELF Parsing — Header Validation
+// =============================================================================
+
+/// Validates an ELF64 header and returns a reference to it.
+///
+/// Checks: magic, class (64-bit), endianness (LE), type (executable),
+/// machine (x86_64), and that the program header table fits within the file.
+pub fn validate_header(elf_data: &[u8]) -> Result<&Elf64Ehdr, ElfError> {
+    if elf_data.len() < core::mem::size_of::<Elf64Ehdr>() {
+        return Err(ElfError::TooSmall);
+    }
+
+    let ehdr = unsafe { &*(elf_data.as_ptr() as *const Elf64Ehdr) };
+
+    // Validate ELF magic
+    if ehdr.e_ident[0..4] != ELF_MAGIC {
+        return Err(ElfError::BadMagic);
+    }
+
+    // Must be 64-bit
+    if ehdr.e_ident[4] != ELFCLASS64 {
+        return Err(ElfError::Not64Bit);
+    }
+
+    // Must be little-endian
+    if ehdr.e_ident[5] != ELFDATA2LSB {
+        return Err(ElfError::NotLittleEndian);
+    }
+
+    // Must be an executable (ET_EXEC) or PIE (ET_DYN).
+    // Rust's linker on x86_64-unknown-none produces ET_DYN by default
+    // even when using a custom linker script with fixed addresses.
+    let e_type = ehdr.e_type;
+    if e_type != ET_EXEC && e_type != ET_DYN {
+        return Err(ElfError::NotExecutable);
+    }
+
+    // Must target x86_64
+    let e_machine = ehdr.e_machine;
+    if e_machine != EM_X86_64 {
+        return Err(ElfError::WrongArch);
+    }
+
+    // Validate program header table bounds. `program_headers` strides by
+    // size_of::<Elf64Phdr>(), so any other entry size is rejected too.
+    // Copy packed fields to locals to avoid unaligned reference UB
+    let e_phoff = ehdr.e_phoff;
+    let e_phnum = ehdr.e_phnum as u64;
+    let e_phentsize = ehdr.e_phentsize as usize;
+    if e_phnum != 0 && e_phentsize != core::mem::size_of::<Elf64Phdr>() {
+        return Err(ElfError::PhdrOutOfBounds);
+    }
+    let phdr_end = e_phoff.checked_add(e_phnum * core::mem::size_of::<Elf64Phdr>() as u64);
+    if phdr_end.is_none_or(|end| end > elf_data.len() as u64) {
+        return Err(ElfError::PhdrOutOfBounds);
+    }
+
+    Ok(ehdr)
+}
+
+/// Returns an iterator over the program headers in the ELF file.
+///
+/// # Safety
+/// The caller must have validated the header first via `validate_header`.
+pub fn program_headers<'a>(elf_data: &'a [u8], ehdr: &Elf64Ehdr) -> &'a [Elf64Phdr] {
+    // Copy packed fields to locals to avoid unaligned reference UB
+    let offset = ehdr.e_phoff as usize;
+    let count = ehdr.e_phnum as usize;
+    unsafe {
+        core::slice::from_raw_parts(
+            elf_data.as_ptr().add(offset) as *const Elf64Phdr,
+            count,
+        )
+    }
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::testutil::Rng;
+    use std::vec;
+    use std::vec::Vec;
+
+    const EHDR: usize = core::mem::size_of::<Elf64Ehdr>();
+    const PHDR: usize = core::mem::size_of::<Elf64Phdr>();
+
+    /// A minimal valid x86_64 executable header with `phnum` PT_LOAD
+    /// entries right after it.
+    fn image(phnum: u16) -> Vec<u8> {
+        let mut elf = vec![0u8; EHDR + phnum as usize * PHDR];
+        elf[0..4].copy_from_slice(&ELF_MAGIC);
+        elf[4] = ELFCLASS64;
+        elf[5] = ELFDATA2LSB;
+        elf[16..18].copy_from_slice(&ET_EXEC.to_le_bytes());
+        elf[18..20].copy_from_slice(&EM_X86_64.to_le_bytes());
+        elf[24..32].copy_from_slice(&0x40_1000u64.to_le_bytes());
+        elf[32..40].copy_from_slice(&(EHDR as u64).to_le_bytes());
+        elf[54..56].copy_from_slice(&(PHDR as u16).to_le_bytes());
+        elf[56..58].copy_from_slice(&phnum.to_le_bytes());
+        for i in 0..phnum as usize {
+            let ph = EHDR + i * PHDR;
+            elf[ph..ph + 4].copy_from_slice(&PT_LOAD.to_le_bytes());
+            elf[ph + 16..ph + 24].copy_from_slice(&(0x40_0000u64 + i as u64 * 0x1000).to_le_bytes());
+        }
+        elf
+    }
+
+    fn err(elf: &[u8]) -> ElfError {
+        validate_header(elf).expect_err("malformed header accepted")
+    }
+
+    #[test]
+    fn accepts_valid_image() {
+        let elf = image(3);
+        let ehdr = validate_header(&elf).unwrap();
+        let entry = ehdr.e_entry;
+        assert_eq!(entry, 0x40_1000);
+        let phdrs = program_headers(&elf, ehdr);
+        assert_eq!(phdrs.len(), 3);
+        let vaddr = phdrs[2].p_vaddr;
+        assert_eq!(vaddr, 0x40_2000);
+        assert!(validate_header(&image(0)).is_ok());
+    }
+
+    #[test]
+    fn rejects_each_bad_field() {
+        let good = image(1);
+        assert!(matches!(err(&good[..EHDR - 1]), ElfError::TooSmall));
+        assert!(matches!(err(&[]), ElfError::TooSmall));
+
+        let mut e = good.clone();
+        e[1] = b'X';
+        assert!(matches!(err(&e), ElfError::BadMagic));
+        let mut e = good.clone();
+        e[4] = 1;
+        assert!(matches!(err(&e), ElfError::Not64Bit));
+        let mut e = good.clone();
+        e[5] = 2;
+        assert!(matches!(err(&e), ElfError::NotLittleEndian));
+        let mut e = good.clone();
+        e[16] = 1;
+        assert!(matches!(err(&e), ElfError::NotExecutable));
+        let mut e = good.clone();
+        e[18] = 3;
+        assert!(matches!(err(&e), ElfError::WrongArch));
+    }
+
+    #[test]
+    fn rejects_program_header_table_outside_file() {
+        // One entry past the end.
+        let mut e = image(1);
+        e[56] = 2;
+        assert!(matches!(err(&e), ElfError::PhdrOutOfBounds));
+
+        // Offset near u64::MAX must not wrap around into bounds.
+        let mut e = image(1);
+        e[32..40].copy_from_slice(&(u64::MAX - 8).to_le_bytes());
+        assert!(matches!(err(&e), ElfError::PhdrOutOfBounds));
+
+        // A short entry size would let program_headers read past the file.
+        for phentsize in [0u16, 1, 55, 57, 0xFFFF] {
+            let mut e = image(1);
+            e[54..56].copy_from_slice(&phentsize.to_le_bytes());
+            assert!(matches!(err(&e), ElfError::PhdrOutOfBounds), "phentsize {}", phentsize);
+        }
+    }
+
+    #[test]
+    fn random_corruption_never_escapes_the_file() {
+        let mut rng = Rng::new(0xE1F);
+        for _ in 0..20_000 {
+            let mut elf = image(rng.below(4) as u16);
+            // Corrupt header fields past the identification bytes.
+            for _ in 0..1 + rng.below(6) {
+                let i = 16 + rng.below(EHDR - 16);
+                elf[i] = rng.next() as u8;
+            }
+            let len = if rng.chance(20) { rng.below(elf.len() + 1) } else { elf.len() };
+            let elf = &elf[..len];
+            if let Ok(ehdr) = validate_header(elf) {
+                let phdrs = program_headers(elf, ehdr);
+                let start = phdrs.as_ptr() as usize;
+                let end = start + phdrs.len() * PHDR;
+                let file = elf.as_ptr_range();
+                assert!(start >= file.start as usize && end <= file.end as usize);
+            }
+        }
+    }
+}
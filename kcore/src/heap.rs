@@ -0,0 +1,415 @@
+// =============================================================================
+// MinimalOS NextGen — Linked-List Free-List Heap (core)
+// =============================================================================
+//
+// The first-fit, address-ordered, coalescing free list behind the kernel
+// heap. It manages one caller-provided region and knows nothing about the
+// PMM, HHDM or locking — the kernel's `memory::heap` wraps it in a SpinLock
+// and feeds it PMM pages; a host harness can feed it a boxed byte buffer.
+//
+// See `kernel/src/memory/heap.rs` for the allocation/deallocation design.
+//
+// =============================================================================
+
+use core::alloc::Layout;
+use core::ptr;
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+/// Minimum block size: must be at least `size_of::<FreeBlock>()` so that
+/// every free region can hold the linked-list node header.
+const MIN_BLOCK_SIZE: usize = core::mem::size_of::<FreeBlock>();
+
+/// Granule of every block boundary. Sizes and alignments are rounded up
+/// to it, so the gap a split leaves is either empty or a whole block:
+/// no sliver too small to hold a header is ever dropped from the list,
+/// and every header lands on an aligned address.
+const BLOCK_ALIGN: usize = MIN_BLOCK_SIZE;
+
+// =============================================================================
+// Free block node
+// =============================================================================
+
+/// Header stored at the beginning of each free block in the heap.
+///
+/// When a region is freed, we write this header at its start address.
+/// The region must be at least `size_of::<FreeBlock>()` bytes (16 bytes
+/// on 64-bit) to hold this header.
+///
+/// # Memory layout
+/// ```text
+/// ┌──────────────────┐
+/// │ size: usize (8B) │ ← total size of this free block INCLUDING header
+/// │ next: *mut (8B)  │ ← pointer to next free block (or null)
+/// ├──────────────────┤
+/// │ ... free space ..│ ← remaining bytes available for allocation
+/// └──────────────────┘
+/// ```
+#[repr(C)]
+struct FreeBlock {
+    /// Total size of this free block in bytes (including the header).
+    size: usize,
+    /// Pointer to the next free block, or null if this is the last one.
+    next: *mut FreeBlock,
+}
+
+// =============================================================================
+// Heap internals
+// =============================================================================
+
+/// A first-fit heap: a sorted linked list of free blocks over one region.
+pub struct FreeListHeap {
+    /// Head of the free list (sorted by address, lowest first).
+    free_list: *mut FreeBlock,
+
+    /// Start of the heap region (for bounds checking in debug mode).
+    heap_start: usize,
+
+    /// End of the heap region (exclusive).
+    heap_end: usize,
+
+    /// Total bytes currently allocated (for statistics).
+    allocated_bytes: usize,
+
+    /// Total heap size in bytes.
+    total_bytes: usize,
+}
+
+// SAFETY: The heap pointers are only accessed through `&mut self`; the
+// owner (e.g. the kernel's SpinLock) provides the locking.
+unsafe impl Send for FreeListHeap {}
+
+impl FreeListHeap {
+    /// Creates an uninitialized heap. Must call `init()` before use.
+    pub const fn new() -> Self {
+        Self {
+            free_list: ptr::null_mut(),
+            heap_start: 0,
+            heap_end: 0,
+            allocated_bytes: 0,
+            total_bytes: 0,
+        }
+    }
+
+    /// Initializes the heap with the given memory region.
+    ///
+    /// Creates a single free block spanning the entire region.
+    ///
+    /// # Parameters
+    /// - `start`: Virtual address of the heap region (must be aligned to
+    ///   BLOCK_ALIGN).
+    /// - `size`: Size of the heap region in bytes (a partial trailing
+    ///   block is not used).
+    ///
+    /// # Safety
+    /// `[start, start + size)` must be valid, writable memory owned by this
+    /// heap for as long as it is used.
+    pub unsafe fn init(&mut self, start: usize, size: usize) {
+        let size = size & !(BLOCK_ALIGN - 1);
+        assert!(size >= MIN_BLOCK_SIZE, "Heap region too small");
+        assert!(
+            start % BLOCK_ALIGN == 0,
+            "Heap start must be aligned to BLOCK_ALIGN"
+        );
+
+        self.heap_start = start;
+        self.heap_end = start + size;
+        self.total_bytes = size;
+        self.allocated_bytes = 0;
+
+        // Create a single free block spanning the entire heap.
+        let block = start as *mut FreeBlock;
+        unsafe {
+            (*block).size = size;
+            (*block).next = ptr::null_mut();
+        }
+        self.free_list = block;
+    }
+
+    /// Allocates memory with the given layout.
+    ///
+    /// Uses first-fit: walks the free list and picks the first block that
+    /// can satisfy the request (including alignment).
+    ///
+    /// # Returns
+    /// A pointer to the allocated memory, or null if out of memory.
+    pub fn alloc(&mut self, layout: Layout) -> *mut u8 {
+        let size = block_size(layout);
+        let align = layout.align().max(BLOCK_ALIGN);
+
+        let mut prev: *mut FreeBlock = ptr::null_mut();
+        let mut current = self.free_list;
+
+        while !current.is_null() {
+            let block_start = current as usize;
+            let block_size = unsafe { (*current).size };
+            let block_end = block_start + block_size;
+
+            // Calculate the aligned start address within this block.
+            let alloc_start = align_up(block_start, align);
+            let alloc_end = alloc_start + size;
+
+            if alloc_end <= block_end {
+                // This block can satisfy the request.
+
+                // Unlink this block from the free list.
+                let next = unsafe { (*current).next };
+                if prev.is_null() {
+                    self.free_list = next;
+                } else {
+                    unsafe {
+                        (*prev).next = next;
+                    }
+                }
+
+                // Front gap: space between block_start and alloc_start.
+                // If big enough, return it to the free list.
+                let front_gap = alloc_start - block_start;
+                if front_gap >= MIN_BLOCK_SIZE {
+                    self.insert_free_block(block_start, front_gap);
+                }
+
+                // Back gap: space between alloc_end and block_end.
+                // If big enough, return it to the free list.
+                let back_gap = block_end - alloc_end;
+                if back_gap >= MIN_BLOCK_SIZE {
+                    self.insert_free_block(alloc_end, back_gap);
+                }
+
+                self.allocated_bytes += size;
+                return alloc_start as *mut u8;
+            }
+
+            prev = current;
+            current = unsafe { (*current).next };
+        }
+
+        // No suitable block found.
+        ptr::null_mut()
+    }
+
+    /// Frees previously allocated memory.
+    ///
+    /// Inserts the freed region back into the free list (sorted by address)
+    /// and coalesces with adjacent free blocks to reduce fragmentation.
+    ///
+    /// # Safety
+    /// `ptr` must have come from `alloc` on this heap with the same `layout`.
+    pub unsafe fn dealloc(&mut self, ptr: *mut u8, layout: Layout) {
+        let addr = ptr as usize;
+        let size = block_size(layout);
+
+        debug_assert!(
+            addr >= self.heap_start && addr + size <= self.heap_end,
+            "Heap: dealloc address outside heap bounds"
+        );
+
+        self.allocated_bytes -= size;
+        self.insert_free_block(addr, size);
+    }
+
+    /// Total bytes currently allocated.
+    pub fn allocated_bytes(&self) -> usize {
+        self.allocated_bytes
+    }
+
+    /// Total heap size in bytes.
+    pub fn total_bytes(&self) -> usize {
+        self.total_bytes
+    }
+
+    /// Inserts a free region into the free list, maintaining address order,
+    /// and coalesces with adjacent blocks.
+    fn insert_free_block(&mut self, addr: usize, size: usize) {
+        debug_assert!(size >= MIN_BLOCK_SIZE);
+
+        let new_block = addr as *mut FreeBlock;
+
+        // Find the correct insertion point: walk the list until we find
+        // a block with a higher address (or reach the end).
+        let mut prev: *mut FreeBlock = ptr::null_mut();
+        let mut current = self.free_list;
+
+        while !current.is_null() && (current as usize) < addr {
+            prev = current;
+            current = unsafe { (*current).next };
+        }
+
+        // Initialize the new block.
+        unsafe {
+            (*new_block).size = size;
+            (*new_block).next = current;
+        }
+
+        // Link from predecessor (or update head).
+        if prev.is_null() {
+            self.free_list = new_block;
+        } else {
+            unsafe {
+                (*prev).next = new_block;
+            }
+        }
+
+        // --- Coalesce with successor ---
+        // If the new block ends exactly where the next block starts,
+        // merge them into one larger block.
+        if !current.is_null() {
+            let new_end = addr + unsafe { (*new_block).size };
+            if new_end == current as usize {
+                unsafe {
+                    (*new_block).size += (*current).size;
+                    (*new_block).next = (*current).next;
+                }
+            }
+        }
+
+        // --- Coalesce with predecessor ---
+        // If the predecessor block ends exactly where the new block starts,
+        // merge them.
+        if !prev.is_null() {
+            let prev_end = prev as usize + unsafe { (*prev).size };
+            if prev_end == addr {
+                unsafe {
+                    (*prev).size += (*new_block).size;
+                    (*prev).next = (*new_block).next;
+                }
+            }
+        }
+    }
+}
+
+// =============================================================================
+// Alignment helpers
+// =============================================================================
+
+/// Bytes a block for `layout` takes out of the free list.
+#[inline]
+const fn block_size(layout: Layout) -> usize {
+    let size = if layout.size() > MIN_BLOCK_SIZE { layout.size() } else { MIN_BLOCK_SIZE };
+    align_up(size, BLOCK_ALIGN)
+}
+
+/// Aligns `value` up to the nearest multiple of `align`.
+///
+/// `align` must be a power of two.
+#[inline]
+const fn align_up(value: usize, align: usize) -> usize {
+    (value + align - 1) & !(align - 1)
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::testutil::Rng;
+    use std::vec;
+    use std::vec::Vec;
+
+    const HEAP_BYTES: usize = 64 * 1024;
+
+    /// A heap over fresh storage. The Vec owns the region and must outlive
+    /// the heap.
+    fn heap() -> (Vec<u128>, FreeListHeap) {
+        let mut storage = vec![0u128; HEAP_BYTES / 16];
+        let mut heap = FreeListHeap::new();
+        unsafe { heap.init(storage.as_mut_ptr() as usize, HEAP_BYTES); }
+        (storage, heap)
+    }
+
+    struct Live {
+        ptr: *mut u8,
+        layout: Layout,
+        tag: u8,
+    }
+
+    #[test]
+    fn exhausts_and_recovers() {
+        let (_storage, mut heap) = heap();
+        let layout = Layout::from_size_align(1000, 8).unwrap();
+        let mut ptrs = Vec::new();
+        loop {
+            let p = heap.alloc(layout);
+            if p.is_null() {
+                break;
+            }
+            ptrs.push(p);
+        }
+        assert_eq!(ptrs.len(), HEAP_BYTES / block_size(layout));
+        for p in ptrs {
+            unsafe { heap.dealloc(p, layout); }
+        }
+        assert_eq!(heap.allocated_bytes(), 0);
+        // Everything coalesced back into one block.
+        let whole = Layout::from_size_align(HEAP_BYTES, 16).unwrap();
+        assert!(!heap.alloc(whole).is_null());
+    }
+
+    #[test]
+    fn odd_sizes_leave_no_slivers() {
+        // Sizes off the 16-byte grid used to strand sub-header gaps and
+        // misalign the next free header.
+        let (_storage, mut heap) = heap();
+        let mut live = Vec::new();
+        for size in 1..200 {
+            let layout = Layout::from_size_align(size, 1).unwrap();
+            let p = heap.alloc(layout);
+            assert!(!p.is_null());
+            live.push((p, layout));
+        }
+        for (p, layout) in live.into_iter().rev() {
+            unsafe { heap.dealloc(p, layout); }
+        }
+        let whole = Layout::from_size_align(HEAP_BYTES, 16).unwrap();
+        assert!(!heap.alloc(whole).is_null());
+    }
+
+    #[test]
+    fn random_alloc_free_never_overlaps() {
+        let mut rng = Rng::new(0x4EA9);
+        let (storage, mut heap) = heap();
+        let lo = storage.as_ptr() as usize;
+        let hi = lo + HEAP_BYTES;
+        let mut live: Vec<Live> = Vec::new();
+        let mut accounted = 0usize;
+
+        for step in 0..20_000u32 {
+            if live.is_empty() || rng.chance(60) {
+                let max = if rng.chance(10) { 4096 } else { 200 };
+                let size = 1 + rng.below(max);
+                let align = 1 << rng.below(8);
+                let layout = Layout::from_size_align(size, align).unwrap();
+                let ptr = heap.alloc(layout);
+                if ptr.is_null() {
+                    continue;
+                }
+                let addr = ptr as usize;
+                assert_eq!(addr % align, 0, "misaligned for {:?}", layout);
+                assert!(addr >= lo && addr + size <= hi, "outside the heap");
+                // Fill with a tag; any overlap corrupts a neighbour's tag.
+                let tag = step as u8;
+                unsafe { core::ptr::write_bytes(ptr, tag, size); }
+                accounted += block_size(layout);
+                live.push(Live { ptr, layout, tag });
+            } else {
+                let a = live.swap_remove(rng.below(live.len()));
+                let bytes = unsafe { core::slice::from_raw_parts(a.ptr, a.layout.size()) };
+                assert!(bytes.iter().all(|&b| b == a.tag), "allocation was overwritten");
+                unsafe { heap.dealloc(a.ptr, a.layout); }
+                accounted -= block_size(a.layout);
+            }
+            assert_eq!(heap.allocated_bytes(), accounted);
+        }
+
+        for a in live.drain(..) {
+            unsafe { heap.dealloc(a.ptr, a.layout); }
+        }
+        assert_eq!(heap.allocated_bytes(), 0);
+        let whole = Layout::from_size_align(HEAP_BYTES, 16).unwrap();
+        assert!(!heap.alloc(whole).is_null(), "free list did not coalesce");
+    }
+}
@@ -0,0 +1,42 @@
+// =============================================================================
+// kcore — MinimalOS Kernel Core Data Structures
+// =============================================================================
+//
+// Kernel data structures that have no business knowing about the hardware.
+// Everything here operates on plain memory handed in by the caller:
+//
+//   bitmap — FrameBitmap: the PMM's frame allocator, over frame indices
+//   heap   — FreeListHeap: the kernel heap's first-fit coalescing free list
+//   cnode  — CapRights, CapObject, Capability, CNode
+//   tar    — read-only USTAR parser (initrd)
+//   elf    — ELF64 header / program header validation
+//   sched  — SchedContext and IPC scheduling-context donation bookkeeping
+//
+// The kernel wraps these with its locks, PhysAddr/HHDM translation and
+// logging. Nothing in this crate may print, lock, or touch hardware, so it
+// also builds for the host target (see `make kcore-host`).
+//
+// TESTS AND BENCHES:
+//   Each module carries `#[cfg(test)]` property tests next to the code:
+//   random operation sequences checked against a plain model (a Vec of
+//   flags, an array of slots), plus malformed-input cases for the parsers.
+//   They use std and a seeded xorshift (`testutil`) — still no external
+//   crates. `benches/kcore.rs` times the hot operations on the host.
+//   Run both with `make kcore-test` / `make kcore-bench`.
+//
+// =============================================================================
+
+#![no_std]
+
+#[cfg(test)]
+extern crate std;
+
+#[cfg(test)]
+mod testutil;
+
+pub mod bitmap;
+pub mod cnode;
+pub mod elf;
+pub mod heap;
+pub mod sched;
+pub mod tar;
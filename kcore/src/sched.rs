@@ -0,0 +1,284 @@
+// =============================================================================
+// MinimalOS NextGen — Scheduling Contexts and IPC Donation (core)
+// =============================================================================
+//
+// The bookkeeping half of scheduling-context donation: which context a
+// thread runs on, and whose call it is serving. The kernel's
+// `sched::scheduler` applies the result — run-queue level, the core's
+// published priority, the quantum timer — and `ipc::endpoint` calls in at
+// every rendezvous.
+//
+// DONATION LIFECYCLE:
+//   call    sender → receiver: the receiver runs on the sender's context if
+//           that outranks its own, and remembers the sender as its donor.
+//   reply   receiver → its donor: the call is over, the receiver returns to
+//           its own context.
+//   recv    a thread waiting for its next message is done with whatever it
+//           was serving — a one-way send never gets the reply that would
+//           otherwise end the donation. The exception is a server waiting
+//           on an onward call it made for its donor (`callee`): it keeps
+//           the context until that reply arrives and it replies in turn.
+//           A third thread's message reaching it meanwhile can lift its
+//           priority but not take over as donor: the chain back to the
+//           original caller stays intact.
+//
+// INVARIANT: `effective` is `own` when there is no donor, and never ranks
+// below `own`.
+//
+// =============================================================================
+
+/// Number of priority levels (0 = lowest).
+pub const NUM_PRIORITIES: usize = 8;
+
+/// TID that names no thread (`SchedState::donor`/`callee` when unset).
+pub const NO_TID: u64 = u64::MAX;
+
+/// A scheduling context: the priority and time slice a thread runs with.
+///
+/// Ready threads of a higher priority always run first; threads of equal
+/// priority share the CPU round-robin, `quantum_us` at a time.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SchedContext {
+    /// 0 ..= NUM_PRIORITIES - 1.
+    pub priority: u8,
+    /// Time slice per dispatch, microseconds.
+    pub quantum_us: u32,
+}
+
+impl SchedContext {
+    /// Every thread's context until it calls SYS_SCHED_SET.
+    pub const DEFAULT: Self = Self { priority: 3, quantum_us: 10_000 };
+}
+
+/// A thread's scheduling contexts and its place in a donation chain.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SchedState {
+    /// The thread's own context (SYS_SCHED_SET).
+    pub own: SchedContext,
+
+    /// The context the scheduler applies: `own`, or the one a caller
+    /// donated for the duration of a call.
+    pub effective: SchedContext,
+
+    /// TID of the caller whose context `effective` is (`NO_TID` if none).
+    pub donor: u64,
+
+    /// TID of the thread this one called onward while serving `donor`
+    /// and has no reply from yet (`NO_TID` if none).
+    pub callee: u64,
+}
+
+impl SchedState {
+    /// A thread's state until it calls SYS_SCHED_SET or IPC.
+    pub const DEFAULT: Self = Self {
+        own: SchedContext::DEFAULT,
+        effective: SchedContext::DEFAULT,
+        donor: NO_TID,
+        callee: NO_TID,
+    };
+
+    /// Replaces the thread's own context. A donated context stays in
+    /// force until the call ends, unless the new one outranks it.
+    pub fn set_own(&mut self, sc: SchedContext) {
+        self.own = sc;
+        if self.donor == NO_TID || sc.priority >= self.effective.priority {
+            self.effective = sc;
+        }
+    }
+
+    /// The thread waits for its next message: the donation it ran on ends
+    /// unless it is waiting on a reply to an onward call.
+    ///
+    /// # Returns
+    /// `true` if `effective` changed.
+    pub fn on_recv(&mut self) -> bool {
+        if self.donor == NO_TID || self.callee != NO_TID {
+            return false;
+        }
+        let changed = self.effective != self.own;
+        self.end_donation();
+        changed
+    }
+
+    /// Returns to the thread's own context.
+    fn end_donation(&mut self) {
+        self.effective = self.own;
+        self.donor = NO_TID;
+        self.callee = NO_TID;
+    }
+}
+
+/// Passes scheduling contexts at an IPC rendezvous.
+///
+/// - `sender` messaging the thread it serves (`sender.donor`): that is the
+///   reply, and the call is over — the sender returns to its own context.
+/// - Otherwise a call starts: `receiver` serves `sender` and runs on the
+///   sender's context if it outranks its own. A new call replaces an
+///   unfinished one, and a server calling onward passes on what it holds.
+/// - Except while the receiver waits on an onward call (`callee`): it keeps
+///   its donor — whose reply it still owes — and only takes the sender's
+///   context if that outranks the one it runs on.
+pub fn donate(sender_id: u64, sender: &mut SchedState, receiver_id: u64, receiver: &mut SchedState) {
+    if sender.donor == receiver_id {
+        sender.end_donation();
+        if receiver.callee == sender_id {
+            receiver.callee = NO_TID;
+        }
+        return;
+    }
+    if receiver.callee != NO_TID {
+        if sender.effective.priority > receiver.effective.priority {
+            receiver.effective = sender.effective;
+        }
+        return;
+    }
+    receiver.effective = if sender.effective.priority > receiver.own.priority {
+        sender.effective
+    } else {
+        receiver.own
+    };
+    receiver.donor = sender_id;
+    if sender.donor != NO_TID {
+        sender.callee = receiver_id;
+    }
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::testutil::Rng;
+
+    const CLIENT: u64 = 1;
+    const SERVER: u64 = 2;
+    const BACKEND: u64 = 3;
+
+    fn prio(priority: u8) -> SchedState {
+        let mut s = SchedState::DEFAULT;
+        s.set_own(SchedContext { priority, quantum_us: 1_000 * (priority as u32 + 1) });
+        s
+    }
+
+    #[test]
+    fn call_boosts_and_reply_reverts() {
+        let (mut client, mut server) = (prio(6), prio(2));
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        assert_eq!(server.effective, client.own);
+        assert_eq!(server.donor, CLIENT);
+
+        donate(SERVER, &mut server, CLIENT, &mut client);
+        assert_eq!(server, prio(2));
+        assert_eq!(client, prio(6));
+    }
+
+    #[test]
+    fn lower_caller_does_not_demote() {
+        let (mut client, mut server) = (prio(1), prio(4));
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        assert_eq!(server.effective, server.own);
+    }
+
+    #[test]
+    fn one_way_send_reverts_at_next_recv() {
+        let (mut client, mut server) = (prio(6), prio(2));
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        assert_eq!(server.effective.priority, 6);
+
+        // No reply ever comes; the server goes back to recv.
+        assert!(server.on_recv());
+        assert_eq!(server, prio(2));
+        assert!(!server.on_recv());
+        // A plain client waiting for its reply is unaffected.
+        assert!(!client.on_recv());
+        assert_eq!(client, prio(6));
+    }
+
+    #[test]
+    fn onward_call_keeps_the_chain_across_recv() {
+        let (mut client, mut server, mut backend) = (prio(6), prio(2), prio(1));
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        donate(SERVER, &mut server, BACKEND, &mut backend);
+        assert_eq!(backend.effective.priority, 6);
+
+        // The server waits for the backend's reply: still serving the client.
+        assert!(!server.on_recv());
+        assert_eq!(server.effective.priority, 6);
+
+        donate(BACKEND, &mut backend, SERVER, &mut server);
+        assert_eq!(backend, prio(1));
+        assert_eq!(server.callee, NO_TID);
+        assert_eq!(server.effective.priority, 6);
+
+        donate(SERVER, &mut server, CLIENT, &mut client);
+        assert_eq!(server, prio(2));
+    }
+
+    #[test]
+    fn message_mid_chain_keeps_the_donor() {
+        const OTHER: u64 = 4;
+        let (mut client, mut server, mut backend) = (prio(5), prio(2), prio(1));
+        let mut other = prio(6);
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        donate(SERVER, &mut server, BACKEND, &mut backend);
+
+        // Another client's message lands while the server awaits the backend.
+        donate(OTHER, &mut other, SERVER, &mut server);
+        assert_eq!(server.donor, CLIENT);
+        assert_eq!(server.callee, BACKEND);
+        assert_eq!(server.effective, other.own, "a higher sender still lifts it");
+        assert_eq!(other, prio(6));
+
+        // The chain unwinds to the original caller, not into it.
+        donate(BACKEND, &mut backend, SERVER, &mut server);
+        assert_eq!(server.callee, NO_TID);
+        donate(SERVER, &mut server, CLIENT, &mut client);
+        assert_eq!(server, prio(2));
+        assert_eq!(client, prio(5));
+    }
+
+    #[test]
+    fn set_own_during_a_call() {
+        let (mut client, mut server) = (prio(6), prio(2));
+        donate(CLIENT, &mut client, SERVER, &mut server);
+        server.set_own(SchedContext { priority: 4, quantum_us: 5_000 });
+        assert_eq!(server.effective.priority, 6, "donation stays in force");
+        server.set_own(SchedContext { priority: 7, quantum_us: 5_000 });
+        assert_eq!(server.effective.priority, 7, "own context outranks it");
+        donate(SERVER, &mut server, CLIENT, &mut client);
+        assert_eq!(server.effective, server.own);
+    }
+
+    #[test]
+    fn random_traffic_keeps_invariant() {
+        const N: usize = 6;
+        let mut rng = Rng::new(0xD0A7E);
+        let mut threads: [SchedState; N] = core::array::from_fn(|i| prio(i as u8 % NUM_PRIORITIES as u8));
+        for _ in 0..50_000 {
+            let a = rng.below(N);
+            let b = rng.below(N);
+            if a == b {
+                threads[a].on_recv();
+            } else if rng.chance(5) {
+                threads[a].set_own(SchedContext { priority: rng.below(NUM_PRIORITIES) as u8, quantum_us: 1_000 });
+            } else {
+                let (s, r) = if a < b {
+                    let (lo, hi) = threads.split_at_mut(b);
+                    (&mut lo[a], &mut hi[0])
+                } else {
+                    let (lo, hi) = threads.split_at_mut(a);
+                    (&mut hi[0], &mut lo[b])
+                };
+                donate(a as u64, s, b as u64, r);
+            }
+            for t in &threads {
+                assert!(t.effective.priority >= t.own.priority);
+                if t.donor == NO_TID {
+                    assert_eq!(t.effective, t.own);
+                }
+            }
+        }
+    }
+}
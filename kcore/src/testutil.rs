@@ -0,0 +1,38 @@
+// =============================================================================
+// MinimalOS NextGen — kcore Test Helpers (host only)
+// =============================================================================
+//
+// Deterministic randomness for the property tests. Every test seeds its own
+// generator, so a failing sequence replays exactly on the next run.
+//
+// =============================================================================
+
+/// xorshift64* — tiny, fast and good enough to shuffle operation sequences.
+pub struct Rng(u64);
+
+impl Rng {
+    /// Creates a generator; any seed works (zero is remapped).
+    pub fn new(seed: u64) -> Self {
+        Self(seed | 1)
+    }
+
+    /// Next 64 random bits.
+    pub fn next(&mut self) -> u64 {
+        let mut x = self.0;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        self.0 = x;
+        x.wrapping_mul(0x2545_F491_4F6C_DD1D)
+    }
+
+    /// Uniform-ish value in `0..n` (`n` > 0).
+    pub fn below(&mut self, n: usize) -> usize {
+        (self.next() % n as u64) as usize
+    }
+
+    /// True with probability `percent`/100.
+    pub fn chance(&mut self, percent: u32) -> bool {
+        self.below(100) < percent as usize
+    }
+}
@@ -1,13 +1,14 @@
 // =============================================================================
-// MinimalOS NextGen — ACPI Table Parser (MADT Extraction)
+// MinimalOS NextGen — ACPI Table Parser (MADT + MCFG Extraction)
 // =============================================================================
 //
 // Minimal ACPI parser for extracting interrupt controller topology from the
-// MADT (Multiple APIC Description Table). This is the only ACPI table we
-// parse in Sprint 3 — future sprints add FADT, HPET, etc.
+// MADT (Multiple APIC Description Table) and the PCIe ECAM windows from the
+// MCFG. Future sprints add FADT, HPET, etc.
 //
 // ACPI TABLE HIERARCHY:
 //   RSDP → XSDT (or RSDT) → MADT ("APIC" signature)
+//                         → MCFG ("MCFG" signature, optional)
 //
 // CRITICAL: XSDT vs RSDT
 // ======================
@@ -25,6 +26,11 @@
 //     Type 2: Interrupt Source Override (10 bytes) — ISA IRQ remapping
 //     Type 4: Local APIC NMI        (6 bytes)  — NMI wiring
 //
+// MCFG STRUCTURE:
+//   Header (44 bytes) = SDT header (36 bytes) + 8 reserved bytes
+//   Followed by 16-byte allocation entries: ECAM base (u64), segment (u16),
+//   start bus (u8), end bus (u8), reserved (u32).
+//
 // =============================================================================
 
 use crate::kprintln;
@@ -118,8 +124,18 @@ struct MadtIso {
     flags: u16,             // Polarity and trigger mode
 }
 
+/// MCFG allocation entry — one ECAM window per PCI segment / bus range.
+#[repr(C, packed)]
+struct McfgEntry {
+    base_address: u64,      // Physical base of the window (address of bus 0)
+    segment: u16,           // PCI segment group
+    start_bus: u8,
+    end_bus: u8,
+    reserved: u32,
+}
+
 // =============================================================================
-// Public types — returned from parse_madt()
+// Public types — returned from parse_madt() / parse_mcfg()
 // =============================================================================
 
 /// Information about a single I/O APIC found in the MADT.
@@ -172,6 +188,33 @@ pub struct MadtInfo {
     pub override_count: usize,
 }
 
+/// One PCIe ECAM window from the MCFG.
+///
+/// Function `bus:dev.fn` lives at `base + (bus << 20 | dev << 15 | fn << 12)`
+/// — `base` is the address of bus 0 even when `start_bus` is not 0.
+#[derive(Debug, Clone, Copy)]
+pub struct EcamRegion {
+    pub base: u64,
+    pub segment: u16,
+    pub start_bus: u8,
+    pub end_bus: u8,
+}
+
+/// All information extracted from the MCFG.
+pub struct McfgInfo {
+    pub regions: [EcamRegion; 4],
+    pub region_count: usize,
+}
+
+impl McfgInfo {
+    fn new() -> Self {
+        Self {
+            regions: [EcamRegion { base: 0, segment: 0, start_bus: 0, end_bus: 0 }; 4],
+            region_count: 0,
+        }
+    }
+}
+
 impl MadtInfo {
     fn new() -> Self {
         Self {
@@ -202,15 +245,70 @@ impl MadtInfo {
 ///
 /// # Panics
 /// - If RSDP signature is invalid
-/// - If ACPI revision is 0 (RSDT-only) — we require XSDT
-/// - If MADT is not found in the XSDT
+/// - If MADT is not found in the XSDT / RSDT
 pub fn parse_madt(rsdp_phys: u64) -> MadtInfo {
+    kprintln!("[acpi] RSDP physical: {:#018X}", rsdp_phys);
+    match find_table(rsdp_phys, b"APIC") {
+        Some(madt_phys) => {
+            kprintln!("[acpi] Found MADT at physical: {:#018X}", madt_phys);
+            parse_madt_table(madt_phys)
+        }
+        None => panic!("[acpi] MADT (\"APIC\") not found in XSDT/RSDT"),
+    }
+}
+
+/// Parses the ACPI MCFG table (PCI Express ECAM regions).
+///
+/// Returns `None` if the firmware has no MCFG (legacy PCI only, e.g. QEMU
+/// `-M pc`); callers then stay on port I/O config access.
+pub fn parse_mcfg(rsdp_phys: u64) -> Option<McfgInfo> {
+    let mcfg_phys = find_table(rsdp_phys, b"MCFG")?;
+    kprintln!("[acpi] Found MCFG at physical: {:#018X}", mcfg_phys);
+
+    let mcfg_virt = PhysAddr::new(mcfg_phys).to_virt();
+    let header = unsafe { &*mcfg_virt.as_ptr::<SdtHeader>() };
+    let table_length = unsafe { ptr::addr_of!(header.length).read_unaligned() } as usize;
+
+    // Entries start after the 36-byte header + 8 reserved bytes.
+    let entries_start = mem::size_of::<SdtHeader>() + 8;
+    let entry_size = mem::size_of::<McfgEntry>();
+
+    let mut info = McfgInfo::new();
+    let mut offset = entries_start;
+    while offset + entry_size <= table_length && info.region_count < info.regions.len() {
+        let entry = unsafe { &*((mcfg_virt.as_u64() + offset as u64) as *const McfgEntry) };
+        let base = unsafe { ptr::addr_of!(entry.base_address).read_unaligned() };
+        let segment = unsafe { ptr::addr_of!(entry.segment).read_unaligned() };
+        let region = EcamRegion {
+            base,
+            segment,
+            start_bus: entry.start_bus,
+            end_bus: entry.end_bus,
+        };
+        kprintln!("[acpi]   ECAM: segment {} buses {:02X}-{:02X} @ {:#012X}",
+            segment, region.start_bus, region.end_bus, base);
+        info.regions[info.region_count] = region;
+        info.region_count += 1;
+        offset += entry_size;
+    }
+
+    Some(info)
+}
+
+// =============================================================================
+// Root table walk
+// =============================================================================
+
+/// Finds the table with signature `sig` via the RSDP's XSDT (ACPI 2.0+)
+/// or RSDT (ACPI 1.0). Returns its physical address.
+///
+/// # Panics
+/// If the RSDP or root table signature is invalid.
+fn find_table(rsdp_phys: u64, sig: &[u8; 4]) -> Option<u64> {
     // =========================================================================
     // Step 1: Validate and parse the RSDP
     // =========================================================================
-    kprintln!("[acpi] RSDP physical: {:#018X}", rsdp_phys);
     let rsdp_virt = PhysAddr::new(rsdp_phys).to_virt();
-    kprintln!("[acpi] RSDP virtual (HHDM): {:#018X}", rsdp_virt.as_u64());
     let rsdp_v1 = unsafe { &*rsdp_virt.as_ptr::<RsdpV1>() };
 
     // Validate RSDP signature
@@ -218,8 +316,6 @@ pub fn parse_madt(rsdp_phys: u64) -> MadtInfo {
         panic!("[acpi] Invalid RSDP signature");
     }
 
-    kprintln!("[acpi] RSDP revision: {}", rsdp_v1.revision);
-
     // =========================================================================
     // Step 2: Get the root table (XSDT required for ACPI 2.0+)
     // =========================================================================
@@ -229,88 +325,44 @@ pub fn parse_madt(rsdp_phys: u64) -> MadtInfo {
         // We support it as a fallback but log a warning.
         kprintln!("[acpi] WARNING: ACPI 1.0 (RSDT) — 32-bit pointers, may miss high tables");
         let rsdt_addr = unsafe { ptr::addr_of!(rsdp_v1.rsdt_address).read_unaligned() };
-        return parse_from_rsdt(rsdt_addr as u64);
+        return find_in_root(rsdt_addr as u64, b"RSDT", 4, sig);
     }
 
     // ACPI 2.0+ — use XSDT (64-bit pointers).
     let rsdp_v2 = unsafe { &*rsdp_virt.as_ptr::<RsdpV2>() };
     let xsdt_phys = unsafe { ptr::addr_of!(rsdp_v2.xsdt_address).read_unaligned() };
 
-    kprintln!("[acpi] XSDT at physical: {:#018X}", xsdt_phys);
-
-    parse_from_xsdt(xsdt_phys)
+    find_in_root(xsdt_phys, b"XSDT", 8, sig)
 }
 
-// =============================================================================
-// Root table parsers
-// =============================================================================
+/// Walks an XSDT (`ptr_size` 8) or RSDT (`ptr_size` 4) looking for `sig`.
+fn find_in_root(root_phys: u64, root_sig: &[u8; 4], ptr_size: usize, sig: &[u8; 4]) -> Option<u64> {
+    let root_virt = PhysAddr::new(root_phys).to_virt();
+    let header = unsafe { &*root_virt.as_ptr::<SdtHeader>() };
 
-/// Parses tables from the XSDT (64-bit pointers). Preferred path.
-fn parse_from_xsdt(xsdt_phys: u64) -> MadtInfo {
-    let xsdt_virt = PhysAddr::new(xsdt_phys).to_virt();
-    let header = unsafe { &*xsdt_virt.as_ptr::<SdtHeader>() };
-
-    // Validate XSDT signature
-    if &header.signature != b"XSDT" {
-        panic!("[acpi] Invalid XSDT signature: {:?}", header.signature);
+    if &header.signature != root_sig {
+        panic!("[acpi] Invalid root table signature: {:?}", header.signature);
     }
 
     let header_size = mem::size_of::<SdtHeader>();
     let table_length = unsafe { ptr::addr_of!(header.length).read_unaligned() } as usize;
-    let entries_bytes = table_length.saturating_sub(header_size);
-    let entry_count = entries_bytes / 8; // 64-bit pointers
-
-    kprintln!("[acpi] XSDT: {} table entries", entry_count);
+    let entry_count = table_length.saturating_sub(header_size) / ptr_size;
 
-    // Walk all XSDT entries (each is a 64-bit physical address of an SDT).
     for i in 0..entry_count {
-        let entry_offset = header_size + i * 8;
-        let entry_virt = PhysAddr::new(xsdt_phys + entry_offset as u64).to_virt();
-        let table_phys = unsafe { entry_virt.as_ptr::<u64>().read_unaligned() };
+        let entry_virt = PhysAddr::new(root_phys + (header_size + i * ptr_size) as u64).to_virt();
+        let table_phys = if ptr_size == 8 {
+            unsafe { entry_virt.as_ptr::<u64>().read_unaligned() }
+        } else {
+            unsafe { entry_virt.as_ptr::<u32>().read_unaligned() as u64 }
+        };
 
         let table_header = unsafe { &*PhysAddr::new(table_phys).to_virt().as_ptr::<SdtHeader>() };
-        let sig = &table_header.signature;
-
-        if sig == b"APIC" {
-            kprintln!("[acpi] Found MADT at physical: {:#018X}", table_phys);
-            return parse_madt_table(table_phys);
-        }
-    }
-
-    panic!("[acpi] MADT (\"APIC\") not found in XSDT");
-}
-
-/// Parses tables from the RSDT (32-bit pointers). Fallback for BIOS.
-fn parse_from_rsdt(rsdt_phys: u64) -> MadtInfo {
-    let rsdt_virt = PhysAddr::new(rsdt_phys).to_virt();
-    let header = unsafe { &*rsdt_virt.as_ptr::<SdtHeader>() };
-
-    if &header.signature != b"RSDT" {
-        panic!("[acpi] Invalid RSDT signature: {:?}", header.signature);
-    }
-
-    let header_size = mem::size_of::<SdtHeader>();
-    let table_length = unsafe { ptr::addr_of!(header.length).read_unaligned() } as usize;
-    let entries_bytes = table_length.saturating_sub(header_size);
-    let entry_count = entries_bytes / 4; // 32-bit pointers
-
-    kprintln!("[acpi] RSDT: {} table entries (32-bit pointers)", entry_count);
-
-    for i in 0..entry_count {
-        let entry_offset = header_size + i * 4;
-        let entry_virt = PhysAddr::new(rsdt_phys + entry_offset as u64).to_virt();
-        let table_phys = unsafe { entry_virt.as_ptr::<u32>().read_unaligned() } as u64;
-
-        let table_header = unsafe { &*PhysAddr::new(table_phys).to_virt().as_ptr::<SdtHeader>() };
-        let sig = &table_header.signature;
-
-        if sig == b"APIC" {
-            kprintln!("[acpi] Found MADT at physical: {:#018X}", table_phys);
-            return parse_madt_table(table_phys);
+        if &table_header.signature == sig {
+            return Some(table_phys);
         }
     }
 
-    panic!("[acpi] MADT (\"APIC\") not found in RSDT");
+    None
 }
 
 // =============================================================================
@@ -58,10 +58,13 @@ pub fn halt() {
 ///
 /// Disables interrupts and then halts. The CPU will never wake up.
 /// Used for fatal errors (double fault, panic) where we can't continue.
+/// Buffered serial output is pushed out first (the THRE interrupt that
+/// would drain it will never be taken).
 ///
 /// This function never returns.
 #[inline(always)]
 pub fn halt_forever() -> ! {
+    super::serial::flush_sync();
     loop {
         // SAFETY: CLI + HLT in a loop ensures the CPU stays stopped.
         // No interrupt can wake us because interrupts are disabled.
@@ -155,6 +158,42 @@ pub unsafe fn write_cr3(value: u64) {
     }
 }
 
+/// Reads the current value of the CR4 register.
+///
+/// CR4 holds per-core feature enables (PAE, PGE, OSFXSR, PCE, ...).
+#[inline]
+pub fn read_cr4() -> u64 {
+    let value: u64;
+    // SAFETY: Reading CR4 is privileged but has no side effects.
+    unsafe {
+        core::arch::asm!(
+            "mov {}, cr4",
+            out(reg) value,
+            options(nomem, nostack, preserves_flags)
+        );
+    }
+    value
+}
+
+/// Writes a new value to the CR4 register.
+///
+/// CR4 writes serialize the core, so callers should skip the write when
+/// the value is unchanged.
+///
+/// # Safety
+/// Clearing bits the kernel depends on (PAE, PGE) crashes the system.
+#[inline]
+pub unsafe fn write_cr4(value: u64) {
+    // SAFETY: Caller guarantees the new value keeps paging intact.
+    unsafe {
+        core::arch::asm!(
+            "mov cr4, {}",
+            in(reg) value,
+            options(nostack, preserves_flags)
+        );
+    }
+}
+
 /// Invalidates a single page in the TLB.
 ///
 /// When we change a single page table entry (e.g., mapping a new page),
@@ -263,3 +302,43 @@ pub unsafe fn write_msr(msr: u32, value: u64) {
         );
     }
 }
+
+/// IA32_PAT — the Page Attribute Table MSR.
+const IA32_PAT: u32 = 0x277;
+
+/// Our PAT layout: the power-on default with entry 1 turned into WC.
+///
+///   index (PAT:PCD:PWT)  0 WB  1 WC  2 UC-  3 UC  4 WB  5 WT  6 UC-  7 UC
+///
+/// A PTE with only PWT set therefore selects write-combining — in 4K PTEs
+/// and 2M PDEs alike, because PWT/PCD sit at the same bits in both (the
+/// PAT bit does not). No kernel mapping uses PWT=1 for write-through.
+const PAT_VALUE: u64 = 0x0007_0406_0007_0106;
+
+/// Programs IA32_PAT with `PAT_VALUE` on the current core.
+///
+/// The SDM requires every core to use the same PAT, so the BSP calls this
+/// before building the kernel page tables and every AP in `ap_rust_entry`.
+/// (Limine leaves its own layout behind; its WC framebuffer mapping at
+/// entry 5 degrades to WT until the CR3 swap, which is harmless.)
+pub fn init_pat() {
+    // CPUID.01H:EDX[16] — PAT. Present on every x86_64 CPU, but check anyway.
+    let (_, _, _, edx) = cpuid(1, 0);
+    if edx & (1 << 16) == 0 {
+        return;
+    }
+    // SAFETY: IA32_PAT exists when CPUID reports PAT; the value only uses
+    // architectural memory types.
+    unsafe { write_msr(IA32_PAT, PAT_VALUE); }
+}
+
+/// Executes CPUID for `leaf` / `subleaf`.
+///
+/// # Returns
+/// `(eax, ebx, ecx, edx)`.
+#[inline]
+pub fn cpuid(leaf: u32, subleaf: u32) -> (u32, u32, u32, u32) {
+    // SAFETY: CPUID is available on all x86_64 CPUs and has no side effects.
+    let r = unsafe { core::arch::x86_64::__cpuid_count(leaf, subleaf) };
+    (r.eax, r.ebx, r.ecx, r.edx)
+}
@@ -211,7 +211,7 @@ struct GdtPointer {
 // Inter-core access does not occur.
 
 /// Maximum supported CPU cores.
-const MAX_CPUS: usize = 64;
+pub const MAX_CPUS: usize = 64;
 
 static mut GDT_ARRAY: [[u64; GDT_ENTRY_COUNT]; MAX_CPUS] = [[0; GDT_ENTRY_COUNT]; MAX_CPUS];
 static mut TSS_ARRAY: [Tss; MAX_CPUS] = {
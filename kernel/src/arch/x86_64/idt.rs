@@ -307,6 +307,9 @@ irq_stub!(irq_13_stub, "45");   // FPU
 irq_stub!(irq_14_stub, "46");   // Primary IDE
 irq_stub!(irq_15_stub, "47");   // Secondary IDE
 
+// Reschedule IPI (sched::scheduler::RESCHEDULE_VECTOR)
+irq_stub!(reschedule_stub, "240");
+
 // Spurious interrupt vector (255)
 irq_stub!(spurious_stub, "255");
 
@@ -314,6 +317,17 @@ irq_stub!(spurious_stub, "255");
 // Exception dispatcher (called from assembly stubs)
 // =============================================================================
 
+/// A #DE, #UD, #GP or #PF raised in Ring 3 is the faulting thread's own
+/// problem (e.g. an AOT Wasm guest hitting its guard region): the thread
+/// is marked Dead and the core goes on scheduling. Returns only for
+/// kernel-mode faults, which still halt.
+fn kill_user_thread(frame: &InterruptFrame) {
+    if frame.cs & 3 == 3 {
+        kprintln!("  Ring 3 fault — killing the faulting thread");
+        crate::sched::thread::thread_exit();
+    }
+}
+
 /// Central exception dispatcher — called by all exception stubs.
 ///
 /// Receives the full InterruptFrame via RDI (System V ABI).
@@ -328,6 +342,7 @@ pub extern "C" fn exception_dispatch(frame: &InterruptFrame) {
             kprintln!("  CS:     {:#06X}", frame.cs);
             kprintln!("  RFLAGS: {:#018X}", frame.rflags);
             kprintln!("  RSP:    {:#018X}", frame.rsp);
+            kill_user_thread(frame);
             cpu::halt_forever();
         }
 
@@ -336,6 +351,7 @@ pub extern "C" fn exception_dispatch(frame: &InterruptFrame) {
             kprintln!("EXCEPTION: #UD Invalid Opcode");
             kprintln!("  RIP:    {:#018X}", frame.rip);
             kprintln!("  CS:     {:#06X}", frame.cs);
+            kill_user_thread(frame);
             cpu::halt_forever();
         }
 
@@ -383,6 +399,7 @@ pub extern "C" fn exception_dispatch(frame: &InterruptFrame) {
             kprintln!("  RIP:    {:#018X}", frame.rip);
             kprintln!("  CS:     {:#06X}", frame.cs);
             kprintln!("  RSP:    {:#018X}", frame.rsp);
+            kill_user_thread(frame);
             cpu::halt_forever();
         }
 
@@ -400,6 +417,7 @@ pub extern "C" fn exception_dispatch(frame: &InterruptFrame) {
             kprintln!("    {}",   if err & 16 != 0 { "Instruction fetch (NX)" } else { "Data access" });
             kprintln!("  RIP:    {:#018X}", frame.rip);
             kprintln!("  RSP:    {:#018X}", frame.rsp);
+            kill_user_thread(frame);
             cpu::halt_forever();
         }
 
@@ -438,6 +456,16 @@ pub extern "C" fn irq_dispatch(frame: &InterruptFrame) {
             // interrupt can occur between EOI and the context switch.
             crate::arch::lapic::eoi();
 
+            // Serial TX safety net (one atomic load when idle).
+            crate::arch::serial::poll_tx();
+
+            // Profiling builds: take a sample; between quanta the profiler
+            // re-arms the timer itself and we must not reschedule.
+            #[cfg(feature = "profile")]
+            if crate::profile::on_timer(frame) {
+                return;
+            }
+
             // Trigger the context switch (picks next thread, swaps RSP)
             unsafe { crate::sched::scheduler::schedule(); }
 
@@ -445,6 +473,15 @@ pub extern "C" fn irq_dispatch(frame: &InterruptFrame) {
             return;
         }
 
+        240 => {
+            // Reschedule IPI: another core placed a thread on this (idle
+            // or tickless isolated) core. Same EOI-first rule as the
+            // timer; schedule() drains the inbox and switches to it.
+            crate::arch::lapic::eoi();
+            unsafe { crate::sched::scheduler::schedule(); }
+            return;
+        }
+
         255 => {
             // Spurious interrupt — do NOT send EOI.
             // The LAPIC generates these when the interrupt is no longer pending
@@ -452,6 +489,13 @@ pub extern "C" fn irq_dispatch(frame: &InterruptFrame) {
             return;
         }
 
+        36 => {
+            // COM1 (IRQ 4): refill the kernel TX FIFO, then wake the
+            // Ring 3 serial driver if it is blocked on this IRQ.
+            crate::arch::serial::on_irq();
+            crate::arch::syscall::notify_irq_waiters(4);
+        }
+
         v => {
             // Hardware IRQ: vector 33-47 → IRQ 1-15
             // Check if any thread is blocked on SYS_WAIT_IRQ for this IRQ.
@@ -538,6 +582,11 @@ pub fn init() {
     idt[46] = IdtEntry::interrupt_gate(handler_addr!(irq_14_stub), 0);
     idt[47] = IdtEntry::interrupt_gate(handler_addr!(irq_15_stub), 0);
 
+    // =====================================================================
+    // Reschedule IPI (240)
+    // =====================================================================
+    idt[240] = IdtEntry::interrupt_gate(handler_addr!(reschedule_stub), 0);
+
     // =====================================================================
     // Spurious interrupt vector (255)
     // =====================================================================
@@ -559,6 +608,6 @@ pub fn init() {
         );
     }
 
-    kprintln!("[idt] IDT loaded: {} exception handlers, {} IRQ handlers, spurious @255",
+    kprintln!("[idt] IDT loaded: {} exception handlers, {} IRQ handlers, reschedule @240, spurious @255",
         15, 16); // 15 exception vectors registered + 16 IRQ stubs
 }
@@ -62,6 +62,10 @@ const LVT_MASK: u32 = 1 << 16;
 // Spurious vector register bits
 const SPURIOUS_ENABLE: u32 = 1 << 8;
 
+// ICR low bits (fixed delivery mode and physical destination are both 0)
+const ICR_LEVEL_ASSERT: u32 = 1 << 14;
+const ICR_SEND_PENDING: u32 = 1 << 12;
+
 // =============================================================================
 // Global state
 // =============================================================================
@@ -72,6 +76,9 @@ static LAPIC_BASE: AtomicU64 = AtomicU64::new(0);
 /// Calibrated LAPIC timer ticks per microsecond.
 static TICKS_PER_US: AtomicU64 = AtomicU64::new(0);
 
+/// TSC frequency in Hz, measured alongside the LAPIC timer (0 = unknown).
+static TSC_HZ: AtomicU64 = AtomicU64::new(0);
+
 // =============================================================================
 // MMIO helpers
 // =============================================================================
@@ -140,6 +147,21 @@ pub fn id() -> u8 {
     (read_reg(LAPIC_ID) >> 24) as u8
 }
 
+/// Sends a fixed-delivery IPI with `vector` to the core with `lapic_id`.
+///
+/// The ICR is written high half first — the write to the low half sends.
+/// Waits until the LAPIC has accepted the IPI (delivery status idle).
+///
+/// Must be called with IF=0: an interrupt handler that sends its own IPI
+/// between the two writes would change the destination under us.
+pub fn send_ipi(lapic_id: u32, vector: u8) {
+    write_reg(LAPIC_ICR_HI, lapic_id << 24);
+    write_reg(LAPIC_ICR_LO, ICR_LEVEL_ASSERT | vector as u32);
+    while read_reg(LAPIC_ICR_LO) & ICR_SEND_PENDING != 0 {
+        core::hint::spin_loop();
+    }
+}
+
 /// Calibrates the LAPIC timer to determine ticks per microsecond.
 ///
 /// Tries CPUID Leaf 0x15 first (direct crystal clock info, most accurate).
@@ -181,6 +203,7 @@ pub fn calibrate_timer() {
 
             if ticks_per_us > 0 {
                 TICKS_PER_US.store(ticks_per_us, Ordering::Relaxed);
+                TSC_HZ.store(tsc_hz, Ordering::Relaxed);
                 kprintln!("[lapic] Calibrated via CPUID 0x15:");
                 kprintln!("[lapic]   Crystal: {} MHz", crystal_hz / 1_000_000);
                 kprintln!("[lapic]   TSC:     {} MHz", tsc_hz / 1_000_000);
@@ -225,14 +248,17 @@ pub fn calibrate_timer() {
         // Enable PIT channel 2 gate.
         let gate = port_in_u8(PIT_GATE);
         port_out_u8(PIT_GATE, (gate & 0xFD) | 0x01); // Gate enable
+        let tsc_start = crate::arch::cpu::read_tsc();
 
         // Wait for PIT to count down (bit 5 of port 0x61 goes high when done).
         while port_in_u8(PIT_GATE) & 0x20 == 0 {
             core::hint::spin_loop();
         }
 
-        // Read how much the LAPIC timer counted down.
+        // Read how much the LAPIC timer (and the TSC) counted.
         let elapsed = 0xFFFF_FFFFu64 - read_reg(LAPIC_TIMER_CUR) as u64;
+        let tsc_elapsed = crate::arch::cpu::read_tsc() - tsc_start;
+        TSC_HZ.store(tsc_elapsed * (1000 / PIT_INTERVAL_MS as u64), Ordering::Relaxed);
 
         // Mask the timer while we calculate.
         write_reg(LAPIC_LVT_TIMER, LVT_MASK);
@@ -252,6 +278,12 @@ pub fn calibrate_timer() {
     }
 }
 
+/// TSC frequency in Hz as measured by `calibrate_timer()` (0 before
+/// calibration). Used to turn TSC deltas into wall time.
+pub fn tsc_hz() -> u64 {
+    TSC_HZ.load(Ordering::Relaxed)
+}
+
 /// Arms the LAPIC timer in one-shot mode.
 ///
 /// The timer will fire a single interrupt on vector 32 after `microseconds`
@@ -275,6 +307,12 @@ pub fn set_timer_oneshot(microseconds: u64) {
     write_reg(LAPIC_TIMER_INIT, count);
 }
 
+/// Cancels a pending one-shot timer (writing 0 to the initial count stops
+/// the countdown without firing).
+pub fn stop_timer() {
+    write_reg(LAPIC_TIMER_INIT, 0);
+}
+
 /// Sends End of Interrupt to the LAPIC.
 ///
 /// Must be called at the end of every interrupt handler for LAPIC-delivered
@@ -36,3 +36,4 @@ pub mod ioapic;
 pub mod smp;
 pub mod syscall;
 pub mod pci;
+pub mod pmu;
@@ -2,14 +2,20 @@
 // MinimalOS NextGen — PCI Configuration Space Driver (Sprint 11)
 // =============================================================================
 //
-// Enumerates the PCI bus using the legacy Port I/O mechanism:
-//   - CONFIG_ADDRESS (0xCF8): 32-bit address register
-//   - CONFIG_DATA    (0xCFC): 32-bit data register
+// Two configuration access mechanisms:
 //
-// This is the most universally supported PCI access method on x86_64.
-// MCFG (PCIe MMIO configuration) can be added later for extended config space.
+//   ECAM (PCIe, preferred) — every function's 4 KiB config space is
+//     memory-mapped. The window comes from the ACPI MCFG table; `init_ecam()`
+//     records it and `pml4::build()` maps it uncacheable into the HHDM.
+//     One access = one MMIO load/store.
 //
-// Address format (CONFIG_ADDRESS):
+//       addr = ecam_base + (bus << 20 | device << 15 | func << 12 | offset)
+//
+//   Port I/O (legacy fallback, no MCFG) — two port accesses per register:
+//     - CONFIG_ADDRESS (0xCF8): 32-bit address register
+//     - CONFIG_DATA    (0xCFC): 32-bit data register
+//
+// Port I/O address format (CONFIG_ADDRESS):
 //   Bit 31:      Enable bit (must be 1)
 //   Bits 23-16:  Bus number (0-255)
 //   Bits 15-11:  Device number (0-31)
@@ -17,10 +23,28 @@
 //   Bits 7-2:    Register offset (6 bits, 4-byte aligned)
 //   Bits 1-0:    Always 0
 //
+// ENUMERATION:
+//   Instead of probing all 256 buses × 32 devices, `enumerate_buses()`
+//   starts at the host bridge's bus and only descends into secondary buses
+//   of PCI-to-PCI bridges that actually exist. The result is cached in a
+//   device table (`for_each_device`, `find_device`) so drivers never
+//   rescan config space.
+//
+// Only PCI segment 0 is supported (one ECAM window) — every x86 desktop
+// and QEMU machine we target has a single segment.
+//
 // =============================================================================
 
+extern crate alloc;
+
+use alloc::vec::Vec;
 use core::arch::asm;
+use core::sync::atomic::{AtomicU64, AtomicU8, Ordering};
+
+use crate::arch::acpi::McfgInfo;
 use crate::kprintln;
+use crate::memory::address;
+use crate::sync::spinlock::SpinLock;
 
 /// PCI Configuration Address port (write-only for address selection).
 const CONFIG_ADDRESS: u16 = 0xCF8;
@@ -28,27 +52,126 @@ const CONFIG_ADDRESS: u16 = 0xCF8;
 /// PCI Configuration Data port (read/write for register access).
 const CONFIG_DATA: u16 = 0xCFC;
 
+// ─── ECAM Window ────────────────────────────────────────────────────────────
+
+/// Physical address of bus 0 in the segment-0 ECAM window (0 = no ECAM).
+static ECAM_PHYS: AtomicU64 = AtomicU64::new(0);
+
+/// First and last bus decoded by the ECAM window.
+static ECAM_START_BUS: AtomicU8 = AtomicU8::new(0);
+static ECAM_END_BUS: AtomicU8 = AtomicU8::new(0);
+
+/// Records the segment-0 ECAM window from the MCFG.
+///
+/// Must run before `memory::pml4::build()` (which maps the window) and
+/// before any config space access.
+pub fn init_ecam(mcfg: &McfgInfo) {
+    for region in &mcfg.regions[..mcfg.region_count] {
+        if region.segment != 0 {
+            kprintln!("[pci] Ignoring ECAM window for segment {}", region.segment);
+            continue;
+        }
+        ECAM_START_BUS.store(region.start_bus, Ordering::Relaxed);
+        ECAM_END_BUS.store(region.end_bus, Ordering::Relaxed);
+        ECAM_PHYS.store(region.base, Ordering::Release);
+        kprintln!("[pci] ECAM enabled: buses {:02X}-{:02X} @ {:#012X}",
+            region.start_bus, region.end_bus, region.base);
+        return;
+    }
+}
+
+/// Physical range `(start, length)` of the ECAM window, for `pml4::build()`.
+pub fn ecam_window() -> Option<(u64, u64)> {
+    let base = ECAM_PHYS.load(Ordering::Acquire);
+    if base == 0 {
+        return None;
+    }
+    let start = ECAM_START_BUS.load(Ordering::Relaxed) as u64;
+    let end = ECAM_END_BUS.load(Ordering::Relaxed) as u64;
+    Some((base + (start << 20), (end - start + 1) << 20))
+}
+
+/// HHDM address of a config register through ECAM, or `None` if the bus is
+/// not covered (then the caller falls back to port I/O).
+#[inline]
+fn ecam_addr(bus: u8, device: u8, func: u8, offset: u8) -> Option<u64> {
+    let base = ECAM_PHYS.load(Ordering::Relaxed);
+    if base == 0
+        || bus < ECAM_START_BUS.load(Ordering::Relaxed)
+        || bus > ECAM_END_BUS.load(Ordering::Relaxed)
+    {
+        return None;
+    }
+    Some(address::hhdm_offset() + base
+        + ((bus as u64) << 20 | (device as u64) << 15 | (func as u64) << 12)
+        + (offset & 0xFC) as u64)
+}
+
 // ─── Discovered Virtio-Block I/O Base ───────────────────────────────────────
 
 /// Cached I/O port base for the first Virtio-Block device found during
 /// PCI enumeration (vendor 0x1AF4, device 0x1001, BAR 0 in I/O space).
 ///
-/// Written once during single-threaded boot, read-only after.
+/// Written once by the `pci` boot task (possibly on an AP), read-only after
+/// `kmain` joins that task.
 static mut VIRTIO_BLK_IO_BASE: Option<(u16, u16)> = None;
 
 /// Returns the Virtio-Block device's I/O port base and size, if one was
 /// discovered during PCI enumeration.
 ///
 /// # Safety
-/// Safe to call after `enumerate_buses()` has completed (single-threaded init).
+/// Safe to call after `enumerate_buses()` has completed (the `pci` boot
+/// task has been joined).
 pub fn get_virtio_blk_io_base() -> Option<(u16, u16)> {
     unsafe { VIRTIO_BLK_IO_BASE }
 }
 
+// ─── Device Table ───────────────────────────────────────────────────────────
+
+/// One PCI function found by `enumerate_buses()`.
+#[derive(Debug, Clone, Copy)]
+pub struct PciDevice {
+    pub bus: u8,
+    pub device: u8,
+    pub func: u8,
+    pub vendor_id: u16,
+    pub device_id: u16,
+    pub class: u8,
+    pub subclass: u8,
+    pub prog_if: u8,
+    /// Header type without the multi-function bit (0 = endpoint, 1 = bridge).
+    pub header_type: u8,
+    /// Number of bridges between the host bridge and this function.
+    pub depth: u8,
+    /// For PCI-to-PCI bridges: the bus behind the bridge.
+    pub secondary_bus: Option<u8>,
+}
+
+/// Cached device tree in discovery (depth-first) order: a bridge is
+/// followed by everything behind it.
+static DEVICES: SpinLock<Vec<PciDevice>> = SpinLock::new(Vec::new());
+
+/// Calls `f` for every cached PCI function, in tree order.
+pub fn for_each_device(mut f: impl FnMut(&PciDevice)) {
+    for dev in DEVICES.lock().iter() {
+        f(dev);
+    }
+}
+
+/// Returns the first cached function with the given vendor/device ID.
+pub fn find_device(vendor_id: u16, device_id: u16) -> Option<PciDevice> {
+    DEVICES.lock().iter()
+        .find(|d| d.vendor_id == vendor_id && d.device_id == device_id)
+        .copied()
+}
+
 // ─── Raw PCI Configuration Space Access ─────────────────────────────────────
 
 /// Reads a 32-bit register from the PCI configuration space.
 ///
+/// Goes through ECAM when the bus is inside the MCFG window, port I/O
+/// otherwise.
+///
 /// # Arguments
 /// - `bus`:    PCI bus number (0-255)
 /// - `device`: Device number on the bus (0-31)
@@ -56,9 +179,13 @@ pub fn get_virtio_blk_io_base() -> Option<(u16, u16)> {
 /// - `offset`: Register offset (must be 4-byte aligned, low 2 bits ignored)
 ///
 /// # Safety
-/// Performs raw x86 I/O port operations. Must be called from Ring 0.
+/// Performs raw MMIO or x86 I/O port operations. Must be called from Ring 0.
 #[inline]
 pub unsafe fn read_config_32(bus: u8, device: u8, func: u8, offset: u8) -> u32 {
+    if let Some(addr) = ecam_addr(bus, device, func, offset) {
+        return unsafe { core::ptr::read_volatile(addr as *const u32) };
+    }
+
     let address: u32 = 0x8000_0000
         | ((bus as u32) << 16)
         | ((device as u32) << 11)
@@ -88,13 +215,18 @@ pub unsafe fn read_config_32(bus: u8, device: u8, func: u8, offset: u8) -> u32 {
     data
 }
 
-/// Writes a 32-bit value to the PCI configuration space.
+/// Writes a 32-bit value to the PCI configuration space (ECAM or port I/O).
 ///
 /// # Safety
-/// Performs raw x86 I/O port operations. Must be called from Ring 0.
+/// Performs raw MMIO or x86 I/O port operations. Must be called from Ring 0.
 /// Writing to the wrong register can brick a device or corrupt system state.
 #[inline]
 pub unsafe fn write_config_32(bus: u8, device: u8, func: u8, offset: u8, value: u32) {
+    if let Some(addr) = ecam_addr(bus, device, func, offset) {
+        unsafe { core::ptr::write_volatile(addr as *mut u32, value) };
+        return;
+    }
+
     let address: u32 = 0x8000_0000
         | ((bus as u32) << 16)
         | ((device as u32) << 11)
@@ -209,69 +341,124 @@ pub unsafe fn read_bar(bus: u8, device: u8, func: u8, bar_index: u8) -> Option<B
 
 // ─── PCI Bus Enumeration ────────────────────────────────────────────────────
 
-/// Enumerates the entire PCI configuration space (buses 0-255).
+/// Enumerates the PCI hierarchy and caches the device tree.
 ///
-/// For each valid device/function found, logs the vendor ID, device ID,
-/// class code, and subclass to the kernel serial console.
+/// Starts at the host bridge (00:00.0) — if it is multi-function, function
+/// N is the host controller for bus N — and recurses into the secondary bus
+/// of every PCI-to-PCI bridge found. Empty buses are never touched.
 ///
-/// Uses brute-force scanning: checks all 256 buses × 32 devices.
-/// For each device, checks function 0 first, then probes functions 1-7
-/// only if the device is multi-function (header type bit 7 set).
+/// For each function: logs it, probes Virtio BARs, records it in the
+/// device table. Safe to call once (boot task); the table is replaced.
 pub fn enumerate_buses() {
-    kprintln!("[pci] Enumerating PCI configuration space...");
+    kprintln!("[pci] Enumerating PCI hierarchy via {}...",
+        if ECAM_PHYS.load(Ordering::Acquire) != 0 { "ECAM" } else { "port I/O" });
 
-    let mut device_count: u32 = 0;
+    let mut found = Vec::new();
+    let mut visited = [0u64; 4];
 
-    for bus in 0u16..=255 {
-        for device in 0u8..32 {
-            // Check Function 0 — if vendor is 0xFFFF, no device present
-            let vendor_id = unsafe { read_config_32(bus as u8, device, 0, 0) } & 0xFFFF;
-            if vendor_id == 0xFFFF {
-                continue;
+    let host_header = (unsafe { read_config_32(0, 0, 0, 0x0C) } >> 16) & 0xFF;
+    if host_header & 0x80 == 0 {
+        scan_bus(0, 0, &mut visited, &mut found);
+    } else {
+        for func in 0u8..8 {
+            let vendor = unsafe { read_config_32(0, 0, func, 0) } & 0xFFFF;
+            if vendor != 0xFFFF {
+                scan_bus(func, 0, &mut visited, &mut found);
             }
+        }
+    }
 
-            log_device(bus as u8, device, 0);
-            probe_bars_if_virtio(bus as u8, device, 0);
-            device_count += 1;
-
-            // Check if multi-function (Header Type bit 7)
-            let header_type = (unsafe { read_config_32(bus as u8, device, 0, 0x0C) } >> 16) & 0xFF;
-            if (header_type & 0x80) != 0 {
-                for func in 1u8..8 {
-                    let vendor = unsafe { read_config_32(bus as u8, device, func, 0) } & 0xFFFF;
-                    if vendor != 0xFFFF {
-                        log_device(bus as u8, device, func);
-                        probe_bars_if_virtio(bus as u8, device, func);
-                        device_count += 1;
-                    }
+    let buses: u32 = visited.iter().map(|w| w.count_ones()).sum();
+    kprintln!("[pci] Enumeration complete: {} device(s) on {} bus(es)", found.len(), buses);
+    *DEVICES.lock() = found;
+}
+
+/// Scans the 32 device slots of `bus`, recursing through bridges.
+fn scan_bus(bus: u8, depth: u8, visited: &mut [u64; 4], out: &mut Vec<PciDevice>) {
+    let (word, bit) = (bus as usize / 64, bus as usize % 64);
+    if visited[word] & (1 << bit) != 0 {
+        return; // Misconfigured bridge loop — each bus is scanned once.
+    }
+    visited[word] |= 1 << bit;
+
+    for device in 0u8..32 {
+        // Check Function 0 — if vendor is 0xFFFF, no device present
+        let vendor_id = unsafe { read_config_32(bus, device, 0, 0) } & 0xFFFF;
+        if vendor_id == 0xFFFF {
+            continue;
+        }
+
+        scan_function(bus, device, 0, depth, visited, out);
+
+        // Check if multi-function (Header Type bit 7)
+        let header_type = (unsafe { read_config_32(bus, device, 0, 0x0C) } >> 16) & 0xFF;
+        if (header_type & 0x80) != 0 {
+            for func in 1u8..8 {
+                let vendor = unsafe { read_config_32(bus, device, func, 0) } & 0xFFFF;
+                if vendor != 0xFFFF {
+                    scan_function(bus, device, func, depth, visited, out);
                 }
             }
         }
     }
-
-    kprintln!("[pci] Enumeration complete: {} device(s) found", device_count);
 }
 
-/// Reads and logs the identification registers for a single PCI function.
-fn log_device(bus: u8, device: u8, func: u8) {
+/// Records one function and, if it is a PCI-to-PCI bridge, scans the bus
+/// behind it.
+fn scan_function(bus: u8, device: u8, func: u8, depth: u8,
+                 visited: &mut [u64; 4], out: &mut Vec<PciDevice>) {
     // Register 0x00: Vendor ID (low 16) | Device ID (high 16)
     let reg0 = unsafe { read_config_32(bus, device, func, 0x00) };
-    let vendor_id = reg0 & 0xFFFF;
-    let device_id = reg0 >> 16;
-
     // Register 0x08: Revision (7:0) | Prog IF (15:8) | Subclass (23:16) | Class (31:24)
     let class_info = unsafe { read_config_32(bus, device, func, 0x08) };
-    let class = (class_info >> 24) & 0xFF;
-    let subclass = (class_info >> 16) & 0xFF;
-    let prog_if = (class_info >> 8) & 0xFF;
+    let header_type = ((unsafe { read_config_32(bus, device, func, 0x0C) } >> 16) & 0x7F) as u8;
 
+    // Type 1 header, register 0x18: Primary (7:0) | Secondary (15:8) | Subordinate (23:16)
+    let secondary_bus = if header_type == 1 {
+        Some(((unsafe { read_config_32(bus, device, func, 0x18) } >> 8) & 0xFF) as u8)
+    } else {
+        None
+    };
+
+    let dev = PciDevice {
+        bus,
+        device,
+        func,
+        vendor_id: (reg0 & 0xFFFF) as u16,
+        device_id: (reg0 >> 16) as u16,
+        class: (class_info >> 24) as u8,
+        subclass: (class_info >> 16) as u8,
+        prog_if: (class_info >> 8) as u8,
+        header_type,
+        depth,
+        secondary_bus,
+    };
+    log_device(&dev);
+    probe_bars_if_virtio(bus, device, func);
+    out.push(dev);
+
+    // Bus 0 behind a bridge means firmware left it unconfigured.
+    if let Some(secondary) = secondary_bus {
+        if secondary != 0 {
+            scan_bus(secondary, depth.saturating_add(1), visited, out);
+        }
+    }
+}
+
+/// Logs the identification registers of one function, indented by depth.
+fn log_device(dev: &PciDevice) {
     kprintln!(
-        "[pci]   {:02X}:{:02X}.{} — Vendor:{:04X} Device:{:04X} | Class:{:02X} Sub:{:02X} ProgIF:{:02X} ({})",
-        bus, device, func,
-        vendor_id, device_id,
-        class, subclass, prog_if,
-        class_name(class, subclass),
+        "[pci]   {:indent$}{:02X}:{:02X}.{} — Vendor:{:04X} Device:{:04X} | Class:{:02X} Sub:{:02X} ProgIF:{:02X} ({})",
+        "", dev.bus, dev.device, dev.func,
+        dev.vendor_id, dev.device_id,
+        dev.class, dev.subclass, dev.prog_if,
+        class_name(dev.class as u32, dev.subclass as u32),
+        indent = dev.depth as usize * 2,
     );
+    if let Some(secondary) = dev.secondary_bus {
+        kprintln!("[pci]   {:indent$}╰─ bridge → bus {:02X}", "", secondary,
+            indent = dev.depth as usize * 2);
+    }
 }
 
 /// Probes and logs all BARs for Virtio devices (Vendor 0x1AF4).
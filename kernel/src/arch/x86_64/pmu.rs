@@ -0,0 +1,294 @@
+// =============================================================================
+// MinimalOS NextGen — Architectural Performance Monitoring (PMU)
+// =============================================================================
+//
+// Intel's architectural PMU (CPUID leaf 0x0A) gives every core a handful of
+// general-purpose counters, each programmed by one MSR pair:
+//
+//   IA32_PERFEVTSELx (0x186 + x) — what to count (event, umask, USR/OS, EN)
+//   IA32_PMCx        (0x0C1 + x) — the running count
+//
+// 64-BIT COUNTS:
+//   A WRMSR to IA32_PMCx only sets the low 32 bits and sign-extends bit 31,
+//   so a saved count at or above 2^31 cannot be written back there. When
+//   IA32_PERF_CAPABILITIES.FW_WRITE is set, counts are restored through the
+//   full-width alias IA32_A_PMCx (0x4C1 + x). Otherwise only the low 31
+//   bits go back into the hardware and the rest stays in `PmuState::base`;
+//   SYS_PMU_READ adds the two, while a raw `rdpmc` from Ring 3 sees just
+//   the hardware part (fine for deltas within one time slice).
+//
+// PER-THREAD VIRTUALIZATION:
+//   Counters belong to threads, not cores. A thread that programs a counter
+//   (SYS_PMU_CONFIG, gated by a `CapObject::Pmu` capability) gets a
+//   `PmuState` hanging off its TCB. `scheduler::schedule` calls `switch()`
+//   on every context switch:
+//
+//     prev has PmuState → stop counters, save base + PMCx into prev.pmu
+//     next has PmuState → load PMCx from next.pmu, re-enable its EVTSELs,
+//                         set CR4.PCE so Ring 3 can `rdpmc` directly
+//     next has none     → clear CR4.PCE
+//
+//   Threads that never touch the PMU cost two null checks per switch.
+//   CR4.PCE is only set while a capability holder runs, so `rdpmc` from
+//   any other thread still raises #GP.
+//
+// ARCHITECTURAL EVENTS (event | umask << 8):
+//   0x003C cycles, 0x00C0 instructions, 0x4F2E LLC references,
+//   0x412E LLC misses, 0x00C4 branches, 0x00C5 branch misses.
+//   TLB misses are model-specific — pass the raw event/umask for the CPU
+//   (e.g. Airmont/N3710 PAGE_WALKS: event 0x05, umask 0x01 data side).
+//
+// DEGRADING GRACEFULLY:
+//   No vPMU (QEMU/TCG, KVM without `-cpu host`) reports version 0 or zero
+//   counters in CPUID 0x0A. Then `available()` is false, the PMU syscalls
+//   return PMU_UNSUPPORTED and the context switch hook is a no-op.
+//
+// =============================================================================
+
+extern crate alloc;
+
+use alloc::boxed::Box;
+use core::sync::atomic::{AtomicBool, AtomicU8, Ordering};
+
+use crate::arch::cpu;
+use crate::kprintln;
+use crate::sched::thread::Thread;
+
+/// Most general-purpose counters we virtualize per thread.
+pub const MAX_COUNTERS: usize = 8;
+
+/// IA32_PERFEVTSEL0 — event select for counter 0 (counter x at +x).
+const IA32_PERFEVTSEL0: u32 = 0x186;
+
+/// IA32_PMC0 — counter 0 (counter x at +x).
+const IA32_PMC0: u32 = 0x0C1;
+
+/// IA32_A_PMC0 — full-width write alias of counter 0 (counter x at +x).
+const IA32_A_PMC0: u32 = 0x4C1;
+
+/// IA32_PERF_CAPABILITIES — present when CPUID.01H:ECX.PDCM[15] is set.
+const IA32_PERF_CAPABILITIES: u32 = 0x345;
+
+/// IA32_PERF_CAPABILITIES.FW_WRITE — IA32_A_PMCx are writable.
+const PERF_CAP_FW_WRITE: u64 = 1 << 13;
+
+/// CPUID.01H:ECX.PDCM — IA32_PERF_CAPABILITIES is implemented.
+const CPUID_1_ECX_PDCM: u32 = 1 << 15;
+
+/// Largest value a legacy IA32_PMCx write preserves (bit 31 sign-extends).
+const LEGACY_WRITE_MASK: u64 = 0x7FFF_FFFF;
+
+/// IA32_PERF_GLOBAL_CTRL (PMU version ≥ 2) — per-counter master enable.
+const IA32_PERF_GLOBAL_CTRL: u32 = 0x38F;
+
+/// EVTSEL.PC / INT / ANY / EN — kernel-controlled bits.
+const EVTSEL_PC: u64 = 1 << 19;
+const EVTSEL_INT: u64 = 1 << 20;
+const EVTSEL_ANY: u64 = 1 << 21;
+const EVTSEL_EN: u64 = 1 << 22;
+
+/// EVTSEL bits userspace may set: event, umask, USR, OS, E (edge), INV, CMASK.
+/// PC and INT (overflow interrupts), ANY (count the sibling thread) and EN
+/// stay kernel-controlled.
+const EVTSEL_USER_MASK: u64 = 0xFFFF_FFFF & !(EVTSEL_PC | EVTSEL_INT | EVTSEL_ANY | EVTSEL_EN);
+
+/// CR4.PCE — allow RDPMC at CPL 3.
+const CR4_PCE: u64 = 1 << 8;
+
+/// PMU version from CPUID.0AH:EAX[7:0] (0 = no PMU).
+static VERSION: AtomicU8 = AtomicU8::new(0);
+
+/// Number of usable general-purpose counters (≤ MAX_COUNTERS).
+static NUM_COUNTERS: AtomicU8 = AtomicU8::new(0);
+
+/// Counter width in bits, CPUID.0AH:EAX[23:16].
+static COUNTER_WIDTH: AtomicU8 = AtomicU8::new(0);
+
+/// Counts are written back through IA32_A_PMCx (see 64-BIT COUNTS).
+static FULL_WIDTH_WRITE: AtomicBool = AtomicBool::new(false);
+
+/// Saved counter state of one thread.
+pub struct PmuState {
+    /// Programmed event selects (0 = counter unused). EN is not stored.
+    pub evtsel: [u64; MAX_COUNTERS],
+    /// Full counter values while the thread is switched out.
+    pub count: [u64; MAX_COUNTERS],
+    /// While the thread runs: the part of each count the hardware counter
+    /// does not hold (always 0 with FULL_WIDTH_WRITE).
+    pub base: [u64; MAX_COUNTERS],
+}
+
+impl PmuState {
+    pub const fn new() -> Self {
+        Self { evtsel: [0; MAX_COUNTERS], count: [0; MAX_COUNTERS], base: [0; MAX_COUNTERS] }
+    }
+}
+
+// =============================================================================
+// Detection
+// =============================================================================
+
+/// Probes CPUID leaf 0x0A on the BSP. APs share the result (same package).
+pub fn init() {
+    let (max_leaf, _, _, _) = cpu::cpuid(0, 0);
+    if max_leaf < 0x0A {
+        kprintln!("[pmu] CPUID leaf 0x0A not available — PMU disabled");
+        return;
+    }
+
+    let (eax, _, _, _) = cpu::cpuid(0x0A, 0);
+    let version = (eax & 0xFF) as u8;
+    let counters = ((eax >> 8) & 0xFF) as u8;
+    let width = ((eax >> 16) & 0xFF) as u8;
+
+    if version == 0 || counters == 0 {
+        kprintln!("[pmu] No architectural PMU (version {}, {} counters) — PMU disabled",
+            version, counters);
+        return;
+    }
+
+    let counters = counters.min(MAX_COUNTERS as u8);
+    let (_, _, ecx1, _) = cpu::cpuid(1, 0);
+    let fw_write = ecx1 & CPUID_1_ECX_PDCM != 0
+        && unsafe { cpu::read_msr(IA32_PERF_CAPABILITIES) } & PERF_CAP_FW_WRITE != 0;
+    FULL_WIDTH_WRITE.store(fw_write, Ordering::Relaxed);
+    COUNTER_WIDTH.store(width, Ordering::Relaxed);
+    NUM_COUNTERS.store(counters, Ordering::Relaxed);
+    VERSION.store(version, Ordering::Release);
+    init_cpu();
+    kprintln!("[pmu] Architectural PMU v{}: {} counters × {} bits{}", version, counters, width,
+        if fw_write { " (full-width writes)" } else { "" });
+}
+
+/// Per-core setup: open the global enable for every GP counter.
+///
+/// Individual counters still only count while their EVTSEL.EN is set.
+pub fn init_cpu() {
+    if !available() {
+        return;
+    }
+    if VERSION.load(Ordering::Relaxed) >= 2 {
+        let mask = (1u64 << NUM_COUNTERS.load(Ordering::Relaxed)) - 1;
+        unsafe { cpu::write_msr(IA32_PERF_GLOBAL_CTRL, mask); }
+    }
+}
+
+/// True if an architectural PMU was detected.
+#[inline]
+pub fn available() -> bool {
+    VERSION.load(Ordering::Acquire) != 0
+}
+
+/// Packed PMU geometry for SYS_PMU_INFO: version | counters << 8 | width << 16.
+pub fn info() -> u64 {
+    VERSION.load(Ordering::Relaxed) as u64
+        | (NUM_COUNTERS.load(Ordering::Relaxed) as u64) << 8
+        | (COUNTER_WIDTH.load(Ordering::Relaxed) as u64) << 16
+}
+
+/// Number of usable counters (0 without a PMU).
+#[inline]
+pub fn num_counters() -> usize {
+    NUM_COUNTERS.load(Ordering::Relaxed) as usize
+}
+
+// =============================================================================
+// Programming (current thread only, IF=0)
+// =============================================================================
+
+/// Programs counter `idx` of the CURRENT thread with `event` and zeroes it.
+/// `event == 0` stops the counter. Takes effect immediately.
+pub fn configure(thread: &mut Thread, idx: usize, event: u64) {
+    let state = thread.pmu.get_or_insert_with(|| Box::new(PmuState::new()));
+    let evtsel = event & EVTSEL_USER_MASK;
+    state.evtsel[idx] = evtsel;
+    state.count[idx] = 0;
+    unsafe {
+        cpu::write_msr(IA32_PERFEVTSEL0 + idx as u32, 0);
+        load_counter(state, idx, 0);
+        if evtsel != 0 {
+            cpu::write_msr(IA32_PERFEVTSEL0 + idx as u32, evtsel | EVTSEL_EN);
+        }
+        set_pce(true);
+    }
+}
+
+/// Reads counter `idx` of the CURRENT thread (live value).
+///
+/// # Returns
+/// `None` if the thread never programmed a counter — the hardware then
+/// still holds whatever the last thread on this core left in it.
+pub fn read(thread: &Thread, idx: usize) -> Option<u64> {
+    let state = thread.pmu.as_deref()?;
+    if state.evtsel[idx] == 0 {
+        return Some(state.count[idx]);
+    }
+    Some(state.base[idx] + unsafe { cpu::read_msr(IA32_PMC0 + idx as u32) })
+}
+
+// =============================================================================
+// Context switch hook
+// =============================================================================
+
+/// Saves `prev`'s counters and loads `next`'s. Called by `schedule()` with
+/// IF=0, before `switch_context`.
+///
+/// # Safety
+/// Both pointers must be valid TCBs (or null for `prev`).
+#[inline]
+pub unsafe fn switch(prev: *mut Thread, next: *mut Thread) {
+    let prev_pmu = if prev.is_null() { None } else { unsafe { (*prev).pmu.as_deref_mut() } };
+    if prev_pmu.is_none() && unsafe { (*next).pmu.is_none() } {
+        return;
+    }
+
+    let n = num_counters();
+    if let Some(state) = prev_pmu {
+        for i in 0..n {
+            if state.evtsel[i] != 0 {
+                unsafe {
+                    cpu::write_msr(IA32_PERFEVTSEL0 + i as u32, 0);
+                    state.count[i] = state.base[i] + cpu::read_msr(IA32_PMC0 + i as u32);
+                }
+            }
+        }
+    }
+
+    match unsafe { (*next).pmu.as_deref_mut() } {
+        Some(state) => unsafe {
+            for i in 0..n {
+                load_counter(state, i, state.count[i]);
+                if state.evtsel[i] != 0 {
+                    cpu::write_msr(IA32_PERFEVTSEL0 + i as u32, state.evtsel[i] | EVTSEL_EN);
+                }
+            }
+            set_pce(true);
+        },
+        None => unsafe { set_pce(false) },
+    }
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+/// Puts `value` into hardware counter `idx` for the running thread, keeping
+/// whatever a legacy IA32_PMCx write cannot hold in `state.base`.
+unsafe fn load_counter(state: &mut PmuState, idx: usize, value: u64) {
+    if FULL_WIDTH_WRITE.load(Ordering::Relaxed) {
+        state.base[idx] = 0;
+        unsafe { cpu::write_msr(IA32_A_PMC0 + idx as u32, value); }
+    } else {
+        state.base[idx] = value & !LEGACY_WRITE_MASK;
+        unsafe { cpu::write_msr(IA32_PMC0 + idx as u32, value & LEGACY_WRITE_MASK); }
+    }
+}
+
+/// Sets or clears CR4.PCE (skips the write if already in that state).
+unsafe fn set_pce(on: bool) {
+    let cr4 = cpu::read_cr4();
+    let new = if on { cr4 | CR4_PCE } else { cr4 & !CR4_PCE };
+    if new != cr4 {
+        unsafe { cpu::write_cr4(new); }
+    }
+}
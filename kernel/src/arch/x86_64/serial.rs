@@ -50,11 +50,43 @@
 //   The lock ensures characters from different kprintln!() calls don't
 //   get interleaved.
 //
+// TWO TX MODES:
+//   Polled (boot until `enable_tx_irq()`, and again after a panic):
+//     wait for LSR.THRE, which in FIFO mode means the whole 16-byte TX
+//     FIFO is empty, then write up to 16 bytes back to back. One LSR read
+//     per 16 bytes instead of one per byte.
+//
+//   Interrupt-driven (after `sti` in kmain):
+//     kprintln!() only copies bytes into an 8 KiB ring and, if the FIFO
+//     is idle, tops it up with the first 16. When the FIFO runs dry the
+//     UART raises THRE on IRQ 4 (vector 36) and `on_irq()` moves the next
+//     16 bytes. Callers never wait for the UART unless the ring is full:
+//
+//       FullPolicy::Block — drain synchronously until there is room
+//       FullPolicy::Drop  — discard the byte and count it (`dropped()`)
+//
+//   IRQ 4 is shared with the Ring 3 serial_drv (IoPort + Interrupt caps);
+//   `irq_dispatch` runs `on_irq()` before waking its SYS_WAIT_IRQ waiter.
+//   Reading IIR only acknowledges THRE, so pending RX stays for the driver.
+//
+//   `flush_sync()` (halt_forever) and `set_polled()` (panic) push out
+//   whatever is still buffered, so last words are never stuck in the ring.
+//
+// SINGLE OWNER OF THE TRANSMITTER:
+//   A 16-byte burst is only safe when nobody else writes THR between the
+//   THRE check and the last byte. So the kernel is the only writer of
+//   COM1's data register: SYS_PORT_OUT and SYS_PORT_WRITE aimed at
+//   CONSOLE_DATA_PORT land in `write_raw()`, which queues the bytes in the
+//   same ring under the same lock as kprintln!(). User programs (init,
+//   hello_aot, serial_drv) keep their IoPort caps for everything else —
+//   LSR, IER, RX.
+//
 // =============================================================================
 
 use crate::sync::spinlock::SpinLock;
 use core::fmt;
 use core::fmt::Write;
+use core::sync::atomic::{AtomicBool, AtomicU8, Ordering};
 
 // =============================================================================
 // I/O Port Addresses for COM1
@@ -68,6 +100,7 @@ const COM1_BASE: u16 = 0x3F8;
 const DATA_REG: u16 = 0;         // +0: TX/RX data (or divisor low when DLAB=1)
 const INT_ENABLE_REG: u16 = 1;   // +1: Interrupt enable (or divisor high when DLAB=1)
 const FIFO_CTRL_REG: u16 = 2;    // +2: FIFO control
+const INT_ID_REG: u16 = 2;      // +2: Interrupt identification (read)
 const LINE_CTRL_REG: u16 = 3;    // +3: Line control (data bits, parity, stop bits)
 const MODEM_CTRL_REG: u16 = 4;   // +4: Modem control (DTR, RTS, loopback)
 const LINE_STATUS_REG: u16 = 5;  // +5: Line status (TX empty, RX ready, errors)
@@ -76,6 +109,48 @@ const LINE_STATUS_REG: u16 = 5;  // +5: Line status (TX empty, RX ready, errors)
 const LSR_TX_EMPTY: u8 = 1 << 5;   // Transmit Holding Register Empty
 const LSR_RX_READY: u8 = 1 << 0;   // Data Ready (byte received)
 
+/// Interrupt Enable Register: THR empty interrupt (ETBEI).
+const IER_TX_EMPTY: u8 = 1 << 1;
+
+/// Data register of the console UART. Ring 3 writes to it are routed
+/// through `write_raw()` (see SINGLE OWNER OF THE TRANSMITTER).
+pub const CONSOLE_DATA_PORT: u16 = COM1_BASE + DATA_REG;
+
+/// Depth of the 16550A transmit FIFO.
+const TX_FIFO_DEPTH: usize = 16;
+
+/// Size of the kernel TX ring (power of two).
+const TX_RING_SIZE: usize = 8192;
+
+// =============================================================================
+// TX mode and ring-full policy
+// =============================================================================
+
+/// What a writer does when the TX ring is full.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+#[repr(u8)]
+pub enum FullPolicy {
+    /// Spin on the UART until the ring has room (no output is lost).
+    Block = 0,
+    /// Drop the byte and count it; the caller never waits.
+    Drop = 1,
+}
+
+/// Current `FullPolicy` (default: Block).
+static FULL_POLICY: AtomicU8 = AtomicU8::new(FullPolicy::Block as u8);
+
+/// True once THRE interrupts drain the ring (see `enable_tx_irq`).
+static IRQ_DRIVEN: AtomicBool = AtomicBool::new(false);
+
+/// Ring has bytes the UART hasn't taken yet. Lets the timer tick skip the
+/// lock when there is nothing to do (see `poll_tx`).
+static TX_PENDING: AtomicBool = AtomicBool::new(false);
+
+/// Chooses what happens when the TX ring is full.
+pub fn set_full_policy(policy: FullPolicy) {
+    FULL_POLICY.store(policy as u8, Ordering::Relaxed);
+}
+
 // =============================================================================
 // Global Serial Port Instance
 // =============================================================================
@@ -102,6 +177,17 @@ pub static SERIAL: SpinLock<SerialPort> = SpinLock::new(SerialPort::new(COM1_BAS
 pub struct SerialPort {
     /// Base I/O port address for this UART.
     base: u16,
+
+    /// Bytes we may still write before re-checking LSR.THRE (polled mode).
+    fifo_room: usize,
+
+    /// TX ring: bytes `[tail, head)` (mod size) wait for the UART.
+    ring: [u8; TX_RING_SIZE],
+    head: usize,
+    tail: usize,
+
+    /// Bytes discarded under `FullPolicy::Drop`.
+    dropped: u64,
 }
 
 impl SerialPort {
@@ -110,7 +196,7 @@ impl SerialPort {
     /// This doesn't touch hardware — call `init()` to configure the UART.
     /// Using `const fn` so it can be used in static initialization.
     pub const fn new(base: u16) -> Self {
-        Self { base }
+        Self { base, fifo_room: 0, ring: [0; TX_RING_SIZE], head: 0, tail: 0, dropped: 0 }
     }
 
     /// Initializes the UART hardware.
@@ -127,9 +213,8 @@ impl SerialPort {
     ///   6. Test with loopback mode to verify hardware works
     pub fn init(&self) {
         // Step 1: Disable all UART interrupts.
-        // We use polling mode during early boot. Interrupt-driven serial
-        // might be added later for efficiency, but polling is simpler and
-        // works without an IDT.
+        // We use polling mode during early boot — it works without an IDT.
+        // `enable_tx_irq()` turns on THRE interrupts once kmain has run `sti`.
         self.write_port(INT_ENABLE_REG, 0x00);
 
         // Step 2: Set baud rate.
@@ -188,24 +273,99 @@ impl SerialPort {
 
     /// Sends a single byte over the serial port.
     ///
-    /// This function busy-waits until the UART's transmit buffer has space,
-    /// then writes the byte. On a 115200 baud connection, one byte takes
-    /// about 87μs to transmit (10 bits per byte: start + 8 data + stop).
+    /// Polled mode: busy-waits only when the 16-byte FIFO may be full —
+    /// i.e. once per 16 bytes — for an empty FIFO, then writes. On a
+    /// 115200 baud connection, one byte takes about 87μs to transmit
+    /// (10 bits per byte: start + 8 data + stop).
+    ///
+    /// Interrupt-driven mode: appends to the TX ring. Only a full ring
+    /// makes the caller wait (or drop, per `FullPolicy`).
     ///
     /// We don't add a timeout because:
     ///   1. In QEMU, the transmit buffer is always ready immediately
     ///   2. On real hardware, 87μs is fast enough that we won't notice
     ///   3. If serial is truly stuck, we WANT to hang here — it means
     ///      something is very wrong with the hardware
-    pub fn write_byte(&self, byte: u8) {
-        // Wait for the Transmit Holding Register to be empty.
-        // This means the UART is ready to accept another byte.
+    pub fn write_byte(&mut self, byte: u8) {
+        if !IRQ_DRIVEN.load(Ordering::Relaxed) {
+            // Keep ordering: anything still buffered goes out first.
+            self.drain_sync();
+            self.write_polled(byte);
+            return;
+        }
+
+        if self.ring_len() == TX_RING_SIZE {
+            if FULL_POLICY.load(Ordering::Relaxed) == FullPolicy::Drop as u8 {
+                self.dropped += 1;
+                return;
+            }
+            // Block: wait for the FIFO to empty and refill it from the ring.
+            self.wait_tx_empty();
+            self.fill_fifo();
+        }
+        self.ring[self.head % TX_RING_SIZE] = byte;
+        self.head = self.head.wrapping_add(1);
+        TX_PENDING.store(true, Ordering::Relaxed);
+    }
+
+    /// Polled write of one byte: LSR is read only when the FIFO may be full.
+    fn write_polled(&mut self, byte: u8) {
+        if self.fifo_room == 0 {
+            self.wait_tx_empty();
+            self.fifo_room = TX_FIFO_DEPTH;
+        }
+        self.write_port(DATA_REG, byte);
+        self.fifo_room -= 1;
+    }
+
+    /// Spins until LSR.THRE: the TX FIFO is completely empty.
+    fn wait_tx_empty(&self) {
         while self.read_port(LINE_STATUS_REG) & LSR_TX_EMPTY == 0 {
             core::hint::spin_loop();
         }
+    }
 
-        // Write the byte to the data register.
-        self.write_port(DATA_REG, byte);
+    /// Number of bytes waiting in the TX ring.
+    #[inline]
+    fn ring_len(&self) -> usize {
+        self.head.wrapping_sub(self.tail)
+    }
+
+    /// Moves up to one FIFO's worth of bytes from the ring to the UART.
+    /// Caller has seen LSR.THRE (FIFO empty).
+    fn fill_fifo(&mut self) {
+        let n = self.ring_len().min(TX_FIFO_DEPTH);
+        for _ in 0..n {
+            let byte = self.ring[self.tail % TX_RING_SIZE];
+            self.write_port(DATA_REG, byte);
+            self.tail = self.tail.wrapping_add(1);
+        }
+        if self.ring_len() == 0 {
+            TX_PENDING.store(false, Ordering::Relaxed);
+        }
+    }
+
+    /// Starts or continues transmission if the FIFO is idle. Called at the
+    /// end of every write and from the THRE interrupt.
+    fn kick(&mut self) {
+        if self.ring_len() != 0 && self.read_port(LINE_STATUS_REG) & LSR_TX_EMPTY != 0 {
+            self.fill_fifo();
+        }
+    }
+
+    /// Pushes the whole ring out by polling (no interrupts needed).
+    fn drain_sync(&mut self) {
+        while self.ring_len() != 0 {
+            self.wait_tx_empty();
+            self.fill_fifo();
+        }
+        self.fifo_room = 0;
+    }
+
+    /// THRE interrupt: acknowledge it (IIR read) and refill the FIFO.
+    fn handle_irq(&mut self) {
+        let _ = self.read_port(INT_ID_REG);
+        self.kick();
     }
 
     /// Reads a single byte from the serial port, if available.
@@ -227,13 +387,16 @@ impl SerialPort {
     /// Converts `\n` to `\r\n` (CRLF) because serial terminals expect
     /// carriage return before newline to avoid the "staircase effect"
     /// where each line starts further to the right.
-    pub fn write_string(&self, s: &str) {
+    pub fn write_string(&mut self, s: &str) {
         for byte in s.bytes() {
             if byte == b'\n' {
                 self.write_byte(b'\r'); // Carriage return first
             }
             self.write_byte(byte);
         }
+        if IRQ_DRIVEN.load(Ordering::Relaxed) {
+            self.kick();
+        }
     }
 
     // =========================================================================
@@ -304,3 +467,73 @@ impl Write for SerialPort {
         Ok(())
     }
 }
+
+// =============================================================================
+// Interrupt-driven TX control
+// =============================================================================
+
+/// Switches kernel serial output to the ring + THRE interrupt path.
+///
+/// Call on the BSP after `sti`, once IRQ 4 is routed (I/O APIC → vector 36).
+pub fn enable_tx_irq() {
+    let serial = SERIAL.lock();
+    let ier = serial.read_port(INT_ENABLE_REG);
+    serial.write_port(INT_ENABLE_REG, ier | IER_TX_EMPTY);
+    IRQ_DRIVEN.store(true, Ordering::Relaxed);
+}
+
+/// IRQ 4 (vector 36): refill the TX FIFO from the ring.
+///
+/// `try_lock` because the holder on another core will kick the FIFO
+/// itself at the end of its write (on this core the lock can't be held —
+/// it runs with IF=0).
+pub fn on_irq() {
+    if let Some(mut serial) = SERIAL.try_lock() {
+        serial.handle_irq();
+    }
+}
+
+/// Timer-tick safety net: THRE is edge-triggered through the I/O APIC, so
+/// a THRE that coincides with a still-pending RX interrupt raises no new
+/// edge. One relaxed load when the ring is empty.
+#[inline]
+pub fn poll_tx() {
+    if TX_PENDING.load(Ordering::Relaxed) {
+        if let Some(mut serial) = SERIAL.try_lock() {
+            serial.kick();
+        }
+    }
+}
+
+/// Pushes all buffered output to the UART by polling. Used before halting
+/// for good. Skipped if the lock is held (we may be inside a kprintln!).
+pub fn flush_sync() {
+    if let Some(mut serial) = SERIAL.try_lock() {
+        serial.drain_sync();
+    }
+}
+
+/// Panic path: back to synchronous output so every line is on the wire
+/// before the handler returns to `halt_forever`.
+pub fn set_polled() {
+    IRQ_DRIVEN.store(false, Ordering::Relaxed);
+    flush_sync();
+}
+
+/// Queues bytes from a Ring 3 writer behind the kernel's own output,
+/// unchanged (no LF → CRLF). Same ordering and ring-full policy as
+/// kprintln!().
+pub fn write_raw(bytes: &[u8]) {
+    let mut serial = SERIAL.lock();
+    for &byte in bytes {
+        serial.write_byte(byte);
+    }
+    if IRQ_DRIVEN.load(Ordering::Relaxed) {
+        serial.kick();
+    }
+}
+
+/// Bytes discarded so far under `FullPolicy::Drop`.
+pub fn dropped() -> u64 {
+    SERIAL.lock().dropped
+}
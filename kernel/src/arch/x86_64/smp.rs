@@ -11,6 +11,16 @@
 // Only after MMU synchronization can the AP safely access kernel heap,
 // TCBs, or any Rust data structures.
 //
+// OVERLAPPED BRING-UP:
+//   `init()` only releases the APs; it does not wait for them. Each AP
+//   finishes its per-core setup and then helps with the boot task graph
+//   (`boot_tasks::ap_help`) while the BSP keeps loading Init. The BSP
+//   checks that every AP arrived with `wait_online()` at the end of boot.
+//
+//   APs do not calibrate anything: the LAPIC timer rate (TICKS_PER_US) and
+//   TSC frequency measured once on the BSP are global, and every LAPIC
+//   shares the same bus clock.
+//
 // =============================================================================
 
 use core::arch::naked_asm;
@@ -23,20 +33,25 @@ use crate::sched::percpu::CpuLocal;
 
 use alloc::boxed::Box;
 
-/// Counter for online AP cores. BSP increments this after all APs are started.
+/// Counter for online AP cores. Each AP increments this as it enters Rust.
 static AP_ONLINE_COUNT: AtomicU32 = AtomicU32::new(0);
 
+/// Number of APs released by `init()`.
+static AP_RELEASED: AtomicU32 = AtomicU32::new(0);
+
 /// Initializes SMP by waking all Application Processors via Limine MpRequest.
+/// Returns immediately; the number of APs released is returned.
 ///
 /// Must be called after:
 /// - Pristine PML4 is built and KERNEL_PML4 is set
-/// - BSP GDT, IDT, LAPIC are initialized
-pub fn init() {
+/// - BSP GDT, IDT, LAPIC are initialized, timer calibrated
+/// - SYSCALL MSRs and PMU probed on the BSP (APs copy the global state)
+pub fn init() -> u32 {
     let mp_response = match boot::get_mp_response() {
         Some(r) => r,
         None => {
             kprintln!("[smp] No MP response from Limine — single-core mode");
-            return;
+            return 0;
         }
     };
 
@@ -45,6 +60,7 @@ pub fn init() {
     kprintln!("[smp] BSP LAPIC ID: {}, {} CPUs detected", bsp_lapic_id, cpus.len());
 
     let mut ap_count = 0u32;
+    crate::boot_timing::ap_release();
 
     for cpu_info in cpus.iter() {
         // Skip the BSP — it's already running
@@ -60,7 +76,16 @@ pub fn init() {
         ap_count += 1;
     }
 
-    // Wait for APs to come online (with timeout)
+    AP_RELEASED.store(ap_count, Ordering::Relaxed);
+    ap_count
+}
+
+/// Waits (with timeout) until every AP released by `init()` is online.
+///
+/// By the time the BSP gets here the APs have usually been up for a long
+/// time, so this rarely spins.
+pub fn wait_online() {
+    let ap_count = AP_RELEASED.load(Ordering::Relaxed);
     if ap_count > 0 {
         kprintln!("[smp] Waiting for {} APs to come online...", ap_count);
         let mut timeout = 100_000_000u64; // ~1 second at ~100MHz loop
@@ -113,6 +138,9 @@ extern "C" fn ap_rust_entry(cpu_info: &limine::mp::Cpu) -> ! {
     let lapic_id = cpu_info.lapic_id;
     let core_index = AP_ONLINE_COUNT.fetch_add(1, Ordering::SeqCst) + 1; // BSP is 0
 
+    // --- 0. Same PAT as the BSP (framebuffer WC mapping relies on it) ---
+    cpu::init_pat();
+
     // --- 1. Load per-core GDT + TSS ---
     // Each AP needs its own TSS (for IST stacks). For now, we share the GDT
     // but load a per-core TSS. A simplified approach: reload the global GDT.
@@ -130,6 +158,9 @@ extern "C" fn ap_rust_entry(cpu_info: &limine::mp::Cpu) -> ! {
         let _ = Box::into_raw(ap_local);
     }
 
+    #[cfg(feature = "profile")]
+    crate::profile::init_cpu(core_index as usize);
+
     // --- 4. Enable LAPIC ---
     // LAPIC is at the standard 0xFEE00000 for all x86_64 cores
     lapic::init(crate::memory::address::PhysAddr::new(0xFEE0_0000));
@@ -138,10 +169,22 @@ extern "C" fn ap_rust_entry(cpu_info: &limine::mp::Cpu) -> ! {
     // Each core needs its own STAR/LSTAR/FMASK MSRs (MSRs are per-core).
     crate::arch::syscall::init();
 
+    // --- 6. PMU global enable (per-core MSR; BSP already probed CPUID) ---
+    crate::arch::pmu::init_cpu();
+
+    crate::boot_timing::ap_online(core_index as usize);
     kprintln!("[smp] AP core {} (LAPIC {}) online", core_index, lapic_id);
 
-    // --- 5. Enter idle loop ---
-    // When the scheduler is fully wired, this becomes scheduler::run()
+    // --- 7. Help with boot tasks until the BSP seals the graph ---
+    crate::boot_tasks::ap_help();
+
+    // --- 8. Start this core's scheduler ---
+    // IF is still 0 here; the first `sti` below opens it for ticks and IPIs.
+    unsafe { crate::sched::scheduler::init_ap(); }
+
+    // --- 9. Idle loop ---
+    // This context is now the core's idle thread: schedule() switches away
+    // from it whenever a thread is ready and back when none is.
     loop {
         unsafe { core::arch::asm!("sti"); }
         cpu::halt();
@@ -6,7 +6,7 @@
 //
 //   1. SYSCALL MSR configuration (IA32_STAR, IA32_LSTAR, IA32_FMASK)
 //   2. Naked `syscall_entry` assembly (swapgs → stack swap → save → dispatch)
-//   3. `syscall_dispatch` — Rust handler with capability enforcement
+//   3. `FAST_TABLE` jump table + `syscall_dispatch` (capability-checked)
 //   4. Ring 3 transition via IRETQ (builds a fake interrupt frame)
 //   5. User thread creation (spawn_user)
 //   6. Global endpoint table for syscall lookups
@@ -27,6 +27,21 @@
 //   RCX → user RIP (saved by CPU on SYSCALL)
 //   R11 → user RFLAGS (saved by CPU on SYSCALL)
 //
+// FAST vs SLOW PATH:
+//   Every syscall saves only what the user ABI needs restored: user RSP,
+//   RCX/R11 (SYSRET state) and the six argument registers. Callee-saved
+//   registers (RBX, RBP, R12-R15) are preserved by the Rust handlers
+//   themselves — and by `switch_context` if a handler blocks.
+//
+//   Fast path — numbers with a `FAST_TABLE` entry (NULL, SEND, PORT_OUT,
+//     PORT_IN): one indirect call with the arguments still in registers.
+//     Handlers return `FastRet` in RAX:RDX; RDX becomes the user's RDI.
+//   Slow path — everything else (RECV, PORT_WRITE, FUTEX, process/memory,
+//     stats):
+//     the remaining GPRs are pushed to complete a `SyscallFrame` and
+//     `syscall_dispatch` matches on the number. Handlers that return more
+//     than one register (RECV: four) write them into the frame.
+//
 // SECURITY:
 //   - FMASK clears IF on SYSCALL entry → no interrupt races during stack swap
 //   - CLI before user RSP restore → no interrupt on user stack in Ring 0
@@ -37,10 +52,12 @@
 extern crate alloc;
 
 use core::arch::naked_asm;
+use core::sync::atomic::{AtomicBool, Ordering};
 
 use alloc::boxed::Box;
 
 use crate::arch::cpu;
+use crate::arch::serial;
 use crate::arch::x86_64::gdt;
 use crate::cap::cnode::{CapObject, CapRights};
 use crate::ipc::endpoint::Endpoint;
@@ -48,6 +65,7 @@ use crate::ipc::message::IpcMessage;
 use crate::kprintln;
 use crate::sched::percpu::CpuLocal;
 use crate::sched::thread::{Thread, ThreadState};
+use crate::sync::rcu;
 use crate::sync::spinlock::SpinLock;
 
 // =============================================================================
@@ -74,6 +92,9 @@ const IA32_FMASK: u32 = 0xC000_0084;
 // Syscall Numbers
 // =============================================================================
 
+/// SYS_NULL — Does nothing and returns 0. Baseline for syscall entry/exit cost.
+const SYS_NULL: u64 = 0;
+
 /// SYS_SEND — Send an IPC message through a capability.
 const SYS_SEND: u64 = 1;
 
@@ -107,6 +128,39 @@ const SYS_SPAWN_THREAD: u64 = 10;
 /// SYS_DROP_CAP — Remove (drop) a capability from the caller's CNode slot.
 const SYS_DROP_CAP: u64 = 11;
 
+/// SYS_PMU_INFO — Query PMU geometry (version, counters, width).
+const SYS_PMU_INFO: u64 = 12;
+
+/// SYS_PMU_CONFIG — Program one of the caller's performance counters.
+const SYS_PMU_CONFIG: u64 = 13;
+
+/// SYS_PMU_READ — Read one of the caller's performance counters.
+const SYS_PMU_READ: u64 = 14;
+
+/// SYS_THREAD_STATS — Snapshot per-thread CPU accounting (Scheduler capability).
+const SYS_THREAD_STATS: u64 = 15;
+
+/// SYS_SCHED_HIST — Copy per-core scheduler latency histograms (Scheduler capability).
+const SYS_SCHED_HIST: u64 = 16;
+
+/// SYS_PORT_WRITE — Write a user buffer to an I/O port, paced by a status port.
+const SYS_PORT_WRITE: u64 = 17;
+
+/// SYS_FUTEX_WAIT — Sleep while a user word holds an expected value.
+const SYS_FUTEX_WAIT: u64 = 18;
+
+/// SYS_FUTEX_WAKE — Wake threads sleeping on a user word.
+const SYS_FUTEX_WAKE: u64 = 19;
+
+/// SYS_SCHED_PIN — Pin the caller to a core, optionally isolating it (Scheduler capability).
+const SYS_SCHED_PIN: u64 = 20;
+
+/// SYS_SCHED_SET — Set the caller's priority and time slice (Scheduler capability).
+const SYS_SCHED_SET: u64 = 21;
+
+/// SYS_VM_DIRTY — Report and clear the dirty bits of the caller's own pages.
+const SYS_VM_DIRTY: u64 = 22;
+
 // =============================================================================
 // CpuLocal Field Offsets (used by naked assembly)
 // =============================================================================
@@ -160,7 +214,7 @@ const MAX_IRQ_LINES: usize = 16;
 
 /// Per-IRQ blocked thread. When a thread calls SYS_WAIT_IRQ, its Box<Thread>
 /// is stored here (single-waiter per IRQ). When the IRQ fires, the handler
-/// reconstructs the Box, marks it Ready, and pushes it to the run queue.
+/// reconstructs the Box and hands it to `scheduler::wake`.
 ///
 /// Protected by a SpinLock. The IRQ handler acquires this briefly to wake
 /// the waiting thread.
@@ -177,9 +231,17 @@ unsafe impl Send for IrqWaitersInner {}
 static IRQ_WAITERS: SpinLock<IrqWaitersInner> =
     SpinLock::new(IrqWaitersInner([core::ptr::null_mut(); MAX_IRQ_LINES]));
 
+/// IRQ fired while nobody was waiting. The next SYS_WAIT_IRQ consumes the
+/// flag and returns at once, so an interrupt that lands between a driver
+/// servicing the device and blocking again is not lost (edge-triggered
+/// lines would otherwise never fire again). Written under IRQ_WAITERS.
+static IRQ_PENDING: [AtomicBool; MAX_IRQ_LINES] =
+    [const { AtomicBool::new(false) }; MAX_IRQ_LINES];
+
 /// Called from `irq_dispatch` (idt.rs) when a hardware IRQ fires.
 /// Checks if any thread is blocked waiting for this IRQ, and if so,
-/// wakes it by pushing it back to the current core's run queue.
+/// wakes it — on the core the driver last ran on when that core is free,
+/// not necessarily the one taking the interrupt.
 ///
 /// # Parameters
 /// - `irq`: IRQ line number (0-15, NOT the IDT vector).
@@ -191,22 +253,21 @@ pub fn notify_irq_waiters(irq: usize) {
 
     let mut waiters = IRQ_WAITERS.lock();
     let ptr = waiters.0[irq];
-    if ptr.is_null() { return; }
+    if ptr.is_null() {
+        IRQ_PENDING[irq].store(true, Ordering::Relaxed);
+        return;
+    }
 
     // Take ownership back from the waiters table.
     waiters.0[irq] = core::ptr::null_mut();
     drop(waiters);
 
-    // Reconstruct Box, mark Ready, push to run queue.
-    let mut thread = unsafe { Box::from_raw(ptr) };
-    let tid = thread.id;
-    thread.state = ThreadState::Ready;
-
-    let cpu_local = unsafe { CpuLocal::get_mut() };
-    let rq = unsafe { &mut *cpu_local.run_queue };
-    rq.push(thread);
+    // Reconstruct Box and make it runnable.
+    let thread = unsafe { Box::from_raw(ptr) };
+    crate::sched::scheduler::wake(thread);
 
-    kprintln!("[syscall] IRQ {} woke thread {}", irq, tid);
+    // No log line here: an interrupt-driven serial driver would turn
+    // every wakeup into more serial output, i.e. more IRQ 4s.
 }
 
 // =============================================================================
@@ -217,23 +278,25 @@ pub fn notify_irq_waiters(irq: usize) {
 ///
 /// Layout matches the push order in the naked assembly exactly.
 /// Fields are ordered from lowest address (first popped) to highest.
+/// The upper nine slots (r10 … user_rsp) are pushed on every syscall; the
+/// lower seven only on the slow path.
 ///
 /// ```text
-/// [rsp + 0]   r15
-/// [rsp + 8]   r14
-/// [rsp + 16]  r13
-/// [rsp + 24]  r12
-/// [rsp + 32]  r11          ← user RFLAGS (saved by CPU on SYSCALL)
-/// [rsp + 40]  r10          ← arg3
-/// [rsp + 48]  r9
-/// [rsp + 56]  r8
-/// [rsp + 64]  rbp
-/// [rsp + 72]  rdi          ← arg0 (CNode slot index)
-/// [rsp + 80]  rsi          ← arg1 (label)
-/// [rsp + 88]  rdx          ← arg2 (data0)
-/// [rsp + 96]  rcx          ← user RIP (saved by CPU on SYSCALL)
-/// [rsp + 104] rbx
-/// [rsp + 112] rax          ← syscall number / return value
+/// [rsp + 0]   r15          ┐
+/// [rsp + 8]   r14          │
+/// [rsp + 16]  r13          │ slow path only
+/// [rsp + 24]  r12          │
+/// [rsp + 32]  rbp          │
+/// [rsp + 40]  rbx          │
+/// [rsp + 48]  rax          ┘ ← syscall number / return value
+/// [rsp + 56]  r10          ← arg3
+/// [rsp + 64]  r9           ← arg5
+/// [rsp + 72]  r8           ← arg4
+/// [rsp + 80]  rdx          ← arg2 (data0)
+/// [rsp + 88]  rsi          ← arg1 (label)
+/// [rsp + 96]  rdi          ← arg0 (CNode slot index)
+/// [rsp + 104] r11          ← user RFLAGS (saved by CPU on SYSCALL)
+/// [rsp + 112] rcx          ← user RIP (saved by CPU on SYSCALL)
 /// [rsp + 120] user_rsp     ← saved user stack pointer
 /// ```
 #[repr(C)]
@@ -242,20 +305,82 @@ pub struct SyscallFrame {
     pub r14: u64,
     pub r13: u64,
     pub r12: u64,
-    pub r11: u64,
+    pub rbp: u64,
+    pub rbx: u64,
+    pub rax: u64,
     pub r10: u64,
     pub r9: u64,
     pub r8: u64,
-    pub rbp: u64,
-    pub rdi: u64,
-    pub rsi: u64,
     pub rdx: u64,
+    pub rsi: u64,
+    pub rdi: u64,
+    pub r11: u64,
     pub rcx: u64,
-    pub rbx: u64,
-    pub rax: u64,
     pub user_rsp: u64,
 }
 
+const _: () = {
+    assert!(core::mem::offset_of!(SyscallFrame, rax) == 48);
+    assert!(core::mem::size_of::<SyscallFrame>() == 128);
+};
+
+// =============================================================================
+// Fast Path Jump Table
+// =============================================================================
+
+/// Return value of a fast-path handler, in RAX:RDX (System V two-word
+/// struct return). `rdi` is what the user sees in RDI after SYSRET — pass
+/// arg0 through when the syscall has no second result.
+#[repr(C)]
+pub struct FastRet {
+    pub rax: u64,
+    pub rdi: u64,
+}
+
+/// Fast-path handler: (arg0, arg1, arg2, arg3) in RDI, RSI, RDX, RCX.
+type FastHandler = extern "C" fn(u64, u64, u64, u64) -> FastRet;
+
+/// Jump table size — syscall numbers `0..FAST_COUNT` are looked up here.
+const FAST_COUNT: u64 = 5;
+
+/// Fast-path jump table, indexed by syscall number. `None` (a null pointer,
+/// guaranteed by the `Option<fn>` niche) sends the number down the slow path.
+static FAST_TABLE: [Option<FastHandler>; FAST_COUNT as usize] = [
+    Some(fast_null),        // 0 SYS_NULL
+    Some(fast_send),        // 1 SYS_SEND
+    None,                   // 2 SYS_RECV — returns four registers
+    Some(fast_port_out),    // 3 SYS_PORT_OUT
+    Some(fast_port_in),     // 4 SYS_PORT_IN
+];
+
+/// Runs a fast handler with the same per-thread accounting as the slow path.
+#[inline(always)]
+fn accounted(f: impl FnOnce() -> FastRet) -> FastRet {
+    crate::sched::stats::syscall_enter();
+    let ret = f();
+    crate::sched::stats::syscall_exit();
+    ret
+}
+
+extern "C" fn fast_null(a0: u64, _: u64, _: u64, _: u64) -> FastRet {
+    accounted(|| FastRet { rax: 0, rdi: a0 })
+}
+
+extern "C" fn fast_send(slot: u64, label: u64, data0: u64, data1: u64) -> FastRet {
+    accounted(|| FastRet { rax: sys_send(slot, label, data0, data1), rdi: slot })
+}
+
+extern "C" fn fast_port_out(slot: u64, port: u64, value: u64, width: u64) -> FastRet {
+    accounted(|| FastRet { rax: sys_port_out(slot, port, value, width), rdi: slot })
+}
+
+extern "C" fn fast_port_in(slot: u64, port: u64, _: u64, width: u64) -> FastRet {
+    accounted(|| match sys_port_in(slot, port, width) {
+        Ok(value) => FastRet { rax: 0, rdi: value },
+        Err(code) => FastRet { rax: code, rdi: slot },
+    })
+}
+
 // =============================================================================
 // MSR Initialization
 // =============================================================================
@@ -329,9 +454,10 @@ pub fn init() {
 /// 1. `swapgs` — GS now points to kernel CpuLocal
 /// 2. Save user RSP to `gs:[48]` (CpuLocal.user_rsp_scratch)
 /// 3. Load kernel RSP from `gs:[56]` (CpuLocal.kernel_stack_top)
-/// 4. Push user state onto kernel stack → SyscallFrame
-/// 5. Call Rust dispatcher
-/// 6. Restore user state from SyscallFrame
+/// 4. Push user RSP, RCX, R11 and the argument registers (both paths)
+/// 5. Fast path: call `FAST_TABLE[rax]` with the arguments in registers
+///    Slow path: push the rest → SyscallFrame, call `syscall_dispatch`
+/// 6. Restore user state
 /// 7. `cli` + restore user RSP + `swapgs` + `sysretq`
 #[unsafe(naked)]
 unsafe extern "C" fn syscall_entry() {
@@ -341,58 +467,68 @@ unsafe extern "C" fn syscall_entry() {
         "mov gs:[{scratch}], rsp",             // Save user RSP to scratch
         "mov rsp, gs:[{kstack}]",              // Load kernel RSP
 
-        // ─── Phase 2: Build SyscallFrame ────────────────────────────────
-        // Reserve 8-byte slot for user_rsp (filled after GPR saves)
-        "sub rsp, 8",
-
-        // Push all 15 GPRs (rax first → highest offset, r15 last → offset 0)
-        "push rax",
-        "push rbx",
-        "push rcx",
-        "push rdx",
-        "push rsi",
+        // ─── Phase 2: Save what SYSRET + the user ABI need ─────────────
+        "push qword ptr gs:[{scratch}]",       // user_rsp
+        "push rcx",                            // user RIP
+        "push r11",                            // user RFLAGS
         "push rdi",
-        "push rbp",
+        "push rsi",
+        "push rdx",
         "push r8",
         "push r9",
         "push r10",
-        "push r11",
+
+        // ─── Phase 3a: Fast path — FAST_TABLE[rax] ─────────────────────
+        "cmp rax, {fast_count}",
+        "jae 2f",
+        "lea r11, [rip + {table}]",
+        "mov r11, [r11 + rax * 8]",
+        "test r11, r11",
+        "jz 2f",
+        "sub rsp, 8",                          // 9 pushes → realign to 16
+        "mov rcx, r10",                        // arg3: R10 (user) → RCX (SysV)
+        "call r11",
+        "add rsp, 8",
+        "mov [rsp + 40], rdx",                 // FastRet.rdi → saved RDI slot
+        "jmp 3f",
+
+        // ─── Phase 3b: Slow path — complete the SyscallFrame ───────────
+        "2:",
+        "push rax",
+        "push rbx",
+        "push rbp",
         "push r12",
         "push r13",
         "push r14",
         "push r15",
 
-        // Fill user_rsp slot at [rsp + 120] using now-free rax
-        "mov rax, gs:[{scratch}]",
-        "mov [rsp + 120], rax",
-
-        // ─── Phase 3: Call Rust dispatcher ──────────────────────────────
         // System V ABI: rdi = first argument = pointer to SyscallFrame
         "mov rdi, rsp",
         "call syscall_dispatch",
 
-        // ─── Phase 4: Store return value in frame ───────────────────────
-        // RAX from dispatch overwrites the saved rax slot [rsp + 112]
-        "mov [rsp + 112], rax",
+        // RAX from dispatch overwrites the saved rax slot [rsp + 48]
+        "mov [rsp + 48], rax",
 
-        // ─── Phase 5: Restore GPRs from SyscallFrame ───────────────────
         "pop r15",
         "pop r14",
         "pop r13",
         "pop r12",
-        "pop r11",                             // Restored user RFLAGS for SYSRET
+        "pop rbp",
+        "pop rbx",
+        "pop rax",                             // Return value (from modified slot)
+
+        // ─── Phase 4: Restore argument registers + SYSRET state ────────
+        "3:",
         "pop r10",
         "pop r9",
         "pop r8",
-        "pop rbp",
-        "pop rdi",
-        "pop rsi",
         "pop rdx",
+        "pop rsi",
+        "pop rdi",
+        "pop r11",                             // Restored user RFLAGS for SYSRET
         "pop rcx",                             // Restored user RIP for SYSRET
-        "pop rbx",
-        "pop rax",                             // Return value (from modified slot)
 
-        // ─── Phase 6: Return to Ring 3 ─────────────────────────────────
+        // ─── Phase 5: Return to Ring 3 ─────────────────────────────────
         // CRITICAL: Disable interrupts before restoring user RSP.
         // Between `pop rsp` and `sysretq`, we're in Ring 0 with a user stack.
         // An interrupt here would push a Ring 0 frame onto the user stack → SECURITY BUG.
@@ -403,6 +539,8 @@ unsafe extern "C" fn syscall_entry() {
 
         scratch = const CPULOCAL_USER_RSP_SCRATCH,
         kstack = const CPULOCAL_KERNEL_STACK_TOP,
+        fast_count = const FAST_COUNT,
+        table = sym FAST_TABLE,
     );
 }
 
@@ -410,43 +548,25 @@ unsafe extern "C" fn syscall_entry() {
 // Syscall Dispatcher (Rust)
 // =============================================================================
 
-/// Central syscall dispatcher — called from the naked assembly entry point.
+/// Central syscall dispatcher — the slow path of the naked entry point.
 ///
 /// Reads the syscall number from `frame.rax` and dispatches to the
-/// appropriate handler. Each handler validates capabilities before
-/// performing any privileged operation.
+/// appropriate handler. Numbers with a `FAST_TABLE` entry never get here.
+/// Each handler validates capabilities before performing any privileged
+/// operation.
 ///
 /// # Returns
 /// Result code in RAX: 0 = success, nonzero = error.
 #[unsafe(no_mangle)]
 pub extern "C" fn syscall_dispatch(frame: &mut SyscallFrame) -> u64 {
     let number = frame.rax;
+    crate::sched::stats::syscall_enter();
 
-    match number {
-        SYS_SEND => {
-            let slot = frame.rdi;
-            let label = frame.rsi;
-            let data0 = frame.rdx;
-            let data1 = frame.r10;
-            sys_send(slot, label, data0, data1)
-        }
+    let result = match number {
         SYS_RECV => {
             let slot = frame.rdi;
             sys_recv(frame, slot)
         }
-        SYS_PORT_OUT => {
-            let slot = frame.rdi;
-            let port = frame.rsi;
-            let value = frame.rdx;
-            let width = frame.r10;
-            sys_port_out(slot, port, value, width)
-        }
-        SYS_PORT_IN => {
-            let slot = frame.rdi;
-            let port = frame.rsi;
-            let width = frame.r10;
-            sys_port_in(frame, slot, port, width)
-        }
         SYS_WAIT_IRQ => {
             let slot = frame.rdi;
             sys_wait_irq(slot)
@@ -482,12 +602,117 @@ pub extern "C" fn syscall_dispatch(frame: &mut SyscallFrame) -> u64 {
             let slot = frame.rdi;
             sys_drop_cap(slot)
         }
+        SYS_PMU_INFO => {
+            let slot = frame.rdi;
+            sys_pmu_info(frame, slot)
+        }
+        SYS_PMU_CONFIG => {
+            let slot = frame.rdi;
+            let index = frame.rsi;
+            let event = frame.rdx;
+            sys_pmu_config(slot, index, event)
+        }
+        SYS_PMU_READ => {
+            let slot = frame.rdi;
+            let index = frame.rsi;
+            sys_pmu_read(frame, slot, index)
+        }
+        SYS_THREAD_STATS => {
+            let slot = frame.rdi;
+            let buf = frame.rsi;
+            let max = frame.rdx;
+            sys_thread_stats(frame, slot, buf, max)
+        }
+        SYS_SCHED_HIST => {
+            let slot = frame.rdi;
+            let buf = frame.rsi;
+            let max = frame.rdx;
+            sys_sched_hist(frame, slot, buf, max)
+        }
+        SYS_PORT_WRITE => {
+            let slot = frame.rdi;
+            let port = frame.rsi;
+            let buf = frame.rdx;
+            let len = frame.r10;
+            let status = frame.r8;
+            let pacing = frame.r9;
+            sys_port_write(frame, slot, port, buf, len, status, pacing)
+        }
+        SYS_FUTEX_WAIT => {
+            let addr = frame.rdi;
+            let expected = frame.rsi;
+            sys_futex_wait(addr, expected)
+        }
+        SYS_FUTEX_WAKE => {
+            let addr = frame.rdi;
+            let count = frame.rsi;
+            sys_futex_wake(frame, addr, count)
+        }
+        SYS_SCHED_PIN => {
+            let slot = frame.rdi;
+            let core = frame.rsi;
+            let flags = frame.rdx;
+            sys_sched_pin(slot, core, flags)
+        }
+        SYS_SCHED_SET => {
+            let slot = frame.rdi;
+            let priority = frame.rsi;
+            let quantum_us = frame.rdx;
+            sys_sched_set(slot, priority, quantum_us)
+        }
+        SYS_VM_DIRTY => {
+            let vaddr = frame.rdi;
+            let pages = frame.rsi;
+            let bitmap = frame.rdx;
+            sys_vm_dirty(vaddr, pages, bitmap)
+        }
         _ => {
             kprintln!("[syscall] UNKNOWN syscall number {} from RIP={:#018X}",
                 number, frame.rcx);
             u64::MAX
         }
+    };
+
+    crate::sched::stats::syscall_exit();
+    result
+}
+
+/// Copies `src` into the calling process's memory at `dst`.
+///
+/// Every touched page must be mapped USER | WRITABLE in the active PML4
+/// (checked page by page via `vmm::translate_user`); the bytes are written
+/// through the HHDM alias.
+///
+/// # Returns
+/// `false` (nothing written past the first bad page) on a bad buffer.
+fn copy_to_user(dst: u64, src: &[u8]) -> bool {
+    use crate::memory::address::{VirtAddr, PAGE_SIZE};
+    use crate::memory::vmm;
+
+    let pml4 = vmm::active_pml4();
+    let mut done = 0usize;
+    while done < src.len() {
+        // Lower half only — also keeps VirtAddr::new's canonical check happy.
+        let addr = match dst.checked_add(done as u64) {
+            Some(a) if a < 0x0000_8000_0000_0000 => a,
+            _ => return false,
+        };
+        let phys = match vmm::translate_user(pml4, VirtAddr::new(addr), true) {
+            Some(p) => p,
+            None => return false,
+        };
+        let page_left = (PAGE_SIZE - (addr % PAGE_SIZE)) as usize;
+        let n = page_left.min(src.len() - done);
+        unsafe {
+            core::ptr::copy_nonoverlapping(
+                src.as_ptr().add(done),
+                phys.to_virt().as_mut_ptr::<u8>(),
+                n,
+            );
+        }
+        done += n;
     }
+    true
 }
 
 // =============================================================================
@@ -514,7 +739,7 @@ fn sys_send(slot: u64, label: u64, data0: u64, data1: u64) -> u64 {
     let process = unsafe { &*thread.process };
 
     // 1. Validate capability
-    let cap = match process.cnode.lookup(slot as usize) {
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_SEND: thread {} bad slot {}", thread.id, slot);
@@ -584,7 +809,7 @@ fn sys_recv(frame: &mut SyscallFrame, slot: u64) -> u64 {
     let process = unsafe { &*thread.process };
 
     // 1. Validate capability
-    let cap = match process.cnode.lookup(slot as usize) {
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_RECV: thread {} bad slot {}", thread.id, slot);
@@ -660,7 +885,7 @@ fn sys_port_out(slot: u64, port: u64, value: u64, width: u64) -> u64 {
     let process = unsafe { &*thread.process };
 
     // 1. Validate capability
-    let cap = match process.cnode.lookup(slot as usize) {
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_PORT_OUT: thread {} bad slot {}", thread.id, slot);
@@ -693,7 +918,13 @@ fn sys_port_out(slot: u64, port: u64, value: u64, width: u64) -> u64 {
         return u64::MAX - 4;
     }
 
-    // 4. Perform the privileged OUT instruction (width-aware)
+    // 4. The console's transmitter belongs to the kernel ring
+    if port16 == serial::CONSOLE_DATA_PORT && width != 4 {
+        serial::write_raw(&[value as u8]);
+        return 0;
+    }
+
+    // 5. Perform the privileged OUT instruction (width-aware)
     match width {
         4 => {
             // 32-bit OUT — for Virtio and other devices needing dword access
@@ -736,19 +967,19 @@ fn sys_port_out(slot: u64, port: u64, value: u64, width: u64) -> u64 {
 ///   - width: I/O width — 0 or 1 = byte (backward compatible), 4 = dword
 ///
 /// # Returns
-///   RAX = 0 on success. The read value is placed in frame.rdi so the
+///   `Ok(value)` → RAX = 0 and the value in RDI (via `FastRet.rdi`) so the
 ///   user sees it in RDI register after SYSRET.
-fn sys_port_in(frame: &mut SyscallFrame, slot: u64, port: u64, width: u64) -> u64 {
+fn sys_port_in(slot: u64, port: u64, width: u64) -> Result<u64, u64> {
     let cpu_local = unsafe { CpuLocal::get() };
     let thread = unsafe { &*cpu_local.current_thread };
     let process = unsafe { &*thread.process };
 
     // 1. Validate capability
-    let cap = match process.cnode.lookup(slot as usize) {
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_PORT_IN: thread {} bad slot {}", thread.id, slot);
-            return u64::MAX;
+            return Err(u64::MAX);
         }
     };
 
@@ -758,14 +989,14 @@ fn sys_port_in(frame: &mut SyscallFrame, slot: u64, port: u64, width: u64) -> u6
             if !cap.rights.contains(CapRights::READ) {
                 kprintln!("[syscall] SYS_PORT_IN: thread {} no READ right on slot {}",
                     thread.id, slot);
-                return u64::MAX - 1;
+                return Err(u64::MAX - 1);
             }
             (base, size)
         }
         _ => {
             kprintln!("[syscall] SYS_PORT_IN: thread {} slot {} is not an IoPort",
                 thread.id, slot);
-            return u64::MAX - 2;
+            return Err(u64::MAX - 2);
         }
     };
 
@@ -774,7 +1005,7 @@ fn sys_port_in(frame: &mut SyscallFrame, slot: u64, port: u64, width: u64) -> u6
     if port16 < base || port16 >= base + size {
         kprintln!("[syscall] SYS_PORT_IN: thread {} port {:#06X} outside cap range [{:#06X}..{:#06X})",
             thread.id, port16, base, base + size);
-        return u64::MAX - 4;
+        return Err(u64::MAX - 4);
     }
 
     // 4. Perform the privileged IN instruction (width-aware)
@@ -790,8 +1021,7 @@ fn sys_port_in(frame: &mut SyscallFrame, slot: u64, port: u64, width: u64) -> u6
                     options(nomem, nostack, preserves_flags)
                 );
             }
-            // Return 32-bit value in RDI
-            frame.rdi = dword as u64;
+            Ok(dword as u64)
         }
         _ => {
             // 8-bit IN — default, backward compatible
@@ -804,12 +1034,191 @@ fn sys_port_in(frame: &mut SyscallFrame, slot: u64, port: u64, width: u64) -> u6
                     options(nomem, nostack, preserves_flags)
                 );
             }
-            // Return byte value in RDI
-            frame.rdi = byte as u64;
+            Ok(byte as u64)
         }
     }
+}
 
-    0 // Success
+// =============================================================================
+// SYS_PORT_WRITE — Write one FIFO burst of a user buffer to an I/O port
+// =============================================================================
+
+/// Most bytes one SYS_PORT_WRITE emits: one 16550 FIFO burst. The handler
+/// runs with IF=0, so a call is at most one status wait plus 16 OUTs; the
+/// libmnos wrapper loops over longer buffers, taking interrupts in between.
+const PORT_WRITE_MAX: u64 = 16;
+
+/// Status-port reads before a call gives up on a device that is not
+/// ready. A full 16550 FIFO drains in ~1.4 ms at 115200 baud, well inside
+/// this bound; a stuck device costs a few milliseconds with IF=0, not
+/// seconds. The call then returns 0 bytes written.
+const PORT_WRITE_POLL_LIMIT: u32 = 1 << 12;
+
+/// Writes up to one burst of caller memory at `buf` to a data port.
+///
+/// Replaces one SYS_PORT_OUT per byte (plus one SYS_PORT_IN per byte to
+/// poll the device) with one syscall per FIFO burst. The bytes are read
+/// straight from the caller's pages through the HHDM — no kernel buffer,
+/// no copy.
+///
+/// Pacing for FIFO devices like the 16550: the kernel polls
+/// `status_port` until `status & ready_mask != 0`, then writes at most
+/// `burst` bytes. With `ready_mask` = 0 there is no polling and up to
+/// PORT_WRITE_MAX bytes go out back to back (`rep outsb` semantics).
+/// Either way a call never writes more than PORT_WRITE_MAX bytes; the
+/// caller advances by the returned count and calls again.
+///
+/// The console UART (serial::CONSOLE_DATA_PORT) is the exception: its
+/// bytes join the kernel's TX ring, which paces them, so they never race
+/// kernel output for the FIFO.
+///
+/// # Arguments (from syscall registers)
+///   - slot:   CNode slot index containing an IoPort capability with WRITE
+///             (and READ if a status port is polled)
+///   - port:   16-bit data port
+///   - buf:    user address of the bytes (must be mapped USER)
+///   - len:    byte count; only the first PORT_WRITE_MAX are written
+///   - status: 16-bit status port (R8)
+///   - pacing: bits 0..7 = ready_mask, bits 8..15 = burst (0 = 1) (R9)
+///
+/// # Returns
+///   0 on success with the bytes written in RDI — 0 bytes if the device
+///   stayed busy. Error codes like SYS_PORT_OUT, plus `u64::MAX - 5` for
+///   a bad buffer.
+fn sys_port_write(frame: &mut SyscallFrame, slot: u64, port: u64, buf: u64, len: u64,
+                  status: u64, pacing: u64) -> u64 {
+    use crate::memory::address::{VirtAddr, PAGE_SIZE};
+    use crate::memory::vmm;
+
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &*cpu_local.current_thread };
+    let process = unsafe { &*thread.process };
+
+    let ready_mask = pacing as u8;
+    let burst = if ready_mask != 0 {
+        ((pacing >> 8) as u8).max(1) as u64
+    } else {
+        PORT_WRITE_MAX
+    };
+
+    // 1. Validate capability
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
+        Some(c) => c,
+        None => {
+            kprintln!("[syscall] SYS_PORT_WRITE: thread {} bad slot {}", thread.id, slot);
+            return u64::MAX;
+        }
+    };
+
+    // 2. IoPort with WRITE, plus READ when polling the status port
+    let (base, size) = match cap.object {
+        CapObject::IoPort { base, size } => {
+            let needed = if ready_mask != 0 {
+                CapRights::from_raw(CapRights::WRITE.bits() | CapRights::READ.bits())
+            } else {
+                CapRights::WRITE
+            };
+            if !cap.rights.contains(needed) {
+                kprintln!("[syscall] SYS_PORT_WRITE: thread {} missing rights on slot {}",
+                    thread.id, slot);
+                return u64::MAX - 1;
+            }
+            (base, size)
+        }
+        _ => {
+            kprintln!("[syscall] SYS_PORT_WRITE: thread {} slot {} is not an IoPort",
+                thread.id, slot);
+            return u64::MAX - 2;
+        }
+    };
+
+    // 3. Both ports must lie inside the capability's range
+    let port16 = port as u16;
+    let status16 = status as u16;
+    let in_range = |p: u16| p >= base && p < base + size;
+    if !in_range(port16) || (ready_mask != 0 && !in_range(status16)) {
+        kprintln!("[syscall] SYS_PORT_WRITE: thread {} port {:#06X}/{:#06X} outside cap range [{:#06X}..{:#06X})",
+            thread.id, port16, status16, base, base + size);
+        return u64::MAX - 4;
+    }
+
+    // 4. One burst at most; the buffer itself is checked page by page
+    let len = len.min(burst).min(PORT_WRITE_MAX);
+    if buf.checked_add(len).is_none_or(|end| end > 0x0000_8000_0000_0000) {
+        kprintln!("[syscall] SYS_PORT_WRITE: thread {} bad buffer {:#018X} len {}",
+            thread.id, buf, len);
+        return u64::MAX - 5;
+    }
+
+    // 5. Wait for the device once, then emit the burst (it may straddle
+    //    a page boundary). The console is paced by the kernel's ring.
+    let console = port16 == serial::CONSOLE_DATA_PORT;
+    if len != 0 && ready_mask != 0 && !console && !wait_port_ready(status16, ready_mask) {
+        frame.rdi = 0;
+        return 0;
+    }
+    let pml4 = vmm::active_pml4();
+    let mut done = 0u64;
+    while done < len {
+        let addr = buf + done;
+        let phys = match vmm::translate_user(pml4, VirtAddr::new(addr), false) {
+            Some(p) => p,
+            None => {
+                if done == 0 {
+                    kprintln!("[syscall] SYS_PORT_WRITE: buffer {:#018X} not readable", addr);
+                    return u64::MAX - 5;
+                }
+                break;
+            }
+        };
+        let n = (PAGE_SIZE - (addr % PAGE_SIZE)).min(len - done);
+        let src = phys.to_virt().as_ptr::<u8>();
+
+        if console {
+            serial::write_raw(unsafe { core::slice::from_raw_parts(src, n as usize) });
+            done += n;
+            continue;
+        }
+        for i in 0..n {
+            let byte = unsafe { *src.add(i as usize) };
+            unsafe {
+                core::arch::asm!(
+                    "out dx, al",
+                    in("dx") port16,
+                    in("al") byte,
+                    options(nomem, nostack, preserves_flags)
+                );
+            }
+        }
+        done += n;
+    }
+
+    frame.rdi = done;
+    0
+}
+
+/// Polls `port` until `value & mask != 0`.
+///
+/// # Returns
+/// `false` if the device stayed busy for PORT_WRITE_POLL_LIMIT reads.
+#[inline(always)]
+fn wait_port_ready(port: u16, mask: u8) -> bool {
+    for _ in 0..PORT_WRITE_POLL_LIMIT {
+        let value: u8;
+        unsafe {
+            core::arch::asm!(
+                "in al, dx",
+                out("al") value,
+                in("dx") port,
+                options(nomem, nostack, preserves_flags)
+            );
+        }
+        if value & mask != 0 {
+            return true;
+        }
+        core::hint::spin_loop();
+    }
+    false
 }
 
 // =============================================================================
@@ -837,7 +1246,7 @@ fn sys_wait_irq(slot: u64) -> u64 {
     let process = unsafe { &*thread.process };
 
     // 1. Validate capability
-    let cap = match process.cnode.lookup(slot as usize) {
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_WAIT_IRQ: thread {} bad slot {}", thread.id, slot);
@@ -860,8 +1269,6 @@ fn sys_wait_irq(slot: u64) -> u64 {
         return u64::MAX - 4;
     }
 
-    kprintln!("[syscall] SYS_WAIT_IRQ: thread {} blocking on IRQ {}", thread.id, irq);
-
     // 3. Take Box ownership of current thread (IF already 0 from FMASK)
     let current_ptr = cpu_local.current_thread;
     let mut current_box = unsafe { Box::from_raw(current_ptr) };
@@ -870,6 +1277,12 @@ fn sys_wait_irq(slot: u64) -> u64 {
     // 4. Try to register in the IRQ waiters table
     {
         let mut waiters = IRQ_WAITERS.lock();
+        if IRQ_PENDING[irq].swap(false, Ordering::Relaxed) {
+            // Fired since the last wait — consume it without blocking.
+            current_box.state = ThreadState::Running;
+            let _ = Box::into_raw(current_box);
+            return 0;
+        }
         if !waiters.0[irq].is_null() {
             // Another thread already waiting — restore and error
             kprintln!("[syscall] SYS_WAIT_IRQ: IRQ {} already has a waiter", irq);
@@ -889,6 +1302,49 @@ fn sys_wait_irq(slot: u64) -> u64 {
     0 // Success
 }
 
+// =============================================================================
+// SYS_FUTEX_WAIT / SYS_FUTEX_WAKE — Sleep and wake on a user word
+// =============================================================================
+
+/// Blocks the caller while the 32-bit word at `addr` equals `expected`.
+///
+/// The building block of libmnos's Mutex/Condvar: a user lock spins in
+/// Ring 3 for a while, then sleeps here instead of burning its slice.
+/// No capability is involved — the word is the caller's own memory.
+/// See sync/futex.rs.
+///
+/// # Arguments (from syscall registers)
+///   - addr:     user address of a 4-byte aligned, readable u32
+///   - expected: value (low 32 bits) the word must still hold
+///
+/// # Returns
+///   0 after a wakeup (callers re-check their condition; a wakeup may
+///   be meant for another waiter). Error codes:
+///   - `u64::MAX - 4` — unaligned, kernel-half or unmapped address
+///   - `u64::MAX - 7` — the word no longer held `expected` (not slept)
+fn sys_futex_wait(addr: u64, expected: u64) -> u64 {
+    use crate::sync::futex::{self, WaitError};
+
+    match unsafe { futex::wait(addr, expected as u32) } {
+        Ok(()) => 0,
+        Err(WaitError::BadAddress) => {
+            kprintln!("[syscall] SYS_FUTEX_WAIT: bad address {:#018X}", addr);
+            u64::MAX - 4
+        }
+        // Routine under contention — not worth a log line.
+        Err(WaitError::ValueChanged) => u64::MAX - 7,
+    }
+}
+
+/// Wakes up to `count` threads sleeping on `addr` (caller's address space).
+///
+/// # Returns
+///   0, with the number of threads woken in RDI.
+fn sys_futex_wake(frame: &mut SyscallFrame, addr: u64, count: u64) -> u64 {
+    frame.rdi = crate::sync::futex::wake(addr, count);
+    0
+}
+
 // =============================================================================
 // SYS_SPAWN_PROCESS — Create a new empty process (Syscall 6)
 // =============================================================================
@@ -910,7 +1366,7 @@ fn sys_spawn_process() -> u64 {
 
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let thread = unsafe { &mut *cpu_local.current_thread };
-    let process = unsafe { &mut *thread.process };
+    let process = unsafe { &*thread.process };
 
     // 1. Create the new child process
     let child = Box::new(Process::new("user-proc"));
@@ -925,7 +1381,7 @@ fn sys_spawn_process() -> u64 {
         CapObject::Process { pid: child_pid },
         CapRights::ALL,
     );
-    match process.cnode.insert(cap) {
+    match process.cnode.lock().insert(cap) {
         Some(slot) => {
             kprintln!("[syscall] SYS_SPAWN_PROCESS: PID {} created child PID {} → slot {}",
                 process.pid, child_pid, slot);
@@ -964,10 +1420,10 @@ fn sys_alloc_memory(alloc_slot: u64, target_slot: u64) -> u64 {
 
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let thread = unsafe { &*cpu_local.current_thread };
-    let process = unsafe { &mut *thread.process };
+    let process = unsafe { &*thread.process };
 
     // 1. Validate PmmAllocator capability
-    let cap = match process.cnode.lookup(alloc_slot as usize) {
+    let cap = match process.cnode.lock().lookup(alloc_slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_ALLOC_MEMORY: PID {} bad alloc slot {}",
@@ -1005,7 +1461,7 @@ fn sys_alloc_memory(alloc_slot: u64, target_slot: u64) -> u64 {
         CapObject::MemoryFrame { phys: phys.as_u64(), order: 0 },
         CapRights::ALL,
     );
-    match process.cnode.insert_at(target_slot as usize, mem_cap) {
+    match process.cnode.lock().insert_at(target_slot as usize, mem_cap) {
         Ok(()) => {
             kprintln!("[syscall] SYS_ALLOC_MEMORY: PID {} allocated frame P:{:#010X} → slot {}",
                 process.pid, phys.as_u64(), target_slot);
@@ -1055,10 +1511,10 @@ fn sys_map_memory(proc_slot: u64, frame_slot: u64, vaddr: u64, flags_raw: u64) -
 
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let thread = unsafe { &*cpu_local.current_thread };
-    let caller = unsafe { &mut *thread.process };
+    let caller = unsafe { &*thread.process };
 
     // 1. Validate Process capability
-    let proc_cap = match caller.cnode.lookup(proc_slot as usize) {
+    let proc_cap = match caller.cnode.lock().lookup(proc_slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_MAP_MEMORY: PID {} bad proc slot {}",
@@ -1077,7 +1533,7 @@ fn sys_map_memory(proc_slot: u64, frame_slot: u64, vaddr: u64, flags_raw: u64) -
     };
 
     // 2. Validate MemoryFrame capability
-    let frame_cap = match caller.cnode.lookup(frame_slot as usize) {
+    let frame_cap = match caller.cnode.lock().lookup(frame_slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_MAP_MEMORY: PID {} bad frame slot {}",
@@ -1101,7 +1557,8 @@ fn sys_map_memory(proc_slot: u64, frame_slot: u64, vaddr: u64, flags_raw: u64) -
         return u64::MAX - 4;
     }
 
-    // 4. Look up the target process
+    // 4. Look up the target process (RCU: the guard keeps it alive until we return)
+    let _rcu = rcu::read_lock();
     let target_ptr = match process::lookup_process(target_pid) {
         Some(p) => p,
         None => {
@@ -1126,8 +1583,11 @@ fn sys_map_memory(proc_slot: u64, frame_slot: u64, vaddr: u64, flags_raw: u64) -
         pt_flags |= PageTableFlags::NO_EXECUTE;
     }
 
-    // 6. Map the page in the target process's PML4
+    // 6. Map the page in the target process's PML4. Its other threads may be
+    //    mapping concurrently (a walk that allocates the same intermediate
+    //    table twice loses one of the two mappings).
     let result = unsafe {
+        let _vm = target.vm_lock.lock();
         vmm::map_page(
             pml4_phys,
             VirtAddr::new(vaddr),
@@ -1177,10 +1637,10 @@ fn sys_delegate(proc_slot: u64, src_slot: u64, dst_slot: u64) -> u64 {
 
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let thread = unsafe { &*cpu_local.current_thread };
-    let caller = unsafe { &mut *thread.process };
+    let caller = unsafe { &*thread.process };
 
     // 1. Validate Process capability
-    let proc_cap = match caller.cnode.lookup(proc_slot as usize) {
+    let proc_cap = match caller.cnode.lock().lookup(proc_slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_DELEGATE: PID {} bad proc slot {}",
@@ -1198,9 +1658,10 @@ fn sys_delegate(proc_slot: u64, src_slot: u64, dst_slot: u64) -> u64 {
         }
     };
 
-    // 2. Validate and read source capability (copy out of borrow)
-    let src_cap = match caller.cnode.lookup(src_slot as usize) {
-        Some(c) => *c, // Copy the value so we release the borrow
+    // 2. Validate and read source capability (copied out: the caller's
+    //    CNode lock is released before the target's is taken)
+    let src_cap = match caller.cnode.lock().lookup(src_slot as usize).copied() {
+        Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_DELEGATE: PID {} bad source slot {}",
                 caller.pid, src_slot);
@@ -1208,7 +1669,8 @@ fn sys_delegate(proc_slot: u64, src_slot: u64, dst_slot: u64) -> u64 {
         }
     };
 
-    // 3. Look up target process
+    // 3. Look up target process (RCU: the guard keeps it alive until we return)
+    let _rcu = rcu::read_lock();
     let target_ptr = match process::lookup_process(target_pid) {
         Some(p) => p,
         None => {
@@ -1218,10 +1680,10 @@ fn sys_delegate(proc_slot: u64, src_slot: u64, dst_slot: u64) -> u64 {
         }
     };
 
-    let target = unsafe { &mut *target_ptr };
+    let target = unsafe { &*target_ptr };
 
     // 4. Insert into target's CNode at the specified slot
-    match target.cnode.insert_at(dst_slot as usize, src_cap) {
+    match target.cnode.lock().insert_at(dst_slot as usize, src_cap) {
         Ok(()) => {
             kprintln!("[syscall] SYS_DELEGATE: PID {} [{} → PID {} [{}]: {:?}",
                 caller.pid, src_slot, target_pid, dst_slot, src_cap.object);
@@ -1263,7 +1725,7 @@ fn sys_spawn_thread(proc_slot: u64, user_rip: u64, user_rsp: u64) -> u64 {
     let caller = unsafe { &*thread.process };
 
     // 1. Validate Process capability
-    let proc_cap = match caller.cnode.lookup(proc_slot as usize) {
+    let proc_cap = match caller.cnode.lock().lookup(proc_slot as usize).copied() {
         Some(c) => c,
         None => {
             kprintln!("[syscall] SYS_SPAWN_THREAD: PID {} bad proc slot {}",
@@ -1281,7 +1743,8 @@ fn sys_spawn_thread(proc_slot: u64, user_rip: u64, user_rsp: u64) -> u64 {
         }
     };
 
-    // 2. Look up target process
+    // 2. Look up target process (RCU: the guard keeps it alive until we return)
+    let _rcu = rcu::read_lock();
     let target_ptr = match process::lookup_process(target_pid) {
         Some(p) => p,
         None => {
@@ -1325,9 +1788,9 @@ fn sys_spawn_thread(proc_slot: u64, user_rip: u64, user_rsp: u64) -> u64 {
 fn sys_drop_cap(slot: u64) -> u64 {
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let thread = unsafe { &*cpu_local.current_thread };
-    let process = unsafe { &mut *thread.process };
+    let process = unsafe { &*thread.process };
 
-    match process.cnode.remove(slot as usize) {
+    match process.cnode.lock().remove(slot as usize) {
         Some(_cap) => {
             // Cap removed. The slot is now free for reuse.
             0
@@ -1340,6 +1803,395 @@ fn sys_drop_cap(slot: u64) -> u64 {
     }
 }
 
+// =============================================================================
+// SYS_PMU_* — Hardware performance counters (Syscalls 12-14)
+// =============================================================================
+
+/// Error: no architectural PMU on this CPU (e.g. QEMU/TCG without a vPMU).
+const PMU_UNSUPPORTED: u64 = u64::MAX - 5;
+
+/// Validates that `slot` in the caller's CNode holds a `Pmu` capability
+/// with `right`. Returns 0 on success or the syscall error code.
+fn check_pmu_cap(name: &str, slot: u64, right: CapRights) -> u64 {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &*cpu_local.current_thread };
+    let process = unsafe { &*thread.process };
+
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
+        Some(c) => c,
+        None => {
+            kprintln!("[syscall] {}: PID {} bad slot {}", name, process.pid, slot);
+            return u64::MAX;
+        }
+    };
+    match cap.object {
+        CapObject::Pmu => {}
+        _ => {
+            kprintln!("[syscall] {}: PID {} slot {} is not a Pmu capability",
+                name, process.pid, slot);
+            return u64::MAX - 2;
+        }
+    }
+    if !cap.rights.contains(right) {
+        kprintln!("[syscall] {}: PID {} missing right on Pmu slot {}", name, process.pid, slot);
+        return u64::MAX - 1;
+    }
+    if !crate::arch::pmu::available() {
+        return PMU_UNSUPPORTED;
+    }
+    0
+}
+
+/// Reports the PMU geometry.
+///
+/// # Returns
+/// `0` on success with RDI = version | counters << 8 | width << 16,
+/// or an error code (PMU_UNSUPPORTED without a PMU).
+fn sys_pmu_info(frame: &mut SyscallFrame, slot: u64) -> u64 {
+    let err = check_pmu_cap("SYS_PMU_INFO", slot, CapRights::READ);
+    if err != 0 {
+        return err;
+    }
+    frame.rdi = crate::arch::pmu::info();
+    0
+}
+
+/// Programs counter `index` of the CALLING thread and resets it to zero.
+///
+/// `event` is an IA32_PERFEVTSELx value: event select in bits 0-7, umask
+/// in bits 8-15, USR (16) / OS (17) filters, edge, INV and CMASK. The
+/// kernel forces EN and masks off the interrupt/any-thread bits. `event = 0`
+/// stops the counter. The counter follows the thread across context
+/// switches, and while it runs the thread may also read it with `rdpmc`.
+///
+/// # Returns
+/// `0` on success, `u64::MAX - 4` if `index` is out of range.
+fn sys_pmu_config(slot: u64, index: u64, event: u64) -> u64 {
+    let err = check_pmu_cap("SYS_PMU_CONFIG", slot, CapRights::WRITE);
+    if err != 0 {
+        return err;
+    }
+    if index as usize >= crate::arch::pmu::num_counters() {
+        return u64::MAX - 4;
+    }
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &mut *cpu_local.current_thread };
+    crate::arch::pmu::configure(thread, index as usize, event);
+    0
+}
+
+/// Reads counter `index` of the CALLING thread.
+///
+/// # Returns
+/// `0` on success with the counter value in RDI. `u64::MAX - 4` if `index`
+/// is out of range, `u64::MAX - 6` if the thread has never programmed a
+/// counter (the hardware would only show the previous thread's count).
+fn sys_pmu_read(frame: &mut SyscallFrame, slot: u64, index: u64) -> u64 {
+    let err = check_pmu_cap("SYS_PMU_READ", slot, CapRights::READ);
+    if err != 0 {
+        return err;
+    }
+    if index as usize >= crate::arch::pmu::num_counters() {
+        return u64::MAX - 4;
+    }
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &*cpu_local.current_thread };
+    match crate::arch::pmu::read(thread, index as usize) {
+        Some(value) => {
+            frame.rdi = value;
+            0
+        }
+        None => u64::MAX - 6,
+    }
+}
+
+// =============================================================================
+// SYS_THREAD_STATS / SYS_SCHED_HIST — Scheduler accounting (Syscalls 15-16)
+// =============================================================================
+
+/// Validates that `slot` in the caller's CNode holds a `Scheduler`
+/// capability with `right`. Returns 0 on success or the syscall error code.
+fn check_sched_cap(name: &str, slot: u64, right: CapRights) -> u64 {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &*cpu_local.current_thread };
+    let process = unsafe { &*thread.process };
+
+    let cap = match process.cnode.lock().lookup(slot as usize).copied() {
+        Some(c) => c,
+        None => {
+            kprintln!("[syscall] {}: PID {} bad slot {}", name, process.pid, slot);
+            return u64::MAX;
+        }
+    };
+    match cap.object {
+        CapObject::Scheduler => {}
+        _ => {
+            kprintln!("[syscall] {}: PID {} slot {} is not a Scheduler capability",
+                name, process.pid, slot);
+            return u64::MAX - 2;
+        }
+    }
+    if !cap.rights.contains(right) {
+        kprintln!("[syscall] {}: PID {} missing right on slot {}", name, process.pid, slot);
+        return u64::MAX - 1;
+    }
+    0
+}
+
+/// Copies `records` to consecutive `T`-sized slots at `buf`, up to `max`.
+///
+/// # Returns
+/// `Some((written, total))`, or `None` if `buf` is not writable user memory.
+fn copy_records_to_user<T>(buf: u64, max: u64, for_each: impl FnOnce(&mut dyn FnMut(&T)))
+    -> Option<(u64, u64)>
+{
+    let record_size = core::mem::size_of::<T>() as u64;
+    let mut written = 0u64;
+    let mut total = 0u64;
+    let mut fault = false;
+    for_each(&mut |rec: &T| {
+        total += 1;
+        if fault || written >= max {
+            return;
+        }
+        let bytes = unsafe {
+            core::slice::from_raw_parts(rec as *const T as *const u8, record_size as usize)
+        };
+        if copy_to_user(buf.wrapping_add(written * record_size), bytes) {
+            written += 1;
+        } else {
+            fault = true;
+        }
+    });
+    if fault { None } else { Some((written, total)) }
+}
+
+/// Copies up to `max` `ThreadStatRecord`s (one per live thread) to `buf`.
+///
+/// # Arguments
+/// - `slot`: CNode slot containing a Scheduler capability (READ).
+/// - `buf`:  User buffer, `max * size_of::<ThreadStatRecord>()` bytes, writable.
+/// - `max`:  Capacity of `buf` in records.
+///
+/// # Returns
+/// `0` on success with RDI = records written, RSI = live threads (may
+/// exceed RDI if `buf` was too small), RDX = TSC at the snapshot.
+/// `u64::MAX - 4` if `buf` is not writable user memory.
+fn sys_thread_stats(frame: &mut SyscallFrame, slot: u64, buf: u64, max: u64) -> u64 {
+    use crate::sched::stats::{self, ThreadStatRecord};
+
+    let err = check_sched_cap("SYS_THREAD_STATS", slot, CapRights::READ);
+    if err != 0 {
+        return err;
+    }
+    let (written, live) = match copy_records_to_user::<ThreadStatRecord>(
+        buf, max, |f| stats::for_each(|rec| f(rec)),
+    ) {
+        Some(r) => r,
+        None => {
+            kprintln!("[syscall] SYS_THREAD_STATS: buffer {:#018X} not writable", buf);
+            return u64::MAX - 4;
+        }
+    };
+
+    frame.rdi = written;
+    frame.rsi = live;
+    frame.rdx = cpu::read_tsc();
+    0
+}
+
+/// Copies up to `max` `SchedHistRecord`s (one per core that has scheduled)
+/// to `buf`.
+///
+/// # Arguments
+/// - `slot`: CNode slot containing a Scheduler capability (READ).
+/// - `buf`:  User buffer, `max * size_of::<SchedHistRecord>()` bytes, writable.
+/// - `max`:  Capacity of `buf` in records.
+///
+/// # Returns
+/// `0` on success with RDI = records written, RSI = cores with data.
+/// `u64::MAX - 4` if `buf` is not writable user memory.
+fn sys_sched_hist(frame: &mut SyscallFrame, slot: u64, buf: u64, max: u64) -> u64 {
+    use crate::sched::stats::{self, SchedHistRecord};
+
+    let err = check_sched_cap("SYS_SCHED_HIST", slot, CapRights::READ);
+    if err != 0 {
+        return err;
+    }
+    let (written, cores) = match copy_records_to_user::<SchedHistRecord>(
+        buf, max, |f| stats::for_each_core_hist(|rec| f(rec)),
+    ) {
+        Some(r) => r,
+        None => {
+            kprintln!("[syscall] SYS_SCHED_HIST: buffer {:#018X} not writable", buf);
+            return u64::MAX - 4;
+        }
+    };
+
+    frame.rdi = written;
+    frame.rsi = cores;
+    0
+}
+
+// =============================================================================
+// SYS_SCHED_PIN — CPU affinity and isolation (Syscall 20)
+// =============================================================================
+
+/// `SYS_SCHED_PIN` core value that unpins the caller.
+const PIN_ANY_CORE: u64 = u64::MAX;
+
+/// `SYS_SCHED_PIN` flag: dedicate the core to the caller.
+const PIN_ISOLATE: u64 = 1 << 0;
+
+/// Pins the calling thread to a core; see `scheduler::pin_current`.
+///
+/// An isolated core runs only its pinned thread and stops its preemption
+/// tick while that thread is alone — for polling drivers that want no
+/// timer jitter.
+///
+/// # Arguments
+/// - `slot`:  CNode slot containing a Scheduler capability (WRITE).
+/// - `core`:  Core index, or `PIN_ANY_CORE` to unpin.
+/// - `flags`: `PIN_ISOLATE` to dedicate the core.
+///
+/// # Returns
+/// `0` on success, running on `core`. Error codes:
+/// - `u64::MAX - 3` — no such online core (or isolating core 0)
+/// - `u64::MAX - 5` — core is isolated for another thread, or (isolating)
+///   another thread is pinned to it
+fn sys_sched_pin(slot: u64, core: u64, flags: u64) -> u64 {
+    use crate::sched::scheduler::{self, PinError};
+
+    let err = check_sched_cap("SYS_SCHED_PIN", slot, CapRights::WRITE);
+    if err != 0 {
+        return err;
+    }
+    let core = if core == PIN_ANY_CORE { None } else { Some(core as usize) };
+    match unsafe { scheduler::pin_current(core, flags & PIN_ISOLATE != 0) } {
+        Ok(()) => 0,
+        Err(PinError::BadCore) => {
+            kprintln!("[syscall] SYS_SCHED_PIN: bad core {:?}", core);
+            u64::MAX - 3
+        }
+        Err(PinError::CoreTaken) => u64::MAX - 5,
+    }
+}
+
+// =============================================================================
+// SYS_SCHED_SET — Scheduling context (Syscall 21)
+// =============================================================================
+
+/// Sets the calling thread's own scheduling context.
+///
+/// Ready threads of a higher priority always run first. During an IPC
+/// call the thread may run on its caller's context instead (see
+/// `scheduler::donate`); the new context applies once that call ends, or
+/// at once if it outranks the donated one.
+///
+/// # Arguments
+/// - `slot`:       CNode slot containing a Scheduler capability (WRITE).
+/// - `priority`:   0 (lowest) ..= NUM_PRIORITIES - 1; the default is 3.
+/// - `quantum_us`: Time slice, QUANTUM_MIN_US ..= QUANTUM_MAX_US.
+///
+/// # Returns
+/// `0` on success. `u64::MAX - 3` for an out-of-range priority or quantum.
+fn sys_sched_set(slot: u64, priority: u64, quantum_us: u64) -> u64 {
+    use crate::sched::scheduler::{self, QUANTUM_MAX_US, QUANTUM_MIN_US};
+    use crate::sched::thread::{SchedContext, NUM_PRIORITIES};
+
+    let err = check_sched_cap("SYS_SCHED_SET", slot, CapRights::WRITE);
+    if err != 0 {
+        return err;
+    }
+    if priority >= NUM_PRIORITIES as u64
+        || !(QUANTUM_MIN_US as u64..=QUANTUM_MAX_US as u64).contains(&quantum_us)
+    {
+        kprintln!("[syscall] SYS_SCHED_SET: bad priority {} / quantum {} us", priority, quantum_us);
+        return u64::MAX - 3;
+    }
+    unsafe {
+        scheduler::set_current_context(SchedContext {
+            priority: priority as u8,
+            quantum_us: quantum_us as u32,
+        });
+    }
+    0
+}
+
+// =============================================================================
+// SYS_VM_DIRTY — Page dirty bits (Syscall 22)
+// =============================================================================
+
+/// Most pages one SYS_VM_DIRTY call covers (a 512-byte bitmap).
+const VM_DIRTY_MAX_PAGES: u64 = 4096;
+
+/// Reports which of the caller's pages `[vaddr, vaddr + pages * 4 KiB)`
+/// were written since the previous call for them, and clears their dirty
+/// bits — so a process can restore only what changed (init's Wasm
+/// instance pool).
+///
+/// No capability is involved: only the caller's own page tables are read.
+/// Bits are cleared with a local TLB flush and no shootdown, so the answer
+/// is only exact for pages nothing writes from another core. The caller
+/// must therefore be pinned (SYS_SCHED_PIN), and it must itself ensure no
+/// other thread writes those pages elsewhere. Writes the kernel makes
+/// through its own mapping of the frame are not seen either.
+///
+/// # Arguments
+///   - vaddr:  page-aligned start
+///   - pages:  1 ..= VM_DIRTY_MAX_PAGES
+///   - bitmap: user buffer of `pages.div_ceil(8)` bytes; bit i (LSB first)
+///             is set if page i was written. Unmapped, read-only and huge
+///             pages always read as written.
+///
+/// # Returns
+///   The number of pages written. Error codes:
+///   - `u64::MAX - 3` — misaligned, empty, oversized or kernel-half range
+///   - `u64::MAX - 4` — bitmap not writable
+///   - `u64::MAX - 5` — the caller is not pinned to a core
+fn sys_vm_dirty(vaddr: u64, pages: u64, bitmap: u64) -> u64 {
+    use crate::memory::address::{VirtAddr, PAGE_SIZE};
+    use crate::memory::vmm;
+    use crate::sched::thread::NO_CPU;
+
+    if vaddr % PAGE_SIZE != 0
+        || pages == 0
+        || pages > VM_DIRTY_MAX_PAGES
+        || vaddr.checked_add(pages * PAGE_SIZE).is_none_or(|end| end > 0x0000_8000_0000_0000)
+    {
+        kprintln!("[syscall] SYS_VM_DIRTY: bad range {:#018X} + {} pages", vaddr, pages);
+        return u64::MAX - 3;
+    }
+    // Interrupts are off, so the thread cannot migrate during the walk.
+    let current = unsafe { &*CpuLocal::get().current_thread };
+    if current.affinity == NO_CPU {
+        return u64::MAX - 5;
+    }
+
+    // Check the reply buffer first: bits taken here cannot be put back.
+    let pml4 = vmm::active_pml4();
+    let len = pages.div_ceil(8);
+    for byte in [bitmap, bitmap.wrapping_add(len - 1)] {
+        if byte >= 0x0000_8000_0000_0000 || vmm::translate_user(pml4, VirtAddr::new(byte), true).is_none() {
+            kprintln!("[syscall] SYS_VM_DIRTY: bad bitmap {:#018X}", bitmap);
+            return u64::MAX - 4;
+        }
+    }
+
+    let mut bits = [0u8; (VM_DIRTY_MAX_PAGES / 8) as usize];
+    let mut written = 0;
+    for i in 0..pages {
+        if vmm::take_dirty_user(pml4, VirtAddr::new(vaddr + i * PAGE_SIZE)) {
+            bits[(i / 8) as usize] |= 1 << (i % 8);
+            written += 1;
+        }
+    }
+
+    // Both pages were checked above and user mappings are never removed.
+    copy_to_user(bitmap, &bits[..len as usize]);
+    written
+}
+
 // =============================================================================
 // Ring 3 Transition
 // =============================================================================
@@ -0,0 +1,372 @@
+// =============================================================================
+// MinimalOS NextGen — In-Kernel Microbenchmark Suite (feature = "bench")
+// =============================================================================
+//
+// Cycle-accurate TSC microbenchmarks for the kernel's hot paths. Built only
+// with `--features bench` (see `make bench`) and run once from kmain, after
+// SYSCALL init and BEFORE the real scheduler starts, so nothing else is
+// runnable and the LAPIC timer is idle while we measure.
+//
+// OUTPUT FORMAT:
+//   One JSON object per line on serial, easy to grep and diff between runs:
+//
+//   {"bench":"pmm_alloc_frame","iters":4096,"unit":"tsc_cycles",
+//    "min":..,"median":..,"p99":..,"max":..,"mean":..}
+//
+//   Samples are per-operation TSC deltas minus the measured `rdtsc` pair
+//   overhead (reported once in the `bench_suite` header line). Throughput
+//   benchmarks add a rate line, e.g. {"bench":"fb_text","chars_per_sec":..}.
+//   The null syscall benchmark needs Ring 3, so it lives in init (also
+//   gated on its `bench` feature) and prints the same format.
+//
+// SCHEDULER BENCHMARKS:
+//   Context switch and IPC round-trip need a run queue. We install a private
+//   RunQueue + a "bench-main" TCB for the current context (same trick as
+//   `scheduler::init` uses for bsp-main), run the partner threads on it,
+//   and tear it down again before the real scheduler is initialized.
+//
+// =============================================================================
+
+extern crate alloc;
+
+use alloc::alloc::{alloc, dealloc, Layout};
+use alloc::boxed::Box;
+use alloc::vec::Vec;
+use core::hint::black_box;
+use core::sync::atomic::{AtomicBool, Ordering};
+
+use crate::arch::{cpu, lapic};
+use crate::cap::cnode::{CNode, CapObject, CapRights, Capability};
+use crate::ipc::endpoint::Endpoint;
+use crate::ipc::message::IpcMessage;
+use crate::kprintln;
+use crate::memory::address::VirtAddr;
+use crate::memory::pmm;
+use crate::memory::vmm::{self, PageTableFlags};
+use crate::sched::percpu::CpuLocal;
+use crate::sched::queue::QueueLink;
+use crate::sched::scheduler::{self, RunQueue};
+use crate::sched::thread::{SchedState, Thread, ThreadState, NO_CPU, NO_TID};
+
+/// Iterations for cheap, allocation-free benchmarks.
+const ITERS: usize = 4096;
+
+/// Iterations for benchmarks that go through the scheduler.
+const SCHED_ITERS: usize = 1024;
+
+/// Scratch user-half address for map/unmap (in a private, throwaway PML4).
+const SCRATCH_VADDR: u64 = 0x0000_1000_0000_0000;
+
+// =============================================================================
+// Timing helpers
+// =============================================================================
+
+/// Reads the TSC after all previous instructions have completed.
+///
+/// `lfence` keeps the measured operation from leaking across the read
+/// (plain RDTSC is not ordered against earlier loads).
+#[inline(always)]
+fn tsc() -> u64 {
+    unsafe { core::arch::asm!("lfence", options(nomem, nostack)); }
+    let t = cpu::read_tsc();
+    unsafe { core::arch::asm!("lfence", options(nomem, nostack)); }
+    t
+}
+
+/// Minimum cost of an empty `tsc()` pair — subtracted from every sample.
+fn measure_overhead() -> u64 {
+    let mut best = u64::MAX;
+    for _ in 0..ITERS {
+        let t0 = tsc();
+        let t1 = tsc();
+        best = best.min(t1 - t0);
+    }
+    best
+}
+
+/// Sorts the samples and prints one JSON result line.
+fn report(name: &str, samples: &mut Vec<u64>) {
+    samples.sort_unstable();
+    let n = samples.len();
+    let sum: u64 = samples.iter().sum();
+    kprintln!(
+        "{{\"bench\":\"{}\",\"iters\":{},\"unit\":\"tsc_cycles\",\"min\":{},\"median\":{},\"p99\":{},\"max\":{},\"mean\":{}}}",
+        name, n, samples[0], samples[n / 2], samples[(n * 99) / 100], samples[n - 1], sum / n as u64
+    );
+}
+
+/// Times `op` `iters` times; `op` gets the iteration index.
+fn run(name: &str, iters: usize, overhead: u64, mut op: impl FnMut(usize)) {
+    let mut samples = Vec::with_capacity(iters);
+    for i in 0..iters {
+        let t0 = tsc();
+        op(i);
+        let t1 = tsc();
+        samples.push((t1 - t0).saturating_sub(overhead));
+    }
+    report(name, &mut samples);
+}
+
+// =============================================================================
+// Entry point
+// =============================================================================
+
+/// Runs the whole kernel benchmark suite and prints JSON lines on serial.
+///
+/// Must be called on the BSP after `CpuLocal` is installed and before
+/// `sched::scheduler::init()` (the scheduler benches need an idle core).
+pub fn run_all() {
+    kprintln!();
+    kprintln!("[bench] Running kernel microbenchmarks...");
+
+    let overhead = measure_overhead();
+    kprintln!("{{\"bench_suite\":\"kernel\",\"tsc_overhead\":{}}}", overhead);
+
+    bench_pmm(overhead);
+    bench_heap(overhead);
+    bench_map_unmap(overhead);
+    bench_cnode_lookup(overhead);
+    bench_context_switch(overhead);
+    bench_ipc_round_trip(overhead);
+    bench_fb_text(overhead);
+
+    kprintln!("[bench] Kernel microbenchmarks done");
+}
+
+// =============================================================================
+// Memory benchmarks
+// =============================================================================
+
+/// `pmm::alloc_frame` (the free is untimed).
+fn bench_pmm(overhead: u64) {
+    let mut frames = Vec::with_capacity(ITERS);
+    run("pmm_alloc_frame", ITERS, overhead, |_| {
+        frames.push(pmm::alloc_frame().expect("[bench] PMM exhausted"));
+    });
+    for f in frames.drain(..) {
+        pmm::free_frame(f);
+    }
+}
+
+/// One 64-byte kernel heap alloc + free pair.
+fn bench_heap(overhead: u64) {
+    let layout = Layout::from_size_align(64, 8).unwrap();
+    run("heap_alloc_free_64", ITERS, overhead, |_| unsafe {
+        let p = alloc(layout);
+        black_box(p);
+        dealloc(p, layout);
+    });
+}
+
+/// `vmm::map_page` + `unmap_page` + `invlpg` on a private PML4.
+///
+/// The first iteration also pays for creating the intermediate tables;
+/// the median reflects the steady state.
+fn bench_map_unmap(overhead: u64) {
+    let pml4 = vmm::new_table().expect("[bench] no frame for scratch PML4");
+    let frame = pmm::alloc_frame().expect("[bench] no frame for scratch page");
+    let virt = VirtAddr::new(SCRATCH_VADDR);
+
+    run("vmm_map_unmap", ITERS, overhead, |_| unsafe {
+        vmm::map_page(pml4, virt, frame, PageTableFlags::KERNEL_DATA)
+            .expect("[bench] map_page failed");
+        vmm::unmap_page(pml4, virt).expect("[bench] unmap_page failed");
+        vmm::flush(virt);
+    });
+
+    // Leaf is unmapped, so this only frees the intermediate tables + PML4.
+    unsafe { vmm::destroy_user_address_space(pml4); }
+    pmm::free_frame(frame);
+}
+
+/// `CNode::lookup` over a fully populated CNode.
+fn bench_cnode_lookup(overhead: u64) {
+    let mut cnode = CNode::new();
+    while cnode.insert(Capability::new(CapObject::PmmAllocator, CapRights::ALL)).is_some() {}
+
+    run("cnode_lookup", ITERS, overhead, |i| {
+        black_box(cnode.lookup(black_box(i % 64)));
+    });
+}
+
+// =============================================================================
+// Scheduler benchmarks
+// =============================================================================
+
+/// Set by the bench-main thread to tell partner threads to return.
+static STOP: AtomicBool = AtomicBool::new(false);
+
+/// Request/reply endpoints for the IPC round-trip benchmark.
+/// IDs are outside the syscall ENDPOINT_TABLE range so they never alias.
+static EP_REQUEST: Endpoint = Endpoint::new(0xBE00);
+static EP_REPLY: Endpoint = Endpoint::new(0xBE01);
+
+/// Label that tells the IPC echo server to exit.
+const LABEL_STOP: u64 = u64::MAX;
+
+/// Voluntarily gives up the CPU (current thread stays Ready).
+#[inline(always)]
+fn yield_now() {
+    unsafe {
+        core::arch::asm!("cli", options(nomem, nostack));
+        scheduler::schedule();
+        core::arch::asm!("sti", options(nomem, nostack));
+    }
+}
+
+/// Installs a private run queue and a TCB for the current context, runs
+/// `f`, drains the queue, and uninstalls everything again.
+fn with_private_scheduler(f: impl FnOnce(*mut RunQueue)) {
+    let rq = Box::into_raw(Box::new(RunQueue::new()));
+    let main = Box::into_raw(Box::new(Thread {
+        id: 0,
+        state: ThreadState::Running,
+        rsp: 0,
+        kernel_stack_base: 0, // running on the boot stack
+        kernel_stack_size: 0,
+        name: {
+            let mut buf = [0u8; 32];
+            let name = b"bench-main";
+            buf[..name.len()].copy_from_slice(name);
+            buf
+        },
+        name_len: 10,
+        process: core::ptr::null_mut(),
+        ipc_buffer: IpcMessage::EMPTY,
+        user_rip: 0,
+        user_rsp: 0,
+        pmu: None,
+        stats: core::ptr::null(),
+        on_cpu: AtomicBool::new(true),
+        link: QueueLink::new(),
+        futex_space: 0,
+        futex_addr: 0,
+        last_cpu: NO_CPU,
+        ipc_waker: NO_TID,
+        affinity: NO_CPU,
+        sched: SchedState::DEFAULT,
+    }));
+
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    cpu_local.run_queue = rq;
+    cpu_local.current_thread = main;
+    STOP.store(false, Ordering::SeqCst);
+
+    f(rq);
+
+    // Let partners observe STOP and exit (they land in DEAD_QUEUE and the
+    // reaper frees their stacks once the real scheduler is running).
+    STOP.store(true, Ordering::SeqCst);
+    while unsafe { !(*rq).is_empty() } {
+        yield_now();
+    }
+
+    // schedule() re-arms the one-shot timer on every switch — stop it.
+    lapic::set_timer_oneshot(0);
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    cpu_local.run_queue = core::ptr::null_mut();
+    cpu_local.current_thread = core::ptr::null_mut();
+    unsafe {
+        drop(Box::from_raw(main));
+        drop(Box::from_raw(rq));
+    }
+}
+
+/// Partner thread for the context switch benchmark: yields until STOP.
+extern "C" fn yield_partner(_arg: u64) {
+    while !STOP.load(Ordering::Relaxed) {
+        yield_now();
+    }
+}
+
+/// Echo server for the IPC round-trip benchmark.
+extern "C" fn ipc_echo_server(_arg: u64) {
+    loop {
+        let msg = EP_REQUEST.recv();
+        if msg.label == LABEL_STOP {
+            return;
+        }
+        EP_REPLY.send(&msg);
+    }
+}
+
+/// Thread switch via `schedule()` + `switch_context`. One sample is a
+/// yield round trip (A→B→A), so it is halved to get a single switch.
+fn bench_context_switch(overhead: u64) {
+    with_private_scheduler(|rq| {
+        let partner = Thread::new("bench-yield", yield_partner, 0, core::ptr::null_mut());
+        unsafe { (*rq).push_ready(partner); }
+        yield_now(); // warm up: let the partner reach its loop
+
+        let mut samples = Vec::with_capacity(SCHED_ITERS);
+        for _ in 0..SCHED_ITERS {
+            let t0 = tsc();
+            yield_now();
+            let t1 = tsc();
+            samples.push((t1 - t0).saturating_sub(overhead) / 2);
+        }
+        report("context_switch", &mut samples);
+    });
+}
+
+/// Synchronous send → echo → recv between two kernel threads.
+fn bench_ipc_round_trip(overhead: u64) {
+    with_private_scheduler(|rq| {
+        let server = Thread::new("bench-echo", ipc_echo_server, 0, core::ptr::null_mut());
+        unsafe { (*rq).push(server); }
+
+        let msg = IpcMessage::with_data(1, [0xB, 0xE, 0xC, 0xD]);
+        run("ipc_round_trip", SCHED_ITERS, overhead, |_| {
+            EP_REQUEST.send(&msg);
+            black_box(EP_REPLY.recv());
+        });
+
+        EP_REQUEST.send(&IpcMessage::with_data(LABEL_STOP, [0; 4]));
+    });
+}
+
+// =============================================================================
+// Console benchmarks
+// =============================================================================
+
+/// Characters per timed framebuffer line (one full-width-ish log line).
+const FB_LINE_CHARS: usize = 80;
+
+/// Framebuffer text rendering: one 80-character line per iteration via
+/// `framebuffer::write_str` (render + scroll + VRAM flush), plus the
+/// resulting throughput in characters per second.
+fn bench_fb_text(overhead: u64) {
+    use crate::drivers::framebuffer;
+
+    if !framebuffer::is_available() {
+        kprintln!("[bench] fb_text skipped — no framebuffer console");
+        return;
+    }
+
+    // 79 printable characters + newline, so every iteration scrolls once
+    // the screen is full (steady-state log output).
+    let mut line = [b'.'; FB_LINE_CHARS];
+    for (i, b) in line.iter_mut().enumerate().take(FB_LINE_CHARS - 1) {
+        *b = b' ' + (i % 95) as u8;
+    }
+    line[FB_LINE_CHARS - 1] = b'\n';
+    let text = core::str::from_utf8(&line).unwrap();
+
+    let mut samples = Vec::with_capacity(SCHED_ITERS);
+    for _ in 0..SCHED_ITERS {
+        let t0 = tsc();
+        framebuffer::write_str(black_box(text));
+        let t1 = tsc();
+        samples.push((t1 - t0).saturating_sub(overhead));
+    }
+    let total: u64 = samples.iter().sum();
+    report("fb_text_line_80", &mut samples);
+
+    let chars = (SCHED_ITERS * FB_LINE_CHARS) as u64;
+    let tsc_hz = lapic::tsc_hz();
+    let per_sec = if total == 0 { 0 } else { (chars as u128 * tsc_hz as u128 / total as u128) as u64 };
+    kprintln!(
+        "{{\"bench\":\"fb_text\",\"chars\":{},\"cycles\":{},\"tsc_hz\":{},\"unit\":\"chars_per_sec\",\"chars_per_sec\":{}}}",
+        chars, total, tsc_hz, per_sec
+    );
+}
@@ -0,0 +1,186 @@
+// =============================================================================
+// MinimalOS NextGen — Boot Task Graph
+// =============================================================================
+//
+// Lets `kmain` hand independent boot work to the Application Processors
+// instead of running every phase back to back on the BSP:
+//
+//   BSP                                APs (after ap_rust_entry setup)
+//   ───                                ───────────────────────────────
+//   smp::init()  ── wake APs ───────→  ap_help(): loop { run_one() }
+//   spawn("pci", ..)                     ├─ pci
+//   spawn("initrd_stage", ..)            ├─ initrd_stage
+//   spawn("zero_pool", ..)               └─ zero_pool
+//   load init ELF, build stack ...
+//   t.join()     ← result ─────────────
+//   seal()       ── APs start their schedulers (scheduler::init_ap)
+//
+// A task is a boxed closure in a fixed table. Whoever claims it first runs
+// it — an AP, or the BSP itself when it blocks in `join()` — so a
+// single-core machine runs exactly the same graph, just serially.
+//
+// EDGES:
+//   There is no dependency solver: the BSP expresses an edge by calling
+//   `join()` right before the first use of a task's result. Tasks must not
+//   depend on each other and must only touch state that is either locked
+//   (PMM, heap, serial) or owned by that one task (PCI config ports).
+//
+// ORDERING:
+//   `STATE[i] = DONE` is a Release store after the task's writes; `join()`
+//   and `seal()` observe it with Acquire, so everything the task wrote
+//   (including plain statics) is visible to the BSP afterwards.
+//
+// The table is boot-only: slots are never reused and `seal()` retires it.
+//
+// =============================================================================
+
+extern crate alloc;
+
+use alloc::boxed::Box;
+use alloc::sync::Arc;
+use core::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, AtomicU8, Ordering};
+
+use crate::arch::cpu;
+use crate::sched::percpu::CpuLocal;
+use crate::sync::spinlock::SpinLock;
+
+/// Maximum number of boot tasks.
+const MAX_TASKS: usize = 8;
+
+/// Slot states.
+const EMPTY: u8 = 0;
+const PENDING: u8 = 1;
+const RUNNING: u8 = 2;
+const DONE: u8 = 3;
+
+/// One queued task.
+struct Slot {
+    name: &'static str,
+    work: Option<Box<dyn FnOnce() + Send>>,
+}
+
+static SLOTS: SpinLock<[Slot; MAX_TASKS]> =
+    SpinLock::new([const { Slot { name: "", work: None } }; MAX_TASKS]);
+
+/// Slot state; PENDING → RUNNING only under the `SLOTS` lock.
+static STATE: [AtomicU8; MAX_TASKS] = [const { AtomicU8::new(EMPTY) }; MAX_TASKS];
+
+/// Core that ran each task, and its TSC start/end (for the boot report).
+static CORE: [AtomicU32; MAX_TASKS] = [const { AtomicU32::new(0) }; MAX_TASKS];
+static START_TSC: [AtomicU64; MAX_TASKS] = [const { AtomicU64::new(0) }; MAX_TASKS];
+static END_TSC: [AtomicU64; MAX_TASKS] = [const { AtomicU64::new(0) }; MAX_TASKS];
+
+/// Set by `seal()`: no more tasks will be spawned, APs may go idle.
+static SEALED: AtomicBool = AtomicBool::new(false);
+
+/// Handle to a spawned task; `join()` returns its result.
+pub struct BootTask<T> {
+    slot: usize,
+    result: Arc<SpinLock<Option<T>>>,
+}
+
+/// Queues `f` for the first idle core (or the BSP at `join()` time).
+///
+/// # Panics
+/// If the task table is full or the table was already sealed.
+pub fn spawn<T, F>(name: &'static str, f: F) -> BootTask<T>
+where
+    T: Send + 'static,
+    F: FnOnce() -> T + Send + 'static,
+{
+    assert!(!SEALED.load(Ordering::Relaxed), "boot_tasks: spawn after seal");
+
+    let result = Arc::new(SpinLock::new(None));
+    let out = result.clone();
+    let work: Box<dyn FnOnce() + Send> = Box::new(move || {
+        let value = f();
+        *out.lock() = Some(value);
+    });
+
+    let mut slots = SLOTS.lock();
+    let slot = (0..MAX_TASKS)
+        .find(|&i| STATE[i].load(Ordering::Relaxed) == EMPTY)
+        .expect("boot_tasks: task table full");
+    slots[slot] = Slot { name, work: Some(work) };
+    STATE[slot].store(PENDING, Ordering::Release);
+
+    BootTask { slot, result }
+}
+
+impl<T> BootTask<T> {
+    /// Waits for the task, running it (or any other pending task) on this
+    /// core instead of spinning idle.
+    pub fn join(self) -> T {
+        run_slot(self.slot);
+        while STATE[self.slot].load(Ordering::Acquire) != DONE {
+            if !run_one() {
+                core::hint::spin_loop();
+            }
+        }
+        self.result.lock().take().expect("boot_tasks: task finished without a result")
+    }
+}
+
+/// Runs slot `i` on this core if it is still pending.
+fn run_slot(i: usize) -> bool {
+    let work = {
+        let mut slots = SLOTS.lock();
+        if STATE[i].load(Ordering::Relaxed) != PENDING {
+            return false;
+        }
+        STATE[i].store(RUNNING, Ordering::Relaxed);
+        slots[i].work.take()
+    };
+
+    // SAFETY: every core that runs tasks has installed its CpuLocal.
+    let core = unsafe { CpuLocal::get().core_index };
+    CORE[i].store(core, Ordering::Relaxed);
+    START_TSC[i].store(cpu::read_tsc(), Ordering::Relaxed);
+    if let Some(work) = work {
+        work();
+    }
+    END_TSC[i].store(cpu::read_tsc(), Ordering::Relaxed);
+    STATE[i].store(DONE, Ordering::Release);
+    true
+}
+
+/// Claims and runs the first pending task. Returns false if none was pending.
+pub fn run_one() -> bool {
+    (0..MAX_TASKS).any(run_slot)
+}
+
+/// AP side: run tasks until the BSP seals the table.
+pub fn ap_help() {
+    while !SEALED.load(Ordering::Acquire) {
+        if !run_one() {
+            core::hint::spin_loop();
+        }
+    }
+}
+
+/// BSP side: finishes every outstanding task and releases the APs.
+pub fn seal() {
+    for i in 0..MAX_TASKS {
+        while matches!(STATE[i].load(Ordering::Acquire), PENDING | RUNNING) {
+            if !run_one() {
+                core::hint::spin_loop();
+            }
+        }
+    }
+    SEALED.store(true, Ordering::Release);
+}
+
+/// Calls `f(name, core, start_tsc, end_tsc)` for every finished task.
+pub fn for_each_done(mut f: impl FnMut(&'static str, u32, u64, u64)) {
+    // Copy the names out so `f` may print without holding the table lock.
+    let names: [&'static str; MAX_TASKS] = {
+        let slots = SLOTS.lock();
+        core::array::from_fn(|i| slots[i].name)
+    };
+    for i in 0..MAX_TASKS {
+        if STATE[i].load(Ordering::Acquire) == DONE {
+            f(names[i], CORE[i].load(Ordering::Relaxed),
+                START_TSC[i].load(Ordering::Relaxed), END_TSC[i].load(Ordering::Relaxed));
+        }
+    }
+}
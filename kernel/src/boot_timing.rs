@@ -0,0 +1,169 @@
+// =============================================================================
+// MinimalOS NextGen — Boot-Phase Timing
+// =============================================================================
+//
+// Records a TSC timestamp at every phase boundary of `kmain` and at every
+// AP bring-up, then prints where the boot time went:
+//
+//   [boot] ─── Boot timing (TSC 1600 MHz) ───
+//   [boot]   phase                   cycles        us      %
+//   [boot]   pmm                    1234567       771    4.2
+//   ...
+//   {"boot_timing":{"tsc_hz":1600000000,"pre_kernel":...,"phases":{...},"aps":{...},"tasks":{...}}}
+//
+// The JSON line is what scripts should parse (same one-line-per-record
+// convention as the bench suite).
+//
+// WHAT A PHASE MEANS:
+//   `mark("x")` closes phase "x": its duration is the time since the
+//   previous mark (or kmain entry). Keep marks at the END of each phase.
+//
+// PRE-KERNEL TIME:
+//   The TSC counts from reset, so its value at kmain entry approximates
+//   firmware + Limine time (exact on hardware with an invariant TSC that
+//   starts at 0; only indicative under QEMU/KVM).
+//
+// All marks are taken on the BSP; APs only store their own online stamp.
+// Work offloaded to the APs (boot_tasks.rs) is listed separately with the
+// core that ran it — BSP phases only show the time spent waiting for it.
+// Until the LAPIC is calibrated the TSC frequency is unknown, so µs and
+// the frequency are filled in at report time.
+//
+// =============================================================================
+
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use crate::arch::cpu;
+use crate::arch::x86_64::gdt::MAX_CPUS;
+use crate::kprintln;
+use crate::sync::spinlock::SpinLock;
+
+/// Maximum number of phase marks.
+const MAX_MARKS: usize = 32;
+
+/// Phase timeline (BSP only).
+#[derive(Clone, Copy)]
+struct Timeline {
+    /// TSC at kmain entry (0 = `start()` not called yet).
+    entry: u64,
+    names: [&'static str; MAX_MARKS],
+    tsc: [u64; MAX_MARKS],
+    len: usize,
+}
+
+static TIMELINE: SpinLock<Timeline> = SpinLock::new(Timeline {
+    entry: 0,
+    names: [""; MAX_MARKS],
+    tsc: [0; MAX_MARKS],
+    len: 0,
+});
+
+/// TSC when the BSP released the APs (`smp::init`).
+static AP_RELEASE_TSC: AtomicU64 = AtomicU64::new(0);
+
+/// TSC when each AP finished `ap_rust_entry` setup (0 = not online).
+static AP_ONLINE_TSC: [AtomicU64; MAX_CPUS] = [const { AtomicU64::new(0) }; MAX_CPUS];
+
+/// Records the kmain entry timestamp. First thing `kmain` does.
+pub fn start() {
+    TIMELINE.lock().entry = cpu::read_tsc();
+}
+
+/// Closes boot phase `name` at the current TSC.
+pub fn mark(name: &'static str) {
+    let now = cpu::read_tsc();
+    let mut t = TIMELINE.lock();
+    if t.len < MAX_MARKS {
+        let i = t.len;
+        t.names[i] = name;
+        t.tsc[i] = now;
+        t.len += 1;
+    }
+}
+
+/// BSP is about to wake the APs.
+pub fn ap_release() {
+    AP_RELEASE_TSC.store(cpu::read_tsc(), Ordering::Relaxed);
+}
+
+/// AP `core` finished its per-core setup.
+pub fn ap_online(core: usize) {
+    if core < MAX_CPUS {
+        AP_ONLINE_TSC[core].store(cpu::read_tsc(), Ordering::Relaxed);
+    }
+}
+
+/// TSC cycles → microseconds (0 if the TSC frequency is unknown).
+fn to_us(cycles: u64, tsc_hz: u64) -> u64 {
+    if tsc_hz == 0 { 0 } else { (cycles as u128 * 1_000_000 / tsc_hz as u128) as u64 }
+}
+
+/// Prints the phase table and the machine-readable `boot_timing` line.
+pub fn report() {
+    // Copy out so the lock (and IF=0) isn't held across serial output.
+    let t = *TIMELINE.lock();
+    let tsc_hz = crate::arch::lapic::tsc_hz();
+    let end = if t.len > 0 { t.tsc[t.len - 1] } else { t.entry };
+    let total = end.saturating_sub(t.entry).max(1);
+
+    kprintln!();
+    kprintln!("[boot] ─── Boot timing (TSC {} MHz) ───", tsc_hz / 1_000_000);
+    kprintln!("[boot]   {:<20} {:>12} {:>9} {:>6}", "phase", "cycles", "us", "%");
+    kprintln!("[boot]   {:<20} {:>12} {:>9} {:>6}", "(pre-kernel)", t.entry,
+        to_us(t.entry, tsc_hz), "-");
+    let mut prev = t.entry;
+    for i in 0..t.len {
+        let d = t.tsc[i].saturating_sub(prev);
+        prev = t.tsc[i];
+        let tenths = d * 1000 / total;
+        kprintln!("[boot]   {:<20} {:>12} {:>9} {:>4}.{}",
+            t.names[i], d, to_us(d, tsc_hz), tenths / 10, tenths % 10);
+    }
+    kprintln!("[boot]   {:<20} {:>12} {:>9} {:>6}", "total (kmain)", total,
+        to_us(total, tsc_hz), "100.0");
+
+    let release = AP_RELEASE_TSC.load(Ordering::Relaxed);
+    for core in 1..MAX_CPUS {
+        let online = AP_ONLINE_TSC[core].load(Ordering::Relaxed);
+        if online != 0 && release != 0 {
+            let d = online.saturating_sub(release);
+            kprintln!("[boot]   AP core {:<12} {:>12} {:>9}", core, d, to_us(d, tsc_hz));
+        }
+    }
+
+    // Boot tasks: offset from kmain entry, duration, and which core ran them.
+    crate::boot_tasks::for_each_done(|name, core, start, end| {
+        let d = end.saturating_sub(start);
+        kprintln!("[boot]   task {:<15} {:>12} {:>9}  core {} @ +{} us", name, d,
+            to_us(d, tsc_hz), core, to_us(start.saturating_sub(t.entry), tsc_hz));
+    });
+
+    // Machine-readable: one JSON line, phases in boot order.
+    crate::kprint!("{{\"boot_timing\":{{\"tsc_hz\":{},\"pre_kernel\":{},\"total\":{},\"phases\":{{",
+        tsc_hz, t.entry, total);
+    let mut prev = t.entry;
+    for i in 0..t.len {
+        crate::kprint!("{}\"{}\":{}", if i == 0 { "" } else { "," }, t.names[i],
+            t.tsc[i].saturating_sub(prev));
+        prev = t.tsc[i];
+    }
+    crate::kprint!("}},\"aps\":{{");
+    let mut first = true;
+    for core in 1..MAX_CPUS {
+        let online = AP_ONLINE_TSC[core].load(Ordering::Relaxed);
+        if online != 0 && release != 0 {
+            crate::kprint!("{}\"{}\":{}", if first { "" } else { "," }, core,
+                online.saturating_sub(release));
+            first = false;
+        }
+    }
+    crate::kprint!("}},\"tasks\":{{");
+    let mut first = true;
+    crate::boot_tasks::for_each_done(|name, core, start, end| {
+        crate::kprint!("{}\"{}\":{{\"core\":{},\"start\":{},\"cycles\":{}}}",
+            if first { "" } else { "," }, name, core,
+            start.saturating_sub(t.entry), end.saturating_sub(start));
+        first = false;
+    });
+    kprintln!("}}}}}}");
+}
@@ -21,21 +21,48 @@
 //   After ExitBootServices(), UEFI's console output service is gone.
 //   The only output we have is raw pixel access to the framebuffer.
 //
+// SHADOW BUFFER:
+//   Reading VRAM is slow (uncached or write-combined: every load goes to the
+//   device), so once the PMM is up `attach_shadow()` gives the console a
+//   RAM copy of the screen. All drawing goes to the shadow; the rectangle
+//   that changed is copied to VRAM once per `write_fmt()` call:
+//
+//     draw_char / scroll / clear ──→ shadow (RAM, write-back)
+//                                      │  dirty rect
+//     write_fmt() end ── flush() ──────┴──→ VRAM (write-combining, PAT)
+//
+//   VRAM is only ever written, in whole-row runs, which is exactly what
+//   write-combining is good at. Before the shadow exists (Phase 2 banner)
+//   the console draws straight into VRAM.
+//
 // SCROLLING:
-//   When text reaches the bottom of the screen, we scroll by copying
-//   the framebuffer contents up by one line height (16 pixels) and
-//   clearing the bottom line. This is a memcpy of ~4MB on 1366x768 —
-//   takes about 0.3ms on N3710, acceptable for a debug console.
+//   With the shadow, scrolling is one memmove of the shadow (RAM to RAM,
+//   `rep movs`) plus a `rep stos` fill of the bottom text row; the next
+//   flush rewrites the whole screen with streaming stores. The kernel is
+//   built without SSE, so the string instructions are the "wide" moves.
+//
+// WRITE-COMBINING:
+//   `pml4::build()` maps `vram_window()` with PAT entry 1, which
+//   `cpu::init_pat()` reprograms from write-through to write-combining.
+//   `flush()` ends with SFENCE so the WC buffers drain before we unlock.
+//
+// GLYPH SPANS:
+//   A font row is one byte = 8 pixels, so there are only 256 possible
+//   rows. `set_colors()` expands each of them once into an 8-pixel 32bpp
+//   span for the current fg/bg. Drawing a character is then 16 lookups
+//   and 16 × 32-byte row copies (four 8-byte stores each) instead of 128
+//   bounds-checked single-pixel writes.
 //
 // THREAD SAFETY:
-//   The framebuffer console is protected by the SERIAL spinlock
-//   (since kprintln writes to both serial AND framebuffer atomically).
-//   This is a simplification — a future improvement could use a separate
-//   lock for the framebuffer.
+//   All console state lives behind the CONSOLE spinlock. `kprint!` only
+//   goes to serial; callers that want screen output use `write_fmt()`.
 //
 // =============================================================================
 
 use crate::arch::boot::FramebufferInfo;
+use crate::kprintln;
+use crate::memory::address::{self, PAGE_SIZE};
+use crate::memory::pmm;
 use crate::sync::spinlock::SpinLock;
 
 // =============================================================================
@@ -100,10 +127,14 @@ pub static CONSOLE: SpinLock<Option<Console>> = SpinLock::new(None);
 /// for text rendering. The cursor auto-advances on each character write
 /// and wraps/scrolls when it reaches the screen edge or bottom.
 pub struct Console {
-    /// Raw pointer to the framebuffer pixel data.
+    /// Raw pointer to the framebuffer pixel data (VRAM).
     /// Each pixel is 4 bytes (32-bit XRGB).
     buffer: *mut u32,
 
+    /// RAM shadow of the screen, `width * height` pixels with no row
+    /// padding. Null until `attach_shadow()`; then all drawing goes here.
+    shadow: *mut u32,
+
     /// Width of the framebuffer in pixels.
     width: u64,
 
@@ -124,6 +155,41 @@ pub struct Console {
 
     /// Maximum number of character rows that fit on screen.
     max_rows: u64,
+
+    /// Shadow pixels not yet copied to VRAM.
+    dirty: DirtyRect,
+
+    /// Current text colors (0x00RRGGBB).
+    fg: u32,
+    bg: u32,
+
+    /// `spans[b]` = font row byte `b` expanded to 8 pixels in fg/bg.
+    spans: [[u32; CHAR_WIDTH as usize]; 256],
+}
+
+/// Pixel rectangle `[x0, x1) × [y0, y1)`; empty when `x0 >= x1`.
+#[derive(Clone, Copy)]
+struct DirtyRect {
+    x0: u64,
+    y0: u64,
+    x1: u64,
+    y1: u64,
+}
+
+impl DirtyRect {
+    const EMPTY: Self = DirtyRect { x0: u64::MAX, y0: u64::MAX, x1: 0, y1: 0 };
+
+    fn is_empty(&self) -> bool {
+        self.x0 >= self.x1
+    }
+
+    /// Grows the rectangle to cover `[x0, x1) × [y0, y1)`.
+    fn add(&mut self, x0: u64, y0: u64, x1: u64, y1: u64) {
+        self.x0 = self.x0.min(x0);
+        self.y0 = self.y0.min(y0);
+        self.x1 = self.x1.max(x1);
+        self.y1 = self.y1.max(y1);
+    }
 }
 
 // SAFETY: The framebuffer pointer is valid for the lifetime of the system
@@ -142,6 +208,7 @@ impl Console {
 
         let mut console = Console {
             buffer: info.address as *mut u32,
+            shadow: core::ptr::null_mut(),
             width: info.width,
             height: info.height,
             pitch: info.pitch,
@@ -149,20 +216,34 @@ impl Console {
             cursor_y: 0,
             max_cols,
             max_rows,
+            dirty: DirtyRect::EMPTY,
+            fg: FG_COLOR,
+            bg: BG_COLOR,
+            spans: [[0; CHAR_WIDTH as usize]; 256],
         };
 
-        // Clear the screen to background color.
+        // Expand the glyph spans, then clear the screen to background color.
+        console.set_colors(FG_COLOR, BG_COLOR);
         console.clear();
         console
     }
 
-    /// Clears the entire screen to the background color.
-    pub fn clear(&mut self) {
-        for y in 0..self.height {
-            for x in 0..self.width {
-                self.put_pixel(x, y, BG_COLOR);
+    /// Sets the text colors and rebuilds the glyph span table for them.
+    /// Text already on screen keeps its old colors.
+    pub fn set_colors(&mut self, fg: u32, bg: u32) {
+        self.fg = fg;
+        self.bg = bg;
+        for (bits, span) in self.spans.iter_mut().enumerate() {
+            for (dx, px) in span.iter_mut().enumerate() {
+                // Bit 7 = leftmost pixel, bit 0 = rightmost pixel.
+                *px = if (bits >> (7 - dx)) & 1 == 1 { fg } else { bg };
             }
         }
+    }
+
+    /// Clears the entire screen to the background color.
+    pub fn clear(&mut self) {
+        self.fill_rows(0, self.height, self.bg);
         self.cursor_x = 0;
         self.cursor_y = 0;
     }
@@ -231,49 +312,53 @@ impl Console {
     /// Draws a single character glyph at the given character cell position.
     ///
     /// The character is rendered using the built-in 8x16 bitmap font.
-    /// The font data is a simple array: each ASCII character has 16 bytes,
-    /// each byte is a row of 8 pixels (MSB = leftmost pixel).
+    /// Each of its 16 row bytes picks a pre-expanded span from `spans`,
+    /// which is copied into the target buffer as one 32-byte row.
     ///
     /// # Parameters
-    /// - `col`: Character column (0-based)
-    /// - `row`: Character row (0-based)
+    /// - `col`: Character column (0-based, < max_cols)
+    /// - `row`: Character row (0-based, < max_rows)
     /// - `ascii`: ASCII character code to render
     fn draw_char(&mut self, col: u64, row: u64, ascii: u8) {
         let glyph = get_glyph(ascii);
         let base_x = col * CHAR_WIDTH;
         let base_y = row * CHAR_HEIGHT;
+        let (base, stride) = self.target();
 
-        for (dy, &glyph_row) in glyph.iter().enumerate() {
-            for dx in 0..CHAR_WIDTH {
-                // Check if this pixel is "on" in the glyph.
-                // Bit 7 = leftmost pixel, bit 0 = rightmost pixel.
-                let pixel_on = (glyph_row >> (7 - dx)) & 1 == 1;
-                let color = if pixel_on { FG_COLOR } else { BG_COLOR };
-                self.put_pixel(base_x + dx, base_y + dy as u64, color);
+        // SAFETY: the cursor keeps col/row inside the character grid, so
+        // the 8 × 16 cell lies inside the buffer.
+        unsafe {
+            let mut dst = base.add((base_y * stride + base_x) as usize);
+            for &bits in glyph.iter() {
+                core::ptr::copy_nonoverlapping(
+                    self.spans[bits as usize].as_ptr(),
+                    dst,
+                    CHAR_WIDTH as usize,
+                );
+                dst = dst.add(stride as usize);
             }
         }
+        self.dirty.add(base_x, base_y, base_x + CHAR_WIDTH, base_y + CHAR_HEIGHT);
     }
 
-    /// Writes a single pixel to the framebuffer.
-    ///
-    /// # Parameters
-    /// - `x`: Pixel X coordinate (0 = left edge)
-    /// - `y`: Pixel Y coordinate (0 = top edge)
-    /// - `color`: 32-bit XRGB color value (0x00RRGGBB)
+    /// Returns the buffer drawing goes to and its stride in pixels.
     #[inline(always)]
-    fn put_pixel(&mut self, x: u64, y: u64, color: u32) {
-        if x >= self.width || y >= self.height {
-            return; // Bounds check — don't write outside the framebuffer
+    fn target(&self) -> (*mut u32, u64) {
+        if self.shadow.is_null() {
+            (self.buffer, self.pitch / 4)
+        } else {
+            (self.shadow, self.width)
         }
-        // Calculate the pixel offset.
-        // pitch is in BYTES, but our buffer pointer is *mut u32 (4 bytes per element).
-        // So we divide pitch by 4 to get the u32 stride per row.
-        let offset = y * (self.pitch / 4) + x;
-        // SAFETY: We've bounds-checked x and y above. The framebuffer memory
-        // was mapped by UEFI and is valid for the lifetime of the system.
-        unsafe {
-            self.buffer.add(offset as usize).write_volatile(color);
+    }
+
+    /// Fills pixel rows `[y0, y1)` with `color` and marks them dirty.
+    fn fill_rows(&mut self, y0: u64, y1: u64, color: u32) {
+        let (base, stride) = self.target();
+        for y in y0..y1 {
+            // SAFETY: y < height, and each row holds at least `width` pixels.
+            unsafe { fill32(base.add((y * stride) as usize), self.width as usize, color); }
         }
+        self.dirty.add(0, y0, self.width, y1);
     }
 
     /// Checks if the cursor has moved past the bottom of the screen.
@@ -287,32 +372,61 @@ impl Console {
 
     /// Scrolls the screen up by one character row (CHAR_HEIGHT pixels).
     ///
-    /// This copies each pixel row up by CHAR_HEIGHT pixels and clears
-    /// the bottom row. On 1366x768 with 32bpp, this copies about 4MB
-    /// of pixel data — takes ~0.3ms on N3710 DDR3L.
+    /// With the shadow attached this is a single memmove inside RAM; the
+    /// whole screen becomes dirty and reaches VRAM on the next `flush()`.
+    /// Without it (early boot) every row is moved inside VRAM, which reads
+    /// the framebuffer and is several times slower.
     fn scroll_up(&mut self) {
-        let row_stride = self.pitch / 4; // u32 elements per row
-
-        // Copy each pixel row up by CHAR_HEIGHT pixels.
-        for y in CHAR_HEIGHT..self.height {
-            let src_offset = y * row_stride;
-            let dst_offset = (y - CHAR_HEIGHT) * row_stride;
-            for x in 0..self.width {
-                // SAFETY: Bounds are within the framebuffer dimensions.
-                unsafe {
-                    let pixel = self.buffer.add((src_offset + x) as usize).read_volatile();
-                    self.buffer.add((dst_offset + x) as usize).write_volatile(pixel);
+        let keep = self.height - CHAR_HEIGHT;
+        let (base, stride) = self.target();
+        // SAFETY: source and destination rows lie inside the buffer.
+        unsafe {
+            if self.shadow.is_null() {
+                for y in 0..keep {
+                    core::ptr::copy_nonoverlapping(
+                        base.add(((y + CHAR_HEIGHT) * stride) as usize),
+                        base.add((y * stride) as usize),
+                        self.width as usize,
+                    );
                 }
+            } else {
+                // Rows are contiguous in the shadow: one overlapping move.
+                core::ptr::copy(
+                    base.add((CHAR_HEIGHT * stride) as usize),
+                    base,
+                    (keep * stride) as usize,
+                );
             }
         }
 
         // Clear the bottom row (fill with background color).
-        let clear_start_y = self.height - CHAR_HEIGHT;
-        for y in clear_start_y..self.height {
-            for x in 0..self.width {
-                self.put_pixel(x, y, BG_COLOR);
+        self.fill_rows(keep, self.height, self.bg);
+        self.dirty.add(0, 0, self.width, self.height);
+    }
+
+    /// Copies the dirty rectangle of the shadow to VRAM.
+    ///
+    /// One `rep movs` per pixel row into the write-combining mapping, then
+    /// SFENCE. No-op before `attach_shadow()` (drawing was direct).
+    pub fn flush(&mut self) {
+        if self.shadow.is_null() || self.dirty.is_empty() {
+            return;
+        }
+        let d = self.dirty;
+        let vram_stride = self.pitch / 4;
+        for y in d.y0..d.y1 {
+            // SAFETY: the dirty rect is clamped to width × height by construction.
+            unsafe {
+                core::ptr::copy_nonoverlapping(
+                    self.shadow.add((y * self.width + d.x0) as usize),
+                    self.buffer.add((y * vram_stride + d.x0) as usize),
+                    (d.x1 - d.x0) as usize,
+                );
             }
         }
+        // SAFETY: SFENCE only orders stores.
+        unsafe { core::arch::asm!("sfence", options(nostack, preserves_flags)); }
+        self.dirty = DirtyRect::EMPTY;
     }
 }
 
@@ -342,13 +456,97 @@ pub fn init(info: FramebufferInfo) {
 
 /// Writes to the framebuffer console if it has been initialized.
 ///
-/// This is called by the kprint!() macro to display output on screen.
+/// Boot code calls this to put text on screen (kprint!() is serial-only).
 /// If the console hasn't been initialized yet, this is a no-op.
+/// The whole message is rendered, then flushed to VRAM in one batch.
 pub fn write_fmt(args: core::fmt::Arguments) {
     use core::fmt::Write;
     let mut console = CONSOLE.lock();
     if let Some(ref mut con) = *console {
         let _ = con.write_fmt(args);
+        con.flush();
+    }
+}
+
+/// Writes a whole string under one lock acquisition and one VRAM flush.
+pub fn write_str(s: &str) {
+    let mut console = CONSOLE.lock();
+    if let Some(ref mut con) = *console {
+        con.write_string(s);
+        con.flush();
+    }
+}
+
+/// True once `init()` has set up a framebuffer console.
+pub fn is_available() -> bool {
+    CONSOLE.lock().is_some()
+}
+
+/// Gives the console its RAM shadow buffer (contiguous PMM frames, used
+/// through the HHDM). Call once after `pmm::init()`.
+///
+/// The current screen is read back from VRAM once so nothing is lost.
+/// If the PMM can't supply the frames the console keeps drawing directly.
+pub fn attach_shadow() {
+    let (pixels, ok) = {
+        let mut console = CONSOLE.lock();
+        let Some(con) = console.as_mut() else { return };
+        let pixels = con.width * con.height;
+        let pages = (pixels * 4).div_ceil(PAGE_SIZE) as usize;
+        match pmm::alloc_contiguous(pages) {
+            Some(phys) => {
+                let shadow = phys.to_virt().as_mut_ptr::<u32>();
+                let stride = con.pitch / 4;
+                for y in 0..con.height {
+                    // SAFETY: both rows are `width` pixels inside their buffers.
+                    unsafe {
+                        core::ptr::copy_nonoverlapping(
+                            con.buffer.add((y * stride) as usize),
+                            shadow.add((y * con.width) as usize),
+                            con.width as usize,
+                        );
+                    }
+                }
+                con.shadow = shadow;
+                (pixels, true)
+            }
+            None => (pixels, false),
+        }
+    };
+    if ok {
+        kprintln!("[fb] Shadow buffer: {} KiB in RAM, dirty-rect flush to VRAM",
+            pixels * 4 / 1024);
+    } else {
+        kprintln!("[fb] WARNING: no contiguous frames for shadow buffer — drawing direct");
+    }
+}
+
+/// Physical range of the framebuffer, page-rounded, for the write-combining
+/// mapping in `pml4::build()`. `None` without a framebuffer console.
+pub fn vram_window() -> Option<(u64, u64)> {
+    let console = CONSOLE.lock();
+    let con = console.as_ref()?;
+    let phys = con.buffer as u64 - address::hhdm_offset();
+    let start = phys & !(PAGE_SIZE - 1);
+    let end = (phys + con.pitch * con.height + PAGE_SIZE - 1) & !(PAGE_SIZE - 1);
+    Some((start, end - start))
+}
+
+/// Fills `count` pixels at `dst` with `value` (`rep stosd`).
+///
+/// # Safety
+/// `dst..dst+count` must be writable.
+#[inline(always)]
+unsafe fn fill32(dst: *mut u32, count: usize, value: u32) {
+    // SAFETY: caller guarantees the range; DF is clear per the SysV ABI.
+    unsafe {
+        core::arch::asm!(
+            "rep stosd",
+            inout("rdi") dst => _,
+            inout("rcx") count => _,
+            in("eax") value,
+            options(nostack, preserves_flags)
+        );
     }
 }
 
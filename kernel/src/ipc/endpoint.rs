@@ -18,11 +18,35 @@
 //   4. If we used raw pointers in the Endpoint queues, the Box would be
 //      dropped by the scheduler while the thread is asleep → use-after-free.
 //   5. Therefore: Endpoint holds Box<Thread> for sleeping threads.
+//      The queues are ThreadQueues — linked through the TCB's own
+//      QueueLink — so blocking never allocates under the Endpoint lock.
 //
 //   Ownership flow:
 //     RunQueue ─pop→ schedule() ─into_raw→ CpuLocal.current_thread
 //     IPC::send/recv ─from_raw→ Box<Thread> ─push→ Endpoint queue
-//     Partner wakes → Endpoint ─pop→ Box<Thread> ─push→ RunQueue
+//     Partner wakes → Endpoint ─pop→ Box<Thread> ─wake_sync→ RunQueue
+//
+//   `scheduler::wake_sync` sends the woken partner back to the core it last
+//   ran on, or pulls it onto the waker's core when the two keep waking
+//   each other (see WAKEUPS in scheduler.rs).
+//
+// SCHEDULING-CONTEXT DONATION:
+//   Every rendezvous calls `scheduler::donate(sender, receiver)`: a request
+//   lends the sender's priority and quantum to the receiver (if higher
+//   than its own), the receiver's reply to that sender hands it back, and
+//   so does its next `recv` (one-way sends). Priority inheritance follows
+//   the call chain with no extra syscall. When the thread that keeps
+//   running changes context, `scheduler::current_context_changed` makes
+//   its core's priority and quantum match.
+//
+//   LIMITATION: donation happens at the rendezvous, not before it. A
+//   client whose send takes the slowpath (the server is busy, not yet
+//   back in recv) lends nothing while it waits: the server finishes its
+//   current work at whatever context it has, and a medium-priority thread
+//   can still delay it — and so the client — until it reaches recv. An
+//   Endpoint has no notion of "its server" to boost early (any thread
+//   holding the capability may recv), and blocked senders are served
+//   FIFO, not by priority.
 //
 // SMP SPINLOCK DEADLOCK PREVENTION:
 //
@@ -46,14 +70,20 @@
 extern crate alloc;
 
 use alloc::boxed::Box;
-use alloc::collections::VecDeque;
 
 use crate::ipc::message::IpcMessage;
 use crate::kprintln;
 use crate::sched::percpu::CpuLocal;
+use crate::sched::queue::ThreadQueue;
 use crate::sched::thread::{Thread, ThreadState};
 use crate::sync::spinlock::SpinLock;
 
+/// Per-operation IPC trace logging on serial.
+///
+/// Compiled out in bench builds: one trace line costs far more than the IPC
+/// itself at 115200 baud, and would swamp the `ipc_round_trip` numbers.
+const IPC_TRACE: bool = !cfg!(feature = "bench");
+
 // =============================================================================
 // Endpoint
 // =============================================================================
@@ -61,10 +91,10 @@ use crate::sync::spinlock::SpinLock;
 /// Internal state protected by the Endpoint's spinlock.
 struct EndpointInner {
     /// Threads blocked waiting to send (they have a message in ipc_buffer).
-    blocked_senders: VecDeque<Box<Thread>>,
+    blocked_senders: ThreadQueue,
 
     /// Threads blocked waiting to receive (they need a message).
-    blocked_receivers: VecDeque<Box<Thread>>,
+    blocked_receivers: ThreadQueue,
 }
 
 /// An IPC Endpoint — the rendezvous point for synchronous message passing.
@@ -97,8 +127,8 @@ impl Endpoint {
         Self {
             id,
             inner: SpinLock::new(EndpointInner {
-                blocked_senders: VecDeque::new(),
-                blocked_receivers: VecDeque::new(),
+                blocked_senders: ThreadQueue::new(),
+                blocked_receivers: ThreadQueue::new(),
             }),
         }
     }
@@ -118,12 +148,15 @@ impl Endpoint {
     /// If no receiver is waiting, this is the **slowpath**: the sender's
     /// message is stored in its ipc_buffer, the sender blocks (ownership
     /// transferred to the Endpoint), and schedule() is called to yield
-    /// the CPU.
+    /// the CPU. Its context is donated only once a receiver takes the
+    /// message (see LIMITATION above).
     ///
     /// # SMP Safety
     /// Interrupts are disabled before locking to prevent the lost-wakeup
     /// race. See module-level documentation for the full analysis.
     pub fn send(&self, msg: &IpcMessage) {
+        crate::sched::stats::on_ipc_send();
+
         // Step 1: Disable interrupts BEFORE locking.
         // This protects CPU-local state (RunQueue, current_thread) from
         // being corrupted by a timer ISR calling schedule() concurrently.
@@ -141,21 +174,27 @@ impl Endpoint {
             // This is safe because the receiver is asleep (blocked) and
             // we hold the Endpoint lock.
             receiver.ipc_buffer = *msg;
-            receiver.state = ThreadState::Ready;
+            let current = unsafe { &mut *CpuLocal::get().current_thread };
+            let before = current.sched.effective;
+            crate::sched::scheduler::donate(current, &mut receiver);
+            // A reply drops us back to our own context: republish it
+            // before the (possibly higher) caller is queued.
+            if current.sched.effective != before {
+                crate::sched::scheduler::current_context_changed();
+            }
 
             let receiver_id = receiver.id;
 
-            // Push the woken receiver to the current core's RunQueue.
-            // (Future optimization: send IPI to the receiver's home core)
-            let cpu_local = unsafe { CpuLocal::get_mut() };
-            let rq = unsafe { &mut *cpu_local.run_queue };
-            rq.push(receiver);
+            // Hand the woken receiver to the scheduler (cache-affine core).
+            crate::sched::scheduler::wake_sync(receiver);
 
             // Unlock endpoint
             drop(inner);
 
-            kprintln!("[ipc] EP{}: send fastpath — woke receiver thread {}",
-                self.id, receiver_id);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: send fastpath — woke receiver thread {}",
+                    self.id, receiver_id);
+            }
 
             // Re-enable interrupts and return (sender continues running)
             unsafe { core::arch::asm!("sti", options(nomem, nostack)); }
@@ -181,8 +220,10 @@ impl Endpoint {
             // Unlock endpoint (IF stays 0 because SpinLock saved IF=0)
             drop(inner);
 
-            kprintln!("[ipc] EP{}: send slowpath — thread {} blocking (no receiver)",
-                self.id, sender_id);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: send slowpath — thread {} blocking (no receiver)",
+                    self.id, sender_id);
+            }
 
             // Yield the CPU. schedule() sees BlockedSend state and will
             // NOT try to requeue this thread (ownership is in the Endpoint).
@@ -193,7 +234,9 @@ impl Endpoint {
             // Re-enable interrupts.
             unsafe { core::arch::asm!("sti", options(nomem, nostack)); }
 
-            kprintln!("[ipc] EP{}: sender thread {} resumed after block", self.id, sender_id);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: sender thread {} resumed after block", self.id, sender_id);
+            }
         }
     }
 
@@ -211,9 +254,17 @@ impl Endpoint {
     /// # Returns
     /// The received IPC message.
     pub fn recv(&self) -> IpcMessage {
+        crate::sched::stats::on_ipc_recv();
+
         // Step 1: Disable interrupts
         unsafe { core::arch::asm!("cli", options(nomem, nostack)); }
 
+        // Waiting for the next message ends the call we were serving
+        // (a one-way send gets no reply to end it).
+        let current = unsafe { &mut *CpuLocal::get().current_thread };
+        let before = current.sched.effective;
+        current.sched.on_recv();
+
         // Step 2: Lock the Endpoint
         let mut inner = self.inner.lock();
 
@@ -223,20 +274,25 @@ impl Endpoint {
             // Copy the sender's message directly.
             let msg = sender.ipc_buffer;
             sender.ipc_buffer = IpcMessage::EMPTY; // Clear sender's buffer
-            sender.state = ThreadState::Ready;
+            crate::sched::scheduler::donate(&mut sender, current);
+            // We keep running, now on the caller's context (or our own):
+            // republish priority and quantum before the sender is queued.
+            if current.sched.effective != before {
+                crate::sched::scheduler::current_context_changed();
+            }
 
             let sender_id = sender.id;
 
-            // Push the woken sender to the current core's RunQueue
-            let cpu_local = unsafe { CpuLocal::get_mut() };
-            let rq = unsafe { &mut *cpu_local.run_queue };
-            rq.push(sender);
+            // Hand the woken sender to the scheduler (cache-affine core)
+            crate::sched::scheduler::wake_sync(sender);
 
             // Unlock endpoint
             drop(inner);
 
-            kprintln!("[ipc] EP{}: recv fastpath — woke sender thread {}, label={}",
-                self.id, sender_id, msg.label);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: recv fastpath — woke sender thread {}, label={}",
+                    self.id, sender_id, msg.label);
+            }
 
             // Re-enable interrupts and return the message
             unsafe { core::arch::asm!("sti", options(nomem, nostack)); }
@@ -258,8 +314,10 @@ impl Endpoint {
             // Unlock endpoint
             drop(inner);
 
-            kprintln!("[ipc] EP{}: recv slowpath — thread {} blocking (no sender)",
-                self.id, receiver_id);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: recv slowpath — thread {} blocking (no sender)",
+                    self.id, receiver_id);
+            }
 
             // Yield the CPU
             unsafe { crate::sched::scheduler::schedule(); }
@@ -273,8 +331,10 @@ impl Endpoint {
             let cpu_local = unsafe { CpuLocal::get() };
             let msg = unsafe { (*cpu_local.current_thread).ipc_buffer };
 
-            kprintln!("[ipc] EP{}: receiver thread {} resumed, label={}",
-                self.id, receiver_id, msg.label);
+            if IPC_TRACE {
+                kprintln!("[ipc] EP{}: receiver thread {} resumed, label={}",
+                    self.id, receiver_id, msg.label);
+            }
 
             msg
         }
@@ -103,6 +103,24 @@ mod ipc;
 /// Contains: USTAR TAR parser, ELF64 executable loader.
 mod fs;
 
+/// Boot-phase TSC timeline.
+/// Contains: per-phase marks, AP online stamps, summary table + JSON line.
+mod boot_timing;
+
+/// Boot task graph: independent boot work run on the APs.
+/// Contains: task table, spawn/join, AP helper loop, seal.
+mod boot_tasks;
+
+/// In-kernel microbenchmarks (`make bench` only).
+/// Contains: TSC benchmarks for PMM, heap, VMM, CNode, context switch, IPC.
+#[cfg(feature = "bench")]
+mod bench;
+
+/// Sampling profiler (`make profile` only).
+/// Contains: LAPIC-timer sampling, per-CPU buffers, serial dump thread.
+#[cfg(feature = "profile")]
+mod profile;
+
 // =============================================================================
 // Imports
 // =============================================================================
@@ -114,6 +132,10 @@ use memory::address::PhysAddr;
 use memory::pmm;
 use memory::heap;
 
+/// Command channel of the Ring 3 serial driver (serial_drv's slot 1).
+/// Installed in init's CNode; init delegates it when it spawns the driver.
+static SERIAL_DRV_EP: ipc::endpoint::Endpoint = ipc::endpoint::Endpoint::new(2);
+
 // =============================================================================
 // Linker-provided symbols
 // =============================================================================
@@ -174,6 +196,9 @@ extern "C" fn kmain() -> ! {
     // we get a silent hang. Keep this phase as simple as possible.
     // =========================================================================
 
+    // Stamp kmain entry first — everything below is attributed to a phase.
+    boot_timing::start();
+
     // Initialize the serial UART (COM1) for debug output.
     // After this call, kprintln!() works over serial.
     // This touches only I/O ports — no memory allocation, no page tables.
@@ -189,6 +214,7 @@ extern "C" fn kmain() -> ! {
     kprintln!("  Capability-based microkernel for x86_64");
     kprintln!("==========================================================");
     kprintln!();
+    boot_timing::mark("serial");
 
     // =========================================================================
     // PHASE 2: "Can See" → Parse boot info, init framebuffer
@@ -325,6 +351,7 @@ extern "C" fn kmain() -> ! {
     } else {
         kprintln!("[boot] WARNING: No framebuffer available (serial only)");
     }
+    boot_timing::mark("bootinfo_fb");
 
     // =========================================================================
     // PHASE 3: "Can Remember" → Memory Management (Sprint 2)
@@ -353,6 +380,10 @@ extern "C" fn kmain() -> ! {
         mem_stats.free_frames as u64 * 4096 / 1024 / 1024,
     );
 
+    // The console can have its RAM shadow now (contiguous PMM frames).
+    drivers::framebuffer::attach_shadow();
+    boot_timing::mark("pmm");
+
     // --- Kernel Heap ---
     // Allocate contiguous physical pages from the PMM and set up the
     // linked-list heap allocator. After this call, alloc::Vec and friends work.
@@ -378,6 +409,7 @@ extern "C" fn kmain() -> ! {
         heap::allocated_bytes(),
         heap::total_bytes() / 1024,
     );
+    boot_timing::mark("heap");
 
     // --- VMM (infrastructure only) ---
     // The page table types and manipulation functions (map_page, unmap_page,
@@ -414,6 +446,7 @@ extern "C" fn kmain() -> ! {
     // Note: interrupts are still disabled (IF=0). The IDT is loaded but
     // no interrupts will fire until we STI.
     arch::idt::init();
+    boot_timing::mark("gdt_idt");
 
     // --- 4c. Map ACPI regions into HHDM ---
     // Limine base revision 3 only maps Usable/Bootloader/Kernel regions in
@@ -489,6 +522,12 @@ extern "C" fn kmain() -> ! {
         let info = arch::acpi::parse_madt(rsdp);
         kprintln!("[acpi] Summary: LAPIC @ {:#010X}, {} CPUs, {} I/O APICs, {} overrides",
             info.lapic_addr, info.cpu_count, info.ioapic_count, info.override_count);
+
+        // MCFG → PCIe ECAM window (mapped by the pristine PML4 in 4g).
+        match arch::acpi::parse_mcfg(rsdp) {
+            Some(mcfg) => arch::pci::init_ecam(&mcfg),
+            None => kprintln!("[acpi] No MCFG — PCI config space via port I/O"),
+        }
         Some(info)
     } else {
         kprintln!("[acpi] WARNING: No RSDP found — cannot configure APIC");
@@ -536,6 +575,8 @@ extern "C" fn kmain() -> ! {
         }
     }
 
+    boot_timing::mark("acpi_madt_mmio");
+
     // --- 4f. Disable legacy 8259 PIC ---
     // Must happen before enabling I/O APIC to prevent spurious legacy IRQs.
     arch::ioapic::disable_pic();
@@ -548,6 +589,7 @@ extern "C" fn kmain() -> ! {
     } else {
         kprintln!("[lapic] SKIPPED — no MADT available");
     }
+    boot_timing::mark("pic_lapic_calib");
 
     // --- 4f. I/O APIC ---
     // Initialize each I/O APIC from the MADT and route interrupts.
@@ -575,12 +617,16 @@ extern "C" fn kmain() -> ! {
         };
         arch::ioapic::enable_irq(com1_gsi, 36, 0);
     }
+    boot_timing::mark("ioapic");
 
     // --- 4g. Pristine PML4 + CR3 swap ---
     // Build clean page tables replacing Limine's contaminated ones.
-    // Maps HHDM (2M huge), kernel W^X (4K), MMIO (uncacheable).
+    // Maps HHDM (2M huge), kernel W^X (4K), MMIO (uncacheable),
+    // framebuffer (write-combining — needs our PAT layout first).
+    arch::cpu::init_pat();
     let pristine_pml4 = memory::pml4::build();
     unsafe { memory::pml4::activate(pristine_pml4); }
+    boot_timing::mark("pml4");
 
     // --- 4h. Enable interrupts ---
     // Everything is set up. STI allows the CPU to begin processing
@@ -588,6 +634,14 @@ extern "C" fn kmain() -> ! {
     unsafe { core::arch::asm!("sti"); }
     kprintln!("[init] Interrupts ENABLED");
 
+    // --- 4i. Interrupt-driven serial TX ---
+    // IRQ 4 is routed (4f), so kprintln!() can stop polling the UART and
+    // just fill the TX ring; the THRE interrupt drains it.
+    if madt_info.is_some() {
+        arch::serial::enable_tx_irq();
+        kprintln!("[serial] TX now interrupt-driven (8 KiB ring, 16-byte FIFO bursts)");
+    }
+
     // =========================================================================
     // PHASE 5: Scheduler + Threads (Sprint 4)
     // =========================================================================
@@ -605,6 +659,10 @@ extern "C" fn kmain() -> ! {
         let _ = alloc::boxed::Box::into_raw(bsp_local);
     }
 
+    #[cfg(feature = "profile")]
+    profile::init_cpu(0);
+    boot_timing::mark("percpu");
+
     // =========================================================================
     // PHASE 6: SYSCALL MSR Initialization (Sprint 6 → Sprint 7)
     // =========================================================================
@@ -614,12 +672,47 @@ extern "C" fn kmain() -> ! {
     // --- 6a. SYSCALL MSR initialization ---
     arch::syscall::init();
 
+    // --- 6b. Performance monitoring (CPUID 0x0A probe) ---
+    arch::pmu::init();
+    boot_timing::mark("syscall_pmu");
+
     // =========================================================================
-    // PHASE 6.5: PCI Device Discovery (Sprint 11)
+    // PHASE 6.5: Microbenchmarks (bench builds only)
+    // =========================================================================
+    // Runs before any thread exists and before the APs are released, so the
+    // measurements see an idle machine.
+    #[cfg(feature = "bench")]
+    {
+        bench::run_all();
+        boot_timing::mark("bench");
+    }
+
+    // =========================================================================
+    // PHASE 6.9: Parallel boot — release APs, start the boot task graph
+    // =========================================================================
+    //
+    // Everything the APs need (pristine PML4, IDT, calibrated LAPIC, SYSCALL
+    // and PMU state) exists now, so wake them here instead of after Init is
+    // loaded. They pick up independent boot tasks while the BSP continues
+    // with Phase 7; the BSP joins each task right before its result is
+    // needed (see boot_tasks.rs).
     // =========================================================================
     kprintln!();
-    kprintln!("[init] Phase 6.5: PCI Device Discovery");
-    arch::x86_64::pci::enumerate_buses();
+    kprintln!("[init] Phase 6.9: Releasing APs + boot task graph");
+    let ap_count = arch::smp::init();
+
+    // --- 6.9a. PCI device discovery (Sprint 11) — joined before 7i ---
+    let pci_task = boot_tasks::spawn("pci", || arch::x86_64::pci::enumerate_buses());
+
+    // --- 6.9b. Pre-zeroed frame pool for Init's page tables / stack ---
+    // Only worth it when another core does the zeroing.
+    if ap_count > 0 {
+        let _ = boot_tasks::spawn("zero_pool", || {
+            let n = pmm::prefill_zero_pool(512);
+            kprintln!("[pmm] Zero pool prefilled: {} frames", n);
+        });
+    }
+    boot_timing::mark("smp_release");
 
     // =========================================================================
     // PHASE 7: Init Process — The God Process (Sprint 9 Phase 3)
@@ -664,10 +757,9 @@ extern "C" fn kmain() -> ! {
         (data, phys_base, size)
     };
 
-    // --- 7b. List initrd contents ---
-    kprintln!("[initrd] Archive contents:");
-    fs::tar::for_each_file(initrd, |name, size| {
-        kprintln!("[initrd]   {} ({} bytes)", name, size);
+    // --- 7b. Index + stage the initrd (boot task, joined in 7h) ---
+    let initrd_task = boot_tasks::spawn("initrd_stage", move || {
+        stage_initrd(initrd, initrd_phys_base, initrd_size)
     });
 
     // --- 7c. Locate init ELF in the initrd ---
@@ -738,81 +830,63 @@ extern "C" fn kmain() -> ! {
 
     // --- 7h. Map initrd TarFS pages into Init's PML4 at 0x1000_0000 ---
     //
-    // Init needs to read the TarFS from Ring 3. We map the physical pages
-    // that Limine loaded the initrd.tar into at a fixed virtual address
-    // in Init's address space. Read-only + USER, no allocation needed.
+    // Init needs to read the TarFS from Ring 3. The `initrd_stage` task
+    // already copied the archive into fresh PMM frames; map them read-only
+    // + USER at a fixed virtual address in Init's address space.
     {
         use memory::vmm::{self, PageTableFlags};
 
+        let staged = initrd_task.join();
         let initrd_map_base = 0x1000_0000u64;
         let page_size = memory::address::PAGE_SIZE;
-        let page_count = (initrd_size as u64 + page_size - 1) / page_size;
-        let mut mapped = 0u64;
-
-        // IMPORTANT: We allocate fresh PMM frames and COPY the initrd data
-        // instead of mapping bootloader-owned physical pages directly.
-        // Direct mapping of non-PMM pages causes `destroy_user_address_space`
-        // to call `pmm::free_frame()` on pages that were never allocated from
-        // PMM, corrupting the bitmap and causing double-free panics.
-        let hhdm = memory::address::hhdm_offset();
-        for i in 0..page_count {
-            let src_phys = initrd_phys_base + i * page_size;
-            let frame = memory::pmm::alloc_frame_zeroed()
-                .expect("[init] FATAL: cannot allocate frame for initrd copy");
-            let virt = memory::address::VirtAddr::new(initrd_map_base + i * page_size);
-
-            // Copy initrd page data from bootloader memory into the fresh PMM frame
-            unsafe {
-                let src = (hhdm + src_phys) as *const u8;
-                let dst = frame.to_virt().as_mut_ptr::<u8>();
-                let copy_len = if (i + 1) * page_size <= initrd_size as u64 {
-                    page_size as usize
-                } else {
-                    (initrd_size as u64 - i * page_size) as usize
-                };
-                core::ptr::copy_nonoverlapping(src, dst, copy_len);
-            }
 
+        for (i, &frame) in staged.iter().enumerate() {
+            let virt = memory::address::VirtAddr::new(initrd_map_base + i as u64 * page_size);
             unsafe {
                 vmm::map_page(init_pml4, virt, frame,
                     PageTableFlags::PRESENT | PageTableFlags::USER | PageTableFlags::NO_EXECUTE,
                 ).expect("[init] FATAL: cannot map initrd page into Init PML4");
             }
-            mapped += 1;
         }
 
-        kprintln!("[init] Initrd copied+mapped into Init PML4: {:#010X} — {:#010X} ({} pages, read-only)",
+        kprintln!("[init] Initrd mapped into Init PML4: {:#010X} — {:#010X} ({} pages, read-only)",
             initrd_map_base,
-            initrd_map_base + page_count * page_size,
-            mapped);
+            initrd_map_base + staged.len() as u64 * page_size,
+            staged.len());
     }
+    boot_timing::mark("init_load");
+
+    // --- 7i0. PCI results are needed for the Virtio IoPort capability ---
+    pci_task.join();
+    boot_timing::mark("pci_wait");
 
     // --- 7i. Install capabilities into Init's CNode ---
     unsafe {
         use cap::cnode::{CapObject, CapRights, Capability};
         let init_pid = (*init_proc).pid;
+        let mut cnode = (*init_proc).cnode.lock();
 
         // Slot 1: PmmAllocator — mint physical frames
-        (*init_proc).cnode.insert_at(1, Capability::new(
+        cnode.insert_at(1, Capability::new(
             CapObject::PmmAllocator,
             CapRights::ALL,
         )).expect("[init] FATAL: cannot install PmmAllocator capability");
 
         // Slot 2: IoPort capability for COM1 (0x3F8-0x3FF, 8 ports)
-        (*init_proc).cnode.insert_at(2, Capability::new(
+        cnode.insert_at(2, Capability::new(
             CapObject::IoPort { base: 0x3F8, size: 8 },
             CapRights::ALL,
         )).expect("[init] FATAL: cannot install IoPort capability");
 
         // Slot 3: Process capability (self) — for SYS_MAP_MEMORY on own space
-        (*init_proc).cnode.insert_at(3, Capability::new(
+        cnode.insert_at(3, Capability::new(
             CapObject::Process { pid: init_pid },
             CapRights::ALL,
         )).expect("[init] FATAL: cannot install Process(self) capability");
 
         // Slot 4: IoPort capability for Virtio-Block (dynamically discovered)
         if let Some((vio_base, vio_size)) = arch::pci::get_virtio_blk_io_base() {
-            (*init_proc).cnode.insert_at(4, Capability::new(
+            cnode.insert_at(4, Capability::new(
                 CapObject::IoPort { base: vio_base, size: vio_size },
                 CapRights::ALL,
             )).expect("[init] FATAL: cannot install Virtio IoPort capability");
@@ -821,6 +895,31 @@ extern "C" fn kmain() -> ! {
         } else {
             kprintln!("[init]   Slot 4: (empty) — no Virtio-Blk device found");
         }
+
+        // Slot 5: Pmu — program/read hardware performance counters
+        cnode.insert_at(5, Capability::new(
+            CapObject::Pmu,
+            CapRights::ALL,
+        )).expect("[init] FATAL: cannot install Pmu capability");
+
+        // Slot 6: Scheduler — per-thread CPU accounting snapshots
+        cnode.insert_at(6, Capability::new(
+            CapObject::Scheduler,
+            CapRights::ALL,
+        )).expect("[init] FATAL: cannot install Scheduler capability");
+
+        // Slot 7: Endpoint — serial_drv's command channel (init delegates it)
+        arch::syscall::register_endpoint(&SERIAL_DRV_EP);
+        cnode.insert_at(7, Capability::new(
+            CapObject::Endpoint { id: SERIAL_DRV_EP.id() },
+            CapRights::ALL,
+        )).expect("[init] FATAL: cannot install serial Endpoint capability");
+
+        // Slot 8: Interrupt — COM1's IRQ 4, for serial_drv's RX thread
+        cnode.insert_at(8, Capability::new(
+            CapObject::Interrupt { irq: 4 },
+            CapRights::ALL,
+        )).expect("[init] FATAL: cannot install COM1 Interrupt capability");
     }
 
     kprintln!("[init] Init CNode (PID={}):",
@@ -833,6 +932,11 @@ extern "C" fn kmain() -> ! {
         let (vb, vs) = arch::pci::get_virtio_blk_io_base().unwrap();
         kprintln!("[init]   Slot 4: IoPort(0x{:04X}, {}) [ALL] (Virtio-Blk)", vb, vs);
     }
+    kprintln!("[init]   Slot 5: Pmu [ALL]{}",
+        if arch::pmu::available() { "" } else { " (no PMU — syscalls return unsupported)" });
+    kprintln!("[init]   Slot 6: Scheduler [ALL]");
+    kprintln!("[init]   Slot 7: Endpoint(id={}) [ALL] (serial_drv commands)", SERIAL_DRV_EP.id());
+    kprintln!("[init]   Slot 8: Interrupt(irq=4) [ALL] (COM1)");
 
     // --- 7j. Spawn Init thread owned by its Process ---
     {
@@ -841,6 +945,7 @@ extern "C" fn kmain() -> ! {
         );
         sched::scheduler::spawn_thread(init_thread);
     }
+    boot_timing::mark("init_caps_spawn");
 
     // --- 7k. Create kernel pseudo-process (PID 0) ---
     let kernel_proc = {
@@ -857,9 +962,15 @@ extern "C" fn kmain() -> ! {
 
     // --- 7l. Initialize scheduler (BSP thread belongs to kernel process) ---
     sched::scheduler::init(kernel_proc);
+    boot_timing::mark("sched_init");
+
+    // --- 7m. Finish the boot task graph, confirm the APs arrived ---
+    arch::smp::wait_online();
+    boot_tasks::seal();
+    boot_timing::mark("smp_seal");
 
-    // --- 7m. Start Application Processors ---
-    arch::smp::init();
+    // --- 7n. Boot timing summary ---
+    boot_timing::report();
 
     // =========================================================================
     // BSP IDLE LOOP
@@ -868,7 +979,7 @@ extern "C" fn kmain() -> ! {
     kprintln!("==========================================================");
     kprintln!("  Sprint 9 Phase 3 — The God Process (Init) LIVE!");
     kprintln!("  Init (PID 1) runs in isolated Process with own PML4");
-    kprintln!("  Capabilities: PmmAllocator + IoPort + Process(self)");
+    kprintln!("  Capabilities: PmmAllocator + IoPort + Process(self) + Pmu + Scheduler");
     kprintln!("  Initrd TarFS mapped at 0x1000_0000 for Ring 3 parsing");
     kprintln!("  BSP entering idle loop.");
     kprintln!("==========================================================");
@@ -889,3 +1000,46 @@ extern "C" fn kmain() -> ! {
 // have been removed. Init will eventually spawn the serial driver itself via
 // SYS_SPAWN_PROCESS + SYS_DELEGATE + SYS_SPAWN_THREAD.
 // =============================================================================
+
+// =============================================================================
+// Boot tasks
+// =============================================================================
+
+/// `initrd_stage` boot task: lists the archive and copies it into fresh
+/// PMM frames, one per page, ready to be mapped into Init (7h).
+///
+/// IMPORTANT: We allocate fresh PMM frames and COPY the initrd data
+/// instead of mapping bootloader-owned physical pages directly.
+/// Direct mapping of non-PMM pages causes `destroy_user_address_space`
+/// to call `pmm::free_frame()` on pages that were never allocated from
+/// PMM, corrupting the bitmap and causing double-free panics.
+fn stage_initrd(initrd: &[u8], phys_base: u64, size: usize) -> alloc::vec::Vec<PhysAddr> {
+    kprintln!("[initrd] Archive contents:");
+    fs::tar::for_each_file(initrd, |name, size| {
+        kprintln!("[initrd]   {} ({} bytes)", name, size);
+    });
+
+    let page_size = memory::address::PAGE_SIZE;
+    let page_count = (size as u64 + page_size - 1) / page_size;
+    let hhdm = address::hhdm_offset();
+    let mut frames = alloc::vec::Vec::with_capacity(page_count as usize);
+
+    for i in 0..page_count {
+        let frame = pmm::alloc_frame()
+            .expect("[init] FATAL: cannot allocate frame for initrd copy");
+
+        // Copy one page; the tail of the last page is zeroed so Init never
+        // sees stale frame contents past the end of the archive.
+        let copy_len = (size as u64 - i * page_size).min(page_size) as usize;
+        unsafe {
+            let src = (hhdm + phys_base + i * page_size) as *const u8;
+            let dst = frame.to_virt().as_mut_ptr::<u8>();
+            core::ptr::copy_nonoverlapping(src, dst, copy_len);
+            core::ptr::write_bytes(dst.add(copy_len), 0, page_size as usize - copy_len);
+        }
+        frames.push(frame);
+    }
+
+    kprintln!("[initrd] Staged {} pages ({} bytes) into PMM frames", page_count, size);
+    frames
+}
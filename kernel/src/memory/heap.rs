@@ -41,6 +41,9 @@
 //   The allocator is wrapped in a SpinLock. `GlobalAlloc::alloc/dealloc`
 //   acquire the lock before accessing the free list.
 //
+// The free-list itself is `kcore::heap::FreeListHeap` (host-buildable);
+// this module supplies the backing pages, the lock and `#[global_allocator]`.
+//
 // WHY NOT A SLAB/BUDDY ALLOCATOR?
 //   Simplicity. A linked-list allocator is easy to audit and debug.
 //   For a microkernel where most work happens in userspace, the kernel
@@ -50,7 +53,8 @@
 // =============================================================================
 
 use core::alloc::{GlobalAlloc, Layout};
-use core::ptr;
+
+use kcore::heap::FreeListHeap;
 
 use crate::kprintln;
 use crate::memory::address::PAGE_SIZE;
@@ -65,252 +69,16 @@ use crate::sync::spinlock::SpinLock;
 /// 64 pages × 4 KiB = 256 KiB.
 const INITIAL_HEAP_PAGES: usize = 64;
 
-/// Minimum block size: must be at least `size_of::<FreeBlock>()` so that
-/// every free region can hold the linked-list node header.
-const MIN_BLOCK_SIZE: usize = core::mem::size_of::<FreeBlock>();
-
-// =============================================================================
-// Free block node
-// =============================================================================
-
-/// Header stored at the beginning of each free block in the heap.
-///
-/// When a region is freed, we write this header at its start address.
-/// The region must be at least `size_of::<FreeBlock>()` bytes (16 bytes
-/// on 64-bit) to hold this header.
-///
-/// # Memory layout
-/// ```text
-/// ┌──────────────────┐
-/// │ size: usize (8B) │ ← total size of this free block INCLUDING header
-/// │ next: *mut (8B)  │ ← pointer to next free block (or null)
-/// ├──────────────────┤
-/// │ ... free space ..│ ← remaining bytes available for allocation
-/// └──────────────────┘
-/// ```
-#[repr(C)]
-struct FreeBlock {
-    /// Total size of this free block in bytes (including the header).
-    size: usize,
-    /// Pointer to the next free block, or null if this is the last one.
-    next: *mut FreeBlock,
-}
-
-// =============================================================================
-// Heap internals
-// =============================================================================
-
-/// The internal heap state: a sorted linked list of free blocks.
-struct Heap {
-    /// Head of the free list (sorted by address, lowest first).
-    free_list: *mut FreeBlock,
-
-    /// Start of the heap region (for bounds checking in debug mode).
-    heap_start: usize,
-
-    /// End of the heap region (exclusive).
-    heap_end: usize,
-
-    /// Total bytes currently allocated (for statistics).
-    allocated_bytes: usize,
-
-    /// Total heap size in bytes.
-    total_bytes: usize,
-}
-
-// SAFETY: The heap pointers are only accessed while holding the SpinLock.
-unsafe impl Send for Heap {}
-
-impl Heap {
-    /// Creates an uninitialized heap. Must call `init()` before use.
-    const fn new() -> Self {
-        Self {
-            free_list: ptr::null_mut(),
-            heap_start: 0,
-            heap_end: 0,
-            allocated_bytes: 0,
-            total_bytes: 0,
-        }
-    }
-
-    /// Initializes the heap with the given memory region.
-    ///
-    /// Creates a single free block spanning the entire region.
-    ///
-    /// # Parameters
-    /// - `start`: Virtual address of the heap region (must be aligned to at
-    ///   least `align_of::<FreeBlock>()`).
-    /// - `size`: Size of the heap region in bytes.
-    fn init(&mut self, start: usize, size: usize) {
-        assert!(size >= MIN_BLOCK_SIZE, "Heap region too small");
-        assert!(
-            start % core::mem::align_of::<FreeBlock>() == 0,
-            "Heap start must be aligned to FreeBlock alignment"
-        );
-
-        self.heap_start = start;
-        self.heap_end = start + size;
-        self.total_bytes = size;
-        self.allocated_bytes = 0;
-
-        // Create a single free block spanning the entire heap.
-        let block = start as *mut FreeBlock;
-        unsafe {
-            (*block).size = size;
-            (*block).next = ptr::null_mut();
-        }
-        self.free_list = block;
-    }
-
-    /// Allocates memory with the given layout.
-    ///
-    /// Uses first-fit: walks the free list and picks the first block that
-    /// can satisfy the request (including alignment).
-    ///
-    /// # Returns
-    /// A pointer to the allocated memory, or null if out of memory.
-    fn alloc(&mut self, layout: Layout) -> *mut u8 {
-        let size = layout.size().max(MIN_BLOCK_SIZE);
-        let align = layout.align().max(core::mem::align_of::<FreeBlock>());
-
-        let mut prev: *mut FreeBlock = ptr::null_mut();
-        let mut current = self.free_list;
-
-        while !current.is_null() {
-            let block_start = current as usize;
-            let block_size = unsafe { (*current).size };
-            let block_end = block_start + block_size;
-
-            // Calculate the aligned start address within this block.
-            let alloc_start = align_up(block_start, align);
-            let alloc_end = alloc_start + size;
-
-            if alloc_end <= block_end {
-                // This block can satisfy the request.
-
-                // Unlink this block from the free list.
-                let next = unsafe { (*current).next };
-                if prev.is_null() {
-                    self.free_list = next;
-                } else {
-                    unsafe {
-                        (*prev).next = next;
-                    }
-                }
-
-                // Front gap: space between block_start and alloc_start.
-                // If big enough, return it to the free list.
-                let front_gap = alloc_start - block_start;
-                if front_gap >= MIN_BLOCK_SIZE {
-                    self.insert_free_block(block_start, front_gap);
-                }
-
-                // Back gap: space between alloc_end and block_end.
-                // If big enough, return it to the free list.
-                let back_gap = block_end - alloc_end;
-                if back_gap >= MIN_BLOCK_SIZE {
-                    self.insert_free_block(alloc_end, back_gap);
-                }
-
-                self.allocated_bytes += size;
-                return alloc_start as *mut u8;
-            }
-
-            prev = current;
-            current = unsafe { (*current).next };
-        }
-
-        // No suitable block found.
-        ptr::null_mut()
-    }
-
-    /// Frees previously allocated memory.
-    ///
-    /// Inserts the freed region back into the free list (sorted by address)
-    /// and coalesces with adjacent free blocks to reduce fragmentation.
-    fn dealloc(&mut self, ptr: *mut u8, layout: Layout) {
-        let addr = ptr as usize;
-        let size = layout.size().max(MIN_BLOCK_SIZE);
-
-        debug_assert!(
-            addr >= self.heap_start && addr + size <= self.heap_end,
-            "Heap: dealloc address outside heap bounds"
-        );
-
-        self.allocated_bytes -= size;
-        self.insert_free_block(addr, size);
-    }
-
-    /// Inserts a free region into the free list, maintaining address order,
-    /// and coalesces with adjacent blocks.
-    fn insert_free_block(&mut self, addr: usize, size: usize) {
-        debug_assert!(size >= MIN_BLOCK_SIZE);
-
-        let new_block = addr as *mut FreeBlock;
-
-        // Find the correct insertion point: walk the list until we find
-        // a block with a higher address (or reach the end).
-        let mut prev: *mut FreeBlock = ptr::null_mut();
-        let mut current = self.free_list;
-
-        while !current.is_null() && (current as usize) < addr {
-            prev = current;
-            current = unsafe { (*current).next };
-        }
-
-        // Initialize the new block.
-        unsafe {
-            (*new_block).size = size;
-            (*new_block).next = current;
-        }
-
-        // Link from predecessor (or update head).
-        if prev.is_null() {
-            self.free_list = new_block;
-        } else {
-            unsafe {
-                (*prev).next = new_block;
-            }
-        }
-
-        // --- Coalesce with successor ---
-        // If the new block ends exactly where the next block starts,
-        // merge them into one larger block.
-        if !current.is_null() {
-            let new_end = addr + unsafe { (*new_block).size };
-            if new_end == current as usize {
-                unsafe {
-                    (*new_block).size += (*current).size;
-                    (*new_block).next = (*current).next;
-                }
-            }
-        }
-
-        // --- Coalesce with predecessor ---
-        // If the predecessor block ends exactly where the new block starts,
-        // merge them.
-        if !prev.is_null() {
-            let prev_end = prev as usize + unsafe { (*prev).size };
-            if prev_end == addr {
-                unsafe {
-                    (*prev).size += (*new_block).size;
-                    (*prev).next = (*new_block).next;
-                }
-            }
-        }
-    }
-}
-
 // =============================================================================
 // Global allocator
 // =============================================================================
 
 /// The kernel's global heap allocator.
 ///
-/// Wraps the `Heap` in a `SpinLock` to satisfy `GlobalAlloc`'s `Sync`
+/// Wraps the `FreeListHeap` in a `SpinLock` to satisfy `GlobalAlloc`'s `Sync`
 /// requirement. All allocation/deallocation calls acquire the lock.
 pub struct KernelAllocator {
-    inner: SpinLock<Heap>,
+    inner: SpinLock<FreeListHeap>,
 }
 
 impl KernelAllocator {
@@ -319,12 +87,12 @@ impl KernelAllocator {
     /// Must call `init()` before any allocations occur.
     const fn new() -> Self {
         Self {
-            inner: SpinLock::new(Heap::new()),
+            inner: SpinLock::new(FreeListHeap::new()),
         }
     }
 }
 
-/// SAFETY: The SpinLock ensures exclusive access to the Heap internals.
+/// SAFETY: The SpinLock ensures exclusive access to the FreeListHeap internals.
 /// `GlobalAlloc` requires `Sync`, which we provide through the lock.
 unsafe impl GlobalAlloc for KernelAllocator {
     unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
@@ -332,7 +100,7 @@ unsafe impl GlobalAlloc for KernelAllocator {
     }
 
     unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
-        self.inner.lock().dealloc(ptr, layout)
+        unsafe { self.inner.lock().dealloc(ptr, layout) }
     }
 }
 
@@ -378,31 +146,21 @@ pub fn init() {
     );
 
     // Initialize the linked-list allocator over this region.
-    ALLOCATOR.inner.lock().init(heap_virt, heap_size);
+    // SAFETY: the region is freshly allocated, HHDM-mapped, and owned by
+    // the heap from now on.
+    unsafe { ALLOCATOR.inner.lock().init(heap_virt, heap_size); }
 
     kprintln!("[heap] Kernel heap initialized ({} KiB)", heap_size / 1024);
 }
 
 /// Returns the number of bytes currently allocated from the kernel heap.
 pub fn allocated_bytes() -> usize {
-    ALLOCATOR.inner.lock().allocated_bytes
+    ALLOCATOR.inner.lock().allocated_bytes()
 }
 
 /// Returns the total size of the kernel heap in bytes.
 pub fn total_bytes() -> usize {
-    ALLOCATOR.inner.lock().total_bytes
-}
-
-// =============================================================================
-// Alignment helper
-// =============================================================================
-
-/// Aligns `value` up to the nearest multiple of `align`.
-///
-/// `align` must be a power of two.
-#[inline]
-const fn align_up(value: usize, align: usize) -> usize {
-    (value + align - 1) & !(align - 1)
+    ALLOCATOR.inner.lock().total_bytes()
 }
 
 // =============================================================================
@@ -8,6 +8,8 @@
 //   1. HHDM: all physical RAM at HHDM_OFFSET + phys (2M huge pages)
 //   2. Kernel ELF sections with strict W^X permissions (4K pages)
 //   3. MMIO: LAPIC/IOAPIC with uncacheable flags (4K pages)
+//      + the PCIe ECAM window from the MCFG (mapped before the HHDM)
+//      + the framebuffer, write-combining via PAT (mapped before the HHDM)
 //
 // After activation via CR3 swap, the kernel runs on clean page tables
 // with no identity mappings, no bootloader ghosts, no UEFI residue.
@@ -67,6 +69,67 @@ pub fn build() -> PhysAddr {
         | PageTableFlags::GLOBAL
         | PageTableFlags::NO_EXECUTE;
 
+    // ---- 1a. PCIe ECAM window (uncacheable), before the HHDM loop ----
+    // Firmware usually reports the ECAM window as a RESERVED memory map
+    // entry, which the HHDM loop below would map write-back. Config space
+    // must be uncacheable, so map it first; the HHDM loop then skips these
+    // pages as AlreadyMapped.
+    if let Some((ecam_base, ecam_len)) = crate::arch::pci::ecam_window() {
+        let ecam_flags = PageTableFlags::PRESENT
+            | PageTableFlags::WRITABLE
+            | PageTableFlags::NO_EXECUTE
+            | PageTableFlags::NO_CACHE
+            | PageTableFlags::GLOBAL;
+        let mut off = 0u64;
+        while off < ecam_len {
+            let phys = ecam_base + off;
+            let virt = VirtAddr::new(hhdm + phys);
+            let result = if phys & (SIZE_2M - 1) == 0 && ecam_len - off >= SIZE_2M {
+                off += SIZE_2M;
+                unsafe { vmm::map_huge_page_2m(pml4, virt, PhysAddr::new(phys), ecam_flags) }
+            } else {
+                off += PAGE_SIZE;
+                unsafe { vmm::map_page(pml4, virt, PhysAddr::new(phys), ecam_flags) }
+            };
+            match result {
+                Ok(()) | Err(vmm::MapError::AlreadyMapped) => {}
+                Err(e) => kprintln!("[pml4] WARNING: ECAM map failed @ {:#018X}: {:?}", phys, e),
+            }
+        }
+        kprintln!("[pml4] ECAM: {} MiB mapped at {:#018X} (uncacheable)",
+            ecam_len >> 20, hhdm + ecam_base);
+    }
+
+    // ---- 1b. Framebuffer (write-combining), before the HHDM loop ----
+    // Same trick as ECAM: the FRAMEBUFFER memory map entry would otherwise
+    // be mapped write-back. WC lets the console's row copies stream out
+    // as full bursts (needs `cpu::init_pat()` to have run on this core).
+    if let Some((fb_base, fb_len)) = crate::drivers::framebuffer::vram_window() {
+        let fb_flags = PageTableFlags::PRESENT
+            | PageTableFlags::WRITABLE
+            | PageTableFlags::NO_EXECUTE
+            | PageTableFlags::WRITE_COMBINING
+            | PageTableFlags::GLOBAL;
+        let mut off = 0u64;
+        while off < fb_len {
+            let phys = fb_base + off;
+            let virt = VirtAddr::new(hhdm + phys);
+            let result = if phys & (SIZE_2M - 1) == 0 && fb_len - off >= SIZE_2M {
+                off += SIZE_2M;
+                unsafe { vmm::map_huge_page_2m(pml4, virt, PhysAddr::new(phys), fb_flags) }
+            } else {
+                off += PAGE_SIZE;
+                unsafe { vmm::map_page(pml4, virt, PhysAddr::new(phys), fb_flags) }
+            };
+            match result {
+                Ok(()) | Err(vmm::MapError::AlreadyMapped) => {}
+                Err(e) => kprintln!("[pml4] WARNING: framebuffer map failed @ {:#018X}: {:?}", phys, e),
+            }
+        }
+        kprintln!("[pml4] Framebuffer: {} KiB mapped at {:#018X} (write-combining)",
+            fb_len >> 10, hhdm + fb_base);
+    }
+
     for entry in memory_map.iter() {
         let base = entry.base;
         let length = entry.length;
@@ -87,7 +150,16 @@ pub fn build() -> PhysAddr {
             if phys & (SIZE_2M - 1) == 0 && remaining >= SIZE_2M {
                 match unsafe { vmm::map_huge_page_2m(pml4, virt, PhysAddr::new(phys), hhdm_flags) } {
                     Ok(()) => { hhdm_pages_2m += 1; }
-                    Err(vmm::MapError::AlreadyMapped) => {}
+                    Err(vmm::MapError::AlreadyMapped) => {
+                        // Part of this 2M block was pre-mapped with 4K pages
+                        // (1a/1b): fill in the rest of the block 4K at a time.
+                        for p in (phys..phys + SIZE_2M).step_by(PAGE_SIZE as usize) {
+                            let v = VirtAddr::new(hhdm + p);
+                            if unsafe { vmm::map_page(pml4, v, PhysAddr::new(p), hhdm_flags) }.is_ok() {
+                                hhdm_pages_4k += 1;
+                            }
+                        }
+                    }
                     Err(e) => {
                         kprintln!("[pml4] WARNING: HHDM 2M map failed @ {:#018X}: {:?}", phys, e);
                     }
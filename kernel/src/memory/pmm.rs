@@ -26,6 +26,8 @@
 //   Single frame: Linear scan using u64-at-a-time for 64× speedup.
 //   Contiguous N: Linear scan for N consecutive zero bits.
 //   The `search_start` cursor avoids re-scanning already-allocated regions.
+//   The bitmap logic itself is `kcore::bitmap::FrameBitmap` (frame indices
+//   only, host-buildable); this module adds the Limine/HHDM/PhysAddr glue.
 //
 // SIZING FOR N3710 (8 GB RAM):
 //   Max physical address ≈ 8 GB → 2,097,152 frames
@@ -40,6 +42,8 @@
 
 use core::ptr;
 
+use kcore::bitmap::{DoubleFree, FrameBitmap};
+
 use crate::kprintln;
 use crate::memory::address::{PhysAddr, PAGE_SIZE};
 use crate::sync::spinlock::SpinLock;
@@ -76,6 +80,26 @@ pub struct MemoryStats {
 /// PMM is not yet initialized.
 static PMM: SpinLock<Option<BitmapAllocator>> = SpinLock::new(None);
 
+/// Capacity of the pre-zeroed frame pool (512 frames = 2 MiB).
+const ZERO_POOL_CAP: usize = 512;
+
+/// Frames already allocated from the bitmap and zeroed ahead of time.
+///
+/// Filled by `prefill_zero_pool()` (a boot task on an otherwise idle AP)
+/// and drained by `alloc_frame_zeroed()`, so the page tables, ELF pages and
+/// stack of Init cost the BSP a pop instead of a 4 KiB memset. Pooled
+/// frames count as USED in `stats()`. The pool is never refilled after
+/// boot; once empty, `alloc_frame_zeroed()` zeroes on demand as before.
+struct ZeroPool {
+    frames: [PhysAddr; ZERO_POOL_CAP],
+    len: usize,
+}
+
+static ZERO_POOL: SpinLock<ZeroPool> = SpinLock::new(ZeroPool {
+    frames: [PhysAddr::new(0); ZERO_POOL_CAP],
+    len: 0,
+});
+
 // =============================================================================
 // Bitmap Allocator internals
 // =============================================================================
@@ -86,9 +110,9 @@ static PMM: SpinLock<Option<BitmapAllocator>> = SpinLock::new(None);
 /// Not exposed publicly — all access goes through the module-level functions
 /// which hold the spinlock.
 struct BitmapAllocator {
-    /// Virtual address of the bitmap (accessed through HHDM).
-    /// The bitmap lives in physical memory; we access it at phys + HHDM_OFFSET.
-    bitmap: *mut u8,
+    /// The frame bitmap. Its storage lives in physical memory; we access it
+    /// at phys + HHDM_OFFSET.
+    frames: FrameBitmap,
 
     /// Size of the bitmap in bytes.
     bitmap_bytes: usize,
@@ -98,22 +122,8 @@ struct BitmapAllocator {
 
     /// Number of physical frames the bitmap occupies.
     bitmap_frame_count: usize,
-
-    /// Total number of physical frames tracked (= highest_addr / PAGE_SIZE).
-    total_frames: usize,
-
-    /// Number of frames currently marked as used.
-    used_frames: usize,
-
-    /// Optimization: start the next allocation scan from this frame index.
-    /// Updated after each alloc/free to avoid rescanning known-used regions.
-    search_start: usize,
 }
 
-// SAFETY: The bitmap pointer is only dereferenced while holding the PMM spinlock.
-// No other code accesses the bitmap concurrently.
-unsafe impl Send for BitmapAllocator {}
-
 impl BitmapAllocator {
     /// Creates and initializes a new bitmap allocator from the Limine memory map.
     ///
@@ -154,7 +164,7 @@ impl BitmapAllocator {
         }
 
         let total_frames = (highest_addr / PAGE_SIZE) as usize;
-        let bitmap_bytes = (total_frames + 7) / 8; // round up to whole bytes
+        let bitmap_bytes = FrameBitmap::storage_bytes(total_frames);
         let bitmap_frame_count =
             (bitmap_bytes + PAGE_SIZE as usize - 1) / PAGE_SIZE as usize;
 
@@ -208,13 +218,10 @@ impl BitmapAllocator {
         // We start pessimistic: everything is used. Then we selectively
         // free the regions that are actually available.
         //
-        // SAFETY: `bitmap` points to `bitmap_bytes` bytes of valid physical
-        // memory mapped through HHDM. We hold exclusive access (single-core
-        // boot, PMM lock not released yet).
-        unsafe {
-            ptr::write_bytes(bitmap, 0xFF, bitmap_bytes);
-        }
-        let mut used_frames = total_frames;
+        // SAFETY: `bitmap` is page-aligned and points to `bitmap_bytes` bytes
+        // of valid physical memory mapped through HHDM. We hold exclusive
+        // access (single-core boot, PMM lock not released yet).
+        let mut frames = unsafe { FrameBitmap::new_all_used(bitmap, total_frames) };
 
         // =====================================================================
         // Pass 3: Mark USABLE regions as free (clear their bits)
@@ -223,8 +230,7 @@ impl BitmapAllocator {
             if entry.entry_type == limine::memory_map::EntryType::USABLE {
                 let start_frame = (entry.base / PAGE_SIZE) as usize;
                 let end_frame = ((entry.base + entry.length) / PAGE_SIZE) as usize;
-                let freed = clear_range(bitmap, start_frame, end_frame.min(total_frames));
-                used_frames -= freed;
+                frames.mark_free_range(start_frame, end_frame);
             }
         }
 
@@ -237,7 +243,7 @@ impl BitmapAllocator {
         // given out as a free frame.
         let bitmap_start_frame = (bitmap_phys.as_u64() / PAGE_SIZE) as usize;
         for frame in bitmap_start_frame..bitmap_start_frame + bitmap_frame_count {
-            used_frames += set_bit(bitmap, frame);
+            frames.mark_used(frame);
         }
 
         // =====================================================================
@@ -247,8 +253,9 @@ impl BitmapAllocator {
         // Physical address 0 is conventionally treated as "null".
         // Allocating frame 0 and handing it to a caller would look like
         // a null pointer, causing subtle bugs. Mark it unconditionally used.
-        used_frames += set_bit(bitmap, 0);
+        frames.mark_used(0);
 
+        let used_frames = frames.used_frames();
         kprintln!(
             "[pmm] Free frames: {} ({} MiB), used: {} ({} MiB)",
             total_frames - used_frames,
@@ -258,13 +265,10 @@ impl BitmapAllocator {
         );
 
         Self {
-            bitmap,
+            frames,
             bitmap_bytes,
             bitmap_phys,
             bitmap_frame_count,
-            total_frames,
-            used_frames,
-            search_start: 0,
         }
     }
 
@@ -283,47 +287,8 @@ impl BitmapAllocator {
     /// `Some(PhysAddr)` — the page-aligned physical address of the allocated frame.
     /// `None` — if all frames are used (out of memory).
     fn alloc_frame(&mut self) -> Option<PhysAddr> {
-        let total_chunks = (self.total_frames + 63) / 64;
-        let start_chunk = self.search_start / 64;
-        let bitmap_u64 = self.bitmap as *const u64;
-
-        for i in 0..total_chunks {
-            let chunk_idx = (start_chunk + i) % total_chunks;
-            // SAFETY: The bitmap is page-aligned (≥ 8-byte aligned), so
-            // reading u64-at-a-time from the start is always aligned.
-            // The bitmap allocation is rounded up to whole pages, so
-            // reading beyond `bitmap_bytes` by up to 7 bytes is within
-            // the allocated page(s).
-            let chunk = unsafe { *bitmap_u64.add(chunk_idx) };
-
-            if chunk == u64::MAX {
-                // All 64 frames in this chunk are used. Skip.
-                continue;
-            }
-
-            // At least one bit is 0 (free). Find it.
-            // `trailing_zeros` on the inverse gives the index of the
-            // first 0 bit (first free frame in this chunk).
-            let bit_in_chunk = (!chunk).trailing_zeros() as usize;
-            let frame_idx = chunk_idx * 64 + bit_in_chunk;
-
-            if frame_idx >= self.total_frames {
-                continue; // Past the end of tracked memory
-            }
-
-            // Mark the frame as used (set its bit to 1).
-            unsafe {
-                let byte = &mut *self.bitmap.add(frame_idx / 8);
-                *byte |= 1 << (frame_idx % 8);
-            }
-
-            self.used_frames += 1;
-            self.search_start = frame_idx + 1;
-
-            return Some(PhysAddr::new(frame_idx as u64 * PAGE_SIZE));
-        }
-
-        None // Out of memory — all frames used
+        let frame_idx = self.frames.alloc()?;
+        Some(PhysAddr::new(frame_idx as u64 * PAGE_SIZE))
     }
 
     /// Frees a previously allocated physical frame.
@@ -336,39 +301,16 @@ impl BitmapAllocator {
         assert!(addr.is_page_aligned(), "PMM: cannot free unaligned address {}", addr);
 
         let frame_idx = (addr.as_u64() / PAGE_SIZE) as usize;
-        assert!(
-            frame_idx < self.total_frames,
-            "PMM: frame index {} out of range (max {})",
-            frame_idx,
-            self.total_frames
-        );
-
-        let byte_idx = frame_idx / 8;
-        let bit_mask = 1u8 << (frame_idx % 8);
-
-        unsafe {
-            let byte = &mut *self.bitmap.add(byte_idx);
-            if *byte & bit_mask == 0 {
-                // TODO(Sprint 11): Root-cause this race — likely an SMP timing
-                // issue between the reaper daemon and the scheduler's Dead-thread
-                // handling. Converting to a warning so we don't hard-panic during
-                // Sprint 10 Phase 2 Wasm SFI proof.
-                crate::kprintln!(
-                    "[pmm] WARNING: double free detected at frame {} ({}) — skipping",
-                    frame_idx,
-                    addr
-                );
-                return;
-            }
-            *byte &= !bit_mask; // Clear bit → frame is now free
-        }
-
-        self.used_frames -= 1;
-
-        // Move the search cursor back so this freed frame can be reused
-        // quickly by the next allocation.
-        if frame_idx < self.search_start {
-            self.search_start = frame_idx;
+        if let Err(DoubleFree) = self.frames.free(frame_idx) {
+            // TODO(Sprint 11): Root-cause this race — likely an SMP timing
+            // issue between the reaper daemon and the scheduler's Dead-thread
+            // handling. Converting to a warning so we don't hard-panic during
+            // Sprint 10 Phase 2 Wasm SFI proof.
+            kprintln!(
+                "[pmm] WARNING: double free detected at frame {} ({}) — skipping",
+                frame_idx,
+                addr
+            );
         }
     }
 
@@ -385,48 +327,18 @@ impl BitmapAllocator {
     /// `Some(PhysAddr)` — base address of the first frame in the run.
     /// `None` — not enough contiguous free frames.
     fn alloc_contiguous(&mut self, count: usize) -> Option<PhysAddr> {
-        if count == 0 {
-            return None;
-        }
-        if count == 1 {
-            return self.alloc_frame();
-        }
-
-        let mut run_start: usize = 0;
-        let mut run_length: usize = 0;
-
-        for frame in 0..self.total_frames {
-            if is_frame_free(self.bitmap, frame) {
-                if run_length == 0 {
-                    run_start = frame;
-                }
-                run_length += 1;
-
-                if run_length >= count {
-                    // Found enough consecutive free frames. Mark them all used.
-                    for f in run_start..run_start + count {
-                        unsafe {
-                            let byte = &mut *self.bitmap.add(f / 8);
-                            *byte |= 1 << (f % 8);
-                        }
-                    }
-                    self.used_frames += count;
-                    return Some(PhysAddr::new(run_start as u64 * PAGE_SIZE));
-                }
-            } else {
-                run_length = 0;
-            }
-        }
-
-        None
+        let first = self.frames.alloc_contiguous(count)?;
+        Some(PhysAddr::new(first as u64 * PAGE_SIZE))
     }
 
     /// Returns a snapshot of current physical memory statistics.
     fn stats(&self) -> MemoryStats {
+        let total_frames = self.frames.total_frames();
+        let used_frames = self.frames.used_frames();
         MemoryStats {
-            total_frames: self.total_frames,
-            used_frames: self.used_frames,
-            free_frames: self.total_frames - self.used_frames,
+            total_frames,
+            used_frames,
+            free_frames: total_frames - used_frames,
             bitmap_bytes: self.bitmap_bytes,
         }
     }
@@ -449,95 +361,6 @@ impl BitmapAllocator {
     }
 }
 
-// =============================================================================
-// Bitmap manipulation helpers
-// =============================================================================
-
-/// Sets bit `frame` in the bitmap (marks frame as used).
-///
-/// Returns 1 if the bit was previously clear (frame was free), 0 if it
-/// was already set. This allows callers to correctly adjust `used_frames`.
-#[inline]
-fn set_bit(bitmap: *mut u8, frame: usize) -> usize {
-    let byte_idx = frame / 8;
-    let bit_mask = 1u8 << (frame % 8);
-    unsafe {
-        let byte = &mut *bitmap.add(byte_idx);
-        if *byte & bit_mask == 0 {
-            *byte |= bit_mask;
-            1 // was free, now used
-        } else {
-            0 // already used
-        }
-    }
-}
-
-/// Returns `true` if the given frame is free (bit is 0).
-#[inline]
-fn is_frame_free(bitmap: *const u8, frame: usize) -> bool {
-    let byte_idx = frame / 8;
-    let bit_mask = 1u8 << (frame % 8);
-    unsafe { *bitmap.add(byte_idx) & bit_mask == 0 }
-}
-
-/// Clears all bits in the range `[start_frame, end_frame)`.
-///
-/// Optimized for large ranges: handles unaligned head/tail bit-by-bit,
-/// and clears aligned middle bytes whole-byte-at-a-time using popcount
-/// to track how many bits were actually changed.
-///
-/// # Returns
-/// The number of bits that were changed from 1 → 0.
-fn clear_range(bitmap: *mut u8, start_frame: usize, end_frame: usize) -> usize {
-    if start_frame >= end_frame {
-        return 0;
-    }
-
-    let mut cleared = 0usize;
-    let mut frame = start_frame;
-
-    // --- Unaligned head: clear bits until we reach a byte boundary ---
-    while frame < end_frame && (frame % 8) != 0 {
-        unsafe {
-            let byte = &mut *bitmap.add(frame / 8);
-            let mask = 1u8 << (frame % 8);
-            if *byte & mask != 0 {
-                *byte &= !mask;
-                cleared += 1;
-            }
-        }
-        frame += 1;
-    }
-
-    // --- Aligned middle: clear whole bytes at a time ---
-    // Each byte covers 8 frames. Count how many were set (popcount)
-    // before zeroing the byte.
-    while frame + 8 <= end_frame {
-        let byte_idx = frame / 8;
-        unsafe {
-            let byte = &mut *bitmap.add(byte_idx);
-            cleared += (*byte).count_ones() as usize;
-            *byte = 0;
-        }
-        frame += 8;
-    }
-
-    // --- Unaligned tail: clear remaining bits ---
-    while frame < end_frame {
-        unsafe {
-            let byte = &mut *bitmap.add(frame / 8);
-            let mask = 1u8 << (frame % 8);
-            if *byte & mask != 0 {
-                *byte &= !mask;
-                cleared += 1;
-            }
-        }
-        frame += 1;
-    }
-
-    cleared
-}
-
 // =============================================================================
 // Public API — module-level functions that acquire the spinlock
 // =============================================================================
@@ -584,6 +407,13 @@ pub fn alloc_frame() -> Option<PhysAddr> {
 /// # Panics
 /// If the PMM is not initialized.
 pub fn alloc_frame_zeroed() -> Option<PhysAddr> {
+    {
+        let mut pool = ZERO_POOL.lock();
+        if pool.len > 0 {
+            pool.len -= 1;
+            return Some(pool.frames[pool.len]);
+        }
+    }
     PMM.lock()
         .as_mut()
         .expect("PMM: not initialized — call pmm::init() first")
@@ -631,3 +461,30 @@ pub fn stats() -> MemoryStats {
         .expect("PMM: not initialized — call pmm::init() first")
         .stats()
 }
+
+/// Allocates up to `count` frames, zeroes them outside any lock and parks
+/// them in the zero pool. Returns how many frames were added.
+///
+/// Stops early when the pool is full or the PMM runs out of frames.
+pub fn prefill_zero_pool(count: usize) -> usize {
+    let mut added = 0;
+    while added < count {
+        let Some(frame) = alloc_frame() else { break };
+        // SAFETY: the frame was just allocated and is reachable via HHDM.
+        unsafe {
+            ptr::write_bytes(frame.to_virt().as_mut_ptr::<u8>(), 0, PAGE_SIZE as usize);
+        }
+
+        let mut pool = ZERO_POOL.lock();
+        if pool.len == ZERO_POOL_CAP {
+            drop(pool);
+            free_frame(frame);
+            break;
+        }
+        let i = pool.len;
+        pool.frames[i] = frame;
+        pool.len += 1;
+        added += 1;
+    }
+    added
+}
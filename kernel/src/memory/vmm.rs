@@ -97,8 +97,9 @@ bitflags! {
         /// If clear, only kernel mode (Ring 0) can access.
         const USER          = 1 << 2;
 
-        /// Write-through caching. Writes go to cache AND memory.
-        /// Used for memory-mapped I/O where write ordering matters.
+        /// Page-level write-through (PWT), low bit of the PAT index.
+        /// With the kernel's PAT (`cpu::init_pat`) PWT alone selects
+        /// write-combining, not write-through — see `WRITE_COMBINING`.
         const WRITE_THROUGH = 1 << 3;
 
         /// Disable caching for this page.
@@ -161,6 +162,12 @@ impl PageTableFlags {
     /// Used when the leaf entry needs USER set.
     pub const INTERMEDIATE_USER: Self =
         Self::PRESENT.union(Self::WRITABLE).union(Self::USER);
+
+    /// Write-combining memory type. PWT alone selects PAT entry 1, which
+    /// `cpu::init_pat()` programs as WC (the power-on default is WT).
+    ///
+    /// Used for the framebuffer: stores are merged into full-line bursts.
+    pub const WRITE_COMBINING: Self = Self::WRITE_THROUGH;
 }
 
 // =============================================================================
@@ -629,6 +636,84 @@ pub fn translate(pml4_phys: PhysAddr, virt: VirtAddr) -> Option<PhysAddr> {
     Some(PhysAddr::new(pt_entry.addr().as_u64() + offset))
 }
 
+/// Translates a user-space address, checking that Ring 3 may access it.
+///
+/// Like `translate`, but every level of the walk must carry USER (and
+/// WRITABLE if `write` is set). Syscalls use this before touching a
+/// user-supplied buffer so a process can only make the kernel read or
+/// write memory it could access itself.
+///
+/// # Returns
+/// `Some(PhysAddr)` including the page offset, `None` if the address is in
+/// the higher half, unmapped, or lacks the required permissions.
+pub fn translate_user(pml4_phys: PhysAddr, virt: VirtAddr, write: bool) -> Option<PhysAddr> {
+    if virt.as_u64() >= 0x0000_8000_0000_0000 {
+        return None;
+    }
+    let mut required = PageTableFlags::PRESENT | PageTableFlags::USER;
+    if write {
+        required |= PageTableFlags::WRITABLE;
+    }
+
+    let indices = virt.page_table_indices();
+    let mut table = unsafe { &*pml4_phys.to_virt().as_ptr::<PageTable>() };
+    // PML4 → PDPT → PD → PT; `level` is the index into `indices`.
+    for level in (0..4).rev() {
+        let entry = table[indices[level] as usize];
+        if !entry.flags().contains(required) {
+            return None;
+        }
+        if level == 0 || (level < 3 && entry.is_huge()) {
+            // Leaf: 4 KiB (level 0), 2 MiB (level 1) or 1 GiB (level 2).
+            let page_mask = (1u64 << (12 + 9 * level)) - 1;
+            return Some(PhysAddr::new(
+                (entry.addr().as_u64() & !page_mask) + (virt.as_u64() & page_mask),
+            ));
+        }
+        table = unsafe { &*entry.addr().to_virt().as_ptr::<PageTable>() };
+    }
+    None
+}
+
+/// Clears the DIRTY bit of the writable 4 KiB user page at `virt` and
+/// returns whether it was set (the page was written since the last call).
+///
+/// The bit is cleared atomically — the CPU sets it concurrently — and the
+/// page is flushed from this core's TLB whether or not it was dirty: an
+/// entry cached here while the PTE was dirty would let later writes skip
+/// setting the bit. Other cores are not flushed, so a write through their
+/// stale translations is missed: callers must only write the page from
+/// this core (see SYS_VM_DIRTY). Unmapped, read-only and huge pages report
+/// `true`, so a caller never skips a page it cannot vouch for.
+pub fn take_dirty_user(pml4_phys: PhysAddr, virt: VirtAddr) -> bool {
+    use core::sync::atomic::{AtomicU64, Ordering};
+
+    if virt.as_u64() >= 0x0000_8000_0000_0000 {
+        return true;
+    }
+    let required = PageTableFlags::PRESENT | PageTableFlags::USER | PageTableFlags::WRITABLE;
+    let indices = virt.page_table_indices();
+    let mut table = unsafe { &mut *pml4_phys.to_virt().as_mut_ptr::<PageTable>() };
+    for level in (1..4).rev() {
+        let entry = table[indices[level] as usize];
+        if !entry.flags().contains(required) || (level < 3 && entry.is_huge()) {
+            return true;
+        }
+        table = unsafe { &mut *entry.addr().to_virt().as_mut_ptr::<PageTable>() };
+    }
+
+    let leaf = &mut table[indices[0] as usize];
+    if !leaf.flags().contains(required) {
+        return true;
+    }
+    // SAFETY: PageTableEntry is a transparent u64 inside a page table.
+    let raw = unsafe { AtomicU64::from_ptr(leaf as *mut PageTableEntry as *mut u64) };
+    let dirty = raw.fetch_and(!PageTableFlags::DIRTY.bits(), Ordering::AcqRel)
+        & PageTableFlags::DIRTY.bits() != 0;
+    flush(virt);
+    dirty
+}
+
 /// Flushes the TLB entry for a single virtual address.
 ///
 /// Must be called after modifying a page table entry to ensure the CPU
@@ -0,0 +1,348 @@
+// =============================================================================
+// MinimalOS NextGen — Sampling Profiler (feature = "profile")
+// =============================================================================
+//
+// Statistical profiler for kernel AND user time. Built only with
+// `--features profile` (see `make profile`); a normal kernel contains none
+// of this.
+//
+// SAMPLING SOURCE:
+//   The LAPIC has exactly one timer, and the scheduler already uses it in
+//   one-shot mode for the 10ms quantum. With profiling enabled, the
+//   scheduler arms it for one SAMPLE PERIOD instead (`arm_timer`), and the
+//   vector 32 handler calls `on_timer` first:
+//
+//     tick → record sample → quantum not used up? → re-arm period, return
+//                          → quantum used up?     → fall through to schedule()
+//
+//   So preemption still happens every ~10ms, but we get PROFILE_HZ samples
+//   per second per busy core. (PMU-overflow NMIs would also see IF=0
+//   regions, but QEMU/TCG has no PMU to overflow.)
+//
+// SAMPLE CONTENTS:
+//   TSC, interrupted RIP, CPL, PID/TID, and up to CHAIN_DEPTH return
+//   addresses from the frame-pointer chain. `make profile` builds kernel
+//   and user crates with `-C force-frame-pointers=yes` so the chain exists.
+//   The walker never trusts RBP: kernel frames must stay inside the current
+//   thread's kernel stack, user frames must translate in the active PML4.
+//
+// BUFFERS:
+//   One fixed buffer per core (PMM pages via HHDM, no heap), written only
+//   by that core's timer ISR — no locks, no atomics RMW on the hot path.
+//   When a buffer is full, that core stops recording (counted as dropped).
+//
+// OUTPUT:
+//   The "profiler" kernel thread waits for the BSP buffer to fill, disables
+//   sampling, and dumps every buffer to serial:
+//
+//     @prof-begin hz=1000 depth=8
+//     @prof <cpu> <pid> <tid> <cpl> <rip> [<ret> ...]      (hex addresses)
+//     @prof-end samples=4096 dropped=0
+//
+//   `tools/profile_fold.py` symbolizes these against the kernel and user
+//   ELFs and emits folded stacks (flamegraph.pl / speedscope input).
+//
+// =============================================================================
+
+use core::ptr;
+use core::sync::atomic::{AtomicBool, AtomicPtr, AtomicU32, AtomicU64, Ordering};
+
+use crate::arch::gdt::MAX_CPUS;
+use crate::arch::idt::InterruptFrame;
+use crate::arch::{cpu, lapic};
+use crate::kprintln;
+use crate::memory::address::{PhysAddr, VirtAddr, PAGE_SIZE};
+use crate::memory::{pmm, vmm};
+use crate::sched::percpu::CpuLocal;
+
+/// Samples per second per core. Set at build time: `make profile PROFILE_HZ=N`.
+pub const PROFILE_HZ: u64 = parse_u64(option_env!("MNOS_PROFILE_HZ"), 1000);
+
+/// Sample period in microseconds.
+const PERIOD_US: u64 = 1_000_000 / PROFILE_HZ;
+
+/// Return addresses recorded per sample (beyond the interrupted RIP).
+const CHAIN_DEPTH: usize = 8;
+
+/// Buffer capacity per core. 4096 × 96 B = 96 pages.
+const SAMPLES_PER_CPU: usize = 4096;
+
+/// One profiler sample. 96 bytes.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct Sample {
+    tsc: u64,
+    rip: u64,
+    tid: u64,
+    pid: u32,
+    cpl: u8,
+    depth: u8,
+    _pad: u16,
+    chain: [u64; CHAIN_DEPTH],
+}
+
+/// Per-core sample buffer (lives in PMM pages, accessed via HHDM).
+#[repr(C)]
+struct SampleBuf {
+    /// Number of valid entries in `samples`.
+    len: usize,
+    /// Samples lost because the buffer was full.
+    dropped: u64,
+    samples: [Sample; SAMPLES_PER_CPU],
+}
+
+/// Per-core buffers, indexed by `CpuLocal.core_index`. Null until `init_cpu`.
+static BUFFERS: [AtomicPtr<SampleBuf>; MAX_CPUS] =
+    [const { AtomicPtr::new(ptr::null_mut()) }; MAX_CPUS];
+
+/// Sample periods left in the current quantum, per core.
+static TICKS_LEFT: [AtomicU32; MAX_CPUS] = [const { AtomicU32::new(0) }; MAX_CPUS];
+
+/// Cleared by the dumper so buffers are stable while they are printed.
+static ENABLED: AtomicBool = AtomicBool::new(true);
+
+/// Total samples lost across all cores (for the end line).
+static DROPPED: AtomicU64 = AtomicU64::new(0);
+
+/// Parses a decimal build-time setting, falling back to `default`.
+const fn parse_u64(s: Option<&str>, default: u64) -> u64 {
+    let bytes = match s {
+        Some(s) => s.as_bytes(),
+        None => return default,
+    };
+    let mut value = 0u64;
+    let mut i = 0;
+    while i < bytes.len() {
+        let d = bytes[i];
+        if d < b'0' || d > b'9' {
+            return default;
+        }
+        value = value * 10 + (d - b'0') as u64;
+        i += 1;
+    }
+    if value == 0 || value > 1_000_000 { default } else { value }
+}
+
+// =============================================================================
+// Setup
+// =============================================================================
+
+/// Allocates this core's sample buffer. Call right after `CpuLocal::install`.
+pub fn init_cpu(core: usize) {
+    let bytes = core::mem::size_of::<SampleBuf>();
+    let pages = (bytes + PAGE_SIZE as usize - 1) / PAGE_SIZE as usize;
+    let Some(phys) = pmm::alloc_contiguous(pages) else {
+        kprintln!("[profile] core {}: no memory for {} sample pages — not sampling", core, pages);
+        return;
+    };
+    let buf = phys.to_virt().as_mut_ptr::<SampleBuf>();
+    unsafe {
+        (*buf).len = 0;
+        (*buf).dropped = 0;
+    }
+    BUFFERS[core].store(buf, Ordering::Release);
+    if core == 0 {
+        kprintln!("[profile] Sampling at {} Hz, {} samples/core, depth {}",
+            PROFILE_HZ, SAMPLES_PER_CPU, CHAIN_DEPTH);
+    }
+}
+
+/// Arms the LAPIC timer for one sample period and restarts the quantum.
+///
+/// Replaces `set_timer_oneshot(quantum_us)` in the scheduler.
+pub fn arm_timer(quantum_us: u64) {
+    let core = unsafe { CpuLocal::get().core_index } as usize;
+    let ticks = (quantum_us / PERIOD_US).max(1) as u32;
+    TICKS_LEFT[core].store(ticks, Ordering::Relaxed);
+    lapic::set_timer_oneshot(PERIOD_US.min(quantum_us));
+}
+
+// =============================================================================
+// Timer hook (vector 32, IF=0)
+// =============================================================================
+
+/// Records one sample for the interrupted context.
+///
+/// Returns `true` if the tick was consumed (timer re-armed, do NOT schedule),
+/// `false` if the quantum is used up and the caller should call `schedule()`.
+pub fn on_timer(frame: &InterruptFrame) -> bool {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let core = cpu_local.core_index as usize;
+
+    if ENABLED.load(Ordering::Relaxed) {
+        record(core, cpu_local, frame);
+    }
+
+    let left = TICKS_LEFT[core].load(Ordering::Relaxed);
+    if left > 1 {
+        TICKS_LEFT[core].store(left - 1, Ordering::Relaxed);
+        lapic::set_timer_oneshot(PERIOD_US);
+        true
+    } else {
+        false
+    }
+}
+
+fn record(core: usize, cpu_local: &CpuLocal, frame: &InterruptFrame) {
+    let buf = BUFFERS[core].load(Ordering::Acquire);
+    if buf.is_null() {
+        return;
+    }
+    let buf = unsafe { &mut *buf };
+    if buf.len == SAMPLES_PER_CPU {
+        buf.dropped += 1;
+        DROPPED.fetch_add(1, Ordering::Relaxed);
+        return;
+    }
+
+    let thread = cpu_local.current_thread;
+    let (tid, pid, kstack) = if thread.is_null() {
+        (0, 0, (0, 0))
+    } else {
+        let t = unsafe { &*thread };
+        let pid = if t.process.is_null() { 0 } else { unsafe { (*t.process).pid } };
+        (t.id, pid, (t.kernel_stack_base, t.kernel_stack_base + t.kernel_stack_size as u64))
+    };
+
+    let cpl = (frame.cs & 3) as u8;
+    let mut chain = [0u64; CHAIN_DEPTH];
+    let depth = if cpl == 0 {
+        walk_kernel(frame.rbp, kstack, &mut chain)
+    } else {
+        walk_user(frame.rbp, &mut chain)
+    };
+
+    buf.samples[buf.len] = Sample {
+        tsc: cpu::read_tsc(),
+        rip: frame.rip,
+        tid,
+        pid: pid as u32,
+        cpl,
+        depth: depth as u8,
+        _pad: 0,
+        chain,
+    };
+    buf.len += 1;
+}
+
+/// Walks a kernel RBP chain, staying inside `[lo, hi)` (the thread's stack).
+fn walk_kernel(mut rbp: u64, (lo, hi): (u64, u64), chain: &mut [u64; CHAIN_DEPTH]) -> usize {
+    if lo == 0 {
+        return 0; // boot stack — bounds unknown, don't guess
+    }
+    let mut n = 0;
+    while n < CHAIN_DEPTH && rbp >= lo && rbp + 16 <= hi && rbp % 8 == 0 {
+        let (next, ret) = unsafe { (*(rbp as *const u64), *((rbp + 8) as *const u64)) };
+        if ret == 0 {
+            break;
+        }
+        chain[n] = ret;
+        n += 1;
+        if next <= rbp {
+            break; // frames must move toward the stack top
+        }
+        rbp = next;
+    }
+    n
+}
+
+/// Walks a user RBP chain through the active PML4 (reads via HHDM, so an
+/// unmapped or bogus RBP just ends the walk instead of faulting).
+fn walk_user(mut rbp: u64, chain: &mut [u64; CHAIN_DEPTH]) -> usize {
+    let pml4 = vmm::active_pml4();
+    let read = |addr: u64| -> Option<u64> {
+        let phys: PhysAddr = vmm::translate(pml4, VirtAddr::new(addr))?;
+        Some(unsafe { *phys.to_virt().as_ptr::<u64>() })
+    };
+
+    let mut n = 0;
+    while n < CHAIN_DEPTH && rbp != 0 && rbp % 8 == 0 && rbp + 16 <= 0x0000_8000_0000_0000 {
+        let (Some(next), Some(ret)) = (read(rbp), read(rbp + 8)) else { break };
+        if ret == 0 {
+            break;
+        }
+        chain[n] = ret;
+        n += 1;
+        if next <= rbp {
+            break;
+        }
+        rbp = next;
+    }
+    n
+}
+
+// =============================================================================
+// Dumper thread
+// =============================================================================
+
+/// Kernel thread: waits until the BSP buffer is full, then dumps all cores.
+pub extern "C" fn dumper_entry(_arg: u64) {
+    loop {
+        let bsp = BUFFERS[0].load(Ordering::Acquire);
+        if !bsp.is_null() && unsafe { (*bsp).len } == SAMPLES_PER_CPU {
+            break;
+        }
+        cpu::halt();
+    }
+
+    ENABLED.store(false, Ordering::SeqCst);
+    dump();
+    loop {
+        cpu::halt();
+    }
+}
+
+fn dump() {
+    kprintln!("@prof-begin hz={} depth={}", PROFILE_HZ, CHAIN_DEPTH);
+    let mut total = 0usize;
+    for (core, slot) in BUFFERS.iter().enumerate() {
+        let buf = slot.load(Ordering::Acquire);
+        if buf.is_null() {
+            continue;
+        }
+        let buf = unsafe { &*buf };
+        for s in &buf.samples[..buf.len] {
+            print_sample(core, s);
+        }
+        total += buf.len;
+    }
+    kprintln!("@prof-end samples={} dropped={}", total, DROPPED.load(Ordering::Relaxed));
+}
+
+fn print_sample(core: usize, s: &Sample) {
+    // Fixed-size line buffer so the whole sample goes out in one kprintln
+    // (samples from different cores never interleave mid-line).
+    let mut line = LineBuf::new();
+    use core::fmt::Write;
+    let _ = write!(line, "@prof {} {} {} {} {:x}", core, s.pid, s.tid, s.cpl, s.rip);
+    for ret in &s.chain[..s.depth as usize] {
+        let _ = write!(line, " {:x}", ret);
+    }
+    kprintln!("{}", line.as_str());
+}
+
+/// Minimal stack-allocated `fmt::Write` sink for one sample line.
+struct LineBuf {
+    buf: [u8; 256],
+    len: usize,
+}
+
+impl LineBuf {
+    fn new() -> Self {
+        Self { buf: [0; 256], len: 0 }
+    }
+
+    fn as_str(&self) -> &str {
+        core::str::from_utf8(&self.buf[..self.len]).unwrap_or("")
+    }
+}
+
+impl core::fmt::Write for LineBuf {
+    fn write_str(&mut self, s: &str) -> core::fmt::Result {
+        let bytes = s.as_bytes();
+        let n = bytes.len().min(self.buf.len() - self.len);
+        self.buf[self.len..self.len + n].copy_from_slice(&bytes[..n]);
+        self.len += n;
+        Ok(())
+    }
+}
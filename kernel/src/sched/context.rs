@@ -86,12 +86,18 @@ pub unsafe extern "C" fn switch_context(_prev_rsp: *mut u64, _next_rsp: u64) {
 ///   - Interrupts are DISABLED (IF=0, because we came from a timer ISR)
 ///
 /// We must:
-///   1. Enable interrupts (sti) — or this thread will starve the CPU
-///   2. Call the payload function with the argument
-///   3. Call thread_exit() if the payload returns
+///   1. Finish the switch (release the previous thread's `on_cpu`) — the
+///      part of schedule() a resumed thread runs after switch_context
+///   2. Enable interrupts (sti) — or this thread will starve the CPU
+///   3. Call the payload function with the argument
+///   4. Call thread_exit() if the payload returns
 #[unsafe(naked)]
 pub unsafe extern "C" fn thread_entry_trampoline() {
     naked_asm!(
+        // The previous thread's registers are saved: let other cores run it.
+        // RSP is the stack top here, 16-byte aligned as `call` requires.
+        "call {finish}",
+
         // CRITICAL: Re-enable preemption
         // The timer ISR that called schedule() cleared IF.
         // Without this, the thread runs forever without being preempted.
@@ -108,6 +114,7 @@ pub unsafe extern "C" fn thread_entry_trampoline() {
 
         // Should never reach here
         "ud2",
+        finish = sym super::scheduler::finish_switch,
         exit = sym super::thread::thread_exit,
     );
 }
@@ -5,5 +5,7 @@
 pub mod percpu;
 pub mod process;
 pub mod thread;
+pub mod queue;
 pub mod context;
 pub mod scheduler;
+pub mod stats;
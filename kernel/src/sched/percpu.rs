@@ -64,6 +64,21 @@ pub struct CpuLocal {
     /// SYSCALL entry loads RSP from this field (the CPU does NOT use TSS.rsp0
     /// for SYSCALL — only for interrupts). Updated on every context switch.
     pub kernel_stack_top: u64,
+
+    /// Thread this core is switching away from. Set by `schedule()` just
+    /// before `switch_context`; the thread switched to clears the old
+    /// thread's `on_cpu` flag (`scheduler::finish_switch`).
+    pub switch_prev: *mut super::thread::Thread,
+
+    // ─── CPU isolation (SYS_SCHED_PIN) ──────────────────────────────────────
+
+    /// TID of the thread this core is dedicated to (`thread::NO_TID` for a
+    /// shared core). An isolated core runs only threads pinned to it.
+    pub isolated_for: u64,
+
+    /// True while the preemption tick is off: the core is isolated and its
+    /// pinned thread is the only runnable one (`scheduler::arm_tick`).
+    pub tick_stopped: bool,
 }
 
 // Compile-time assertions: verify naked assembly offset assumptions.
@@ -91,6 +106,9 @@ impl CpuLocal {
             online: false,
             user_rsp_scratch: 0,
             kernel_stack_top: 0,
+            switch_prev: ptr::null_mut(),
+            isolated_for: super::thread::NO_TID,
+            tick_stopped: false,
         }
     }
 
@@ -11,6 +11,18 @@
 // Instead, every Thread holds a raw pointer to its parent Process.
 // Multiple threads within the same process share the PML4 and CNode.
 //
+// LOCKING:
+//   Those threads can be in syscalls on several cores at once, so the
+//   shared state is locked per process:
+//   - `cnode` is a SpinLock<CNode> (Level 4). Syscalls copy a capability
+//     out and drop the guard before acting on it; a lookup and the insert
+//     or remove it decides must share one guard.
+//   - `vm_lock` (Level 2) serializes changes to the lower half of the
+//     PML4. Walks (`vmm::translate_user`) stay lock-free: user mappings
+//     are only added while the process lives, and each entry is a single
+//     aligned 8-byte store.
+//   Neither is held while taking the other, or across a block.
+//
 // WHY SEPARATE PROCESS AND THREAD?
 //   seL4 and other formally verified microkernels make this exact split.
 //   The Thread is the unit of *scheduling*. The Process (address space +
@@ -28,9 +40,10 @@
 
 extern crate alloc;
 
-use core::sync::atomic::{AtomicU64, Ordering};
+use core::ptr;
+use core::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
 
-use alloc::collections::BTreeMap;
+use alloc::boxed::Box;
 
 use crate::cap::cnode::CNode;
 use crate::kprintln;
@@ -39,49 +52,117 @@ use crate::memory::pml4;
 use crate::sync::spinlock::SpinLock;
 
 // =============================================================================
-// Global Process Table
+// Global Process Table (two-level radix, RCU-protected)
 // =============================================================================
 //
 // Maps PID → *mut Process. Populated by Process::new() and Process::kernel().
 // Read by syscall handlers to resolve CapObject::Process { pid } capabilities
 // back to the actual Process struct.
 //
-// SAFETY: The raw pointers are heap-allocated via Box::into_raw and never freed
-// during kernel lifetime.  SpinLock ensures atomicity of insert/lookup.
+// LAYOUT:
+//   PID bits [17:9] index PID_ROOT, bits [8:0] index a 512-slot leaf.
+//   Leaves are allocated on first use and never freed, so a reader can
+//   walk root → leaf → slot with two Acquire loads and no lock.
+//
+//   ```text
+//   PID_ROOT[pid >> 9] ──► PidLeaf.slots[pid & 511] ──► *mut Process
+//   ```
+//
+// CONCURRENCY:
+//   - Lookups are lock-free. The caller must hold an `rcu::read_lock()`
+//     guard for as long as it dereferences the returned pointer.
+//   - Register/unregister serialize on PROCESS_TABLE_LOCK (writers only).
+//   - Whoever unregisters a process must call `rcu::synchronize()` before
+//     freeing it (see `scheduler::reaper_entry`).
 // =============================================================================
 
-/// Wrapper to satisfy Send bound for SpinLock<T: Send>.
-pub(crate) struct ProcessTableInner(BTreeMap<u64, *mut Process>);
+/// Bits of the PID consumed by one leaf.
+const PID_LEAF_BITS: u32 = 9;
 
-// SAFETY: The *mut Process pointers represent stable heap allocations that are
-// never freed. Access is serialized by the enclosing SpinLock.
-unsafe impl Send for ProcessTableInner {}
+/// Slots per leaf (and per root).
+const PID_LEAF_SIZE: usize = 1 << PID_LEAF_BITS;
 
-/// Global table mapping PID → *mut Process.
-///
-/// Syscalls use this to look up Process pointers from PID values stored in
-/// `CapObject::Process { pid }` capabilities.
-pub(crate) static PROCESS_TABLE: SpinLock<ProcessTableInner> =
-    SpinLock::new(ProcessTableInner(BTreeMap::new()));
+/// PIDs at or above this value cannot be registered.
+pub const MAX_PID: u64 = (PID_LEAF_SIZE * PID_LEAF_SIZE) as u64;
+
+/// One 4 KiB leaf of the PID radix table.
+struct PidLeaf {
+    slots: [AtomicPtr<Process>; PID_LEAF_SIZE],
+}
+
+/// Root level of the PID radix table. Null = leaf not yet allocated.
+static PID_ROOT: [AtomicPtr<PidLeaf>; PID_LEAF_SIZE] =
+    [const { AtomicPtr::new(ptr::null_mut()) }; PID_LEAF_SIZE];
+
+/// Serializes writers (register/unregister/leaf allocation).
+/// Readers never touch this lock.
+static PROCESS_TABLE_LOCK: SpinLock<()> = SpinLock::new(());
+
+/// Splits a PID into (root index, leaf index).
+#[inline]
+fn pid_indices(pid: u64) -> (usize, usize) {
+    ((pid >> PID_LEAF_BITS) as usize, (pid as usize) & (PID_LEAF_SIZE - 1))
+}
 
 /// Inserts a process into the global table.
 ///
 /// Called automatically by `Process::register()` and from main.rs after
 /// `Box::into_raw`.
 pub fn register_process(pid: u64, ptr: *mut Process) {
-    PROCESS_TABLE.lock().0.insert(pid, ptr);
+    if pid >= MAX_PID {
+        kprintln!("[process] PID {} exceeds MAX_PID {} — not registered", pid, MAX_PID);
+        return;
+    }
+    let (root_idx, leaf_idx) = pid_indices(pid);
+
+    let _guard = PROCESS_TABLE_LOCK.lock();
+    let mut leaf = PID_ROOT[root_idx].load(Ordering::Acquire);
+    if leaf.is_null() {
+        leaf = Box::into_raw(Box::new(PidLeaf {
+            slots: [const { AtomicPtr::new(ptr::null_mut()) }; PID_LEAF_SIZE],
+        }));
+        PID_ROOT[root_idx].store(leaf, Ordering::Release);
+    }
+    // Release: the fully-initialized Process is visible before its pointer.
+    unsafe { (*leaf).slots[leaf_idx].store(ptr, Ordering::Release) };
 }
 
 /// Looks up a process by PID. Returns None if not found.
+///
+/// Lock-free. The returned pointer is only guaranteed to stay valid while
+/// the caller holds an `rcu::read_lock()` guard taken BEFORE this call.
 pub fn lookup_process(pid: u64) -> Option<*mut Process> {
-    PROCESS_TABLE.lock().0.get(&pid).copied()
+    if pid >= MAX_PID {
+        return None;
+    }
+    let (root_idx, leaf_idx) = pid_indices(pid);
+
+    let leaf = PID_ROOT[root_idx].load(Ordering::Acquire);
+    if leaf.is_null() {
+        return None;
+    }
+    // SAFETY: leaves are never freed once published.
+    let ptr = unsafe { (*leaf).slots[leaf_idx].load(Ordering::Acquire) };
+    if ptr.is_null() { None } else { Some(ptr) }
 }
 
 /// Removes a process from the global table. Returns the raw pointer if it
 /// was registered, or None. The caller is responsible for dropping the
-/// Process (e.g., via `Box::from_raw`) to reclaim the CNode and PCB memory.
+/// Process (e.g., via `Box::from_raw`) to reclaim the CNode and PCB memory,
+/// but only AFTER `rcu::synchronize()` — lock-free readers may still hold it.
 pub fn unregister_process(pid: u64) -> Option<*mut Process> {
-    PROCESS_TABLE.lock().0.remove(&pid)
+    if pid >= MAX_PID {
+        return None;
+    }
+    let (root_idx, leaf_idx) = pid_indices(pid);
+
+    let _guard = PROCESS_TABLE_LOCK.lock();
+    let leaf = PID_ROOT[root_idx].load(Ordering::Acquire);
+    if leaf.is_null() {
+        return None;
+    }
+    let old = unsafe { (*leaf).slots[leaf_idx].swap(ptr::null_mut(), Ordering::AcqRel) };
+    if old.is_null() { None } else { Some(old) }
 }
 
 /// Global process ID counter. PID 0 is reserved for the kernel.
@@ -103,10 +184,14 @@ pub struct Process {
     /// For the kernel pseudo-process: same as KERNEL_PML4.
     pub pml4_phys: u64,
 
+    /// Address-space lock — held around `vmm::map_page` on `pml4_phys`
+    /// once the process can have running threads (see LOCKING above).
+    pub vm_lock: SpinLock<()>,
+
     /// Capability table — the process's security context.
     /// All threads within this process share the same CNode.
     /// Syscalls validate capabilities against this table.
-    pub cnode: CNode,
+    pub cnode: SpinLock<CNode>,
 
     /// Human-readable name for debugging.
     pub name: [u8; 32],
@@ -136,7 +221,8 @@ impl Process {
         Self {
             pid,
             pml4_phys: user_pml4.as_u64(),
-            cnode: CNode::new(),
+            vm_lock: SpinLock::new(()),
+            cnode: SpinLock::new(CNode::new()),
             name: name_buf,
             name_len: copy_len,
         }
@@ -153,7 +239,8 @@ impl Process {
         Self {
             pid: 0,
             pml4_phys: kernel_pml4,
-            cnode: CNode::new(),
+            vm_lock: SpinLock::new(()),
+            cnode: SpinLock::new(CNode::new()),
             name: {
                 let mut buf = [0u8; 32];
                 let n = b"kernel";
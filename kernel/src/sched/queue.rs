@@ -0,0 +1,161 @@
+// =============================================================================
+// MinimalOS NextGen — Intrusive Thread Queue
+// =============================================================================
+//
+// Every place a thread waits — a core's run queue and inbox, an Endpoint's
+// sender/receiver lists, a futex bucket, the dead queue — is a FIFO of
+// Box<Thread>. A VecDeque<Box<Thread>> may reallocate on push, and those
+// pushes happen inside schedule() and under IPC spinlocks with IF=0.
+//
+// ThreadQueue instead links threads through a `QueueLink` embedded in the
+// TCB itself:
+//
+//   ThreadQueue { head, tail, len }
+//        │                    │
+//        ▼                    ▼
+//     ┌──────┐  next  ┌──────┐  next  ┌──────┐
+//     │ T 7  │ ─────▶ │ T 3  │ ─────▶ │ T 9  │ ─▶ null
+//     │ link │ ◀───── │ link │ ◀───── │ link │
+//     └──────┘  prev  └──────┘  prev  └──────┘
+//
+//   push_back, pop_front, remove (from anywhere): O(1), no allocation.
+//
+// OWNERSHIP:
+//   The queue still owns its threads exactly like a Box container would:
+//   push_back consumes a Box<Thread> (Box::into_raw), pop_front/remove
+//   hand one back (Box::from_raw). A thread waits in at most one queue at
+//   a time, which is what makes a single embedded link enough.
+//
+// Locking is the container's business (SpinLock<ThreadQueue>, or the
+// owning core with IF=0 for run queues), as with the Vec it replaces.
+//
+// =============================================================================
+
+extern crate alloc;
+
+use alloc::boxed::Box;
+use core::ptr;
+
+use crate::sched::thread::Thread;
+
+/// Doubly-linked list hooks embedded in every `Thread`.
+pub struct QueueLink {
+    prev: *mut Thread,
+    next: *mut Thread,
+    /// True while the thread is in some ThreadQueue.
+    linked: bool,
+}
+
+impl QueueLink {
+    /// An unlinked hook (thread in no queue).
+    pub const fn new() -> Self {
+        Self { prev: ptr::null_mut(), next: ptr::null_mut(), linked: false }
+    }
+
+    /// True while the thread sits in a queue.
+    pub fn is_linked(&self) -> bool {
+        self.linked
+    }
+}
+
+/// FIFO of threads linked through `Thread::link`.
+pub struct ThreadQueue {
+    head: *mut Thread,
+    tail: *mut Thread,
+    len: usize,
+}
+
+// SAFETY: the queue owns the threads it links (as Box<Thread> would), and
+// every user serializes access (SpinLock or the owning core with IF=0).
+unsafe impl Send for ThreadQueue {}
+
+impl ThreadQueue {
+    /// Creates an empty queue.
+    pub const fn new() -> Self {
+        Self { head: ptr::null_mut(), tail: ptr::null_mut(), len: 0 }
+    }
+
+    /// Number of queued threads.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// True if no thread is queued.
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Appends `thread`, taking ownership.
+    pub fn push_back(&mut self, thread: Box<Thread>) {
+        debug_assert!(!thread.link.linked, "thread already in a queue");
+        let raw = Box::into_raw(thread);
+        unsafe {
+            (*raw).link = QueueLink { prev: self.tail, next: ptr::null_mut(), linked: true };
+            if self.tail.is_null() {
+                self.head = raw;
+            } else {
+                (*self.tail).link.next = raw;
+            }
+        }
+        self.tail = raw;
+        self.len += 1;
+    }
+
+    /// Removes and returns the oldest thread.
+    pub fn pop_front(&mut self) -> Option<Box<Thread>> {
+        if self.head.is_null() {
+            return None;
+        }
+        Some(unsafe { self.remove(self.head) })
+    }
+
+    /// Unlinks `thread` from anywhere in the queue and returns ownership.
+    ///
+    /// # Safety
+    /// `thread` must currently be linked into *this* queue.
+    pub unsafe fn remove(&mut self, thread: *mut Thread) -> Box<Thread> {
+        let link = unsafe { &mut (*thread).link };
+        debug_assert!(link.linked, "thread not in a queue");
+        if link.prev.is_null() {
+            self.head = link.next;
+        } else {
+            unsafe { (*link.prev).link.next = link.next; }
+        }
+        if link.next.is_null() {
+            self.tail = link.prev;
+        } else {
+            unsafe { (*link.next).link.prev = link.prev; }
+        }
+        *link = QueueLink::new();
+        self.len -= 1;
+        unsafe { Box::from_raw(thread) }
+    }
+
+    /// Removes up to `max` threads matching `pred`, oldest first, passing
+    /// each to `take`. Returns how many were removed.
+    pub fn remove_matching(
+        &mut self,
+        max: u64,
+        mut pred: impl FnMut(&Thread) -> bool,
+        mut take: impl FnMut(Box<Thread>),
+    ) -> u64 {
+        let mut removed = 0;
+        let mut cur = self.head;
+        while removed < max && !cur.is_null() {
+            let next = unsafe { (*cur).link.next };
+            if pred(unsafe { &*cur }) {
+                take(unsafe { self.remove(cur) });
+                removed += 1;
+            }
+            cur = next;
+        }
+        removed
+    }
+}
+
+impl Drop for ThreadQueue {
+    /// Frees whatever is still queued (bench run queues, mostly empty).
+    fn drop(&mut self) {
+        while self.pop_front().is_some() {}
+    }
+}
@@ -1,5 +1,5 @@
 // =============================================================================
-// MinimalOS NextGen — Preemptive Round-Robin Scheduler
+// MinimalOS NextGen — Preemptive Priority Round-Robin Scheduler
 // =============================================================================
 //
 // FLOW:
@@ -10,62 +10,196 @@
 //
 //   schedule():
 //     1. Read CpuLocal via gs:0
-//     2. Pop next thread from run queue
-//     3. Requeue current thread (if Running)
-//     4. Update CpuLocal.current_thread
-//     5. Call switch_context(prev_rsp, next_rsp)
-//     6. switch_context returns when this thread is resumed later
+//     2. Move threads other cores placed here (inbox) into the run queue
+//     3. Pop the highest-priority ready thread (or this core's idle
+//        thread) — unless the current one outranks everything queued
+//     4. Requeue current thread (if Running)
+//     5. Update CpuLocal.current_thread
+//     6. Call switch_context(prev_rsp, next_rsp)
+//     7. switch_context returns when this thread is resumed later
+//
+// SMP:
+//   Every core runs this scheduler on its own run queue: the BSP from
+//   `init()`, each AP from `init_ap()` once boot tasks are sealed. The run
+//   queue is only touched by its own core with IF=0, so it needs no lock.
+//
+//   New threads are placed on the least-loaded online core
+//   (`spawn_thread`). A thread for another core goes into that core's
+//   INBOX (a locked ThreadQueue) and is picked up by its next schedule(); an idle
+//   target is kicked with a reschedule IPI so it does not sleep through
+//   its tick.
+//
+//   An AP's boot context becomes its idle thread (`sti; hlt` in smp.rs).
+//   It is never queued: schedule() falls back to it when the run queue is
+//   empty and leaves it as soon as anything is ready.
+//
+//   A thread woken on another core can be queued there before its old core
+//   has saved its registers; `Thread::on_cpu` makes the new core wait.
+//
+// WAKEUPS (`wake`, `wake_sync`):
+//   A woken thread goes back to `Thread::last_cpu` — where its cache lines
+//   and TLB entries still are — if that core is idle, or if no core is
+//   idle and it is within WAKE_IMBALANCE of the least-loaded one.
+//   Otherwise it migrates to `pick_core()`.
+//
+//   Synchronous IPC adds one rule: when the waker and the wakee last woke
+//   each other (a client/server pair ping-ponging over an Endpoint) and
+//   the waker's core runs nothing else, the wakee is pulled onto the
+//   waker's core. The waker is about to block for the reply, so the pair
+//   takes turns on one core and the message never crosses a cache.
+//
+//   Every wakeup is counted on the waking core as cache-hot (back on
+//   last_cpu), pulled or migrated (see `stats::on_wake`).
+//
+// CPU ISOLATION (`pin_current`, SYS_SCHED_PIN):
+//   A thread may pin itself to a core (`Thread::affinity`); placement,
+//   wakeups and preemption then always send it there. Pinning with
+//   isolation also dedicates the core to it (`CpuLocal::isolated_for`):
+//   pick_core() and wakeup affinity skip the core, and threads already
+//   queued there are moved off at its next schedule(). A core that other
+//   threads are pinned to cannot be isolated (`CORE_PINNED`).
+//
+//   While the pinned thread is the only runnable one, the core stops its
+//   preemption tick (`arm_tick`) — a polling driver runs with no timer
+//   interrupts at all. Anything placed on the core afterwards arrives
+//   with a reschedule IPI, which brings the tick back — including a
+//   thread the pinned one wakes onto its own core. The BSP (core 0)
+//   cannot be isolated.
+//
+// PRIORITIES AND SCHEDULING CONTEXTS:
+//   Each thread runs on a `SchedContext` (priority + quantum). The run
+//   queue keeps one FIFO per priority; a higher level always runs first,
+//   equal levels share the core one quantum at a time. A thread placed on
+//   a core running something of lower priority kicks that core with a
+//   reschedule IPI (itself included), so it preempts at once rather than
+//   at the next tick.
+//
+//   Synchronous IPC donates the caller's context to the server for the
+//   duration of a call (`donate`, at every Endpoint rendezvous): a
+//   high-priority client's request is served at the client's priority
+//   and quantum, so a medium-priority thread cannot starve the server and
+//   through it the client (priority inversion). The server's reply — its
+//   next message to the donor — returns it to its own context; so does
+//   its next `recv`, which ends a one-way send that never gets a reply
+//   (unless it is waiting on an onward call of its own). The bookkeeping
+//   lives in `kcore::sched`. When the running thread's context changes,
+//   `current_context_changed` republishes its priority and quantum.
+//   Nothing is lent before the rendezvous: a client blocked in send while
+//   the server is still busy waits at the server's own context (see
+//   LIMITATION in ipc/endpoint.rs).
 //
 // =============================================================================
 
 extern crate alloc;
-use alloc::collections::VecDeque;
 use alloc::boxed::Box;
-use alloc::vec::Vec;
-
 
+use core::sync::atomic::{AtomicBool, AtomicPtr, AtomicU32, AtomicU8, AtomicUsize, Ordering};
 
 use crate::kprintln;
 use crate::arch::cpu;
+use crate::arch::gdt::MAX_CPUS;
 use crate::sync::spinlock::SpinLock;
-use crate::sched::thread::{Thread, ThreadState};
+use crate::sched::thread::{SchedContext, SchedState, Thread, ThreadState, NO_CPU, NO_TID, NUM_PRIORITIES};
 use crate::sched::context;
 use crate::sched::percpu::CpuLocal;
+use crate::sched::queue::{QueueLink, ThreadQueue};
 use crate::sched::process::Process;
 use crate::ipc::message::IpcMessage;
 
+/// Default time slice in microseconds (LAPIC one-shot).
+const QUANTUM_US: u64 = SchedContext::DEFAULT.quantum_us as u64;
+
+/// Arms the LAPIC one-shot timer for the next preemption point,
+/// `quantum_us` from now.
+///
+/// In profiling builds the timer fires once per sample period instead and
+/// `profile::on_timer` only lets every Nth tick reach `schedule()`.
+#[inline]
+fn arm_timer(quantum_us: u64) {
+    #[cfg(feature = "profile")]
+    crate::profile::arm_timer(quantum_us);
+    #[cfg(not(feature = "profile"))]
+    crate::arch::lapic::set_timer_oneshot(quantum_us);
+}
+
+/// Time slice of the scheduling context `thread` runs on.
+#[inline]
+fn quantum_of(thread: *const Thread) -> u64 {
+    unsafe { (*thread).sched.effective.quantum_us as u64 }
+}
+
 /// Per-core run queue. One per core, stored via raw pointer in CpuLocal.
 pub struct RunQueue {
-    /// Ready threads waiting for CPU time (FIFO round-robin).
-    pub ready: VecDeque<Box<Thread>>,
+    /// Ready threads per priority level, each FIFO (round-robin within a
+    /// level), linked through their TCBs — pushing never allocates inside
+    /// schedule().
+    levels: [ThreadQueue; NUM_PRIORITIES],
+    /// Bit p set ⇔ `levels[p]` is non-empty.
+    occupied: u32,
+    len: usize,
 }
 
 impl RunQueue {
     /// Creates an empty run queue.
     pub const fn new() -> Self {
         Self {
-            ready: VecDeque::new(),
+            levels: [const { ThreadQueue::new() }; NUM_PRIORITIES],
+            occupied: 0,
+            len: 0,
         }
     }
 
-    /// Adds a thread to the back of the ready queue.
+    /// Adds a thread to the back of its priority level. Does not touch its
+    /// stats: threads drained from an inbox were stamped ready on entry.
     pub fn push(&mut self, thread: Box<Thread>) {
-        self.ready.push_back(thread);
+        let level = thread.sched.effective.priority as usize;
+        self.levels[level].push_back(thread);
+        self.occupied |= 1 << level;
+        self.len += 1;
     }
 
-    /// Removes the next ready thread from the front.
+    /// Stamps a thread ready (`stats::on_ready`) and pushes it — for
+    /// threads entering this queue directly rather than through an inbox.
+    pub fn push_ready(&mut self, thread: Box<Thread>) {
+        crate::sched::stats::on_ready(&thread);
+        self.push(thread);
+    }
+
+    /// Removes the oldest thread of the highest non-empty level.
     pub fn pop(&mut self) -> Option<Box<Thread>> {
-        self.ready.pop_front()
+        let level = self.top_priority()? as usize;
+        let thread = self.levels[level].pop_front();
+        if self.levels[level].is_empty() {
+            self.occupied &= !(1 << level);
+        }
+        self.len -= 1;
+        thread
+    }
+
+    /// Priority of the thread `pop` would return.
+    #[inline]
+    pub fn top_priority(&self) -> Option<u8> {
+        (self.occupied != 0).then(|| (u32::BITS - 1 - self.occupied.leading_zeros()) as u8)
+    }
+
+    /// Removes every thread matching `pred`, passing each to `take`.
+    pub fn remove_matching(&mut self, mut pred: impl FnMut(&Thread) -> bool, mut take: impl FnMut(Box<Thread>)) {
+        for (level, queue) in self.levels.iter_mut().enumerate() {
+            self.len -= queue.remove_matching(u64::MAX, &mut pred, &mut take) as usize;
+            if queue.is_empty() {
+                self.occupied &= !(1 << level);
+            }
+        }
     }
 
     /// Number of threads in the ready queue.
     pub fn len(&self) -> usize {
-        self.ready.len()
+        self.len
     }
 
     /// True if no threads are ready.
     pub fn is_empty(&self) -> bool {
-        self.ready.is_empty()
+        self.len == 0
     }
 }
 
@@ -74,9 +208,47 @@ static BOOT_QUEUE: crate::sync::spinlock::SpinLock<RunQueue> =
     crate::sync::spinlock::SpinLock::new(RunQueue::new());
 
 /// Global queue of dead threads awaiting cleanup by the reaper daemon.
-static DEAD_QUEUE: SpinLock<Vec<Box<Thread>>> = SpinLock::new(Vec::new());
+static DEAD_QUEUE: SpinLock<ThreadQueue> = SpinLock::new(ThreadQueue::new());
 
-/// Spawns a new kernel thread and adds it to the boot queue.
+/// IDT vector of the reschedule IPI (handled in `idt::irq_dispatch`).
+pub const RESCHEDULE_VECTOR: u8 = 240;
+
+/// Cores whose scheduler is running (indexed by `CpuLocal.core_index`).
+static CORE_ONLINE: [AtomicBool; MAX_CPUS] = [const { AtomicBool::new(false) }; MAX_CPUS];
+
+/// LAPIC ID of each online core (IPI destination).
+static CORE_LAPIC: [AtomicU32; MAX_CPUS] = [const { AtomicU32::new(0) }; MAX_CPUS];
+
+/// Placement hint: threads queued on a core plus the one it runs (idle
+/// doesn't count). Rewritten by the core on every schedule(), bumped by
+/// other cores when they place a thread there.
+static CORE_LOAD: [AtomicUsize; MAX_CPUS] = [const { AtomicUsize::new(0) }; MAX_CPUS];
+
+/// True while a core is running its idle thread.
+static CORE_IDLE: [AtomicBool; MAX_CPUS] = [const { AtomicBool::new(false) }; MAX_CPUS];
+
+/// Effective priority of the thread each core runs (0 while idle).
+/// A thread placed on a core running lower priority preempts it.
+static CORE_PRIO: [AtomicU8; MAX_CPUS] = [const { AtomicU8::new(0) }; MAX_CPUS];
+
+/// True for cores dedicated to a pinned thread (the cross-core view of
+/// `CpuLocal::isolated_for`; set when the core is claimed, before its
+/// owner arrives).
+static CORE_ISOLATED: [AtomicBool; MAX_CPUS] = [const { AtomicBool::new(false) }; MAX_CPUS];
+
+/// Live threads whose `Thread::affinity` is each core. Isolation needs the
+/// core free of every other pinned thread; dropped when a pinned thread
+/// re-pins, unpins or dies.
+static CORE_PINNED: [AtomicUsize; MAX_CPUS] = [const { AtomicUsize::new(0) }; MAX_CPUS];
+
+/// Threads placed on a core, waiting for its next schedule().
+static INBOX: [SpinLock<ThreadQueue>; MAX_CPUS] =
+    [const { SpinLock::new(ThreadQueue::new()) }; MAX_CPUS];
+
+/// Kernel pseudo-process, owner of the AP idle threads (set by `init()`).
+static KERNEL_PROCESS: AtomicPtr<Process> = AtomicPtr::new(core::ptr::null_mut());
+
+/// Spawns a new kernel thread and places it on a core.
 ///
 /// # Parameters
 /// - `name`: Human-readable name for debugging.
@@ -86,17 +258,409 @@ static DEAD_QUEUE: SpinLock<Vec<Box<Thread>>> = SpinLock::new(Vec::new());
 pub fn spawn(name: &str, entry: extern "C" fn(u64), arg: u64, process: *mut Process) {
     let thread = Thread::new(name, entry, arg, process);
     kprintln!("[sched] Spawned thread {} '{}'", thread.id, name);
-    BOOT_QUEUE.lock().push(thread);
+    place(thread);
 }
 
-/// Enqueues a pre-built thread (e.g., from syscall::spawn_user) into the boot queue.
+/// Enqueues a pre-built thread (e.g., from syscall::spawn_user).
 ///
 /// The thread must be fully configured (CNode capabilities, user_rip, user_rsp)
 /// before calling this. Used for user threads that need custom setup before spawning.
+///
+/// Before the scheduler is up the thread waits in the boot queue; after
+/// that it goes to the least-loaded online core.
 pub fn spawn_thread(thread: Box<Thread>) {
     kprintln!("[sched] Spawned thread {} '{}' (pre-built)",
         thread.id, thread.name_str());
-    BOOT_QUEUE.lock().push(thread);
+    place(thread);
+}
+
+/// A woken thread stays on its last core while that core's load is
+/// within this many threads of the least-loaded core (when none is idle).
+const WAKE_IMBALANCE: usize = 1;
+
+/// Where `wake_core` put a thread, relative to its last core.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum WakePlacement {
+    /// Back on `last_cpu`.
+    CacheHot,
+    /// Onto the waker's core, next to its IPC partner.
+    Pulled,
+    /// Anywhere else.
+    Migrated,
+}
+
+/// Makes a blocked thread runnable again on a core chosen for cache
+/// affinity (see WAKEUPS above).
+///
+/// For wait queues that hand a sleeper's Box<Thread> back (futexes, IRQ
+/// waiters); IF must be 0.
+pub fn wake(thread: Box<Thread>) {
+    wake_with(thread, false);
+}
+
+/// Like `wake`, for a synchronous IPC rendezvous: the calling thread is
+/// the wakee's partner and may pull it onto this core.
+pub fn wake_sync(thread: Box<Thread>) {
+    wake_with(thread, true);
+}
+
+fn wake_with(mut thread: Box<Thread>, sync: bool) {
+    thread.state = ThreadState::Ready;
+    if !CORE_ONLINE[0].load(Ordering::Acquire) {
+        BOOT_QUEUE.lock().push_ready(thread);
+        return;
+    }
+    let (core, placement) = if thread.affinity != NO_CPU {
+        let core = thread.affinity as usize;
+        (core, if core as u32 == thread.last_cpu { WakePlacement::CacheHot } else { WakePlacement::Migrated })
+    } else {
+        wake_core(&mut thread, sync)
+    };
+    crate::sched::stats::on_wake(placement);
+    enqueue_on(core, thread);
+}
+
+/// Picks the core for a woken thread. Records the caller as the thread's
+/// IPC waker for `sync` wakeups.
+fn wake_core(thread: &mut Thread, sync: bool) -> (usize, WakePlacement) {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let here = cpu_local.core_index as usize;
+    let last = thread.last_cpu as usize;
+    let last_ok = thread.last_cpu != NO_CPU && last < MAX_CPUS
+        && CORE_ONLINE[last].load(Ordering::Acquire)
+        && !CORE_ISOLATED[last].load(Ordering::Acquire);
+    let classify = |core: usize, pulled: bool| {
+        if last_ok && core == last {
+            WakePlacement::CacheHot
+        } else if pulled {
+            WakePlacement::Pulled
+        } else {
+            WakePlacement::Migrated
+        }
+    };
+
+    if sync {
+        let waker = unsafe { &*cpu_local.current_thread };
+        let partners = waker.ipc_waker == thread.id && thread.ipc_waker == waker.id;
+        thread.ipc_waker = waker.id;
+        // Load 1 = just the waker, which blocks on its reply next.
+        if partners && CORE_LOAD[here].load(Ordering::Relaxed) <= 1
+            && !CORE_ISOLATED[here].load(Ordering::Acquire)
+        {
+            return (here, classify(here, true));
+        }
+    }
+
+    if last_ok && CORE_IDLE[last].load(Ordering::Acquire) {
+        return (last, WakePlacement::CacheHot);
+    }
+    let best = pick_core();
+    if last_ok && !CORE_IDLE[best].load(Ordering::Acquire)
+        && CORE_LOAD[last].load(Ordering::Relaxed)
+            <= CORE_LOAD[best].load(Ordering::Relaxed) + WAKE_IMBALANCE
+    {
+        return (last, WakePlacement::CacheHot);
+    }
+    (best, classify(best, false))
+}
+
+/// Boot queue until the BSP scheduler is online, then the thread's pinned
+/// core or `pick_core()`.
+fn place(thread: Box<Thread>) {
+    if !CORE_ONLINE[0].load(Ordering::Acquire) {
+        BOOT_QUEUE.lock().push_ready(thread);
+        return;
+    }
+    let core = if thread.affinity != NO_CPU { thread.affinity as usize } else { pick_core() };
+    enqueue_on(core, thread);
+}
+
+/// The online, non-isolated core with the lowest load; ties go to the
+/// calling core. Never an isolated core (the BSP cannot be one).
+fn pick_core() -> usize {
+    let here = unsafe { CpuLocal::get().core_index } as usize;
+    let mut best = here;
+    let mut best_load = if CORE_ISOLATED[here].load(Ordering::Acquire) {
+        usize::MAX
+    } else {
+        CORE_LOAD[here].load(Ordering::Relaxed)
+    };
+    for core in 0..MAX_CPUS {
+        if !CORE_ONLINE[core].load(Ordering::Acquire) || CORE_ISOLATED[core].load(Ordering::Acquire) {
+            continue;
+        }
+        let load = CORE_LOAD[core].load(Ordering::Relaxed);
+        if load < best_load {
+            best = core;
+            best_load = load;
+        }
+    }
+    best
+}
+
+/// Places a Ready thread on `core` via its inbox, stamping it ready before
+/// it enters (so its wait covers the IPI and drain). An idle or isolated
+/// (possibly tickless) remote core, this core while its tick is stopped,
+/// or any core running a lower priority is kicked with a reschedule IPI;
+/// otherwise the core drains its inbox on its next tick.
+pub fn enqueue_on(core: usize, thread: Box<Thread>) {
+    let priority = thread.sched.effective.priority;
+    crate::sched::stats::on_ready(&thread);
+    // The inbox lock keeps IF=0 until the IPI is out (see lapic::send_ipi).
+    let mut inbox = INBOX[core].lock();
+    inbox.push_back(thread);
+    CORE_LOAD[core].fetch_add(1, Ordering::Relaxed);
+
+    let cpu_local = unsafe { CpuLocal::get() };
+    let here = cpu_local.core_index as usize;
+    let kick = if core == here {
+        // No tick would ever drain it; the self-IPI's schedule() re-arms one.
+        cpu_local.tick_stopped
+    } else {
+        CORE_IDLE[core].load(Ordering::Acquire) || CORE_ISOLATED[core].load(Ordering::Acquire)
+    };
+    if kick || priority > CORE_PRIO[core].load(Ordering::Acquire) {
+        crate::arch::lapic::send_ipi(CORE_LAPIC[core].load(Ordering::Relaxed), RESCHEDULE_VECTOR);
+    }
+    drop(inbox);
+}
+
+/// Moves this core's inbox into its run queue. IF must be 0.
+#[inline]
+fn drain_inbox(core: usize, rq: &mut RunQueue) {
+    let mut inbox = INBOX[core].lock();
+    while let Some(thread) = inbox.pop_front() {
+        rq.push(thread);
+    }
+}
+
+// =============================================================================
+// CPU isolation
+// =============================================================================
+
+/// Why `pin_current` refused.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PinError {
+    /// No such online core, or isolating the BSP.
+    BadCore,
+    /// The core is dedicated to another thread, or (isolating) another
+    /// thread is pinned to it.
+    CoreTaken,
+}
+
+/// The core a running `thread` must leave `core` for, if any.
+#[inline]
+fn move_target(thread: &Thread, core: usize) -> Option<usize> {
+    if thread.affinity != NO_CPU {
+        let home = thread.affinity as usize;
+        return (home != core).then_some(home);
+    }
+    CORE_ISOLATED[core].load(Ordering::Relaxed).then(pick_core)
+}
+
+/// Re-arms the preemption tick `quantum_us` out — unless this core is
+/// isolated and its pinned thread is `alone` (running, nothing else
+/// queued): then the tick stays off until a reschedule IPI brings in more
+/// work.
+#[inline]
+fn arm_tick(cpu_local: &mut CpuLocal, alone: bool, quantum_us: u64) {
+    let stop = alone && cpu_local.isolated_for != NO_TID;
+    if stop {
+        if !cpu_local.tick_stopped {
+            crate::arch::lapic::stop_timer();
+        }
+    } else {
+        arm_timer(quantum_us);
+    }
+    cpu_local.tick_stopped = stop;
+}
+
+/// Sets `thread.affinity`, moving its `CORE_PINNED` count.
+#[inline]
+fn set_affinity(thread: &mut Thread, core: u32) {
+    if thread.affinity != NO_CPU {
+        CORE_PINNED[thread.affinity as usize].fetch_sub(1, Ordering::Relaxed);
+    }
+    if core != NO_CPU {
+        CORE_PINNED[core as usize].fetch_add(1, Ordering::Relaxed);
+    }
+    thread.affinity = core;
+}
+
+/// Returns the calling core to general placement. IF must be 0.
+fn release_isolation(cpu_local: &mut CpuLocal) {
+    let core = cpu_local.core_index as usize;
+    cpu_local.isolated_for = NO_TID;
+    CORE_ISOLATED[core].store(false, Ordering::Release);
+    if cpu_local.tick_stopped {
+        cpu_local.tick_stopped = false;
+        arm_timer(quantum_of(cpu_local.current_thread));
+    }
+}
+
+/// Pins the calling thread to `core`, or unpins it (`None`). With
+/// `isolate`, the core is also dedicated to the thread until it unpins or
+/// exits; a core other threads are pinned to cannot be isolated, since
+/// they could never run anywhere else. Any isolation the thread held
+/// before is released first; on error its old affinity stands.
+///
+/// Returns on the target core: if the caller is elsewhere, it yields and
+/// schedule() moves it.
+///
+/// # Safety
+/// Must be called from a syscall with IF=0, as the current thread.
+pub unsafe fn pin_current(core: Option<usize>, isolate: bool) -> Result<(), PinError> {
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    let thread = unsafe { &mut *cpu_local.current_thread };
+    if cpu_local.isolated_for == thread.id {
+        release_isolation(cpu_local);
+    }
+
+    let Some(core) = core else {
+        set_affinity(thread, NO_CPU);
+        return Ok(());
+    };
+    if core >= MAX_CPUS || !CORE_ONLINE[core].load(Ordering::Acquire) || (isolate && core == 0) {
+        return Err(PinError::BadCore);
+    }
+    // Count ourselves in before looking at CORE_ISOLATED, and an isolator
+    // claims CORE_ISOLATED before counting: with SeqCst on both sides a
+    // racing pin and isolate cannot both succeed.
+    CORE_PINNED[core].fetch_add(1, Ordering::SeqCst);
+    let claimed = if isolate {
+        let already = (thread.affinity == core as u32) as usize;
+        let won = CORE_ISOLATED[core]
+            .compare_exchange(false, true, Ordering::SeqCst, Ordering::Acquire)
+            .is_ok();
+        if won && CORE_PINNED[core].load(Ordering::SeqCst) != 1 + already {
+            CORE_ISOLATED[core].store(false, Ordering::Release);
+            false
+        } else {
+            won
+        }
+    } else {
+        !CORE_ISOLATED[core].load(Ordering::SeqCst)
+    };
+    if !claimed {
+        CORE_PINNED[core].fetch_sub(1, Ordering::Relaxed);
+        return Err(PinError::CoreTaken);
+    }
+
+    // `core` already counts us; drop the old pin's count.
+    if thread.affinity != NO_CPU {
+        CORE_PINNED[thread.affinity as usize].fetch_sub(1, Ordering::Relaxed);
+    }
+    thread.affinity = core as u32;
+    if core != cpu_local.core_index as usize {
+        // Running + affinity elsewhere: schedule() hands us to `core`.
+        unsafe { schedule(); }
+    }
+
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    if isolate {
+        cpu_local.isolated_for = thread.id;
+        kprintln!("[sched] Core {} isolated for thread {}", core, thread.id);
+    }
+    Ok(())
+}
+
+// =============================================================================
+// Scheduling contexts
+// =============================================================================
+
+/// Shortest and longest time slice SYS_SCHED_SET accepts.
+pub const QUANTUM_MIN_US: u32 = 1_000;
+pub const QUANTUM_MAX_US: u32 = 100_000;
+
+/// Passes scheduling contexts at an IPC rendezvous (`kcore::sched::donate`:
+/// a call lends the sender's context, the reply ends the loan). IF must
+/// be 0.
+///
+/// Call before the woken side is queued, so it is queued at the right
+/// level. If the running thread's context changes, follow up with
+/// `current_context_changed`.
+#[inline]
+pub fn donate(sender: &mut Thread, receiver: &mut Thread) {
+    kcore::sched::donate(sender.id, &mut sender.sched, receiver.id, &mut receiver.sched);
+}
+
+/// Applies a change to the running thread's effective context at once:
+/// publishes its priority (what `enqueue_on` kicks against) and restarts
+/// its time slice with the new quantum. If something queued here now
+/// outranks it, the core kicks itself, so the switch happens as soon as
+/// IF is back on rather than at the next tick. IF must be 0.
+pub fn current_context_changed() {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let core = cpu_local.core_index as usize;
+    let current = cpu_local.current_thread;
+    let priority = unsafe { (*current).sched.effective.priority };
+    CORE_PRIO[core].store(priority, Ordering::Release);
+    if !cpu_local.tick_stopped {
+        arm_timer(quantum_of(current));
+    }
+    let rq = unsafe { &*cpu_local.run_queue };
+    if rq.top_priority().is_some_and(|top| top > priority) {
+        crate::arch::lapic::send_ipi(cpu_local.lapic_id, RESCHEDULE_VECTOR);
+    }
+}
+
+/// Replaces the calling thread's own scheduling context (SYS_SCHED_SET).
+/// A donated context it is running on stays in force until the call ends,
+/// unless the new one outranks it.
+///
+/// # Safety
+/// Must be called from a syscall with IF=0, as the current thread.
+pub unsafe fn set_current_context(sc: SchedContext) {
+    let thread = unsafe { &mut *CpuLocal::get().current_thread };
+    let before = thread.sched.effective;
+    thread.sched.set_own(sc);
+    if thread.sched.effective != before {
+        current_context_changed();
+    }
+}
+
+/// Second half of a context switch, run by the thread switched *to*:
+/// the previous thread's registers are now saved, so another core may
+/// resume it. Called after `switch_context` returns in `schedule()` and
+/// from `thread_entry_trampoline` for a thread's first run.
+pub extern "C" fn finish_switch() {
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    let prev = core::mem::replace(&mut cpu_local.switch_prev, core::ptr::null_mut());
+    if !prev.is_null() {
+        unsafe { (*prev).on_cpu.store(false, Ordering::Release) };
+    }
+}
+
+/// TCB for the context a core is already running (BSP main, AP idle):
+/// no synthetic frame, `rsp` is filled in by its first switch away.
+fn boot_context_thread(name: &[u8], process: *mut Process, stats: *const crate::sched::stats::ThreadStats) -> *mut Thread {
+    let mut buf = [0u8; 32];
+    buf[..name.len()].copy_from_slice(name);
+    // Convert to raw pointer via the canonical API — Box::into_raw.
+    // schedule() will later reconstruct via Box::from_raw to requeue.
+    Box::into_raw(Box::new(Thread {
+        id: 0,
+        state: ThreadState::Running,
+        rsp: 0, // Will be filled by switch_context on first preemption
+        kernel_stack_base: 0, // Using the boot stack
+        kernel_stack_size: 0,
+        name: buf,
+        name_len: name.len(),
+        process,
+        ipc_buffer: IpcMessage::EMPTY,
+        user_rip: 0,
+        user_rsp: 0,
+        pmu: None,
+        stats,
+        on_cpu: AtomicBool::new(true),
+        link: QueueLink::new(),
+        futex_space: 0,
+        futex_addr: 0,
+        last_cpu: NO_CPU,
+        ipc_waker: NO_TID,
+        affinity: NO_CPU,
+        sched: SchedState::DEFAULT,
+    }))
 }
 
 /// Initializes the scheduler on the BSP.
@@ -120,27 +684,12 @@ pub fn init(kernel_process: *mut Process) {
     // 2. Create the "BSP main" thread — represents the current execution context.
     //    This thread doesn't need a synthetic stack frame because it IS the running
     //    context. Its RSP will be saved by switch_context when it gets preempted.
-    let bsp_thread = Box::new(Thread {
-        id: 0,
-        state: ThreadState::Running,
-        rsp: 0, // Will be filled by switch_context on first preemption
-        kernel_stack_base: 0, // Using Limine's original stack
-        kernel_stack_size: 0,
-        name: {
-            let mut buf = [0u8; 32];
-            let name = b"bsp-main";
-            buf[..name.len()].copy_from_slice(name);
-            buf
-        },
-        name_len: 8,
-        process: kernel_process,
-        ipc_buffer: IpcMessage::EMPTY,
-        user_rip: 0,
-        user_rsp: 0,
-    });
-    // Convert to raw pointer via the canonical API — Box::into_raw.
-    // schedule() will later reconstruct via Box::from_raw to requeue.
-    let bsp_thread_ptr = Box::into_raw(bsp_thread);
+    let bsp_thread_ptr = boot_context_thread(
+        b"bsp-main",
+        kernel_process,
+        crate::sched::stats::claim(0, unsafe { (*kernel_process).pid }, b"bsp-main"),
+    );
+    KERNEL_PROCESS.store(kernel_process, Ordering::Release);
 
     // 3. Install RunQueue and current thread into CpuLocal
     unsafe {
@@ -164,29 +713,84 @@ pub fn init(kernel_process: *mut Process) {
     // Spawn the reaper daemon as a kernel thread and add it to the BSP run queue.
     // The reaper will pull dead threads from `DEAD_QUEUE` and perform teardown.
     let reaper_thread = Thread::new("reaper", reaper_entry, 0, kernel_process);
-    unsafe { (*rq_ptr).push(reaper_thread); }
+    unsafe { (*rq_ptr).push_ready(reaper_thread); }
     kprintln!("[sched] Reaper daemon spawned");
 
     // Spawn a short-lived test thread that returns immediately so we can
     // exercise the reaper path during boot and observe its serial output.
     let exiter = Thread::new("test-exiter", test_exiter, 0, kernel_process);
-    unsafe { (*rq_ptr).push(exiter); }
+    unsafe { (*rq_ptr).push_ready(exiter); }
     kprintln!("[sched] Spawned test-exiter to exercise reaper");
 
+    // Profiling builds: the dumper prints all sample buffers once full.
+    #[cfg(feature = "profile")]
+    {
+        let dumper = Thread::new("profiler", crate::profile::dumper_entry, 0, kernel_process);
+        unsafe { (*rq_ptr).push_ready(dumper); }
+    }
+
     // 5. Arm the LAPIC timer for periodic preemption (10ms quantum)
-    crate::arch::lapic::set_timer_oneshot(10_000); // 10ms
+    arm_timer(QUANTUM_US);
     kprintln!("[sched] LAPIC timer armed (10ms quantum)");
+
+    // 6. Open the BSP for placement (spawn_thread stops using BOOT_QUEUE)
+    let core = unsafe { CpuLocal::get().core_index } as usize;
+    CORE_LAPIC[core].store(unsafe { CpuLocal::get().lapic_id }, Ordering::Relaxed);
+    CORE_LOAD[core].store(unsafe { (*rq_ptr).len() } + 1, Ordering::Relaxed);
+    CORE_PRIO[core].store(SchedContext::DEFAULT.priority, Ordering::Relaxed);
+    CORE_ONLINE[core].store(true, Ordering::Release);
     kprintln!("[sched] Preemptive scheduler active on BSP");
 }
 
+/// Starts the scheduler on an AP, after the BSP's `init()`.
+///
+/// The calling context becomes the core's idle thread: it returns to the
+/// AP's `sti; hlt` loop, and the first timer tick or reschedule IPI that
+/// finds work switches away from it.
+///
+/// # Safety
+/// Call once per AP with IF=0, after `CpuLocal::install` and `lapic::init`.
+pub unsafe fn init_ap() {
+    // APs leave the boot task graph only after seal(), which the BSP calls
+    // after init(); don't rely on that ordering for KERNEL_PROCESS though.
+    while !CORE_ONLINE[0].load(Ordering::Acquire) {
+        core::hint::spin_loop();
+    }
+
+    let rq_ptr = Box::into_raw(Box::new(RunQueue::new()));
+    let idle = boot_context_thread(
+        b"idle",
+        KERNEL_PROCESS.load(Ordering::Acquire),
+        core::ptr::null(),
+    );
+
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    cpu_local.run_queue = rq_ptr;
+    cpu_local.current_thread = idle;
+    cpu_local.idle_thread = idle;
+    cpu_local.online = true;
+
+    let core = cpu_local.core_index as usize;
+    CORE_LAPIC[core].store(cpu_local.lapic_id, Ordering::Relaxed);
+    CORE_LOAD[core].store(0, Ordering::Relaxed);
+    CORE_IDLE[core].store(true, Ordering::Release);
+    CORE_ONLINE[core].store(true, Ordering::Release);
+
+    arm_timer(QUANTUM_US);
+    kprintln!("[sched] Scheduler active on core {}", core);
+}
+
 /// The main scheduling function. Called from:
 ///   1. LAPIC timer ISR (vector 32) — preemptive context switch
 ///   2. IPC endpoint send/recv — voluntary yield when blocking
 ///
-/// Picks the next Ready thread from the run queue and context-switches to it.
+/// Picks the highest-priority Ready thread from the run queue (the idle
+/// thread if there is none) and context-switches to it — unless the
+/// current thread outranks everything queued, which then keeps running.
 /// Handles the current thread based on its state:
-///   - Running → mark Ready, requeue (normal preemption)
-///   - BlockedSend/BlockedRecv → don't touch (ownership transferred to Endpoint)
+///   - Running → mark Ready, requeue (normal preemption; never the idle thread)
+///   - BlockedSend/BlockedRecv/BlockedWait → don't touch (ownership
+///     transferred to an Endpoint or futex bucket)
 ///   - Dead → don't requeue (leak for now, proper cleanup later)
 ///
 /// # Safety
@@ -207,6 +811,21 @@ pub unsafe fn schedule() {
     let cpu_local = unsafe { CpuLocal::get_mut() };
     let rq = unsafe { &mut *cpu_local.run_queue };
     let current_ptr = cpu_local.current_thread;
+    let idle_ptr = cpu_local.idle_thread;
+    let core = cpu_local.core_index as usize;
+
+    // Threads other cores placed here since the last switch.
+    drain_inbox(core, rq);
+
+    // An isolated core keeps only the threads pinned to it.
+    if CORE_ISOLATED[core].load(Ordering::Relaxed) {
+        rq.remove_matching(
+            |t| t.affinity != core as u32,
+            |t| enqueue_on(pick_core(), t),
+        );
+    }
+
+    crate::sched::stats::on_schedule(rq.len());
 
     // Determine current thread state (needed before we check RunQueue)
     let current_state = if !current_ptr.is_null() {
@@ -214,31 +833,59 @@ pub unsafe fn schedule() {
     } else {
         ThreadState::Dead
     };
+    let current_is_idle = !idle_ptr.is_null() && current_ptr == idle_ptr;
+    // Core the current thread must move to, if it may not stay here
+    // (pinned elsewhere, or unpinned on an isolated core).
+    let current_moves_to = if current_state == ThreadState::Running && !current_is_idle {
+        unsafe { move_target(&*current_ptr, core) }
+    } else {
+        None
+    };
+
+    // --- Current thread outranks everything queued: keep it ---
+    let outranked = match rq.top_priority() {
+        None => false,
+        Some(top) => current_is_idle || top >= unsafe { (*current_ptr).sched.effective.priority },
+    };
+    if current_state == ThreadState::Running && current_moves_to.is_none() && !outranked {
+        // Nothing to switch to — let current keep running.
+        CORE_LOAD[core].store(rq.len() + !current_is_idle as usize, Ordering::Relaxed);
+        if !current_is_idle {
+            CORE_PRIO[core].store(unsafe { (*current_ptr).sched.effective.priority }, Ordering::Release);
+        }
+        arm_tick(cpu_local, rq.is_empty() && !current_is_idle, quantum_of(current_ptr));
+        return;
+    }
 
     // --- Handle empty RunQueue ---
     if rq.is_empty() {
-        if current_state == ThreadState::Running {
-            // Normal preemption with nothing to switch to — let current keep running.
-            crate::arch::lapic::set_timer_oneshot(10_000);
-            return;
-        }
-        // Current thread is blocked/dead — no runnable threads exist.
-        // Spin-wait: on multi-core, another core's IPC wakeup may push here.
-        // On single-core with all threads blocked, this is a legitimate deadlock.
-        while rq.is_empty() {
-            core::hint::spin_loop();
+        if idle_ptr.is_null() {
+            // Current thread is blocked/dead and this core has no idle
+            // thread (BSP) — spin until a wakeup or placement arrives.
+            while rq.is_empty() {
+                core::hint::spin_loop();
+                drain_inbox(core, rq);
+            }
         }
     }
 
-    // Pop the next Ready thread
-    let mut next_box = rq.pop().unwrap();
-    next_box.state = ThreadState::Running;
-    let next_ptr = Box::into_raw(next_box);
+    // Pop the next Ready thread, or fall back to the idle thread.
+    let next_ptr = match rq.pop() {
+        Some(mut next_box) => {
+            next_box.state = ThreadState::Running;
+            Box::into_raw(next_box)
+        }
+        None => {
+            unsafe { (*idle_ptr).state = ThreadState::Running; }
+            idle_ptr
+        }
+    };
+    let next_is_idle = next_ptr == idle_ptr;
 
     // Null check — shouldn't happen after init, but be defensive
     if current_ptr.is_null() {
         cpu_local.current_thread = next_ptr;
-        crate::arch::lapic::set_timer_oneshot(10_000);
+        arm_timer(quantum_of(next_ptr));
         return;
     }
 
@@ -246,22 +893,30 @@ pub unsafe fn schedule() {
     // This raw pointer remains valid because:
     //   - Running: we'll Box::from_raw → push to RunQueue (memory stays alive)
     //   - Blocked*: Endpoint owns the Box (memory stays alive)
-    //   - Dead: memory stays alive until we drop (after switch_context returns)
+    //   - Dead: the reaper waits for `on_cpu` to clear before freeing it
     let prev_rsp_ptr = unsafe { &raw mut (*current_ptr).rsp };
-    let next_rsp_val = unsafe { (*next_ptr).rsp };
 
     // --- Handle current thread based on state ---
     match current_state {
+        ThreadState::Running if current_is_idle => {
+            // The idle thread is never queued; it stays in CpuLocal.
+            unsafe { (*current_ptr).state = ThreadState::Ready; }
+        }
         ThreadState::Running => {
-            // Normal preemption: requeue the current thread.
+            // Normal preemption: requeue the current thread (on the core
+            // it must move to, if any — `on_cpu` holds it there until the
+            // switch below completes).
             // Reconstruct Box (valid: into_raw was the last ownership op).
             unsafe { (*current_ptr).state = ThreadState::Ready; }
             let current_box = unsafe { Box::from_raw(current_ptr) };
-            rq.push(current_box);
+            match current_moves_to {
+                Some(target) => enqueue_on(target, current_box),
+                None => rq.push_ready(current_box),
+            }
         }
-        ThreadState::BlockedSend | ThreadState::BlockedRecv => {
+        ThreadState::BlockedSend | ThreadState::BlockedRecv | ThreadState::BlockedWait => {
             // Thread's Box<Thread> ownership was transferred to an Endpoint
-            // by the IPC code BEFORE calling schedule(). Do NOT reconstruct
+            // (or futex bucket) BEFORE calling schedule(). Do NOT reconstruct
             // a Box here — that would create a second Box for the same
             // allocation, causing a double-free when both are dropped.
             //
@@ -272,17 +927,38 @@ pub unsafe fn schedule() {
             // Thread has terminated. Move ownership of the TCB to the
             // global DEAD_QUEUE so the reaper daemon can reclaim resources
             // (kernel stack, page tables, capabilities) off-stack.
-            let current_box = unsafe { Box::from_raw(current_ptr) };
-            DEAD_QUEUE.lock().push(current_box);
+            // A core dedicated to it becomes a shared core again.
+            if cpu_local.isolated_for == unsafe { (*current_ptr).id } {
+                release_isolation(cpu_local);
+            }
+            let mut current_box = unsafe { Box::from_raw(current_ptr) };
+            set_affinity(&mut current_box, NO_CPU);
+            DEAD_QUEUE.lock().push_back(current_box);
         }
         ThreadState::Ready => {
             // Shouldn't happen — Ready means it should be in the RunQueue.
             // Defensive: just requeue it.
             let current_box = unsafe { Box::from_raw(current_ptr) };
-            rq.push(current_box);
+            rq.push_ready(current_box);
         }
     }
 
+    CORE_LOAD[core].store(rq.len() + !next_is_idle as usize, Ordering::Relaxed);
+    CORE_IDLE[core].store(next_is_idle, Ordering::Release);
+    let next_prio = if next_is_idle { 0 } else { unsafe { (*next_ptr).sched.effective.priority } };
+    CORE_PRIO[core].store(next_prio, Ordering::Release);
+
+    // A thread woken here by another core may still be switching away on
+    // that core. Its saved RSP is only valid once `on_cpu` drops.
+    while unsafe { (*next_ptr).on_cpu.load(Ordering::Acquire) } {
+        core::hint::spin_loop();
+    }
+    unsafe { (*next_ptr).on_cpu.store(true, Ordering::Relaxed); }
+    if !next_is_idle {
+        unsafe { (*next_ptr).last_cpu = core as u32; }
+    }
+    let next_rsp_val = unsafe { (*next_ptr).rsp };
+
     // Install next thread as current and re-arm the timer
     cpu_local.current_thread = next_ptr;
 
@@ -323,20 +999,31 @@ pub unsafe fn schedule() {
         unsafe { crate::arch::cpu::write_cr3(next_pml4); }
     }
 
-    crate::arch::lapic::set_timer_oneshot(10_000);
+    // ─── PMU: per-thread performance counters ──────────────────────────────
+    // Save prev's counters and load next's; toggles CR4.PCE so only threads
+    // that programmed counters through their PMU capability may `rdpmc`.
+    unsafe { crate::arch::pmu::switch(current_ptr, next_ptr); }
+
+    // CPU accounting: close prev's time slice, open next's.
+    unsafe { crate::sched::stats::on_switch(current_ptr, current_state, next_ptr); }
+
+    arm_tick(cpu_local, rq.is_empty() && !next_is_idle, quantum_of(next_ptr));
 
     // Execute the hardware context switch.
     // Saves current callee-saved regs + RSP into *prev_rsp_ptr,
     // loads next thread's RSP and callee-saved regs, then `ret`.
     // We reach the line below when THIS thread gets scheduled back.
+    cpu_local.switch_prev = current_ptr;
     unsafe { context::switch_context(prev_rsp_ptr, next_rsp_val); }
+    finish_switch();
 }
 
 /// Reaper daemon: runs as a normal kernel thread. Wakes periodically, pops
 /// dead `Box<Thread>` entries from `DEAD_QUEUE` and performs full teardown:
 ///   1. Reclaim the kernel stack physical frames (16 KiB = 4 pages)
 ///   2. If this was the last thread of a user process, destroy the entire
-///      address space via the VMM PML4 walker and purge the PROCESS_TABLE.
+///      address space via the VMM PML4 walker and purge the process table
+///      (after an RCU grace period, so lock-free readers are done with it).
 ///   3. Drop the `Box<Thread>` (frees the TCB heap allocation).
 pub extern "C" fn reaper_entry(_arg: u64) {
     loop {
@@ -350,9 +1037,15 @@ pub extern "C" fn reaper_entry(_arg: u64) {
             continue;
         }
 
-        let dead = guard.pop().unwrap();
+        let dead = guard.pop_front().unwrap();
         drop(guard);
 
+        // A thread that died on another core is still on its stack until
+        // that core's next thread has finished switching in.
+        while dead.on_cpu.load(Ordering::Acquire) {
+            core::hint::spin_loop();
+        }
+
         let tid = dead.id;
         let name = dead.name_str();
 
@@ -392,6 +1085,10 @@ pub extern "C" fn reaper_entry(_arg: u64) {
 
             // Remove from PROCESS_TABLE and take ownership back.
             if let Some(ptr) = crate::sched::process::unregister_process(pid) {
+                // Lock-free lookups on other cores may still hold `ptr`.
+                // Wait out a grace period before tearing anything down.
+                crate::sync::rcu::synchronize();
+
                 // Destroy the entire lower-half address space.
                 let pml4 = crate::memory::address::PhysAddr::new(pml4_phys_val);
                 let (user_pages, table_pages) = unsafe {
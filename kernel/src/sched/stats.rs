@@ -0,0 +1,470 @@
+// =============================================================================
+// MinimalOS NextGen — Per-Thread CPU Accounting
+// =============================================================================
+//
+// TSC-based counters for every live thread, so userspace can answer "who is
+// eating the CPU?" (SYS_THREAD_STATS, init's `top` dump).
+//
+// WHERE THE COUNTERS LIVE:
+//   Not in the TCB. A `Box<Thread>` migrates between run queues, endpoints
+//   and the dead queue, and may be freed by the reaper at any moment — a
+//   snapshot walking TCBs would race with all of them. Instead every thread
+//   claims one slot of a static table at creation and releases it when its
+//   TCB is dropped. The TCB only holds a pointer to its slot.
+//
+//   ```text
+//   Thread.stats ──► STATS[i] { tid, pid, name, run_tsc, wait_tsc, ... }
+//                         ▲
+//   SYS_THREAD_STATS ─────┘  (walks all MAX_TRACKED slots, lock-free)
+//   ```
+//
+// UPDATE POINTS (all on the CPU that holds the thread, IF=0):
+//   scheduler::enqueue_on,
+//   RunQueue::push_ready → state = Ready, ready_since = now (before the
+//                         inbox, so wait_tsc includes the IPI and drain)
+//   scheduler::schedule → prev: run_tsc += now - on_cpu_since,
+//                               preemptions++ or blocks++
+//                         next: wait_tsc += now - ready_since,
+//                               dispatches++, on_cpu_since = now
+//   syscall_dispatch    → syscalls++, sys_tsc covers time inside the kernel
+//                         (blocked time in a syscall is excluded)
+//   Endpoint::send/recv → ipc_sends++ / ipc_recvs++
+//
+//   Each field has a single writer at a time (whoever holds the thread), so
+//   plain Relaxed load/store pairs suffice — no locked RMW on the hot path.
+//   Readers may see a row mid-update; the counters are monotonic, so a
+//   snapshot is at worst one event stale.
+//
+// Threads created when the table is full run untracked (null slot).
+// Exited threads drop out of the table; their CPU time is not retained.
+//
+// PER-CORE HISTOGRAMS:
+//   Alongside the per-thread rows, every core keeps log2 histograms (bucket
+//   b counts values in [2^(b-1), 2^b), bucket 0 counts zeros) of:
+//     wakeup   — Ready→Running latency of threads woken from an IPC block
+//     queued   — Ready→Running latency of preempted or newly spawned threads
+//     slice    — TSC cycles a thread actually ran before switching out
+//     rq_depth — run-queue length at every `schedule()` entry
+//   Only the owning core writes its histograms. SYS_SCHED_HIST copies them
+//   out; diff two copies to compare scheduler changes under load.
+//
+//   Next to them each core counts the wakeups it performed by where the
+//   woken thread went (`scheduler::wake_core`): back to the core it last
+//   ran on (cache-hot), pulled next to its IPC partner, or migrated.
+//
+// =============================================================================
+
+use core::ptr;
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use crate::arch::cpu;
+use crate::arch::x86_64::gdt::MAX_CPUS;
+use crate::sched::percpu::CpuLocal;
+use crate::sched::scheduler::WakePlacement;
+use crate::sched::thread::{Thread, ThreadState};
+
+/// Number of threads that can be tracked at once.
+pub const MAX_TRACKED: usize = 256;
+
+/// Live counters of one thread. Slot is free while `tid == FREE`.
+pub struct ThreadStats {
+    tid: AtomicU64,
+    pid: AtomicU64,
+    /// First 16 bytes of the thread name, little-endian packed.
+    name: [AtomicU64; 2],
+    state: AtomicU64,
+
+    run_tsc: AtomicU64,
+    sys_tsc: AtomicU64,
+    wait_tsc: AtomicU64,
+    dispatches: AtomicU64,
+    preemptions: AtomicU64,
+    blocks: AtomicU64,
+    syscalls: AtomicU64,
+    ipc_sends: AtomicU64,
+    ipc_recvs: AtomicU64,
+
+    /// TSC when the thread last got the CPU.
+    on_cpu_since: AtomicU64,
+    /// TSC when the thread last became Ready (0 = not queued).
+    ready_since: AtomicU64,
+    /// 1 if the pending Ready period is a wakeup from an IPC block.
+    woken: AtomicU64,
+    /// TSC when the current syscall (or its last resumption) began; 0 = in Ring 3.
+    sys_since: AtomicU64,
+}
+
+/// `tid` value of an unused slot (TID 0 is bsp-main, so use MAX).
+const FREE: u64 = u64::MAX;
+
+/// Claim in progress — keeps other claimers off while fields are reset.
+const CLAIMING: u64 = u64::MAX - 1;
+
+impl ThreadStats {
+    const fn new() -> Self {
+        Self {
+            tid: AtomicU64::new(FREE),
+            pid: AtomicU64::new(0),
+            name: [AtomicU64::new(0), AtomicU64::new(0)],
+            state: AtomicU64::new(0),
+            run_tsc: AtomicU64::new(0),
+            sys_tsc: AtomicU64::new(0),
+            wait_tsc: AtomicU64::new(0),
+            dispatches: AtomicU64::new(0),
+            preemptions: AtomicU64::new(0),
+            blocks: AtomicU64::new(0),
+            syscalls: AtomicU64::new(0),
+            ipc_sends: AtomicU64::new(0),
+            ipc_recvs: AtomicU64::new(0),
+            on_cpu_since: AtomicU64::new(0),
+            ready_since: AtomicU64::new(0),
+            woken: AtomicU64::new(0),
+            sys_since: AtomicU64::new(0),
+        }
+    }
+}
+
+/// The global stats table.
+static STATS: [ThreadStats; MAX_TRACKED] = [const { ThreadStats::new() }; MAX_TRACKED];
+
+/// Adds `delta` to a single-writer counter.
+#[inline(always)]
+fn bump(counter: &AtomicU64, delta: u64) {
+    counter.store(counter.load(Ordering::Relaxed).wrapping_add(delta), Ordering::Relaxed);
+}
+
+// =============================================================================
+// Slot lifetime
+// =============================================================================
+
+/// Claims a stats slot for a new thread.
+///
+/// # Returns
+/// The slot pointer to store in `Thread.stats`, or null if the table is full.
+pub fn claim(tid: u64, pid: u64, name: &[u8]) -> *const ThreadStats {
+    for slot in STATS.iter() {
+        if slot.tid.compare_exchange(FREE, CLAIMING, Ordering::Acquire, Ordering::Relaxed).is_err() {
+            continue;
+        }
+
+        let mut packed = [0u8; 16];
+        let n = name.len().min(16);
+        packed[..n].copy_from_slice(&name[..n]);
+        slot.name[0].store(u64::from_le_bytes(packed[..8].try_into().unwrap()), Ordering::Relaxed);
+        slot.name[1].store(u64::from_le_bytes(packed[8..].try_into().unwrap()), Ordering::Relaxed);
+        slot.pid.store(pid, Ordering::Relaxed);
+        slot.state.store(ThreadState::Ready as u64, Ordering::Relaxed);
+        for c in [&slot.run_tsc, &slot.sys_tsc, &slot.wait_tsc, &slot.dispatches,
+                  &slot.preemptions, &slot.blocks, &slot.syscalls,
+                  &slot.ipc_sends, &slot.ipc_recvs, &slot.ready_since, &slot.woken,
+                  &slot.sys_since] {
+            c.store(0, Ordering::Relaxed);
+        }
+        slot.on_cpu_since.store(cpu::read_tsc(), Ordering::Relaxed);
+
+        // Release: the reset row is visible before the TID publishes it.
+        slot.tid.store(tid, Ordering::Release);
+        return slot;
+    }
+    ptr::null()
+}
+
+/// Returns a slot to the table. Called from `Thread::drop`.
+pub fn release(stats: *const ThreadStats) {
+    if let Some(slot) = unsafe { stats.as_ref() } {
+        slot.tid.store(FREE, Ordering::Release);
+    }
+}
+
+// =============================================================================
+// Hot-path hooks
+// =============================================================================
+
+/// Thread became runnable: it is about to enter an inbox or run queue.
+#[inline]
+pub fn on_ready(thread: &Thread) {
+    if let Some(s) = unsafe { thread.stats.as_ref() } {
+        let prev = s.state.load(Ordering::Relaxed);
+        s.state.store(ThreadState::Ready as u64, Ordering::Relaxed);
+        let woken = prev == ThreadState::BlockedSend as u64
+            || prev == ThreadState::BlockedRecv as u64
+            || prev == ThreadState::BlockedWait as u64;
+        s.woken.store(woken as u64, Ordering::Relaxed);
+        s.ready_since.store(cpu::read_tsc(), Ordering::Relaxed);
+    }
+}
+
+/// Context switch from `prev` (leaving in `prev_state`) to `next`.
+///
+/// # Safety
+/// `prev` may be null; both must otherwise be live TCBs.
+#[inline]
+pub unsafe fn on_switch(prev: *const Thread, prev_state: ThreadState, next: *const Thread) {
+    let now = cpu::read_tsc();
+    let hist = core_hist();
+
+    if let Some(s) = unsafe { prev.as_ref().and_then(|t| t.stats.as_ref()) } {
+        let slice = now.wrapping_sub(s.on_cpu_since.load(Ordering::Relaxed));
+        bump(&s.run_tsc, slice);
+        record(&hist.slice, slice);
+        let sys = s.sys_since.load(Ordering::Relaxed);
+        if sys != 0 {
+            bump(&s.sys_tsc, now.wrapping_sub(sys));
+        }
+        match prev_state {
+            ThreadState::Running | ThreadState::Ready => bump(&s.preemptions, 1),
+            _ => bump(&s.blocks, 1),
+        }
+        if prev_state != ThreadState::Running {
+            s.state.store(prev_state as u64, Ordering::Relaxed);
+        }
+    }
+
+    if let Some(s) = unsafe { next.as_ref().and_then(|t| t.stats.as_ref()) } {
+        let ready = s.ready_since.load(Ordering::Relaxed);
+        if ready != 0 {
+            let latency = now.wrapping_sub(ready);
+            bump(&s.wait_tsc, latency);
+            s.ready_since.store(0, Ordering::Relaxed);
+            if s.woken.load(Ordering::Relaxed) != 0 {
+                record(&hist.wakeup, latency);
+            } else {
+                record(&hist.queued, latency);
+            }
+        }
+        if s.sys_since.load(Ordering::Relaxed) != 0 {
+            s.sys_since.store(now, Ordering::Relaxed);
+        }
+        bump(&s.dispatches, 1);
+        s.on_cpu_since.store(now, Ordering::Relaxed);
+        s.state.store(ThreadState::Running as u64, Ordering::Relaxed);
+    }
+}
+
+/// This core woke a thread and placed it per `placement`.
+#[inline]
+pub fn on_wake(placement: WakePlacement) {
+    let hist = core_hist();
+    bump(match placement {
+        WakePlacement::CacheHot => &hist.wake_hot,
+        WakePlacement::Pulled => &hist.wake_pulled,
+        WakePlacement::Migrated => &hist.wake_migrated,
+    }, 1);
+}
+
+/// `schedule()` entered with `depth` threads in this core's run queue.
+#[inline]
+pub fn on_schedule(depth: usize) {
+    record(&core_hist().rq_depth, depth as u64);
+}
+
+/// Stats slot of the thread running on this core.
+#[inline(always)]
+fn current() -> Option<&'static ThreadStats> {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = cpu_local.current_thread;
+    if thread.is_null() {
+        return None;
+    }
+    unsafe { (*thread).stats.as_ref() }
+}
+
+/// Syscall entry on the current thread.
+#[inline]
+pub fn syscall_enter() {
+    if let Some(s) = current() {
+        bump(&s.syscalls, 1);
+        s.sys_since.store(cpu::read_tsc(), Ordering::Relaxed);
+    }
+}
+
+/// Syscall exit on the current thread.
+#[inline]
+pub fn syscall_exit() {
+    if let Some(s) = current() {
+        let since = s.sys_since.load(Ordering::Relaxed);
+        if since != 0 {
+            bump(&s.sys_tsc, cpu::read_tsc().wrapping_sub(since));
+            s.sys_since.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Current thread is sending an IPC message.
+#[inline]
+pub fn on_ipc_send() {
+    if let Some(s) = current() {
+        bump(&s.ipc_sends, 1);
+    }
+}
+
+/// Current thread is receiving an IPC message.
+#[inline]
+pub fn on_ipc_recv() {
+    if let Some(s) = current() {
+        bump(&s.ipc_recvs, 1);
+    }
+}
+
+// =============================================================================
+// Snapshot (SYS_THREAD_STATS)
+// =============================================================================
+
+/// One row of a stats snapshot, as copied to userspace.
+///
+/// Layout is ABI — mirrored by `libmnos::sched::ThreadStat`.
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct ThreadStatRecord {
+    pub tid: u64,
+    pub pid: u64,
+    pub name: [u8; 16],
+    /// `ThreadState` discriminant.
+    pub state: u64,
+    /// TSC cycles on a CPU (user + kernel), including the current slice.
+    pub run_tsc: u64,
+    /// Portion of `run_tsc` spent inside syscalls.
+    pub sys_tsc: u64,
+    /// TSC cycles spent Ready but not running (run-queue latency).
+    pub wait_tsc: u64,
+    pub dispatches: u64,
+    pub preemptions: u64,
+    /// Voluntary switches (blocked in IPC or exited).
+    pub blocks: u64,
+    pub syscalls: u64,
+    pub ipc_sends: u64,
+    pub ipc_recvs: u64,
+}
+
+/// Calls `f` with a record for every tracked thread.
+///
+/// The running thread's open time slice is folded into `run_tsc` so a
+/// thread that is never preempted still shows up as busy.
+pub fn for_each(mut f: impl FnMut(&ThreadStatRecord)) {
+    let now = cpu::read_tsc();
+    for slot in STATS.iter() {
+        let tid = slot.tid.load(Ordering::Acquire);
+        if tid == FREE || tid == CLAIMING {
+            continue;
+        }
+        let state = slot.state.load(Ordering::Relaxed);
+        let mut run = slot.run_tsc.load(Ordering::Relaxed);
+        if state == ThreadState::Running as u64 {
+            run = run.wrapping_add(now.wrapping_sub(slot.on_cpu_since.load(Ordering::Relaxed)));
+        }
+        let mut name = [0u8; 16];
+        name[..8].copy_from_slice(&slot.name[0].load(Ordering::Relaxed).to_le_bytes());
+        name[8..].copy_from_slice(&slot.name[1].load(Ordering::Relaxed).to_le_bytes());
+
+        f(&ThreadStatRecord {
+            tid,
+            pid: slot.pid.load(Ordering::Relaxed),
+            name,
+            state,
+            run_tsc: run,
+            sys_tsc: slot.sys_tsc.load(Ordering::Relaxed),
+            wait_tsc: slot.wait_tsc.load(Ordering::Relaxed),
+            dispatches: slot.dispatches.load(Ordering::Relaxed),
+            preemptions: slot.preemptions.load(Ordering::Relaxed),
+            blocks: slot.blocks.load(Ordering::Relaxed),
+            syscalls: slot.syscalls.load(Ordering::Relaxed),
+            ipc_sends: slot.ipc_sends.load(Ordering::Relaxed),
+            ipc_recvs: slot.ipc_recvs.load(Ordering::Relaxed),
+        });
+    }
+}
+
+// =============================================================================
+// Per-core histograms (SYS_SCHED_HIST)
+// =============================================================================
+
+/// Buckets per histogram: bucket 0 = 0, bucket b = [2^(b-1), 2^b).
+pub const HIST_BUCKETS: usize = 64;
+
+/// Scheduler histograms of one core. Written only by that core.
+struct CoreHist {
+    wakeup: [AtomicU64; HIST_BUCKETS],
+    queued: [AtomicU64; HIST_BUCKETS],
+    slice: [AtomicU64; HIST_BUCKETS],
+    rq_depth: [AtomicU64; HIST_BUCKETS],
+    wake_hot: AtomicU64,
+    wake_pulled: AtomicU64,
+    wake_migrated: AtomicU64,
+}
+
+impl CoreHist {
+    const fn new() -> Self {
+        Self {
+            wakeup: [const { AtomicU64::new(0) }; HIST_BUCKETS],
+            queued: [const { AtomicU64::new(0) }; HIST_BUCKETS],
+            slice: [const { AtomicU64::new(0) }; HIST_BUCKETS],
+            rq_depth: [const { AtomicU64::new(0) }; HIST_BUCKETS],
+            wake_hot: AtomicU64::new(0),
+            wake_pulled: AtomicU64::new(0),
+            wake_migrated: AtomicU64::new(0),
+        }
+    }
+}
+
+static CORE_HIST: [CoreHist; MAX_CPUS] = [const { CoreHist::new() }; MAX_CPUS];
+
+/// Histograms of the calling core.
+#[inline(always)]
+fn core_hist() -> &'static CoreHist {
+    let core = unsafe { CpuLocal::get() }.core_index as usize;
+    &CORE_HIST[core.min(MAX_CPUS - 1)]
+}
+
+/// Counts `value` in its log2 bucket.
+#[inline(always)]
+fn record(hist: &[AtomicU64; HIST_BUCKETS], value: u64) {
+    let bucket = (u64::BITS - value.leading_zeros()) as usize;
+    bump(&hist[bucket.min(HIST_BUCKETS - 1)], 1);
+}
+
+/// Histograms of one core, as copied to userspace.
+///
+/// Layout is ABI — mirrored by `libmnos::sched::SchedHist`.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct SchedHistRecord {
+    pub core: u64,
+    /// Wakeup (IPC unblock) → run latency, TSC cycles.
+    pub wakeup: [u64; HIST_BUCKETS],
+    /// Preempted/new thread Ready → run latency, TSC cycles.
+    pub queued: [u64; HIST_BUCKETS],
+    /// Time slice actually used, TSC cycles.
+    pub slice: [u64; HIST_BUCKETS],
+    /// Run-queue depth at `schedule()` entry.
+    pub rq_depth: [u64; HIST_BUCKETS],
+    /// Wakeups by this core that went back to the wakee's last core.
+    pub wake_hot: u64,
+    /// Wakeups that pulled the wakee onto this core, next to its IPC partner.
+    pub wake_pulled: u64,
+    /// Wakeups that moved the wakee to some other core.
+    pub wake_migrated: u64,
+}
+
+/// Calls `f` with the histograms of every core that has scheduled at least
+/// once.
+pub fn for_each_core_hist(mut f: impl FnMut(&SchedHistRecord)) {
+    let copy = |h: &[AtomicU64; HIST_BUCKETS]| -> [u64; HIST_BUCKETS] {
+        core::array::from_fn(|i| h[i].load(Ordering::Relaxed))
+    };
+    for (core, h) in CORE_HIST.iter().enumerate() {
+        let rq_depth = copy(&h.rq_depth);
+        if rq_depth.iter().all(|&n| n == 0) {
+            continue;
+        }
+        f(&SchedHistRecord {
+            core: core as u64,
+            wakeup: copy(&h.wakeup),
+            queued: copy(&h.queued),
+            slice: copy(&h.slice),
+            rq_depth,
+            wake_hot: h.wake_hot.load(Ordering::Relaxed),
+            wake_pulled: h.wake_pulled.load(Ordering::Relaxed),
+            wake_migrated: h.wake_migrated.load(Ordering::Relaxed),
+        });
+    }
+}
@@ -22,9 +22,11 @@ use crate::kprintln;
 use crate::memory::address::PAGE_SIZE;
 use crate::memory::pmm;
 use crate::sched::percpu::CpuLocal;
+use crate::sched::queue::QueueLink;
 use crate::sched::scheduler;
+use crate::sched::stats::{self, ThreadStats};
 
-use core::sync::atomic::{AtomicU64, Ordering};
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
 
 use super::process::Process;
 
@@ -49,6 +51,10 @@ pub enum ThreadState {
     BlockedRecv,
     /// Terminated, waiting for cleanup.
     Dead,
+    /// Sleeping on a futex word (sync::futex). Ownership of the
+    /// Box<Thread> is held by the futex bucket. Declared last so the
+    /// states above keep the values SYS_THREAD_STATS reports.
+    BlockedWait,
 }
 
 /// Thread Control Block — the kernel's representation of a thread.
@@ -99,8 +105,61 @@ pub struct Thread {
     /// User-space stack pointer (top of allocated user stack).
     /// Used by the ring3_entry trampoline to build the iretq frame.
     pub user_rsp: u64,
+
+    /// Saved performance counter state (see `arch::pmu`). `None` until the
+    /// thread programs a counter via SYS_PMU_CONFIG; threads that never do
+    /// skip the PMU save/restore on context switch.
+    pub pmu: Option<Box<crate::arch::pmu::PmuState>>,
+
+    /// CPU accounting slot (see `sched::stats`). Null if the stats table
+    /// was full when the thread was created.
+    pub stats: *const ThreadStats,
+
+    /// True while a core is executing on this thread's kernel stack: from
+    /// the switch *to* it until the next thread on that core has finished
+    /// switching away from it (`scheduler::finish_switch`).
+    ///
+    /// A thread woken on another core may already sit in that core's run
+    /// queue while its old core is still saving its registers; the new
+    /// core waits for this flag before loading `rsp`. The reaper waits for
+    /// it before freeing the stack of a thread that died on another core.
+    pub on_cpu: AtomicBool,
+
+    /// Hooks for the one ThreadQueue (run queue, inbox, endpoint, futex
+    /// bucket, dead queue) this thread is waiting in, if any.
+    pub link: QueueLink,
+
+    /// Futex key while BlockedWait: the sleeper's address space (PML4
+    /// physical address) and the user address of the word.
+    pub futex_space: u64,
+    pub futex_addr: u64,
+
+    /// Core index this thread last ran on (`NO_CPU` before its first run).
+    /// Wakeups prefer it while its caches may still hold the thread's data.
+    pub last_cpu: u32,
+
+    /// TID of the thread whose IPC last woke this one (`NO_TID` if none).
+    /// Two threads that keep waking each other are IPC partners.
+    pub ipc_waker: u64,
+
+    /// Core this thread is pinned to (`NO_CPU` = any). Placement, wakeups
+    /// and preemption all keep a pinned thread on its core.
+    pub affinity: u32,
+
+    /// Own and effective scheduling context, and the IPC caller donating
+    /// the latter (see ipc::endpoint). The scheduler applies
+    /// `sched.effective`.
+    pub sched: SchedState,
 }
 
+/// `Thread::last_cpu` of a thread that has never run.
+pub const NO_CPU: u32 = u32::MAX;
+
+// Scheduling contexts and the donation bookkeeping are pure data and live
+// in `kcore::sched` (host-testable). `NO_TID` is also `Thread::ipc_waker`
+// of a thread no IPC has woken yet.
+pub use kcore::sched::{SchedContext, SchedState, NO_TID, NUM_PRIORITIES};
+
 // SAFETY: Thread contains a `*mut Process` raw pointer which is not inherently
 // `Send`. We guarantee safety because:
 //   1. Process objects are heap-allocated and leaked (`Box::into_raw`) — they
@@ -170,6 +229,8 @@ impl Thread {
         let copy_len = name_bytes.len().min(32);
         name_buf[..copy_len].copy_from_slice(&name_bytes[..copy_len]);
 
+        let pid = if process.is_null() { 0 } else { unsafe { (*process).pid } };
+
         let thread = Box::new(Thread {
             id: tid,
             state: ThreadState::Ready,
@@ -182,6 +243,16 @@ impl Thread {
             ipc_buffer: IpcMessage::EMPTY,
             user_rip: 0,
             user_rsp: 0,
+            pmu: None,
+            stats: stats::claim(tid, pid, &name_buf[..copy_len]),
+            on_cpu: AtomicBool::new(false),
+            link: QueueLink::new(),
+            futex_space: 0,
+            futex_addr: 0,
+            last_cpu: NO_CPU,
+            ipc_waker: NO_TID,
+            affinity: NO_CPU,
+            sched: SchedState::DEFAULT,
         });
 
         kprintln!("[thread] Created thread {} '{}' (stack={:#018X}—{:#018X}, rsp={:#018X})",
@@ -196,6 +267,13 @@ impl Thread {
     }
 }
 
+impl Drop for Thread {
+    /// Returns the accounting slot when the TCB is freed (reaper, bench).
+    fn drop(&mut self) {
+        stats::release(self.stats);
+    }
+}
+
 /// Called when a thread's entry function returns.
 /// Marks the thread as Dead and yields to the scheduler.
 ///
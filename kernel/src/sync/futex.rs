@@ -0,0 +1,137 @@
+// =============================================================================
+// MinimalOS NextGen — Futex (Wait on a User Address)
+// =============================================================================
+//
+// The kernel half of userspace blocking locks. A user lock word is plain
+// memory; the kernel only keeps sleeping threads, keyed by the word's
+// address:
+//
+//   wait(addr, expected):  if *addr == expected → sleep until woken
+//                          else                 → return at once
+//   wake(addr, n):         wake up to n threads sleeping on addr
+//
+// KEYS:
+//   A key is (address space, user virtual address). The address space is
+//   the caller's PML4 physical address, so threads of one process meet on
+//   the same word and unrelated processes never collide even at equal
+//   addresses.
+//
+// BUCKETS:
+//   Keys hash into FUTEX_BUCKETS queues, each under its own spinlock.
+//   A queue holds the sleepers' Box<Thread> (the same ownership model as
+//   Endpoint queues): while a thread sleeps here, its bucket owns it.
+//   The key is stored in the Thread itself (futex_space / futex_addr) and
+//   the bucket is an intrusive ThreadQueue, so wake() unlinks matching
+//   sleepers in place and sleeping never allocates.
+//
+// NO LOST WAKEUPS:
+//   wait() reads the word and enqueues the caller under the bucket lock.
+//   A waker changes the word *before* calling wake(), which takes the same
+//   lock. Either the waiter saw the new value and never slept, or it was
+//   already queued when wake() looked.
+//
+// Woken threads go through `scheduler::wake`, i.e. to the least-loaded
+// core — a lock handed over between cores does not pull every waiter onto
+// the releasing core.
+//
+// =============================================================================
+
+extern crate alloc;
+
+use alloc::boxed::Box;
+use core::sync::atomic::{AtomicU32, Ordering};
+
+use crate::memory::address::VirtAddr;
+use crate::memory::vmm;
+use crate::sched::percpu::CpuLocal;
+use crate::sched::queue::ThreadQueue;
+use crate::sched::thread::ThreadState;
+use crate::sync::spinlock::SpinLock;
+
+/// Number of wait queues keys hash into.
+const FUTEX_BUCKETS: usize = 64;
+
+/// The wait queues, FIFO per bucket. Sleepers carry their own key.
+static BUCKETS: [SpinLock<ThreadQueue>; FUTEX_BUCKETS] =
+    [const { SpinLock::new(ThreadQueue::new()) }; FUTEX_BUCKETS];
+
+/// Why `wait` returned without sleeping.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum WaitError {
+    /// Unaligned, kernel-half or unmapped address.
+    BadAddress,
+    /// The word no longer held `expected`.
+    ValueChanged,
+}
+
+/// Picks the bucket for a key (Fibonacci hashing of the word index).
+#[inline]
+fn bucket(space: u64, addr: u64) -> usize {
+    let h = (space ^ (addr >> 2)).wrapping_mul(0x9E37_79B9_7F4A_7C15);
+    (h >> 58) as usize % FUTEX_BUCKETS
+}
+
+/// The calling thread's address-space key.
+#[inline]
+fn current_space() -> u64 {
+    let cpu_local = unsafe { CpuLocal::get() };
+    let thread = unsafe { &*cpu_local.current_thread };
+    unsafe { (*thread.process).pml4().as_u64() }
+}
+
+/// The kernel alias of the caller's 32-bit word at `addr`.
+fn user_word(addr: u64) -> Option<&'static AtomicU32> {
+    if addr % 4 != 0 {
+        return None;
+    }
+    // An aligned u32 never straddles a page, so one translation covers it.
+    let phys = vmm::translate_user(vmm::active_pml4(), VirtAddr::new(addr), false)?;
+    Some(unsafe { &*phys.to_virt().as_ptr::<AtomicU32>() })
+}
+
+/// Sleeps until woken if the word at `addr` still holds `expected`.
+///
+/// # Safety
+/// Must be called from a syscall with IF=0, as the current thread.
+pub unsafe fn wait(addr: u64, expected: u32) -> Result<(), WaitError> {
+    if addr >= 0x0000_8000_0000_0000 {
+        return Err(WaitError::BadAddress);
+    }
+    let word = user_word(addr).ok_or(WaitError::BadAddress)?;
+    let space = current_space();
+
+    let mut queue = BUCKETS[bucket(space, addr)].lock();
+    if word.load(Ordering::SeqCst) != expected {
+        return Err(WaitError::ValueChanged);
+    }
+
+    // Hand the TCB to the bucket (see Endpoint for the ownership model).
+    let cpu_local = unsafe { CpuLocal::get_mut() };
+    let mut current_box = unsafe { Box::from_raw(cpu_local.current_thread) };
+    current_box.state = ThreadState::BlockedWait;
+    current_box.futex_space = space;
+    current_box.futex_addr = addr;
+    queue.push_back(current_box);
+    drop(queue);
+
+    // Resumes here after wake() (IF is still 0 from the syscall entry).
+    unsafe { crate::sched::scheduler::schedule(); }
+    unsafe { core::arch::asm!("sti", options(nomem, nostack)); }
+    Ok(())
+}
+
+/// Wakes up to `count` threads sleeping on `addr` in the caller's address
+/// space, oldest first.
+///
+/// # Returns
+/// The number of threads woken.
+pub fn wake(addr: u64, count: u64) -> u64 {
+    let space = current_space();
+    let mut queue = BUCKETS[bucket(space, addr)].lock();
+
+    queue.remove_matching(
+        count,
+        |t| t.futex_space == space && t.futex_addr == addr,
+        crate::sched::scheduler::wake,
+    )
+}
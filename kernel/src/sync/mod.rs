@@ -9,10 +9,10 @@
 //
 // IMPORTANT: Lock ordering rules (see architecture doc):
 //   Level 1 (innermost): PMM bitmap lock
-//   Level 2: Page table lock
-//   Level 3: IPC endpoint locks
-//   Level 4: Capability table lock
-//   Level 5: Process table lock
+//   Level 2: Page table lock (Process::vm_lock)
+//   Level 3: IPC endpoint locks, futex bucket locks
+//   Level 4: Capability table lock (Process::cnode)
+//   Level 5: Process table lock (writers only — readers use sync::rcu)
 //   Level 6 (outermost): Scheduler run queue lock
 //
 // NEVER acquire a lower-level lock while holding a higher-level lock.
@@ -20,4 +20,6 @@
 // =============================================================================
 
 pub mod spinlock;
+pub mod rcu;
+pub mod futex;
 
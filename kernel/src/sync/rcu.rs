@@ -0,0 +1,120 @@
+// =============================================================================
+// MinimalOS NextGen — Epoch-Based Read-Copy-Update (RCU)
+// =============================================================================
+//
+// RCU lets readers traverse a shared structure WITHOUT taking a lock, while
+// writers publish/unpublish pointers atomically and defer freeing the old
+// object until every reader that could still hold it has finished.
+//
+// HOW IT WORKS (epoch-based reclamation):
+//   - A global epoch counter `GLOBAL_EPOCH` only ever increases.
+//   - Each core owns one slot in `CPU_EPOCH`. 0 means "quiescent" (not
+//     inside a read-side critical section). Non-zero means "reading since
+//     epoch N".
+//   - `read_lock()` pins the core: copy the global epoch into our slot,
+//     then a full fence so the pin is visible before any pointer load.
+//   - Dropping the guard unpins the core (slot = 0).
+//   - `synchronize()` (writer side) bumps the global epoch to E and spins
+//     until every core is either quiescent or pinned at an epoch >= E.
+//     Readers pinned at >= E started after the writer's unpublish, so they
+//     cannot have seen the removed pointer.
+//
+//   ```text
+//   Writer:   unpublish(ptr) ──► synchronize() ──► free(ptr)
+//                                  │ wait for ▼
+//   Core 1:   [pin@E-1 ... load ptr ... unpin]
+//   Core 2:               [pin@E ... load → null ... unpin]   (not waited on)
+//   ```
+//
+// READ-SIDE RULES:
+//   - Critical sections must be short and must NOT block or call schedule().
+//     Syscall handlers satisfy this: SYSCALL masks IF (FMASK), so a handler
+//     runs to completion on the core that pinned.
+//   - Nesting is allowed; only the outermost guard pins/unpins.
+//   - `synchronize()` may spin for a whole read-side section on every core,
+//     so it is only called from the reaper daemon, never from hot paths.
+//
+// WHY NOT A READER-WRITER LOCK?
+//   A RW lock still bounces its cache line between every reader core. On the
+//   N3710 (4 cores, shared L2) each syscall that names a process would pay a
+//   cross-core atomic RMW. Here a reader only writes its OWN slot.
+//
+// =============================================================================
+
+use core::sync::atomic::{fence, AtomicU32, AtomicU64, Ordering};
+
+use crate::arch::gdt::MAX_CPUS;
+use crate::sched::percpu::CpuLocal;
+
+/// Global grace-period epoch. Starts at 1 so that 0 can mean "quiescent".
+static GLOBAL_EPOCH: AtomicU64 = AtomicU64::new(1);
+
+/// Per-core pinned epoch (0 = quiescent). Indexed by `CpuLocal.core_index`.
+static CPU_EPOCH: [AtomicU64; MAX_CPUS] = [const { AtomicU64::new(0) }; MAX_CPUS];
+
+/// Per-core read-side nesting depth. Only ever touched by its own core.
+static CPU_NESTING: [AtomicU32; MAX_CPUS] = [const { AtomicU32::new(0) }; MAX_CPUS];
+
+/// RAII guard for an RCU read-side critical section.
+///
+/// Pointers obtained from an RCU-protected structure remain valid until
+/// this guard is dropped. Do not block while holding it.
+pub struct RcuReadGuard {
+    /// Core that pinned itself — read-side sections never migrate.
+    core: usize,
+}
+
+/// Enters an RCU read-side critical section on the current core.
+///
+/// # Panics
+/// Must be called after `CpuLocal` has been installed on this core.
+#[inline]
+pub fn read_lock() -> RcuReadGuard {
+    // SAFETY: CpuLocal is installed on every core before any syscall or
+    // kernel thread can run.
+    let core = unsafe { CpuLocal::get().core_index } as usize;
+
+    if CPU_NESTING[core].fetch_add(1, Ordering::Relaxed) == 0 {
+        let epoch = GLOBAL_EPOCH.load(Ordering::Acquire);
+        CPU_EPOCH[core].store(epoch, Ordering::Relaxed);
+        // Full fence: the pin must be globally visible before we load any
+        // RCU-protected pointer, otherwise synchronize() could miss us.
+        fence(Ordering::SeqCst);
+    }
+
+    RcuReadGuard { core }
+}
+
+impl Drop for RcuReadGuard {
+    fn drop(&mut self) {
+        if CPU_NESTING[self.core].fetch_sub(1, Ordering::Relaxed) == 1 {
+            // Release: all our reads of the protected object happen-before
+            // the writer observing us as quiescent and freeing it.
+            CPU_EPOCH[self.core].store(0, Ordering::Release);
+        }
+    }
+}
+
+/// Waits for a full grace period.
+///
+/// On return, every read-side critical section that was in progress when
+/// this function was called has completed. Objects unpublished BEFORE the
+/// call may then be freed safely.
+///
+/// Must not be called from inside a read-side critical section (it would
+/// wait for itself forever).
+pub fn synchronize() {
+    // Order the caller's unpublish store before the epoch bump.
+    fence(Ordering::SeqCst);
+    let target = GLOBAL_EPOCH.fetch_add(1, Ordering::SeqCst) + 1;
+
+    for slot in CPU_EPOCH.iter() {
+        loop {
+            let pinned = slot.load(Ordering::Acquire);
+            if pinned == 0 || pinned >= target {
+                break;
+            }
+            core::hint::spin_loop();
+        }
+    }
+}
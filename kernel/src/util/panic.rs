@@ -65,6 +65,9 @@ fn panic(info: &PanicInfo) -> ! {
     // at least the serial FIFO should have flushed some partial output.
     // A future improvement could write directly to the serial port without
     // the lock.
+    // Interrupt-driven serial would leave this report in the TX ring.
+    crate::arch::serial::set_polled();
+
     kprintln!();
     kprintln!("==========================================================");
     kprintln!("  KERNEL PANIC — MinimalOS NextGen");
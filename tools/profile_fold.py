@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# =============================================================================
+# MinimalOS NextGen — Profiler Sample Folder
+# =============================================================================
+#
+# Turns the `@prof` lines dumped by the kernel's sampling profiler
+# (kernel/src/profile.rs, `make profile`) into folded stacks:
+#
+#     init;main;print_str;sys_port_out 12
+#     [kernel];irq_dispatch;schedule 3
+#
+# which is the input format of flamegraph.pl, inferno and speedscope.
+#
+# Sample line format (addresses in hex, innermost first):
+#     @prof <cpu> <pid> <tid> <cpl> <rip> [<ret> ...]
+#
+# Symbols come from `nm` on the ELFs given on the command line. Kernel
+# addresses (CPL 0) resolve against --kernel. User addresses (CPL 3)
+# resolve against the --user ELF registered for that PID, or against the
+# first PID-less --user ELF whose symbol range contains the address.
+#
+# Usage:
+#     tools/profile_fold.py --kernel KERNEL_ELF \
+#         [--user PID:ELF | --user ELF ...] [--by-cpu] serial.log
+#
+# =============================================================================
+
+import argparse
+import bisect
+import collections
+import os
+import shutil
+import subprocess
+import sys
+
+
+class SymbolTable:
+    """Sorted function symbols of one ELF, looked up by address."""
+
+    def __init__(self, path):
+        self.name = os.path.basename(path)
+        self.addrs = []
+        self.names = []
+        nm = shutil.which("llvm-nm") or shutil.which("nm")
+        if nm is None:
+            sys.exit("profile_fold: need llvm-nm or nm in PATH")
+        out = subprocess.run(
+            [nm, "-n", "-C", "--defined-only", path],
+            check=True, capture_output=True, text=True,
+        ).stdout
+        for line in out.splitlines():
+            parts = line.split(None, 2)
+            if len(parts) != 3 or parts[1] not in "tTwW":
+                continue
+            self.addrs.append(int(parts[0], 16))
+            self.names.append(parts[2])
+
+    def contains(self, addr):
+        return bool(self.addrs) and self.addrs[0] <= addr
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%x" % addr
+        return self.names[i]
+
+
+def parse_args():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0] if __doc__ else None)
+    ap.add_argument("--kernel", required=True, help="kernel ELF with symbols")
+    ap.add_argument("--user", action="append", default=[],
+                    help="user ELF, optionally bound to a PID as PID:ELF")
+    ap.add_argument("--by-cpu", action="store_true",
+                    help="prefix every stack with its CPU")
+    ap.add_argument("log", help="serial log containing @prof lines ('-' for stdin)")
+    return ap.parse_args()
+
+
+def main():
+    args = parse_args()
+    kernel = SymbolTable(args.kernel)
+    user_by_pid = {}
+    user_any = []
+    for spec in args.user:
+        pid, sep, path = spec.partition(":")
+        if sep and pid.isdigit():
+            user_by_pid[int(pid)] = SymbolTable(path)
+        else:
+            user_any.append(SymbolTable(spec))
+
+    def user_table(pid, addr):
+        table = user_by_pid.get(pid)
+        if table is not None:
+            return table
+        for table in user_any:
+            if table.contains(addr):
+                return table
+        return None
+
+    log = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    folded = collections.Counter()
+    samples = 0
+    for line in log:
+        line = line.strip()
+        if not line.startswith("@prof "):
+            continue
+        fields = line.split()[1:]
+        if len(fields) < 5:
+            continue  # truncated by the QEMU kill
+        cpu, pid, tid, cpl = (int(f) for f in fields[:4])
+        addrs = [int(a, 16) for a in fields[4:]]
+
+        if cpl == 0:
+            root = "[kernel]"
+            frames = [kernel.lookup(a) for a in addrs]
+        else:
+            table = user_table(pid, addrs[0])
+            root = table.name if table else "pid%d" % pid
+            frames = [table.lookup(a) if table else "0x%x" % a for a in addrs]
+
+        # Folded stacks are outermost first.
+        stack = [root] + frames[::-1]
+        if args.by_cpu:
+            stack.insert(0, "cpu%d" % cpu)
+        folded[";".join(stack)] += 1
+        samples += 1
+
+    for stack, count in sorted(folded.items()):
+        print("%s %d" % (stack, count))
+    print("profile_fold: %d samples, %d unique stacks" % (samples, len(folded)),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,1238 @@
+#!/usr/bin/env python3
+# =============================================================================
+# MinimalOS NextGen — Wasm → x86_64 Ahead-of-Time Compiler
+# =============================================================================
+#
+# Translates a .wasm module into x86_64 assembly (Intel syntax, no prefix)
+# that a native guest includes with `global_asm!` (user/hello_aot). The
+# guest runs the module's own code — no interpreter, no re-parsing — in a
+# process of its own.
+#
+# SANDBOX:
+#   Linear memory is one NOBITS section, `.wasm_memory`, which the guest's
+#   linker script places at a fixed high address with 8 GiB + 4 KiB of
+#   address space above it that nothing maps. Every load and store is
+#
+#       [r15 + zero-extended i32 address + u32 offset]
+#
+#   with r15 = the memory base, so the furthest any access can reach is
+#   base + 2^33 + 8: an out-of-bounds access hits the guard region and
+#   faults instead of being checked in software. Everything else the code
+#   could index is checked here or at run time:
+#
+#     locals, globals, functions, types   indices checked at compile time
+#     operand stack / branch targets      heights and depths checked here
+#     call_indirect                       table bound + signature at run time
+#     memory.fill / memory.copy           explicit bound check (they must
+#                                         trap before writing anything)
+#     native stack                        limit checked in every prologue
+#
+#   Explicit traps call the host's `wasm_trap(code)`, which never returns.
+#
+#   The input is trusted-toolchain output (rustc/LLVM). Only the structure
+#   the sandbox depends on is checked; operand types are not — wasmi
+#   validates the same module in full when init runs it interpreted.
+#
+# CODE SHAPE:
+#   One native function per Wasm function. The operand stack height at
+#   every instruction is static, so every local and every stack position
+#   is a fixed slot: the bottom four stack positions and the four most
+#   used locals (uses weighted by loop depth) live in registers, the rest
+#   in 8-byte homes below rbp. Each instruction becomes a few moves and
+#   one ALU op on those fixed locations — no register allocator needed.
+#
+#   Arguments are passed by pointer: the caller spills its registers,
+#   points rsi at its first argument's home and the callee copies them
+#   into its own frame. Results come back in rax. rsp stays 16-byte
+#   aligned inside every body, so imports are plain SysV calls; the
+#   export wrappers save the SysV callee-saved registers the code uses.
+#
+# SUPPORTED:
+#   The integer MVP (i32/i64 arithmetic, comparisons, conversions, loads,
+#   stores, globals, control flow, br_table, call, call_indirect),
+#   sign-extension ops, and memory.fill / memory.copy. Memory cannot grow
+#   (memory.grow returns -1 unless the delta is 0). Floats, SIMD, passive
+#   segments and multi-value results fail the build.
+#
+# OUTPUT SYMBOLS (host side: user/hello_aot):
+#   wasm_init                 SysV: copies data segments, runs `start`
+#   wasm_export_<name>        SysV wrapper for each exported function
+#   wasm_memory_base          .quad address of linear memory
+#   wasm_memory_bytes         .quad size of linear memory
+#   wasm_stack_limit          .quad lowest rsp compiled code may use
+#   needs: wasm_import_<name> for each `env` import, wasm_trap(code)
+#
+# Usage:
+#     tools/wasm_aot.py IN.wasm OUT.s
+#
+# =============================================================================
+
+import sys
+
+from wasm_strip import read_leb_u32, split_sections
+
+# Section ids
+SEC_TYPE, SEC_IMPORT, SEC_FUNCTION, SEC_TABLE, SEC_MEMORY = 1, 2, 3, 4, 5
+SEC_GLOBAL, SEC_EXPORT, SEC_START, SEC_ELEMENT, SEC_CODE, SEC_DATA = 6, 7, 8, 9, 10, 11
+
+I32, I64 = 0x7F, 0x7E
+WASM_PAGE = 65536
+
+# Registers for the bottom operand stack positions and for the hottest
+# locals. rax/rcx/rdx/rsi/rdi are scratch, r15 holds the memory base.
+STACK_REGS = ["r8", "r9", "r10", "r11"]
+LOCAL_REGS = ["rbx", "r12", "r13", "r14"]
+
+# 64 / 32 / 16 / 8-bit names
+REG_NAMES = {
+    "rbx": ("rbx", "ebx", "bx", "bl"),
+    "r8": ("r8", "r8d", "r8w", "r8b"),
+    "r9": ("r9", "r9d", "r9w", "r9b"),
+    "r10": ("r10", "r10d", "r10w", "r10b"),
+    "r11": ("r11", "r11d", "r11w", "r11b"),
+    "r12": ("r12", "r12d", "r12w", "r12b"),
+    "r13": ("r13", "r13d", "r13w", "r13b"),
+    "r14": ("r14", "r14d", "r14w", "r14b"),
+}
+
+# Trap codes passed to wasm_trap (mirrored in user/hello_aot).
+TRAP_UNREACHABLE = 0
+TRAP_DIV_ZERO = 1
+TRAP_INT_OVERFLOW = 2
+TRAP_OUT_OF_BOUNDS = 3
+TRAP_INDIRECT_CALL = 4
+TRAP_STACK = 5
+
+
+class Reader:
+    """Cursor over a byte string with the Wasm binary encodings."""
+
+    def __init__(self, data, pos=0, end=None):
+        self.data = data
+        self.pos = pos
+        self.end = len(data) if end is None else end
+
+    def done(self):
+        return self.pos >= self.end
+
+    def byte(self):
+        if self.pos >= self.end:
+            raise ValueError("unexpected end of section at offset %d" % self.pos)
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def u32(self):
+        value, self.pos = read_leb_u32(self.data[:self.end], self.pos)
+        return value
+
+    def signed(self, bits):
+        result = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            result |= (b & 0x7F) << shift
+            shift += 7
+            if b & 0x80 == 0:
+                break
+            if shift >= bits + 7:
+                raise ValueError("signed LEB128 too long at offset %d" % self.pos)
+        if b & 0x40:
+            result -= 1 << shift
+        # Two's complement within `bits`
+        return result & ((1 << bits) - 1)
+
+    def bytes(self, n):
+        if self.pos + n > self.end:
+            raise ValueError("unexpected end of section at offset %d" % self.pos)
+        out = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return out
+
+    def name(self):
+        return self.bytes(self.u32()).decode("utf-8")
+
+
+# =============================================================================
+# Module parsing
+# =============================================================================
+
+class Module:
+    def __init__(self):
+        self.types = []         # [(params, results)]
+        self.imports = []       # [(module, name, type index)]  (functions only)
+        self.funcs = []         # type index per defined function
+        self.table_size = 0
+        self.mem_pages = None
+        self.globals = []       # [(valtype, mutable, initial value)]
+        self.exports = []       # [(name, function index)]
+        self.start = None
+        self.elements = []      # [(offset, [function index])]
+        self.bodies = []        # [(locals, Reader over the expression)]
+        self.data = []          # [(offset, bytes)]
+
+
+def const_expr(r):
+    """Reads a constant expression (i32/i64.const followed by end)."""
+    op = r.byte()
+    if op == 0x41:
+        value = r.signed(32)
+    elif op == 0x42:
+        value = r.signed(64)
+    else:
+        raise ValueError("unsupported constant expression opcode 0x%02x" % op)
+    if r.byte() != 0x0B:
+        raise ValueError("constant expression not terminated by end")
+    return value
+
+
+def limits(r):
+    flags = r.byte()
+    minimum = r.u32()
+    if flags & 1:
+        r.u32()
+    return minimum
+
+
+def parse(wasm):
+    m = Module()
+    for sec_id, _, end, body in split_sections(wasm):
+        r = Reader(wasm, body, end)
+        if sec_id == SEC_TYPE:
+            for _ in range(r.u32()):
+                if r.byte() != 0x60:
+                    raise ValueError("malformed function type")
+                params = [r.byte() for _ in range(r.u32())]
+                results = [r.byte() for _ in range(r.u32())]
+                for t in params + results:
+                    if t not in (I32, I64):
+                        raise ValueError("unsupported value type 0x%02x (integers only)" % t)
+                if len(results) > 1:
+                    raise ValueError("multi-value function results are not supported")
+                m.types.append((params, results))
+        elif sec_id == SEC_IMPORT:
+            for _ in range(r.u32()):
+                module, name, kind = r.name(), r.name(), r.byte()
+                if kind != 0:
+                    raise ValueError("import %s.%s: only function imports are supported" % (module, name))
+                if module != "env":
+                    raise ValueError("import %s.%s: only the env module is provided" % (module, name))
+                m.imports.append((module, name, check_index(r.u32(), len(m.types), "type")))
+        elif sec_id == SEC_FUNCTION:
+            m.funcs = [check_index(r.u32(), len(m.types), "type") for _ in range(r.u32())]
+        elif sec_id == SEC_TABLE:
+            if r.u32() > 1:
+                raise ValueError("more than one table")
+            if r.byte() != 0x70:
+                raise ValueError("only funcref tables are supported")
+            m.table_size = limits(r)
+        elif sec_id == SEC_MEMORY:
+            if r.u32() != 1:
+                raise ValueError("exactly one memory is required")
+            m.mem_pages = limits(r)
+        elif sec_id == SEC_GLOBAL:
+            for _ in range(r.u32()):
+                valtype, mutable = r.byte(), r.byte()
+                if valtype not in (I32, I64):
+                    raise ValueError("unsupported global type 0x%02x" % valtype)
+                m.globals.append((valtype, mutable, const_expr(r)))
+        elif sec_id == SEC_EXPORT:
+            for _ in range(r.u32()):
+                name, kind, index = r.name(), r.byte(), r.u32()
+                if kind == 0:
+                    m.exports.append((name, index))
+        elif sec_id == SEC_START:
+            m.start = r.u32()
+        elif sec_id == SEC_ELEMENT:
+            for _ in range(r.u32()):
+                if r.u32() != 0:
+                    raise ValueError("only active table-0 element segments are supported")
+                offset = const_expr(r)
+                m.elements.append((offset, [r.u32() for _ in range(r.u32())]))
+        elif sec_id == SEC_CODE:
+            for _ in range(r.u32()):
+                size = r.u32()
+                body_end = r.pos + size
+                fr = Reader(wasm, r.pos, body_end)
+                local_types = []
+                for _ in range(fr.u32()):
+                    count, valtype = fr.u32(), fr.byte()
+                    if valtype not in (I32, I64):
+                        raise ValueError("unsupported local type 0x%02x" % valtype)
+                    if count > 50000:
+                        raise ValueError("too many locals")
+                    local_types += [valtype] * count
+                m.bodies.append((local_types, fr))
+                r.pos = body_end
+        elif sec_id == SEC_DATA:
+            for _ in range(r.u32()):
+                if r.u32() != 0:
+                    raise ValueError("only active memory-0 data segments are supported")
+                offset = const_expr(r)
+                m.data.append((offset, r.bytes(r.u32())))
+
+    if m.mem_pages is None:
+        raise ValueError("module has no linear memory")
+    if len(m.bodies) != len(m.funcs):
+        raise ValueError("function and code section counts differ")
+    nfuncs = len(m.imports) + len(m.funcs)
+    for name, index in m.exports:
+        check_index(index, nfuncs, "exported function")
+    if m.start is not None:
+        check_index(m.start, nfuncs, "start function")
+        if m.types[func_type(m, m.start)] != ([], []):
+            raise ValueError("start function must take and return nothing")
+    for offset, indices in m.elements:
+        if offset + len(indices) > m.table_size:
+            raise ValueError("element segment outside the table")
+        for index in indices:
+            check_index(index, nfuncs, "table element")
+    mem_bytes = m.mem_pages * WASM_PAGE
+    for offset, data in m.data:
+        if offset + len(data) > mem_bytes:
+            raise ValueError("data segment at %#x outside linear memory" % offset)
+    return m
+
+
+def check_index(index, count, what):
+    if index >= count:
+        raise ValueError("%s index %d out of range (%d defined)" % (what, index, count))
+    return index
+
+
+def func_type(m, index):
+    if index < len(m.imports):
+        return m.imports[index][2]
+    return m.funcs[index - len(m.imports)]
+
+
+def canonical_types(m):
+    """Maps each type index to the first index with the same signature, so
+    call_indirect compares signatures structurally."""
+    first = {}
+    out = []
+    for params, results in m.types:
+        key = (tuple(params), tuple(results))
+        out.append(first.setdefault(key, len(out)))
+    return out
+
+
+# =============================================================================
+# Code generation
+# =============================================================================
+
+def symbol(name):
+    return "".join(c if c.isalnum() or c == "_" else "_" for c in name)
+
+
+class Block:
+    def __init__(self, kind, label, height, arity, else_label=None):
+        self.kind = kind            # "block", "loop", "if", "func"
+        self.label = label          # branch target
+        self.height = height        # operand height at entry
+        self.arity = arity          # values a branch to it carries
+        self.results = arity        # values on the stack at its end
+        self.else_label = else_label
+        self.unreachable = False
+
+
+class FunctionCompiler:
+    """Compiles one function body to assembly lines."""
+
+    def __init__(self, m, index, local_types, reader, canon):
+        self.m = m
+        self.index = index
+        self.reader = reader
+        self.canon = canon
+        params, results = m.types[func_type(m, index)]
+        self.nparams = len(params)
+        self.nlocals = len(params) + len(local_types)
+        self.results = len(results)
+        self.out = []
+        self.labels = 0
+        self.height = 0
+        self.max_height = 0
+        self.blocks = []
+        self.regs = self.assign_registers()
+
+    def assign_registers(self):
+        """Maps slots to registers: the bottom stack positions, and the
+        locals with the most uses (each loop level counts eight times)."""
+        weights = [0] * self.nlocals
+        r = Reader(self.reader.data, self.reader.pos, self.reader.end)
+        scan = FunctionCompiler.__new__(FunctionCompiler)
+        scan.reader, scan.m, scan.index = r, self.m, self.index
+        kinds = []
+        while not r.done():
+            op = r.byte()
+            if op in (0x02, 0x03, 0x04):
+                scan.block_type()
+                kinds.append(op)
+            elif op == 0x0B:
+                if kinds:
+                    kinds.pop()
+            elif op in (0x20, 0x21, 0x22):
+                index = r.u32()
+                if index < self.nlocals:
+                    weights[index] += 8 ** min(kinds.count(0x03), 6)
+            else:
+                scan.skip_immediates(op)
+        hot = sorted(range(self.nlocals), key=lambda i: -weights[i])
+        regs = {}
+        for i, reg in zip([i for i in hot if weights[i]], LOCAL_REGS):
+            regs[i] = reg
+        # Stack positions are numbered after the locals.
+        for k, reg in enumerate(STACK_REGS):
+            regs[self.nlocals + k] = reg
+        return regs
+
+    # --- slots -------------------------------------------------------------
+
+    def addr(self, slot):
+        return "[rbp - %d]" % (8 * (slot + 1))
+
+    def reg(self, slot, size):
+        """Register name of `slot` (size 0..3 = 64/32/16/8 bits), or None."""
+        reg = self.regs.get(slot)
+        return REG_NAMES[reg][size] if reg else None
+
+    def q(self, slot):
+        return self.reg(slot, 0) or "qword ptr " + self.addr(slot)
+
+    def d(self, slot):
+        return self.reg(slot, 1) or "dword ptr " + self.addr(slot)
+
+    def w(self, slot):
+        return self.reg(slot, 2) or "word ptr " + self.addr(slot)
+
+    def b(self, slot):
+        return self.reg(slot, 3) or "byte ptr " + self.addr(slot)
+
+    def move(self, dst, src):
+        """Copies a 64-bit operand between two locations (slot or global)."""
+        if dst == src:
+            return
+        if dst.startswith(("qword", "dword")) and src.startswith(("qword", "dword")):
+            self.emit("mov rax, " + src)
+            src = "rax"
+        self.emit("mov %s, %s" % (dst, src))
+
+    def top(self, depth=0):
+        """Slot of the operand `depth` below the top."""
+        if self.height - 1 - depth < 0:
+            raise ValueError("function %d: operand stack underflow" % self.index)
+        return self.nlocals + self.height - 1 - depth
+
+    def push(self):
+        self.height += 1
+        self.max_height = max(self.max_height, self.height)
+        return self.nlocals + self.height - 1
+
+    def pop(self):
+        slot = self.top()
+        self.height -= 1
+        return slot
+
+    def local(self, index):
+        return check_index(index, self.nlocals, "local")
+
+    # --- emission ----------------------------------------------------------
+
+    def emit(self, line):
+        self.out.append("    " + line)
+
+    def new_label(self):
+        self.labels += 1
+        return ".Lf%d_%d" % (self.index, self.labels)
+
+    def place(self, label):
+        self.out.append(label + ":")
+
+    def trap_if(self, cond, code):
+        self.emit("%s wasm_trap_%d" % (cond, code))
+
+    # --- control -----------------------------------------------------------
+
+    def block_type(self):
+        b = self.reader.byte()
+        if b == 0x40:
+            return 0
+        if b in (I32, I64):
+            return 1
+        if b & 0x80 or b in (0x7D, 0x7C, 0x7B, 0x70, 0x6F):
+            raise ValueError("function %d: unsupported block type 0x%02x" % (self.index, b))
+        self.reader.pos -= 1
+        params, results = self.m.types[check_index(self.reader.signed(33), len(self.m.types), "type")]
+        if params or len(results) > 1:
+            raise ValueError("function %d: block parameters / multi-value blocks are not supported" % self.index)
+        return len(results)
+
+    def target(self, depth):
+        if depth >= len(self.blocks):
+            raise ValueError("function %d: branch depth %d out of range" % (self.index, depth))
+        return self.blocks[-1 - depth]
+
+    def branch(self, block):
+        """Moves the branch's value (if any) into place and jumps."""
+        if block.arity:
+            self.move(self.q(self.nlocals + block.height), self.q(self.top()))
+        if block.kind == "func":
+            self.ret()
+        else:
+            self.emit("jmp " + block.label)
+
+    def ret(self):
+        if self.results:
+            self.emit("mov rax, " + self.q(self.top()))
+        self.emit("leave")
+        self.emit("ret")
+
+    def set_unreachable(self):
+        self.blocks[-1].unreachable = True
+
+    def skip_dead(self):
+        """Skips code after br/return/unreachable up to the block's else/end.
+        Returns the opcode that ended it."""
+        depth = 0
+        while True:
+            op = self.reader.byte()
+            if op in (0x02, 0x03, 0x04):
+                self.block_type()
+                depth += 1
+            elif op == 0x0B:
+                if depth == 0:
+                    return op
+                depth -= 1
+            elif op == 0x05 and depth == 0:
+                return op
+            else:
+                self.skip_immediates(op)
+
+    def skip_immediates(self, op):
+        r = self.reader
+        if op in (0x0C, 0x0D, 0x10, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0xD2):
+            r.u32()
+        elif op == 0xD0:
+            r.byte()
+        elif op in (0xFD, 0xFE):
+            raise ValueError("function %d: SIMD / atomics are not supported" % self.index)
+        elif op == 0x0E:
+            for _ in range(r.u32() + 1):
+                r.u32()
+        elif op == 0x11:
+            r.u32()
+            r.u32()
+        elif op == 0x1C:
+            for _ in range(r.u32()):
+                r.byte()
+        elif 0x28 <= op <= 0x3E:
+            r.u32()
+            r.u32()
+        elif op in (0x3F, 0x40):
+            r.byte()
+        elif op == 0x41:
+            r.signed(32)
+        elif op == 0x42:
+            r.signed(64)
+        elif op == 0x43:
+            r.bytes(4)
+        elif op == 0x44:
+            r.bytes(8)
+        elif op == 0xFC:
+            sub = r.u32()
+            if sub in (8, 10, 12, 14):
+                r.u32()
+                r.u32()
+            elif sub in (9, 11, 13, 15, 16, 17):
+                r.u32()
+
+    # --- function ----------------------------------------------------------
+
+    def compile(self):
+        body = []
+        self.out = body
+        func = Block("func", None, 0, self.results)
+        self.blocks.append(func)
+        self.run()
+
+        frame = (8 * (self.nlocals + self.max_height) + 15) & ~15
+        prologue = [
+            "wasm_f_%d:" % self.index,
+            "    push rbp",
+            "    mov rbp, rsp",
+            "    lea rax, [rsp - %d]" % frame,
+            "    cmp rax, qword ptr [rip + wasm_stack_limit]",
+            "    jb wasm_trap_%d" % TRAP_STACK,
+            "    mov rsp, rax",
+        ]
+        for i in range(self.nparams):
+            if self.reg(i, 0):
+                prologue.append("    mov %s, qword ptr [rsi - %d]" % (self.q(i), 8 * i))
+            else:
+                prologue.append("    mov rax, qword ptr [rsi - %d]" % (8 * i))
+                prologue.append("    mov " + self.q(i) + ", rax")
+        if self.nlocals > self.nparams:
+            prologue.append("    xor eax, eax")
+            for i in range(self.nparams, self.nlocals):
+                prologue.append("    mov " + self.q(i) + ", rax")
+        return prologue + body
+
+    def run(self):
+        r = self.reader
+        while self.blocks:
+            op = r.byte()
+            if self.blocks[-1].unreachable and op not in (0x05, 0x0B):
+                r.pos -= 1
+                op = self.skip_dead()
+            self.op(op)
+        if not r.done():
+            raise ValueError("function %d: code after the final end" % self.index)
+
+    def end_block(self):
+        block = self.blocks.pop()
+        self.height = block.height + block.results
+        self.max_height = max(self.max_height, self.height)
+        if block.kind == "func":
+            self.ret()
+            return
+        if block.kind == "if" and block.else_label:
+            if block.results:
+                raise ValueError("function %d: if with a result needs an else" % self.index)
+            self.place(block.else_label)
+        if block.kind != "loop":
+            self.place(block.label)
+
+    def op(self, op):
+        r = self.reader
+        e = self.emit
+
+        # ---- control ----
+        if op == 0x00:                                  # unreachable
+            e("jmp wasm_trap_%d" % TRAP_UNREACHABLE)
+            self.set_unreachable()
+        elif op == 0x01:                                # nop
+            pass
+        elif op in (0x02, 0x03):                        # block, loop
+            arity = self.block_type()
+            label = self.new_label()
+            if op == 0x03:
+                self.place(label)
+                self.blocks.append(Block("loop", label, self.height, 0))
+                self.blocks[-1].results = arity
+            else:
+                self.blocks.append(Block("block", label, self.height, arity))
+        elif op == 0x04:                                # if
+            arity = self.block_type()
+            cond = self.pop()
+            block = Block("if", self.new_label(), self.height, arity, self.new_label())
+            e("cmp " + self.d(cond) + ", 0")
+            e("je " + block.else_label)
+            self.blocks.append(block)
+        elif op == 0x05:                                # else
+            block = self.blocks[-1]
+            if block.kind != "if" or block.else_label is None:
+                raise ValueError("function %d: else without if" % self.index)
+            if not block.unreachable:
+                e("jmp " + block.label)
+            self.place(block.else_label)
+            block.else_label = None
+            block.unreachable = False
+            self.height = block.height
+        elif op == 0x0B:                                # end
+            self.end_block()
+        elif op == 0x0C:                                # br
+            self.branch(self.target(r.u32()))
+            self.set_unreachable()
+        elif op == 0x0D:                                # br_if
+            block = self.target(r.u32())
+            cond = self.pop()
+            skip = self.new_label()
+            e("cmp " + self.d(cond) + ", 0")
+            e("je " + skip)
+            self.branch(block)
+            self.place(skip)
+        elif op == 0x0E:                                # br_table
+            targets = [self.target(r.u32()) for _ in range(r.u32())]
+            default = self.target(r.u32())
+            index = self.pop()
+            stubs = [self.new_label() for _ in targets]
+            table = self.new_label()
+            default_stub = self.new_label()
+            e("mov eax, " + self.d(index))
+            e("cmp eax, %d" % len(targets))
+            e("jae " + default_stub)
+            e("lea rcx, [rip + %s]" % table)
+            e("jmp qword ptr [rcx + rax*8]")
+            for stub, block in zip(stubs + [default_stub], targets + [default]):
+                self.place(stub)
+                self.branch(block)
+            self.out.append("    .section .rodata")
+            self.out.append("    .p2align 3")
+            self.place(table)
+            for stub in stubs:
+                self.out.append("    .quad " + stub)
+            self.out.append("    .text")
+            self.set_unreachable()
+        elif op == 0x0F:                                # return
+            self.branch(self.blocks[0])
+            self.set_unreachable()
+        elif op == 0x10:                                # call
+            self.call(check_index(r.u32(), len(self.m.imports) + len(self.m.funcs), "function"))
+        elif op == 0x11:                                # call_indirect
+            type_index = check_index(r.u32(), len(self.m.types), "type")
+            if r.u32() != 0:
+                raise ValueError("function %d: call_indirect on a table other than 0" % self.index)
+            if self.m.table_size == 0:
+                raise ValueError("function %d: call_indirect without a table" % self.index)
+            slot = self.pop()
+            e("mov eax, " + self.d(slot))
+            e("cmp eax, %d" % self.m.table_size)
+            self.trap_if("jae", TRAP_OUT_OF_BOUNDS)
+            e("shl rax, 4")
+            e("lea rcx, [rip + wasm_table]")
+            e("cmp dword ptr [rcx + rax], %d" % self.canon[type_index])
+            self.trap_if("jne", TRAP_INDIRECT_CALL)
+            self.call_with(type_index, "qword ptr [rcx + rax + 8]")
+
+        # ---- parametric ----
+        elif op == 0x1A:                                # drop
+            self.pop()
+        elif op in (0x1B, 0x1C):                        # select
+            if op == 0x1C:
+                for _ in range(r.u32()):
+                    if r.byte() not in (I32, I64):
+                        raise ValueError("function %d: unsupported select type" % self.index)
+            cond, b = self.pop(), self.pop()
+            a = self.top()
+            e("cmp " + self.d(cond) + ", 0")
+            if self.reg(a, 0):
+                e("cmove %s, %s" % (self.q(a), self.q(b)))
+            else:
+                e("mov rax, " + self.q(a))
+                e("cmove rax, " + self.q(b))
+                e("mov " + self.q(a) + ", rax")
+
+        # ---- variables ----
+        elif op == 0x20:                                # local.get
+            src = self.local(r.u32())
+            self.move(self.q(self.push()), self.q(src))
+        elif op in (0x21, 0x22):                        # local.set, local.tee
+            dst = self.local(r.u32())
+            src = self.pop() if op == 0x21 else self.top()
+            self.move(self.q(dst), self.q(src))
+        elif op == 0x23:                                # global.get
+            g = check_index(r.u32(), len(self.m.globals), "global")
+            self.move(self.q(self.push()), "qword ptr [rip + wasm_globals + %d]" % (8 * g))
+        elif op == 0x24:                                # global.set
+            g = check_index(r.u32(), len(self.m.globals), "global")
+            if not self.m.globals[g][1]:
+                raise ValueError("function %d: global.set on immutable global %d" % (self.index, g))
+            self.move("qword ptr [rip + wasm_globals + %d]" % (8 * g), self.q(self.pop()))
+
+        # ---- memory ----
+        elif 0x28 <= op <= 0x35:
+            r.u32()
+            self.load(op, r.u32())
+        elif 0x36 <= op <= 0x3E:
+            r.u32()
+            self.store(op, r.u32())
+        elif op == 0x3F:                                # memory.size
+            r.byte()
+            e("mov %s, %d" % (self.d(self.push()), self.m.mem_pages))
+        elif op == 0x40:                                # memory.grow
+            r.byte()
+            slot = self.top()
+            # Fixed-size memory: growing by 0 reports the size, anything
+            # else fails with -1.
+            e("mov eax, %d" % self.m.mem_pages)
+            e("mov ecx, -1")
+            e("cmp " + self.d(slot) + ", 0")
+            e("cmovne eax, ecx")
+            e("mov " + self.d(slot) + ", eax")
+
+        # ---- constants ----
+        elif op == 0x41:
+            value = r.signed(32)
+            e("mov %s, %d" % (self.d(self.push()), to_signed(value, 32)))
+        elif op == 0x42:
+            value = to_signed(r.signed(64), 64)
+            slot = self.push()
+            if -(1 << 31) <= value < (1 << 31):
+                e("mov %s, %d" % (self.q(slot), value))
+            elif self.reg(slot, 0):
+                e("movabs %s, %d" % (self.q(slot), value))
+            else:
+                e("movabs rax, %d" % value)
+                e("mov " + self.q(slot) + ", rax")
+
+        # ---- numeric ----
+        elif op in I32_COMPARE or op in I64_COMPARE:
+            self.compare(op)
+        elif op in (0x45, 0x50):                        # i32.eqz, i64.eqz
+            slot = self.top()
+            e("cmp %s, 0" % (self.d(slot) if op == 0x45 else self.q(slot)))
+            e("sete al")
+            e("movzx eax, al")
+            e("mov " + self.d(slot) + ", eax")
+        elif 0x67 <= op <= 0x69 or 0x79 <= op <= 0x7B:
+            self.bitcount(op)
+        elif 0x6A <= op <= 0x78 or 0x7C <= op <= 0x8A:
+            self.binop(op)
+        elif op == 0xA7:                                # i32.wrap_i64
+            pass                                        # i32 readers only see the low half
+        elif op == 0xAC:                                # i64.extend_i32_s
+            slot = self.top()
+            e("movsxd rax, " + self.d(slot))
+            e("mov " + self.q(slot) + ", rax")
+        elif op == 0xAD:                                # i64.extend_i32_u
+            slot = self.top()
+            e("mov eax, " + self.d(slot))
+            e("mov " + self.q(slot) + ", rax")
+        elif 0xC0 <= op <= 0xC4:                        # sign-extension ops
+            slot = self.top()
+            e({0xC0: "movsx eax, " + self.b(slot), 0xC1: "movsx eax, " + self.w(slot),
+               0xC2: "movsx rax, " + self.b(slot), 0xC3: "movsx rax, " + self.w(slot),
+               0xC4: "movsxd rax, " + self.d(slot)}[op])
+            e("mov " + self.q(slot) + ", rax")
+        elif op == 0xFC:
+            self.misc(r.u32())
+        else:
+            raise ValueError("function %d: unsupported opcode 0x%02x (floats and SIMD are not compiled)"
+                             % (self.index, op))
+
+    # --- calls ---------------------------------------------------------------
+
+    def call(self, callee):
+        self.call_with(func_type(self.m, callee), "wasm_f_%d" % callee)
+
+    def call_with(self, type_index, target):
+        params, results = self.m.types[type_index]
+        live = self.nlocals + self.height
+        for _ in params:
+            self.pop()
+        base = self.nlocals + self.height
+        # Every register is the callee's to use: spill the locals, the live
+        # stack and the arguments, which sit in homes base.. (descending
+        # addresses).
+        held = sorted(slot for slot in self.regs if slot < live)
+        for slot in held:
+            self.emit("mov %s, %s" % (self.addr(slot), self.q(slot)))
+        self.emit("lea rsi, " + self.addr(base))
+        self.emit("call " + target)
+        for slot in held:
+            if slot < base:
+                self.emit("mov %s, %s" % (self.q(slot), self.addr(slot)))
+        if results:
+            self.emit("mov " + self.q(self.push()) + ", rax")
+
+    # --- memory ----------------------------------------------------------------
+
+    def effective(self, slot, offset):
+        """Loads a linear-memory address into rcx; returns the operand."""
+        self.emit("mov ecx, " + self.d(slot))
+        if offset < (1 << 31):
+            return "[r15 + rcx + %d]" % offset
+        self.emit("mov edx, %d" % to_signed(offset, 32))
+        self.emit("add rcx, rdx")
+        return "[r15 + rcx]"
+
+    def load(self, op, offset):
+        slot = self.top()
+        mem = self.effective(slot, offset)
+        insn = LOADS[op]
+        self.emit(insn % mem)
+        self.emit("mov " + self.q(slot) + ", rax")
+
+    def store(self, op, offset):
+        value = self.pop()
+        slot = self.pop()
+        mem = self.effective(slot, offset)
+        self.emit("mov rax, " + self.q(value))
+        self.emit(STORES[op] % mem)
+
+    def misc(self, sub):
+        r = self.reader
+        e = self.emit
+        mem_bytes = self.m.mem_pages * WASM_PAGE
+        if sub == 11:                                   # memory.fill
+            if r.byte() != 0:
+                raise ValueError("function %d: memory.fill on memory other than 0" % self.index)
+            n, val, dst = self.pop(), self.pop(), self.pop()
+            self.range_check(dst, n, mem_bytes)
+            e("mov eax, " + self.d(val))
+            e("mov ecx, " + self.d(n))
+            e("mov edi, " + self.d(dst))
+            e("add rdi, r15")
+            e("rep stosb")
+        elif sub == 10:                                 # memory.copy
+            if r.byte() != 0 or r.byte() != 0:
+                raise ValueError("function %d: memory.copy on memory other than 0" % self.index)
+            n, src, dst = self.pop(), self.pop(), self.pop()
+            self.range_check(dst, n, mem_bytes)
+            self.range_check(src, n, mem_bytes)
+            forward = self.new_label()
+            done = self.new_label()
+            e("mov ecx, " + self.d(n))
+            e("mov esi, " + self.d(src))
+            e("mov edi, " + self.d(dst))
+            e("cmp rdi, rsi")
+            e("jbe " + forward)
+            # dst above src: copy backwards so an overlap reads old bytes
+            e("lea rsi, [r15 + rsi - 1]")
+            e("add rsi, rcx")
+            e("lea rdi, [r15 + rdi - 1]")
+            e("add rdi, rcx")
+            e("std")
+            e("rep movsb")
+            e("cld")
+            e("jmp " + done)
+            self.place(forward)
+            e("add rsi, r15")
+            e("add rdi, r15")
+            e("rep movsb")
+            self.place(done)
+        else:
+            raise ValueError("function %d: unsupported opcode 0xfc %d" % (self.index, sub))
+
+    def range_check(self, start, n, limit):
+        """Traps unless [start, start + n) lies inside linear memory."""
+        self.emit("mov eax, " + self.d(start))
+        self.emit("mov edx, " + self.d(n))
+        self.emit("add rax, rdx")
+        self.emit("mov rdx, %d" % limit)
+        self.emit("cmp rax, rdx")
+        self.trap_if("ja", TRAP_OUT_OF_BOUNDS)
+
+    # --- numeric ---------------------------------------------------------------
+
+    def compare(self, op):
+        wide = op in I64_COMPARE
+        cc = I64_COMPARE[op] if wide else I32_COMPARE[op]
+        b, a = self.pop(), self.top()
+        acc, operand = ("rax", self.q(b)) if wide else ("eax", self.d(b))
+        self.emit("mov %s, %s" % (acc, self.q(a) if wide else self.d(a)))
+        self.emit("cmp %s, %s" % (acc, operand))
+        self.emit("set%s al" % cc)
+        self.emit("movzx eax, al")
+        self.emit("mov " + self.d(a) + ", eax")
+
+    def bitcount(self, op):
+        wide = op >= 0x79
+        kind = (op - 0x79) if wide else (op - 0x67)     # 0 clz, 1 ctz, 2 popcnt
+        slot = self.top()
+        a, c, d = ("rax", "rcx", "rdx") if wide else ("eax", "ecx", "edx")
+        bits = 64 if wide else 32
+        src = self.q(slot) if wide else self.d(slot)
+        e = self.emit
+        e("mov %s, %s" % (a, src))
+        if kind == 0:
+            # bsr leaves the destination undefined for 0: -1 → clz = bits
+            e("mov %s, -1" % d)
+            e("bsr %s, %s" % (a, a))
+            e("cmovz %s, %s" % (a, d))
+            e("neg %s" % a)
+            e("add %s, %d" % (a, bits - 1))
+        elif kind == 1:
+            e("mov %s, %d" % (d, bits))
+            e("bsf %s, %s" % (a, a))
+            e("cmovz %s, %s" % (a, d))
+        else:
+            # SWAR popcount (popcnt is not on every target CPU model)
+            m1, m2, m4, h = ((0x5555555555555555, 0x3333333333333333, 0x0F0F0F0F0F0F0F0F, 0x0101010101010101)
+                             if wide else (0x55555555, 0x33333333, 0x0F0F0F0F, 0x01010101))
+            e("mov %s, %s" % (c, a))
+            e("shr %s, 1" % c)
+            e("movabs rdx, %d" % m1 if wide else "and ecx, %d" % m1)
+            if wide:
+                e("and rcx, rdx")
+            e("sub %s, %s" % (a, c))
+            e("movabs rdx, %d" % m2 if wide else "mov edx, %d" % m2)
+            e("mov %s, %s" % (c, a))
+            e("shr %s, 2" % c)
+            e("and %s, %s" % (a, d))
+            e("and %s, %s" % (c, d))
+            e("add %s, %s" % (a, c))
+            e("mov %s, %s" % (c, a))
+            e("shr %s, 4" % c)
+            e("add %s, %s" % (a, c))
+            e("movabs rdx, %d" % m4 if wide else "mov edx, %d" % m4)
+            e("and %s, %s" % (a, d))
+            e("movabs rdx, %d" % h if wide else "mov edx, %d" % h)
+            e("imul %s, %s" % (a, d))
+            e("shr %s, %d" % (a, bits - 8))
+        e("mov %s, %s" % (self.q(slot) if wide else self.d(slot), a))
+
+    def binop(self, op):
+        wide = op >= 0x7C
+        kind = op - (0x7C if wide else 0x6A)
+        b, a = self.pop(), self.top()
+        A, C, D = ("rax", "rcx", "rdx") if wide else ("eax", "ecx", "edx")
+        sa, sb = (self.q(a), self.q(b)) if wide else (self.d(a), self.d(b))
+        e = self.emit
+        name = BINOPS[kind]
+        if name in ("add", "sub", "and", "or", "xor", "mul") and self.reg(a, 0):
+            # Operate on the register in place.
+            e("%s %s, %s" % ("imul" if name == "mul" else name, sa, sb))
+            return
+        e("mov %s, %s" % (A, sa))
+        if name in ("add", "sub", "and", "or", "xor"):
+            e("%s %s, %s" % (name, A, sb))
+        elif name == "mul":
+            e("imul %s, %s" % (A, sb))
+        elif name in ("shl", "sar", "shr", "rol", "ror"):
+            e("mov %s, %s" % (C, sb))
+            e("%s %s, cl" % (name, A))
+        else:
+            e("mov %s, %s" % (C, sb))
+            e("test %s, %s" % (C, C))
+            self.trap_if("je", TRAP_DIV_ZERO)
+            if name in ("div_s", "rem_s"):
+                normal = self.new_label()
+                done = self.new_label()
+                e("cmp %s, -1" % C)
+                e("jne " + normal)
+                if name == "div_s":
+                    # INT_MIN / -1 overflows; anything else / -1 is a negate
+                    if wide:
+                        e("movabs rdx, %d" % -(1 << 63))
+                        e("cmp rax, rdx")
+                    else:
+                        e("cmp eax, %d" % -(1 << 31))
+                    self.trap_if("je", TRAP_INT_OVERFLOW)
+                    e("neg %s" % A)
+                else:
+                    e("xor eax, eax")                   # x rem -1 = 0 (idiv would fault on INT_MIN)
+                e("jmp " + done)
+                self.place(normal)
+                e("cqo" if wide else "cdq")
+                e("idiv " + C)
+                if name == "rem_s":
+                    e("mov %s, %s" % (A, D))
+                self.place(done)
+            else:
+                e("xor edx, edx")
+                e("div " + C)
+                if name == "rem_u":
+                    e("mov %s, %s" % (A, D))
+        e("mov %s, %s" % (sa, A))
+
+
+def to_signed(value, bits):
+    value &= (1 << bits) - 1
+    return value - (1 << bits) if value >> (bits - 1) else value
+
+
+I32_COMPARE = {0x46: "e", 0x47: "ne", 0x48: "l", 0x49: "b", 0x4A: "g",
+               0x4B: "a", 0x4C: "le", 0x4D: "be", 0x4E: "ge", 0x4F: "ae"}
+I64_COMPARE = {op + 0x0B: cc for op, cc in I32_COMPARE.items()}
+
+BINOPS = ["add", "sub", "mul", "div_s", "div_u", "rem_s", "rem_u",
+          "and", "or", "xor", "shl", "sar", "shr", "rol", "ror"]
+
+LOADS = {
+    0x28: "mov eax, dword ptr %s",
+    0x29: "mov rax, qword ptr %s",
+    0x2C: "movsx eax, byte ptr %s",
+    0x2D: "movzx eax, byte ptr %s",
+    0x2E: "movsx eax, word ptr %s",
+    0x2F: "movzx eax, word ptr %s",
+    0x30: "movsx rax, byte ptr %s",
+    0x31: "movzx eax, byte ptr %s",
+    0x32: "movsx rax, word ptr %s",
+    0x33: "movzx eax, word ptr %s",
+    0x34: "movsxd rax, dword ptr %s",
+    0x35: "mov eax, dword ptr %s",
+}
+
+STORES = {
+    0x36: "mov dword ptr %s, eax",
+    0x37: "mov qword ptr %s, rax",
+    0x3A: "mov byte ptr %s, al",
+    0x3B: "mov word ptr %s, ax",
+    0x3C: "mov byte ptr %s, al",
+    0x3D: "mov word ptr %s, ax",
+    0x3E: "mov dword ptr %s, eax",
+}
+
+
+# =============================================================================
+# Module emission
+# =============================================================================
+
+# SysV callee-saved registers the compiled code uses, saved by the entry
+# points (wasm_init, the export wrappers) right below rbp.
+SAVED_REGS = ["r15", "rbx", "r12", "r13", "r14"]
+ARGS_BELOW_RBP = 8 * (len(SAVED_REGS) + 1)
+
+
+def restore_saved():
+    return ["    mov %s, qword ptr [rbp - %d]" % (reg, 8 * (i + 1)) for i, reg in enumerate(SAVED_REGS)]
+
+def emit_module(m, src_name):
+    canon = canonical_types(m)
+    out = [
+        "# Generated by tools/wasm_aot.py from %s — do not edit." % src_name,
+        "# Intel syntax, no prefix (the global_asm! default).",
+        "",
+        "    .text",
+    ]
+
+    # Shared trap stubs: align the stack for the SysV call, never return.
+    for code in range(TRAP_STACK + 1):
+        out += [
+            "wasm_trap_%d:" % code,
+            "    mov edi, %d" % code,
+            "    and rsp, -16",
+            "    call wasm_trap",
+            "    ud2",
+        ]
+
+    # Imports: adapt the slot-pointer convention to SysV registers.
+    regs = ["rdi", "rsi", "rdx", "rcx", "r8", "r9"]
+    for i, (_, name, type_index) in enumerate(m.imports):
+        params, _ = m.types[type_index]
+        if len(params) > len(regs):
+            raise ValueError("import %s: more than %d parameters" % (name, len(regs)))
+        out += ["wasm_f_%d:" % i, "    push rbp", "    mov rbp, rsp"]
+        order = list(range(len(params)))
+        if len(order) > 1:
+            order = order[:1] + order[2:] + order[1:2]   # rsi last
+        for p in order:
+            out.append("    mov %s, qword ptr [rsi - %d]" % (regs[p], 8 * p))
+        out += ["    call wasm_import_%s" % symbol(name), "    leave", "    ret"]
+
+    # Defined functions
+    for i, (local_types, reader) in enumerate(m.bodies):
+        index = len(m.imports) + i
+        out += FunctionCompiler(m, index, local_types, reader, canon).compile()
+
+    # Exports: SysV → slot convention, with r15 = memory base.
+    for name, index in m.exports:
+        params, _ = m.types[func_type(m, index)]
+        if len(params) > len(regs):
+            raise ValueError("export %s: more than %d parameters" % (name, len(regs)))
+        # Five saved registers leave rsp ≡ 8 (mod 16); `pad` realigns.
+        pad = 8 * len(params) + (0 if len(params) % 2 else 8)
+        out += [
+            "    .globl wasm_export_%s" % symbol(name),
+            "wasm_export_%s:" % symbol(name),
+            "    push rbp",
+            "    mov rbp, rsp",
+        ] + ["    push " + reg for reg in SAVED_REGS] + [
+            "    sub rsp, %d" % pad,
+        ]
+        for p in range(len(params)):
+            out.append("    mov qword ptr [rbp - %d], %s" % (ARGS_BELOW_RBP + 8 * p, regs[p]))
+        out += [
+            "    movabs r15, offset wasm_memory",
+            "    lea rsi, [rbp - %d]" % ARGS_BELOW_RBP,
+            "    call wasm_f_%d" % index,
+        ] + restore_saved() + [
+            "    leave",
+            "    ret",
+        ]
+
+    # wasm_init: data segments, then the start function.
+    out += [
+        "    .globl wasm_init",
+        "wasm_init:",
+        "    push rbp",
+        "    mov rbp, rsp",
+    ] + ["    push " + reg for reg in SAVED_REGS] + [
+        "    sub rsp, 8",
+        "    movabs r15, offset wasm_memory",
+    ]
+    for k, (offset, data) in enumerate(m.data):
+        if not data:
+            continue
+        out += [
+            "    lea rsi, [rip + wasm_data_%d]" % k,
+            "    mov edi, %d" % to_signed(offset, 32),
+            "    add rdi, r15",
+            "    mov ecx, %d" % len(data),
+            "    rep movsb",
+        ]
+    if m.start is not None:
+        out += ["    call wasm_f_%d" % m.start]
+    out += restore_saved() + [
+        "    leave",
+        "    ret",
+    ]
+
+    # Read-only data: segment bytes and the function table.
+    out += ["", "    .section .rodata", "    .p2align 4"]
+    for k, (_, data) in enumerate(m.data):
+        out.append("wasm_data_%d:" % k)
+        for i in range(0, len(data), 32):
+            out.append("    .byte " + ", ".join(str(b) for b in data[i:i + 32]))
+    table = [None] * m.table_size
+    for offset, indices in m.elements:
+        for i, index in enumerate(indices):
+            table[offset + i] = index
+    out += ["    .p2align 4", "wasm_table:"]
+    for entry in table:
+        if entry is None:
+            out.append("    .quad -1, 0")       # no signature matches -1
+        else:
+            out.append("    .quad %d, wasm_f_%d" % (canon[func_type(m, entry)], entry))
+    mem_bytes = m.mem_pages * WASM_PAGE
+    out += [
+        "    .p2align 3",
+        "    .globl wasm_memory_base",
+        "wasm_memory_base:",
+        "    .quad wasm_memory",
+        "    .globl wasm_memory_bytes",
+        "wasm_memory_bytes:",
+        "    .quad %d" % mem_bytes,
+    ]
+
+    # Mutable state: globals and the stack limit the host sets.
+    out += ["", "    .data", "    .p2align 3", "wasm_globals:"]
+    for _, _, value in m.globals:
+        out.append("    .quad %d" % to_signed(value, 64))
+    out += [
+        "    .globl wasm_stack_limit",
+        "wasm_stack_limit:",
+        "    .quad -1",          # traps until the host sets it
+    ]
+
+    # Linear memory: zero-filled, placed by the linker script.
+    out += [
+        "",
+        '    .section .wasm_memory, "aw", @nobits',
+        "    .p2align 12",
+        "    .globl wasm_memory",
+        "wasm_memory:",
+        "    .zero %d" % mem_bytes,
+        "    .text",
+        "",
+    ]
+    return out
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: wasm_aot.py IN.wasm OUT.s")
+    src_path, out_path = sys.argv[1], sys.argv[2]
+
+    with open(src_path, "rb") as f:
+        wasm = f.read()
+
+    try:
+        m = parse(wasm)
+        lines = emit_module(m, src_path.rsplit("/", 1)[-1])
+    except ValueError as e:
+        sys.exit("wasm_aot: %s: %s" % (src_path, e))
+
+    text = "\n".join(lines)
+    if "{" in text or "}" in text:
+        sys.exit("wasm_aot: %s: braces in output would break global_asm!" % src_path)
+    with open(out_path, "w") as f:
+        f.write(text)
+
+    print("[wasm] %s: %d functions, %d KiB linear memory -> %s"
+          % (src_path, len(m.funcs), m.mem_pages * WASM_PAGE // 1024, out_path))
+
+
+if __name__ == "__main__":
+    main()
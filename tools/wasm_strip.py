@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# =============================================================================
+# MinimalOS NextGen — Wasm Module Check + Strip
+# =============================================================================
+#
+# Checks a .wasm module on the build host and writes a copy without its
+# custom sections (names, producers, DWARF). `make` ships the copy as
+# hello_wasm.wasm, so init parses fewer bytes and the build — not the
+# boot — is where a malformed or stale module is caught.
+#
+# The check is structural: header, LEB128 section framing, known section
+# ids in canonical order, every size in bounds, and a code section whose
+# body count matches the function section. wasmi 0.31 can neither load
+# translated bytecode nor skip validation, so init still validates the
+# module in full; nothing here is trusted at boot.
+#
+# Usage:
+#     tools/wasm_strip.py IN.wasm OUT.wasm
+#
+# =============================================================================
+
+import sys
+
+WASM_HEADER = b"\x00asm\x01\x00\x00\x00"
+
+# Non-custom section ids in the order the spec requires them
+# (12 = DataCount comes between Element and Code).
+SECTION_ORDER = [1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 10, 11]
+
+SEC_FUNCTION = 3
+SEC_CODE = 10
+
+
+def read_leb_u32(data, pos):
+    """Reads an unsigned LEB128 u32. Returns (value, new_pos)."""
+    result = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated LEB128 at offset %d" % pos)
+        b = data[pos]
+        pos += 1
+        result |= (b & 0x7F) << shift
+        if b & 0x80 == 0:
+            break
+        shift += 7
+        if shift >= 35:
+            raise ValueError("LEB128 too long at offset %d" % pos)
+    if result > 0xFFFFFFFF:
+        raise ValueError("LEB128 overflows u32 at offset %d" % pos)
+    return result, pos
+
+
+def split_sections(wasm):
+    """Validates the section framing. Returns [(id, start, end, body)]:
+    [start, end) covers the whole section including its header, `body` is
+    where its contents begin."""
+    if wasm[:8] != WASM_HEADER:
+        raise ValueError("not a wasm v1 module (bad magic/version)")
+
+    sections = []
+    pos = 8
+    last_rank = -1
+    while pos < len(wasm):
+        start = pos
+        sec_id = wasm[pos]
+        size, body = read_leb_u32(wasm, pos + 1)
+        end = body + size
+        if end > len(wasm):
+            raise ValueError("section %d at offset %d overruns the module" % (sec_id, start))
+        if sec_id != 0:
+            if sec_id not in SECTION_ORDER:
+                raise ValueError("unknown section id %d at offset %d" % (sec_id, start))
+            rank = SECTION_ORDER.index(sec_id)
+            if rank <= last_rank:
+                raise ValueError("section %d out of order or duplicated" % sec_id)
+            last_rank = rank
+        sections.append((sec_id, start, end, body))
+        pos = end
+    return sections
+
+
+def check_function_bodies(wasm, sections):
+    """The function and code sections must declare the same count."""
+    counts = {}
+    for sec_id, _, end, body in sections:
+        if sec_id in (SEC_FUNCTION, SEC_CODE):
+            counts[sec_id], _ = read_leb_u32(wasm[:end], body)
+    if counts.get(SEC_FUNCTION, 0) != counts.get(SEC_CODE, 0):
+        raise ValueError("function section declares %d functions, code section has %d bodies"
+                         % (counts.get(SEC_FUNCTION, 0), counts.get(SEC_CODE, 0)))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: wasm_strip.py IN.wasm OUT.wasm")
+    src_path, out_path = sys.argv[1], sys.argv[2]
+
+    with open(src_path, "rb") as f:
+        wasm = f.read()
+
+    try:
+        sections = split_sections(wasm)
+        check_function_bodies(wasm, sections)
+    except ValueError as e:
+        sys.exit("wasm_strip: %s: %s" % (src_path, e))
+
+    out = bytearray(WASM_HEADER)
+    for sec_id, start, end, _ in sections:
+        if sec_id != 0:
+            out += wasm[start:end]
+
+    with open(out_path, "wb") as f:
+        f.write(out)
+
+    print("[wasm] %s: %d -> %d bytes (%d custom section(s) stripped)"
+          % (out_path, len(wasm), len(out),
+             sum(1 for s in sections if s[0] == 0)))
+
+
+if __name__ == "__main__":
+    main()
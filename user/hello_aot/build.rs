@@ -0,0 +1,44 @@
+// =============================================================================
+// hello_aot — Build Script
+// =============================================================================
+//
+// Tells the linker to use our custom linker script that places the binary
+// at 0x400000 (userspace base address), and compiles the guest module to
+// x86_64 assembly with tools/wasm_aot.py for `global_asm!`.
+//
+// MNOS_AOT_WASM names the .wasm to compile (the Makefile passes the
+// stripped hello_wasm module); it defaults to where `make wasm-hello`
+// writes it.
+// =============================================================================
+
+use std::path::PathBuf;
+use std::process::Command;
+
+fn main() {
+    let manifest_dir = PathBuf::from(std::env::var("CARGO_MANIFEST_DIR").unwrap());
+    println!("cargo:rustc-link-arg=-T{}/linker.ld", manifest_dir.display());
+    println!("cargo:rerun-if-changed=linker.ld");
+
+    let workspace = manifest_dir.join("../..");
+    let compiler = workspace.join("tools/wasm_aot.py");
+    let wasm = std::env::var_os("MNOS_AOT_WASM")
+        .map(PathBuf::from)
+        .unwrap_or_else(|| workspace.join("target/hello_wasm.stripped.wasm"));
+    let asm = PathBuf::from(std::env::var("OUT_DIR").unwrap()).join("hello_wasm.s");
+
+    let status = Command::new("python3")
+        .arg(&compiler)
+        .arg(&wasm)
+        .arg(&asm)
+        .status()
+        .expect("failed to run python3 tools/wasm_aot.py");
+    if !status.success() {
+        panic!("wasm_aot.py failed on {} (run `make wasm-hello` first)", wasm.display());
+    }
+
+    println!("cargo:rustc-env=MNOS_AOT_ASM={}", asm.display());
+    println!("cargo:rerun-if-env-changed=MNOS_AOT_WASM");
+    println!("cargo:rerun-if-changed={}", wasm.display());
+    println!("cargo:rerun-if-changed={}", compiler.display());
+    println!("cargo:rerun-if-changed={}", workspace.join("tools/wasm_strip.py").display());
+}
@@ -0,0 +1,202 @@
+// =============================================================================
+// hello_aot — Native Host for the AOT-Compiled hello_wasm Guest
+// =============================================================================
+//
+// init runs the hello_wasm guest twice: once as a .wasm module under the
+// wasmi interpreter, and once as this binary — the same .wasm module
+// compiled ahead of time to x86_64 by tools/wasm_aot.py (build.rs) and
+// included with `global_asm!`. No Rust of the guest is linked in; this
+// crate is only the host side of the module's imports and exports.
+//
+// IMPORT ABI:
+//   The module imports `env.host_print(ptr: i32, len: i32)`. The compiler
+//   turns that into a SysV call to `wasm_import_host_print` below, where
+//   `ptr` is an offset into linear memory, exactly as wasmi sees it.
+//
+// SANDBOX:
+//   Linear memory is the `.wasm_memory` section (linker.ld), with 8 GiB +
+//   4 KiB of unmapped guard region above it. Compiled loads and stores
+//   address it as r15 + u32 + u32, so an out-of-bounds access faults in
+//   the guard region; the kernel then kills this process only. Checks
+//   that cannot be left to the MMU (division, call_indirect, bulk memory,
+//   native stack depth) call `wasm_trap`. The process itself holds
+//   nothing but the COM1 IoPort capability `host_print` needs.
+//
+// BENCHMARK:
+//   If init asks for it (`GuestBoot::bench_iters`), the host times the
+//   module's `compute(n)` export and prints a `guest_compute` JSON line
+//   with `"mode":"aot"`, next to init's `"mode":"wasmi"` line for the
+//   same n.
+//
+// =============================================================================
+
+#![no_std]
+#![no_main]
+
+use libmnos::guest::GuestBoot;
+
+// The compiled module: wasm_init, wasm_export_*, linear memory.
+core::arch::global_asm!(include_str!(env!("MNOS_AOT_ASM")));
+
+unsafe extern "C" {
+    fn wasm_init();
+    fn wasm_export_run_guest();
+    fn wasm_export_compute(n: i32) -> i32;
+
+    /// Address and size of linear memory.
+    static wasm_memory_base: u64;
+    static wasm_memory_bytes: u64;
+
+    /// Lowest RSP compiled code may use; every compiled prologue checks it.
+    static mut wasm_stack_limit: u64;
+}
+
+/// COM1 data register (Transmit Holding / Receive Buffer).
+const COM1_DATA: u16 = 0x3F8;
+
+/// COM1 Line Status Register.
+const COM1_LSR: u16 = 0x3FD;
+
+/// Native stack the compiled code may use, out of init's 64 KiB; the rest
+/// is left for `_start` and the host functions.
+const WASM_STACK_BUDGET: u64 = 48 * 1024;
+
+/// `wasm_trap` codes (tools/wasm_aot.py).
+const TRAP_NAMES: [&[u8]; 6] = [
+    b"unreachable",
+    b"integer divide by zero",
+    b"integer overflow",
+    b"out of bounds memory access",
+    b"indirect call type mismatch",
+    b"native stack exhausted",
+];
+
+/// CNode slot of the COM1 IoPort capability (from the boot page).
+static mut IO_SLOT: u64 = u64::MAX;
+
+/// Guest entry — init's SYS_SPAWN_THREAD lands here.
+#[unsafe(no_mangle)]
+#[unsafe(link_section = ".text.entry")]
+pub extern "C" fn _start() -> ! {
+    // SAFETY: init maps the boot page before spawning this thread.
+    let Some(boot) = (unsafe { GuestBoot::get() }) else { halt_loop() };
+    unsafe { IO_SLOT = boot.io_slot };
+
+    let rsp: u64;
+    unsafe { core::arch::asm!("mov {}, rsp", out(reg) rsp, options(nomem, nostack)) };
+    unsafe {
+        wasm_stack_limit = rsp - WASM_STACK_BUDGET;
+        wasm_init();
+    }
+
+    print_str(b"[hello_aot] AOT-compiled Wasm guest running in its own process\r\n");
+    unsafe { wasm_export_run_guest() };
+
+    if boot.bench_iters != 0 {
+        let n = boot.bench_iters.min(i32::MAX as u64) as i32;
+        let t0 = read_tsc();
+        let result = unsafe { wasm_export_compute(core::hint::black_box(n)) };
+        let t1 = read_tsc();
+
+        print_str(b"{\"bench\":\"guest_compute\",\"mode\":\"aot\",\"iters\":");
+        print_dec(n as u64);
+        print_str(b",\"unit\":\"tsc_cycles\",\"cycles\":");
+        print_dec(t1 - t0);
+        print_str(b",\"result\":");
+        print_dec(result as u32 as u64);
+        print_str(b"}\r\n");
+    }
+
+    halt_loop();
+}
+
+// =============================================================================
+// Host side of the module
+// =============================================================================
+
+/// `env.host_print(ptr, len)`: prints `len` bytes of linear memory at
+/// offset `ptr` to COM1. Out-of-range requests print nothing, as in
+/// init's wasmi host function.
+#[unsafe(no_mangle)]
+extern "C" fn wasm_import_host_print(ptr: u32, len: u32) {
+    let (base, size) = unsafe { (wasm_memory_base, wasm_memory_bytes) };
+    let end = ptr as u64 + len as u64;
+    if end > size {
+        return;
+    }
+    // SAFETY: [ptr, ptr + len) lies inside linear memory.
+    let bytes = unsafe { core::slice::from_raw_parts((base + ptr as u64) as *const u8, len as usize) };
+    print_str(bytes);
+}
+
+/// Called by compiled code on a Wasm trap. The guest's state is no longer
+/// meaningful, so it reports the trap and stops.
+#[unsafe(no_mangle)]
+extern "C" fn wasm_trap(code: u32) -> ! {
+    print_str(b"[hello_aot] wasm trap: ");
+    print_str(TRAP_NAMES.get(code as usize).copied().unwrap_or(b"unknown"));
+    print_str(b"\r\n");
+    halt_loop();
+}
+
+// =============================================================================
+// Serial I/O Helpers
+// =============================================================================
+
+/// Prints a byte string to COM1: one SYS_PORT_WRITE per 16 bytes, queued
+/// in the kernel's console ring.
+fn print_str(s: &[u8]) {
+    let slot = unsafe { IO_SLOT };
+    let pacing = libmnos::io::TxPacing::uart16550(COM1_LSR);
+    let _ = libmnos::io::sys_port_write(slot, COM1_DATA, s, pacing);
+}
+
+/// Prints a u64 in decimal to COM1.
+fn print_dec(mut n: u64) {
+    let mut buf = [0u8; 20];
+    let mut i = buf.len();
+    loop {
+        i -= 1;
+        buf[i] = b'0' + (n % 10) as u8;
+        n /= 10;
+        if n == 0 {
+            break;
+        }
+    }
+    print_str(&buf[i..]);
+}
+
+/// Reads the TSC, fenced so the timed code can't leak across the read.
+#[inline(always)]
+fn read_tsc() -> u64 {
+    let low: u32;
+    let high: u32;
+    unsafe {
+        core::arch::asm!(
+            "lfence",
+            "rdtsc",
+            "lfence",
+            out("eax") low,
+            out("edx") high,
+            options(nomem, nostack)
+        );
+    }
+    ((high as u64) << 32) | (low as u64)
+}
+
+/// Parks the guest once it is done (there is no exit syscall yet).
+fn halt_loop() -> ! {
+    loop {
+        core::hint::spin_loop();
+    }
+}
+
+// =============================================================================
+// Panic Handler (required for #![no_std] binaries)
+// =============================================================================
+
+#[panic_handler]
+fn panic(_info: &core::panic::PanicInfo) -> ! {
+    print_str(b"[hello_aot] panic\r\n");
+    halt_loop();
+}
@@ -0,0 +1,38 @@
+// =============================================================================
+// init — Ring 3 Loader for Native (AOT) Guests
+// =============================================================================
+//
+// Starts an AOT-compiled guest (e.g. `hello_aot` from the initrd) in a
+// process of its own through the ELF loader (`loader.rs`), then:
+//
+//   1. boot page at GUEST_BOOT_VADDR (libmnos::guest), read-only
+//   2. SYS_DELEGATE the COM1 IoPort cap → guest slot GUEST_IO_SLOT
+//   3. SYS_SPAWN_THREAD at the ELF entry
+//
+// =============================================================================
+
+use libmnos::guest::{GuestBoot, GUEST_BOOT_MAGIC, GUEST_BOOT_VADDR};
+use libmnos::process::sys_delegate;
+
+use crate::loader::{self, LoadError};
+use crate::IO_SLOT;
+
+/// Guest CNode slot for the COM1 IoPort capability (same as init's).
+const GUEST_IO_SLOT: u64 = 2;
+
+/// Loads `image` into a new process and starts it. `bench_iters` is passed
+/// through the boot page (0 = no benchmark).
+pub fn spawn(image: &[u8], bench_iters: u64) -> Result<(), LoadError> {
+    let child = loader::load(image)?;
+
+    // Boot page
+    let dst = loader::stage_page()?;
+    let boot = GuestBoot { magic: GUEST_BOOT_MAGIC, io_slot: GUEST_IO_SLOT, bench_iters };
+    unsafe { core::ptr::write(dst as *mut GuestBoot, boot) };
+    loader::map_staged(child.proc_slot, GUEST_BOOT_VADDR, 0)?;
+
+    sys_delegate(child.proc_slot, IO_SLOT, GUEST_IO_SLOT)
+        .map_err(|e| LoadError::Syscall(b"delegate", e.0))?;
+
+    loader::start(&child)
+}
@@ -0,0 +1,185 @@
+// =============================================================================
+// init — Ring 3 ELF Process Loader
+// =============================================================================
+//
+// Starts an ELF from the initrd (serial_drv, hello_aot) in a process of
+// its own, using only capabilities init already holds:
+//
+//   1. SYS_SPAWN_PROCESS                  → empty process, Process cap
+//   2. per PT_LOAD page:
+//        SYS_ALLOC_MEMORY → frame cap in LOADER_SCRATCH_SLOT
+//        map into init's staging window, copy the file bytes in
+//        SYS_MAP_MEMORY into the child (W / X from p_flags)
+//      pages with no file bytes (.bss, Wasm linear memory) are mapped
+//      straight into the child: frames arrive zeroed
+//   3. stack pages below STACK_TOP (the page under them stays unmapped
+//      as a guard)
+//   4. the caller delegates capabilities and maps extra pages
+//      (`stage_page` + `map_staged`)
+//   5. `start`: SYS_SPAWN_THREAD at the ELF entry
+//
+// KNOWN HOLE: there is no unmap syscall yet, so every staged page stays
+// mapped writable in init after the child starts — including the child's
+// code pages. A bug in init could patch a running child's text. The
+// window is only ever written by this loader, and nothing else in init
+// computes addresses inside it.
+//
+// =============================================================================
+
+use kcore::elf::{self, PF_W, PF_X, PT_LOAD};
+use libmnos::process::{
+    sys_alloc_memory, sys_drop_cap, sys_map_memory, sys_spawn_process, sys_spawn_thread,
+};
+
+use crate::{PMM_SLOT, SELF_PROC_SLOT};
+
+/// CNode scratch slot for child frames (the heap keeps SCRATCH_SLOT).
+const LOADER_SCRATCH_SLOT: u64 = 11;
+
+/// Child stack: STACK_PAGES pages ending at STACK_TOP.
+const STACK_TOP: u64 = 0x0080_0000;
+const STACK_PAGES: u64 = 16;
+
+/// Segments must end in the lower canonical half.
+const IMAGE_LIMIT: u64 = 0x0000_8000_0000_0000;
+
+/// init's window for staging child pages while they are filled in.
+const STAGING_BASE: u64 = 0x3000_0000;
+const STAGING_LIMIT: u64 = 0x3800_0000;
+
+pub const PAGE_SIZE: u64 = 4096;
+
+/// SYS_MAP_MEMORY flag bits.
+pub const MAP_WRITABLE: u64 = 0x01;
+pub const MAP_EXECUTABLE: u64 = 0x02;
+
+/// Why a child could not be started.
+#[derive(Debug, Clone, Copy)]
+pub enum LoadError {
+    /// The ELF header or program headers are malformed.
+    BadElf,
+    /// A segment is misaligned, out of bounds, or above IMAGE_LIMIT.
+    BadSegment,
+    /// The staging window is full.
+    StagingFull,
+    /// A syscall failed: which step, and the kernel's error code.
+    Syscall(&'static [u8], u64),
+}
+
+/// A loaded, not yet running child.
+pub struct Child {
+    /// init's CNode slot holding the child's Process capability.
+    pub proc_slot: u64,
+    /// ELF entry point.
+    pub entry: u64,
+}
+
+/// Next free page of the staging window (init is single-threaded here).
+static mut STAGING_NEXT: u64 = STAGING_BASE;
+
+/// Creates a process and maps `image`'s PT_LOAD segments and a stack.
+pub fn load(image: &[u8]) -> Result<Child, LoadError> {
+    let ehdr = elf::validate_header(image).map_err(|_| LoadError::BadElf)?;
+    let entry = ehdr.e_entry;
+    let phdrs = elf::program_headers(image, ehdr);
+
+    // Reject bad images before creating anything.
+    for ph in phdrs.iter().filter(|ph| ph.p_type == PT_LOAD) {
+        let (vaddr, memsz) = (ph.p_vaddr, ph.p_memsz);
+        let (offset, filesz) = (ph.p_offset, ph.p_filesz);
+        if vaddr % PAGE_SIZE != 0
+            || filesz > memsz
+            || vaddr.checked_add(memsz).is_none_or(|end| end > IMAGE_LIMIT)
+            || offset.checked_add(filesz).is_none_or(|end| end > image.len() as u64)
+        {
+            return Err(LoadError::BadSegment);
+        }
+    }
+
+    let child = sys_spawn_process().map_err(|e| LoadError::Syscall(b"spawn_process", e.0))?;
+
+    // Image
+    for ph in phdrs.iter().filter(|ph| ph.p_type == PT_LOAD) {
+        let (vaddr, memsz, offset, filesz) = (ph.p_vaddr, ph.p_memsz, ph.p_offset, ph.p_filesz);
+        let flags = if ph.p_flags & PF_W != 0 { MAP_WRITABLE } else { 0 }
+            | if ph.p_flags & PF_X != 0 { MAP_EXECUTABLE } else { 0 };
+        let file = &image[offset as usize..(offset + filesz) as usize];
+
+        let mut page = vaddr;
+        while page < vaddr + memsz {
+            // Frames arrive zeroed, so only the file-backed part is copied.
+            let start = (page - vaddr) as usize;
+            if start < file.len() {
+                let dst = stage_page()?;
+                let n = file.len().min(start + PAGE_SIZE as usize) - start;
+                unsafe { core::ptr::copy_nonoverlapping(file[start..].as_ptr(), dst, n) };
+                map_staged(child, page, flags)?;
+            } else {
+                map_zeroed(child, page, flags)?;
+            }
+            page += PAGE_SIZE;
+        }
+    }
+
+    // Stack (zeroed frames, no staging needed)
+    for i in 0..STACK_PAGES {
+        map_zeroed(child, STACK_TOP - (i + 1) * PAGE_SIZE, MAP_WRITABLE)?;
+    }
+
+    Ok(Child { proc_slot: child, entry })
+}
+
+/// Starts the child's first thread at its entry point.
+pub fn start(child: &Child) -> Result<(), LoadError> {
+    // Entry RSP ≡ 8 (mod 16), as if `_start` had been called.
+    sys_spawn_thread(child.proc_slot, child.entry, STACK_TOP - 8)
+        .map(|_| ())
+        .map_err(|e| LoadError::Syscall(b"spawn_thread", e.0))
+}
+
+/// Allocates a frame into LOADER_SCRATCH_SLOT and maps it at the next
+/// staging page in init. Returns init's pointer to it; `map_staged` then
+/// hands the frame to the child.
+pub fn stage_page() -> Result<*mut u8, LoadError> {
+    let va = unsafe { STAGING_NEXT };
+    if va >= STAGING_LIMIT {
+        return Err(LoadError::StagingFull);
+    }
+    sys_alloc_memory(PMM_SLOT, LOADER_SCRATCH_SLOT)
+        .map_err(|e| LoadError::Syscall(b"alloc_memory", e.0))?;
+    sys_map_memory(SELF_PROC_SLOT, LOADER_SCRATCH_SLOT, va, MAP_WRITABLE)
+        .map_err(|e| LoadError::Syscall(b"map_memory (staging)", e.0))?;
+    unsafe { STAGING_NEXT = va + PAGE_SIZE };
+    Ok(va as *mut u8)
+}
+
+/// Maps the frame last returned by `stage_page` into the child at `vaddr`
+/// and frees the scratch slot again.
+pub fn map_staged(child: u64, vaddr: u64, flags: u64) -> Result<(), LoadError> {
+    let mapped = sys_map_memory(child, LOADER_SCRATCH_SLOT, vaddr, flags);
+    let _ = sys_drop_cap(LOADER_SCRATCH_SLOT);
+    mapped.map_err(|e| LoadError::Syscall(b"map_memory (child)", e.0))
+}
+
+/// Maps a fresh zeroed frame into the child at `vaddr` (never in init).
+pub fn map_zeroed(child: u64, vaddr: u64, flags: u64) -> Result<(), LoadError> {
+    sys_alloc_memory(PMM_SLOT, LOADER_SCRATCH_SLOT)
+        .map_err(|e| LoadError::Syscall(b"alloc_memory", e.0))?;
+    map_staged(child, vaddr, flags)
+}
+
+impl LoadError {
+    pub fn print(self) {
+        use crate::{print_dec, print_str};
+        match self {
+            LoadError::BadElf => print_str(b"bad ELF header"),
+            LoadError::BadSegment => print_str(b"bad PT_LOAD segment"),
+            LoadError::StagingFull => print_str(b"staging window full"),
+            LoadError::Syscall(step, code) => {
+                print_str(step);
+                print_str(b" failed, err=");
+                print_dec(code);
+            }
+        }
+    }
+}
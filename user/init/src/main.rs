@@ -10,22 +10,28 @@
 //   Slot 2: IoPort { base: 0x3F8, size: 8 }  — direct COM1 serial output
 //   Slot 3: Process { pid: 1 } (self)        — SYS_MAP_MEMORY on own space
 //   Slot 4: IoPort { base: 0xC000, size: 128 } — Virtio-Block device I/O
+//   Slot 5: Pmu                              — hardware performance counters
+//   Slot 6: Scheduler                        — per-thread CPU accounting
+//   Slot 7: Endpoint { id: 2 }               — serial_drv command channel
+//   Slot 8: Interrupt { irq: 4 }             — COM1 IRQ (for serial_drv)
 //
 // The kernel maps the initrd TarFS pages at virtual address 0x1000_0000
 // (read-only) so Init can parse the archive from Ring 3.
 //
 // SPRINT 11, PHASE 3 PROVES:
-//   1. Ring 3 global allocator (linked_list_allocator) — 4 MiB heap
+//   1. Ring 3 global allocator (size classes + page heap) — grows on demand
 //   2. Capability-gated SYS_ALLOC_MEMORY + SYS_MAP_MEMORY for heap
 //   3. TarFS extraction of a .wasm payload from initrd
 //   4. wasmi WebAssembly interpreter running entirely in Ring 3
 //   5. Wasm add(10, 32) → 42 (computational isolation)
 //   6. host_print() host function registered via wasmi Linker
 //   7. Wasm run_guest() calls host_print(ptr, len)
-//   8. Host reads Wasm linear memory → COM1 via IoPort capability
-//   9. Full chain: Wasm→wasmi→Ring3 Heap→host_print→SYS_PORT_OUT→COM1
+//   8. Host hands a Wasm linear-memory slice → COM1 via IoPort capability
+//   9. Full chain: Wasm→wasmi→host_print→SYS_PORT_WRITE→COM1 (zero-copy)
 //  10. PCI→CAP→Ring3: Dynamic IoPort cap for Virtio-Blk I/O BAR
 //  11. Ring 3 reads Virtio-Blk device features + disk capacity
+//  12. Pooled Wasm instances serving calls on worker threads across cores
+//  13. serial_drv started from the initrd with delegated COM1 caps
 //
 // =============================================================================
 
@@ -34,6 +40,10 @@
 
 extern crate alloc;
 
+mod aot;
+mod loader;
+mod pool;
+
 use alloc::vec::Vec;
 use wasmi::{Caller, Engine, Linker, Module, Store, Value};
 
@@ -53,27 +63,57 @@ const SELF_PROC_SLOT: u64 = 3;
 /// CNode slot 4: IoPort capability for Virtio-Block device (dynamically minted).
 const VIRTIO_SLOT: u64 = 4;
 
+/// CNode slot 5: Pmu capability — program/read performance counters.
+#[cfg(feature = "bench")]
+const PMU_SLOT: u64 = 5;
+
+/// CNode slot 6: Scheduler capability — SYS_THREAD_STATS snapshots.
+const SCHED_SLOT: u64 = 6;
+
+/// CNode slot 7: Endpoint capability — serial_drv's command channel.
+const SERIAL_EP_SLOT: u64 = 7;
+
+/// CNode slot 8: Interrupt capability for COM1 (IRQ 4).
+const COM1_IRQ_SLOT: u64 = 8;
+
+/// TSC cycles between two `top` dumps (~2.5 s on the 1.6 GHz N3710).
+const TOP_INTERVAL_TSC: u64 = 4_000_000_000;
+
+/// Maximum threads shown by `top`.
+const TOP_MAX_THREADS: usize = 64;
+
+/// Maximum cores whose scheduler histograms `top` prints.
+const TOP_MAX_CORES: usize = 8;
+
 /// COM1 data register (Transmit Holding / Receive Buffer).
 const COM1_DATA: u16 = 0x3F8;
 
 /// COM1 Line Status Register.
 const COM1_LSR: u16 = 0x3FD;
 
-/// LSR bit 5: Transmit Holding Register Empty.
-const LSR_TX_EMPTY: u8 = 1 << 5;
-
 /// Virtual address where the kernel maps the initrd TarFS pages.
 const INITRD_BASE: usize = 0x1000_0000;
 
+/// Bytes of linear memory each pooled `touch()` call dirties (two pages).
+const POOL_TOUCH_BYTES: i32 = 8192;
+
+/// Calls in the instance pool's check batch.
+const POOL_CHECK_CALLS: u32 = 64;
+
+/// Rounds of the guest's `compute()` timed under wasmi and AOT.
+#[cfg(feature = "bench")]
+const GUEST_BENCH_ITERS: u64 = 1_000_000;
+
 /// CNode scratch slot for dynamic frame allocation (reused each iteration).
 const SCRATCH_SLOT: u64 = 10;
 
 /// Virtual base address for the Ring 3 heap.
 const HEAP_BASE: u64 = 0x4000_0000;
 
-/// Number of 4 KiB pages for the Ring 3 heap (1000 pages = 4 MiB).
-/// wasmi's parser + JIT tables need ~2-3 MiB for even a trivial module.
-const HEAP_PAGES: u64 = 1000;
+/// Number of 4 KiB pages mapped up front for the Ring 3 heap (1 MiB).
+/// The heap grows on demand past this (wasmi's parser + JIT tables need
+/// ~2-3 MiB for even a trivial module).
+const HEAP_PAGES: u64 = 256;
 
 // =============================================================================
 // Init Entry Point
@@ -111,15 +151,15 @@ pub extern "C" fn _start() -> ! {
     print_str(b" file(s) in initrd\r\n");
 
     // =========================================================================
-    // Phase 3: Bootstrap Ring 3 Heap (4 MiB for wasmi)
+    // Phase 3: Bootstrap Ring 3 Heap (1 MiB up front, grows on demand)
     // =========================================================================
     print_str(b"\r\n[init] Bootstrapping Ring 3 heap...\r\n");
-    print_str(b"[init]   heap_base=0x4000_0000, pages=1000 (4 MiB)\r\n");
+    print_str(b"[init]   heap_base=0x4000_0000, pages=256 (1 MiB, grows on demand)\r\n");
     print_str(b"[init]   alloc_slot=1 (PmmAllocator), proc_slot=3 (self)\r\n");
 
     libmnos::heap::init_heap(HEAP_BASE, HEAP_PAGES, PMM_SLOT, SELF_PROC_SLOT, SCRATCH_SLOT);
 
-    print_str(b"[init]   OK: Heap initialized (4 MiB at 0x4000_0000)\r\n");
+    print_str(b"[init]   OK: Heap initialized (1 MiB at 0x4000_0000)\r\n");
 
     // =========================================================================
     // Phase 4: Quick Vec sanity check
@@ -136,6 +176,16 @@ pub extern "C" fn _start() -> ! {
         print_str(b"[init]   OK: Vec works (3 elements verified)\r\n");
     }
 
+    // =========================================================================
+    // Phase 4.5: Ring 3 microbenchmarks (bench builds only)
+    // =========================================================================
+    #[cfg(feature = "bench")]
+    bench_null_syscall();
+    #[cfg(feature = "bench")]
+    bench_null_syscall_pmu();
+    #[cfg(feature = "bench")]
+    bench_alloc();
+
     // =========================================================================
     // Phase 5: Extract hello_wasm.wasm from TarFS
     // =========================================================================
@@ -165,8 +215,14 @@ pub extern "C" fn _start() -> ! {
 
     // Step 2: Parse the Wasm binary into a Module
     print_str(b"[init]   Parsing Module...\r\n");
+    let parse_start = read_tsc();
     let module = match Module::new(&engine, wasm_bytes) {
-        Ok(m) => m,
+        Ok(m) => {
+            print_str(b"[init]   Module ready in ");
+            print_dec(read_tsc() - parse_start);
+            print_str(b" TSC cycles\r\n");
+            m
+        }
         Err(_) => {
             print_str(b"[init] FATAL: wasmi Module::new() failed!\r\n");
             halt_loop();
@@ -180,33 +236,7 @@ pub extern "C" fn _start() -> ! {
     // Step 4: Create a Linker and register the host_print bridge
     print_str(b"[init]   Creating Linker + registering host_print...\r\n");
     let mut linker = Linker::<()>::new(&engine);
-
-    // Register host_print(ptr: i32, len: i32) — the SFI hardware bridge.
-    // When Wasm calls host_print, wasmi invokes this closure which:
-    //   1. Reads the Wasm linear memory at [ptr..ptr+len]
-    //   2. Prints each byte to COM1 via the IoPort capability (Slot 2)
-    linker.func_wrap("env", "host_print", |caller: Caller<'_, ()>, ptr: i32, len: i32| {
-        // Extract the Wasm module's exported linear memory
-        let memory = match caller.get_export("memory") {
-            Some(ext) => match ext.into_memory() {
-                Some(mem) => mem,
-                None => return,
-            },
-            None => return,
-        };
-
-        // Allocate a buffer on the Ring 3 heap and read from Wasm memory
-        let size = len as usize;
-        let mut buffer = alloc::vec![0u8; size];
-        if memory.read(&caller, ptr as usize, &mut buffer).is_err() {
-            return;
-        }
-
-        // Print each byte to COM1 using polled TX via IoPort capability
-        for &b in &buffer {
-            host_write_byte(b);
-        }
-    }).expect("[init] FATAL: failed to register host_print");
+    register_host_print(&mut linker);
 
     // Step 5: Instantiate the module
     print_str(b"[init]   Instantiating...\r\n");
@@ -262,8 +292,8 @@ pub extern "C" fn _start() -> ! {
     // Phase 8: Call run_guest() — Wasm → Host bridge  (Sprint 10 Phase 3 proof)
     //
     //   Wasm run_guest() → host_print(ptr, len) → wasmi host closure
-    //   → Memory::read from Wasm linear memory → write_byte() per char
-    //   → SYS_PORT_OUT via IoPort capability → COM1 hardware
+    //   → slice of Wasm linear memory (Memory::data, no copy)
+    //   → SYS_PORT_WRITE bursts via IoPort capability → COM1 hardware
     // =========================================================================
     print_str(b"\r\n[init] Calling run_guest() from Wasm...\r\n");
     print_str(b"[init]   (Wasm will call host_print -> COM1 via IoPort cap)\r\n");
@@ -286,6 +316,9 @@ pub extern "C" fn _start() -> ! {
 
     print_str(b"[init]   run_guest() returned successfully\r\n");
 
+    #[cfg(feature = "bench")]
+    bench_guest_compute_wasmi(&mut store, &instance);
+
     // =========================================================================
     // Phase 9: Virtio-Block Device Interrogation from Ring 3
     //
@@ -390,43 +423,177 @@ pub extern "C" fn _start() -> ! {
     print_str(b"  [init] Sprint 11 Phase 3 COMPLETE.\r\n");
     print_str(b"==========================================================\r\n");
 
-    halt_loop();
+    // =========================================================================
+    // Phase 10: Pooled instances on worker threads (see pool.rs)
+    //
+    //   One worker per AP (at least one); the kernel places each on the
+    //   least-loaded core. A check batch runs touch(POOL_TOUCH_BYTES), which
+    //   only returns POOL_TOUCH_BYTES on a correctly reset instance.
+    // =========================================================================
+    print_str(b"\r\n[init] Phase 10: Wasm instance pool\r\n");
+    let cores = online_cores();
+    let workers = cores.saturating_sub(1).clamp(1, pool::MAX_WORKERS);
+    let mut pool_linker = Linker::<()>::new(&engine);
+    register_host_print(&mut pool_linker);
+    match pool::Pool::new(&engine, pool_linker, &module, "touch", workers)
+        .and_then(|p| pool::start(p, workers))
+    {
+        Ok(pool) => {
+            print_str(b"[init]   ");
+            print_dec(pool.len() as u64);
+            print_str(b" instances (");
+            print_dec(pool.memory_bytes() as u64 / 1024);
+            print_str(b" KiB linear memory each), ");
+            print_dec(pool::workers() as u64);
+            print_str(b" workers, ");
+            print_dec(cores as u64);
+            print_str(b" cores\r\n");
+
+            let report = pool::run(POOL_TOUCH_BYTES, POOL_TOUCH_BYTES, POOL_CHECK_CALLS, workers);
+            print_str(if report.mismatched == 0 { b"[init]   OK: " } else { b"[init]   FAIL: " });
+            print_dec(POOL_CHECK_CALLS as u64);
+            print_str(b" pooled calls, ");
+            print_dec(report.mismatched as u64);
+            print_str(b" wrong, ");
+            print_dec(pool.pages_restored.load(core::sync::atomic::Ordering::Relaxed));
+            print_str(b" dirty pages restored\r\n");
+
+            #[cfg(feature = "bench")]
+            bench_wasm_pool(workers);
+        }
+        Err(e) => {
+            print_str(b"[init]   WARN: instance pool not started: ");
+            print_str(e.as_str());
+            if let pool::PoolError::Spawn(code) = e {
+                print_str(b" (error ");
+                print_dec(code);
+                print_str(b")");
+            }
+            print_str(b"\r\n");
+        }
+    }
+
+    // =========================================================================
+    // Phase 11: The same .wasm compiled ahead of time, in its own process
+    //
+    //   Started last: it prints from another core, and would interleave
+    //   with init's own output otherwise.
+    // =========================================================================
+    print_str(b"\r\n[init] Phase 11: Starting hello_aot (native guest)\r\n");
+    #[cfg(feature = "bench")]
+    let bench_iters = GUEST_BENCH_ITERS;
+    #[cfg(not(feature = "bench"))]
+    let bench_iters = 0;
+    match tar_find(initrd, b"hello_aot") {
+        Some(image) => match aot::spawn(image, bench_iters) {
+            Ok(()) => print_str(b"[init]   OK: hello_aot spawned\r\n"),
+            Err(e) => {
+                print_str(b"[init]   WARN: hello_aot not started: ");
+                e.print();
+                print_str(b"\r\n");
+            }
+        },
+        None => print_str(b"[init]   WARN: hello_aot not in initrd\r\n"),
+    }
+
+    // =========================================================================
+    // Phase 12: The Ring 3 serial driver
+    //
+    //   serial_drv takes over COM1 receive (IRQ 4) and serves write
+    //   commands on its endpoint. Transmit stays with the kernel's console
+    //   ring, which SYS_PORT_WRITE feeds.
+    // =========================================================================
+    print_str(b"\r\n[init] Phase 12: Starting serial_drv\r\n");
+    match tar_find(initrd, b"serial_drv") {
+        Some(image) => match spawn_serial_drv(image) {
+            Ok(()) => print_str(b"[init]   OK: serial_drv spawned\r\n"),
+            Err(e) => {
+                print_str(b"[init]   WARN: serial_drv not started: ");
+                e.print();
+                print_str(b"\r\n");
+            }
+        },
+        None => print_str(b"[init]   WARN: serial_drv not in initrd\r\n"),
+    }
+
+    top_loop();
 }
 
 // =============================================================================
-// Serial I/O Helpers
+// Driver Startup
 // =============================================================================
 
-/// Writes a single byte to COM1 using the polled TX path.
-#[inline(always)]
-fn write_byte(byte: u8) {
-    // Wait for Transmit Holding Register Empty
-    loop {
-        match libmnos::io::sys_port_in(IO_SLOT, COM1_LSR) {
-            Ok(lsr) if lsr & LSR_TX_EMPTY != 0 => break,
-            Ok(_) => {}
-            Err(_) => return,
-        }
+/// Loads serial_drv and hands it its capability layout:
+///
+///   Slot 0: IoPort COM1    Slot 1: Endpoint (commands)
+///   Slot 2: Interrupt 4    Slot 3: Process (itself, for its IRQ thread)
+fn spawn_serial_drv(image: &[u8]) -> Result<(), loader::LoadError> {
+    use libmnos::process::sys_delegate;
+
+    let child = loader::load(image)?;
+    for (src, dst) in [(IO_SLOT, 0), (SERIAL_EP_SLOT, 1), (COM1_IRQ_SLOT, 2), (child.proc_slot, 3)] {
+        sys_delegate(child.proc_slot, src, dst)
+            .map_err(|e| loader::LoadError::Syscall(b"delegate", e.0))?;
     }
-    let _ = libmnos::io::sys_port_out(IO_SLOT, COM1_DATA, byte);
+    loader::start(&child)
 }
 
-/// Identical to `write_byte` — used by the wasmi host_print closure.
+// =============================================================================
+// Wasm Host Functions
+// =============================================================================
+
+/// Registers `env.host_print(ptr: i32, len: i32)` — the SFI hardware bridge.
+///
+/// When Wasm calls host_print, wasmi invokes this closure which:
+///   1. Bounds-checks [ptr..ptr+len] against the Wasm linear memory
+///   2. Hands that slice of linear memory to `sys_port_write` (COM1,
+///      IoPort capability in Slot 2) — no heap buffer, no copy
 ///
-/// We define this as a separate free function so the closure passed to
-/// `linker.func_wrap()` can call it without capturing anything. The closure
-/// must satisfy `Send + Sync + 'static`, and calling a free function does
-/// not require any captures.
+/// The closure captures nothing, so it is `Send + Sync + 'static` as
+/// `func_wrap` requires.
+fn register_host_print(linker: &mut Linker<()>) {
+    linker.func_wrap("env", "host_print", |caller: Caller<'_, ()>, ptr: i32, len: i32| {
+        // Extract the Wasm module's exported linear memory
+        let memory = match caller.get_export("memory") {
+            Some(ext) => match ext.into_memory() {
+                Some(mem) => mem,
+                None => return,
+            },
+            None => return,
+        };
+
+        // Borrow the bytes in place; an out-of-bounds range prints nothing
+        let start = ptr as u32 as usize;
+        let end = start.saturating_add(len as u32 as usize);
+        if let Some(bytes) = memory.data(&caller).get(start..end) {
+            write_bytes(bytes);
+        }
+    }).expect("[init] FATAL: failed to register host_print");
+}
+
+// =============================================================================
+// Serial I/O Helpers
+// =============================================================================
+
+/// Writes a byte string to COM1 with one SYS_PORT_WRITE per 16 bytes.
+///
+/// The kernel queues them in its console ring, so the output is paced by
+/// the UART rather than by syscalls.
 #[inline(always)]
-fn host_write_byte(byte: u8) {
-    write_byte(byte);
+fn write_bytes(bytes: &[u8]) {
+    let pacing = libmnos::io::TxPacing::uart16550(COM1_LSR);
+    let _ = libmnos::io::sys_port_write(IO_SLOT, COM1_DATA, bytes, pacing);
+}
+
+/// Writes a single byte to COM1.
+#[inline(always)]
+fn write_byte(byte: u8) {
+    write_bytes(&[byte]);
 }
 
 /// Prints a byte string to COM1.
 fn print_str(s: &[u8]) {
-    for &b in s {
-        write_byte(b);
-    }
+    write_bytes(s);
 }
 
 /// Prints a u64 in decimal to COM1.
@@ -436,16 +603,13 @@ fn print_dec(mut n: u64) {
         return;
     }
     let mut buf = [0u8; 20];
-    let mut i = 0;
+    let mut i = buf.len();
     while n > 0 {
+        i -= 1;
         buf[i] = b'0' + (n % 10) as u8;
         n /= 10;
-        i += 1;
-    }
-    while i > 0 {
-        i -= 1;
-        write_byte(buf[i]);
     }
+    write_bytes(&buf[i..]);
 }
 
 /// Prints a signed i32 in decimal to COM1.
@@ -461,16 +625,21 @@ fn print_i32(n: i32) {
 
 /// Prints a u64 in hexadecimal (0x...) to COM1.
 fn print_hex(n: u64) {
-    print_str(b"0x");
     let hex = b"0123456789ABCDEF";
-    let mut started = false;
-    for shift in (0..16).rev() {
-        let nibble = ((n >> (shift * 4)) & 0xF) as usize;
-        if nibble != 0 || started || shift == 0 {
-            write_byte(hex[nibble]);
-            started = true;
+    let mut buf = [0u8; 18];
+    let mut i = buf.len();
+    let mut rest = n;
+    loop {
+        i -= 1;
+        buf[i] = hex[(rest & 0xF) as usize];
+        rest >>= 4;
+        if rest == 0 {
+            break;
         }
     }
+    i -= 2;
+    buf[i..i + 2].copy_from_slice(b"0x");
+    write_bytes(&buf[i..]);
 }
 
 // =============================================================================
@@ -585,11 +754,423 @@ fn parse_octal(field: &[u8]) -> u64 {
 // Utility
 // =============================================================================
 
-/// Infinite loop — Init is done. In a future sprint this would idle-loop
-/// waiting for child process events.
+// =============================================================================
+// Microbenchmarks (feature = "bench")
+// =============================================================================
+
+/// Number of timed SYS_NULL calls.
+#[cfg(feature = "bench")]
+const BENCH_ITERS: usize = 4096;
+
+/// Reads the TSC, fenced so the syscall can't leak across the read.
+#[cfg(feature = "bench")]
+#[inline(always)]
+fn bench_tsc() -> u64 {
+    let low: u32;
+    let high: u32;
+    unsafe {
+        core::arch::asm!(
+            "lfence",
+            "rdtsc",
+            "lfence",
+            out("eax") low,
+            out("edx") high,
+            options(nomem, nostack)
+        );
+    }
+    ((high as u64) << 32) | (low as u64)
+}
+
+/// Times SYS_NULL round trips and prints one JSON line in the same format
+/// as the kernel suite (`kernel/src/bench.rs`).
+#[cfg(feature = "bench")]
+fn bench_null_syscall() {
+    let mut overhead = u64::MAX;
+    for _ in 0..BENCH_ITERS {
+        let t0 = bench_tsc();
+        let t1 = bench_tsc();
+        overhead = overhead.min(t1 - t0);
+    }
+
+    let mut samples: Vec<u64> = Vec::with_capacity(BENCH_ITERS);
+    for _ in 0..BENCH_ITERS {
+        let t0 = bench_tsc();
+        core::hint::black_box(libmnos::syscall::sys_null());
+        let t1 = bench_tsc();
+        samples.push((t1 - t0).saturating_sub(overhead));
+    }
+    samples.sort_unstable();
+    let n = samples.len();
+    let sum: u64 = samples.iter().sum();
+
+    print_str(b"{\"bench\":\"null_syscall\",\"iters\":");
+    print_dec(n as u64);
+    print_str(b",\"unit\":\"tsc_cycles\",\"min\":");
+    print_dec(samples[0]);
+    print_str(b",\"median\":");
+    print_dec(samples[n / 2]);
+    print_str(b",\"p99\":");
+    print_dec(samples[(n * 99) / 100]);
+    print_str(b",\"max\":");
+    print_dec(samples[n - 1]);
+    print_str(b",\"mean\":");
+    print_dec(sum / n as u64);
+    print_str(b"}\r\n");
+}
+
+/// Counts retired instructions and cycles per SYS_NULL round trip with the
+/// per-thread PMU counters (read via RDPMC). Prints a JSON line, or a
+/// `"skipped"` line when the CPU has no PMU (QEMU/TCG).
+#[cfg(feature = "bench")]
+fn bench_null_syscall_pmu() {
+    use libmnos::pmu;
+
+    let info = match pmu::sys_pmu_info(PMU_SLOT) {
+        Ok(info) if info.counters >= 2 => info,
+        _ => {
+            print_str(b"{\"bench\":\"null_syscall_pmu\",\"skipped\":\"no_pmu\"}\r\n");
+            return;
+        }
+    };
+    let events = pmu::USR | pmu::OS;
+    if pmu::sys_pmu_config(PMU_SLOT, 0, pmu::EVENT_INSTRUCTIONS | events).is_err()
+        || pmu::sys_pmu_config(PMU_SLOT, 1, pmu::EVENT_CYCLES | events).is_err()
+    {
+        print_str(b"{\"bench\":\"null_syscall_pmu\",\"skipped\":\"config\"}\r\n");
+        return;
+    }
+
+    let (i0, c0) = unsafe { (pmu::rdpmc(0), pmu::rdpmc(1)) };
+    for _ in 0..BENCH_ITERS {
+        core::hint::black_box(libmnos::syscall::sys_null());
+    }
+    let (i1, c1) = unsafe { (pmu::rdpmc(0), pmu::rdpmc(1)) };
+    let mask = if info.width >= 64 { u64::MAX } else { (1u64 << info.width) - 1 };
+
+    print_str(b"{\"bench\":\"null_syscall_pmu\",\"iters\":");
+    print_dec(BENCH_ITERS as u64);
+    print_str(b",\"pmu_version\":");
+    print_dec(info.version as u64);
+    print_str(b",\"instructions_per_iter\":");
+    print_dec((i1.wrapping_sub(i0) & mask) / BENCH_ITERS as u64);
+    print_str(b",\"cycles_per_iter\":");
+    print_dec((c1.wrapping_sub(c0) & mask) / BENCH_ITERS as u64);
+    print_str(b"}\r\n");
+
+    let _ = pmu::sys_pmu_config(PMU_SLOT, 0, 0);
+    let _ = pmu::sys_pmu_config(PMU_SLOT, 1, 0);
+}
+
+/// Times `compute(GUEST_BENCH_ITERS)` under wasmi. hello_aot prints the
+/// matching `"mode":"aot"` line; the `result` fields must agree.
+#[cfg(feature = "bench")]
+fn bench_guest_compute_wasmi(store: &mut Store<()>, instance: &wasmi::Instance) {
+    let Some(compute) = instance.get_func(&*store, "compute") else {
+        print_str(b"{\"bench\":\"guest_compute\",\"mode\":\"wasmi\",\"skipped\":\"no_export\"}\r\n");
+        return;
+    };
+    let mut results = [Value::I32(0)];
+    let t0 = bench_tsc();
+    let ok = compute.call(&mut *store, &[Value::I32(GUEST_BENCH_ITERS as i32)], &mut results).is_ok();
+    let t1 = bench_tsc();
+    let result = match results[0] {
+        Value::I32(v) if ok => v,
+        _ => {
+            print_str(b"{\"bench\":\"guest_compute\",\"mode\":\"wasmi\",\"skipped\":\"call\"}\r\n");
+            return;
+        }
+    };
+
+    print_str(b"{\"bench\":\"guest_compute\",\"mode\":\"wasmi\",\"iters\":");
+    print_dec(GUEST_BENCH_ITERS);
+    print_str(b",\"unit\":\"tsc_cycles\",\"cycles\":");
+    print_dec(t1 - t0);
+    print_str(b",\"result\":");
+    print_dec(result as u32 as u64);
+    print_str(b"}\r\n");
+}
+
+/// Pooled calls timed per worker count.
+#[cfg(feature = "bench")]
+const POOL_BENCH_CALLS: u32 = 2048;
+
+/// Runs the same batch of pooled `touch()` calls on 1, 2, … `workers`
+/// workers and prints one JSON line per count. Throughput scales with
+/// cores while `cycles` drops as 1/workers.
+#[cfg(feature = "bench")]
+fn bench_wasm_pool(workers: usize) {
+    for active in 1..=workers {
+        let report = pool::run(POOL_TOUCH_BYTES, POOL_TOUCH_BYTES, POOL_BENCH_CALLS, active);
+        print_str(b"{\"bench\":\"wasm_pool\",\"export\":\"touch\",\"workers\":");
+        print_dec(active as u64);
+        print_str(b",\"calls\":");
+        print_dec(POOL_BENCH_CALLS as u64);
+        print_str(b",\"unit\":\"tsc_cycles\",\"cycles\":");
+        print_dec(report.cycles);
+        print_str(b",\"cycles_per_call\":");
+        print_dec(report.cycles / POOL_BENCH_CALLS as u64);
+        print_str(b",\"wrong\":");
+        print_dec(report.mismatched as u64);
+        print_str(b"}\r\n");
+    }
+}
+
+/// Live allocations the allocator benchmark keeps around.
+#[cfg(feature = "bench")]
+const ALLOC_SLOTS: usize = 512;
+
+/// Alloc/free pairs timed per allocator.
+#[cfg(feature = "bench")]
+const ALLOC_OPS: usize = 50_000;
+
+/// Region handed to the linked-list baseline.
+#[cfg(feature = "bench")]
+const ALLOC_BASELINE_BYTES: usize = 2 * 1024 * 1024;
+
+/// Replays the same pseudo-random alloc/free mix against the old
+/// first-fit `LinkedListHeap` and the global size-class allocator, and
+/// prints one JSON line per allocator.
+///
+/// The mix is wasmi-shaped: mostly 8–256 byte objects, one in sixteen up
+/// to 4 KiB, with ALLOC_SLOTS objects alive at any time.
+#[cfg(feature = "bench")]
+fn bench_alloc() {
+    use core::alloc::{GlobalAlloc, Layout};
+    use libmnos::malloc::LinkedListHeap;
+
+    // The baseline gets its own region, carved from the global heap.
+    let mut region = alloc::vec![0u8; ALLOC_BASELINE_BYTES];
+    let baseline = unsafe { LinkedListHeap::new(region.as_mut_ptr(), region.len()) };
+
+    bench_alloc_one(b"alloc_linked_list", &baseline);
+    bench_alloc_one(b"alloc_size_class", &libmnos::HEAP);
+
+    fn bench_alloc_one(name: &[u8], heap: &dyn GlobalAlloc) {
+        let mut live: [(*mut u8, usize); ALLOC_SLOTS] = [(core::ptr::null_mut(), 0); ALLOC_SLOTS];
+        let mut seed: u64 = 0x2545_F491_4F6C_DD1D;
+        let mut failed = 0u64;
+
+        let t0 = bench_tsc();
+        for _ in 0..ALLOC_OPS {
+            seed = seed.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            let r = seed >> 33;
+            let slot = (r as usize) % ALLOC_SLOTS;
+            let size = if r & 0xF0_0000 == 0 { 256 + (r >> 8) as usize % 3840 } else { 8 + (r >> 8) as usize % 248 };
+
+            let (old, old_size) = live[slot];
+            unsafe {
+                if !old.is_null() {
+                    heap.dealloc(old, Layout::from_size_align_unchecked(old_size, 8));
+                }
+                let p = heap.alloc(Layout::from_size_align_unchecked(size, 8));
+                if p.is_null() {
+                    failed += 1;
+                }
+                live[slot] = (p, size);
+            }
+        }
+        let t1 = bench_tsc();
+
+        for &(p, size) in live.iter() {
+            if !p.is_null() {
+                unsafe { heap.dealloc(p, Layout::from_size_align_unchecked(size, 8)) };
+            }
+        }
+
+        print_str(b"{\"bench\":\"");
+        print_str(name);
+        print_str(b"\",\"ops\":");
+        print_dec(ALLOC_OPS as u64);
+        print_str(b",\"live\":");
+        print_dec(ALLOC_SLOTS as u64);
+        print_str(b",\"unit\":\"tsc_cycles\",\"per_op\":");
+        print_dec((t1 - t0) / ALLOC_OPS as u64);
+        print_str(b",\"failed\":");
+        print_dec(failed);
+        print_str(b",\"heap_mapped\":");
+        print_dec(libmnos::heap::mapped_bytes());
+        print_str(b"}\r\n");
+    }
+}
+
+// =============================================================================
+// top — periodic per-thread CPU accounting dump
+// =============================================================================
+
+/// Init's idle loop: every TOP_INTERVAL_TSC cycles, snapshots the kernel's
+/// per-thread accounting (SYS_THREAD_STATS) and prints each thread's share
+/// of one CPU since the previous snapshot, then per-process totals and the
+/// per-core scheduler histograms (SYS_SCHED_HIST).
+///
+/// Falls back to `halt_loop()` if the Scheduler capability is missing.
+fn top_loop() -> ! {
+    use libmnos::sched::{self, ThreadStat};
+
+    let mut prev: Vec<ThreadStat> = Vec::new();
+    let mut prev_tsc = 0u64;
+    let mut cur: Vec<ThreadStat> = alloc::vec![ThreadStat::default(); TOP_MAX_THREADS];
+    let mut hist: Vec<sched::SchedHist> = alloc::vec![sched::SchedHist::EMPTY; TOP_MAX_CORES];
+
+    loop {
+        let snap = match sched::sys_thread_stats(SCHED_SLOT, &mut cur) {
+            Ok(s) => s,
+            Err(_) => {
+                print_str(b"[top] SYS_THREAD_STATS failed -- top disabled\r\n");
+                halt_loop();
+            }
+        };
+        let rows = &cur[..snap.written];
+
+        if prev_tsc != 0 {
+            let elapsed = snap.tsc.wrapping_sub(prev_tsc).max(1);
+            print_str(b"\r\n[top] threads=");
+            print_dec(snap.live as u64);
+            print_str(b" interval_tsc=");
+            print_dec(elapsed);
+            print_str(b"\r\n[top]   TID  PID S  CPU%  SYS% WAIT%  SWITCH  SYSCALL     IPC NAME\r\n");
+
+            // Per-process totals: (pid, run delta, sys delta).
+            let mut procs: Vec<(u64, u64, u64)> = Vec::new();
+            for r in rows {
+                let old = prev.iter().find(|p| p.tid == r.tid).copied().unwrap_or_default();
+                let run = r.run_tsc.wrapping_sub(old.run_tsc);
+                let sys = r.sys_tsc.wrapping_sub(old.sys_tsc);
+                let wait = r.wait_tsc.wrapping_sub(old.wait_tsc);
+
+                print_str(b"[top] ");
+                print_padded(r.tid, 5);
+                print_padded(r.pid, 5);
+                print_str(match r.state {
+                    sched::STATE_READY => b" R",
+                    sched::STATE_RUNNING => b" *",
+                    sched::STATE_BLOCKED_SEND | sched::STATE_BLOCKED_RECV | sched::STATE_BLOCKED_WAIT => b" B",
+                    _ => b" D",
+                });
+                print_percent(run, elapsed);
+                print_percent(sys, elapsed);
+                print_percent(wait, elapsed);
+                print_padded(r.dispatches.wrapping_sub(old.dispatches), 8);
+                print_padded(r.syscalls.wrapping_sub(old.syscalls), 9);
+                print_padded(r.ipc_sends.wrapping_sub(old.ipc_sends)
+                    + r.ipc_recvs.wrapping_sub(old.ipc_recvs), 8);
+                print_str(b" ");
+                print_str(r.name());
+                print_str(b"\r\n");
+
+                match procs.iter_mut().find(|p| p.0 == r.pid) {
+                    Some(p) => { p.1 += run; p.2 += sys; }
+                    None => procs.push((r.pid, run, sys)),
+                }
+            }
+            for (pid, run, sys) in procs {
+                print_str(b"[top] pid ");
+                print_dec(pid);
+                print_str(b": cpu");
+                print_percent(run, elapsed);
+                print_str(b"% sys");
+                print_percent(sys, elapsed);
+                print_str(b"%\r\n");
+            }
+
+            if let Ok(n) = sched::sys_sched_hist(SCHED_SLOT, &mut hist) {
+                for h in &hist[..n] {
+                    print_hist(h.core, b"wakeup", &h.wakeup);
+                    print_hist(h.core, b"queued", &h.queued);
+                    print_hist(h.core, b"slice", &h.slice);
+                    print_hist(h.core, b"rq_depth", &h.rq_depth);
+                    print_str(b"[wake] core=");
+                    print_dec(h.core);
+                    print_str(b" hot=");
+                    print_dec(h.wake_hot);
+                    print_str(b" pulled=");
+                    print_dec(h.wake_pulled);
+                    print_str(b" migrated=");
+                    print_dec(h.wake_migrated);
+                    print_str(b"\r\n");
+                }
+            }
+        }
+
+        prev.clear();
+        prev.extend_from_slice(rows);
+        prev_tsc = snap.tsc;
+
+        while read_tsc().wrapping_sub(prev_tsc) < TOP_INTERVAL_TSC {
+            core::hint::spin_loop();
+        }
+    }
+}
+
+/// Number of cores running the scheduler (those with scheduler
+/// histograms), or 1 if the Scheduler capability is missing.
+fn online_cores() -> usize {
+    let mut hist = alloc::vec![libmnos::sched::SchedHist::EMPTY; TOP_MAX_CORES];
+    libmnos::sched::sys_sched_hist(SCHED_SLOT, &mut hist).unwrap_or(1).max(1)
+}
+
+/// Prints one cumulative log2 histogram as `[hist] core=N name b:count ...`,
+/// non-empty buckets only (bucket b holds values in [2^(b-1), 2^b)).
+fn print_hist(core: u64, name: &[u8], buckets: &[u64]) {
+    print_str(b"[hist] core=");
+    print_dec(core);
+    print_str(b" ");
+    print_str(name);
+    for (b, &count) in buckets.iter().enumerate() {
+        if count != 0 {
+            print_str(b" ");
+            print_dec(b as u64);
+            print_str(b":");
+            print_dec(count);
+        }
+    }
+    print_str(b"\r\n");
+}
+
+/// Prints `n` right-aligned in a field of `width` characters.
+fn print_padded(n: u64, width: usize) {
+    let mut digits = 1;
+    let mut t = n;
+    while t >= 10 {
+        t /= 10;
+        digits += 1;
+    }
+    for _ in digits..width {
+        write_byte(b' ');
+    }
+    print_dec(n);
+}
+
+/// Prints `part / whole` as a percentage with one decimal, width 6.
+fn print_percent(part: u64, whole: u64) {
+    let tenths = (part as u128 * 1000 / whole as u128) as u64;
+    print_padded(tenths / 10, 4);
+    write_byte(b'.');
+    write_byte(b'0' + (tenths % 10) as u8);
+}
+
+/// Reads the TSC (for the `top` interval timer).
+#[inline(always)]
+fn read_tsc() -> u64 {
+    let low: u32;
+    let high: u32;
+    unsafe {
+        core::arch::asm!(
+            "rdtsc",
+            out("eax") low,
+            out("edx") high,
+            options(nomem, nostack)
+        );
+    }
+    ((high as u64) << 32) | (low as u64)
+}
+
+/// Infinite sleep — Init is done. In a future sprint this would wait for
+/// child process events. Sleeps on a futex nobody wakes, so the thread
+/// gives its core away instead of spinning.
 fn halt_loop() -> ! {
+    static PARKED: core::sync::atomic::AtomicU32 = core::sync::atomic::AtomicU32::new(0);
     loop {
-        core::hint::spin_loop();
+        let _ = libmnos::sync::futex_wait(&PARKED, 0);
     }
 }
 
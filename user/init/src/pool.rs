@@ -0,0 +1,489 @@
+// =============================================================================
+// init — Pooled Wasm Instances on Worker Threads
+// =============================================================================
+//
+// Phase 6 runs one Store/Instance on init's own thread. To serve many short
+// invocations, the pool keeps several instances of one module, all created
+// up front, and runs calls on worker threads. Worker i pins itself to
+// core i + 1, leaving core 0 to init's main thread, so the workers spread
+// over the machine:
+//
+//   main:     run(arg, total) ── CURSOR = gen:0 ──┐
+//                                                 ▼
+//   worker 0 (core 1):  claim job → checkout slot → call → reset → checkin
+//   worker 1 (core 2):  claim job → checkout slot → call → reset → checkin
+//   ...
+//   main:     ◀── DONE == total
+//
+// PRE-INSTANTIATED SLOTS:
+//   Each slot owns a Store, its Instance and that instance's linear memory,
+//   all allocated — and so mapped — when the pool is built. Nothing on the
+//   call path parses, links or allocates a memory.
+//
+// RESET BETWEEN USES:
+//   A pristine copy of linear memory is taken right after the first
+//   instantiation (one copy, shared by every slot). After each call the slot
+//   copies back only the 4 KiB pages that differ from it: a short call
+//   dirties a few stack and data pages, not the whole memory. A slot whose
+//   call trapped (globals and memory in an unknown state) or whose memory
+//   grew is instantiated afresh instead.
+//
+//   Which pages to look at comes from the MMU. Workers pin themselves to a
+//   core, and SYS_VM_DIRTY reports (and clears) the dirty bits of the
+//   pages wholly inside the slot's memory, so only those pages — plus the
+//   two partial pages at its ends, which other heap objects share — are
+//   compared. The bits are only exact while every write since they were
+//   cleared came from the same core, so a slot remembers the core that
+//   cleared them (`tracked_on`). A reset on any other core, or by an
+//   unpinned worker, compares every page and starts tracking afresh.
+//
+// RETIRED SLOTS:
+//   A slot that cannot be re-instantiated (out of memory) stays busy for
+//   good. Once every slot is retired, calls fail with `Exhausted` instead
+//   of waiting for a slot that will never come back.
+//
+// WAITING:
+//   Idle workers sleep on EPOCH (the low half of the batch generation)
+//   with libmnos's futex wait: `run` bumps it and wakes them all. The
+//   caller sleeps on DONE until the worker finishing the last job wakes
+//   it. Jobs are claimed with one CAS on CURSOR, whose high half is the
+//   batch generation: a worker late from one batch cannot claim a job of
+//   the next.
+//
+// All slots share one Engine. wasmi only takes its engine locks briefly
+// (code lookup, stack reuse) around a call, so calls on different slots
+// run in parallel.
+//
+// =============================================================================
+
+use alloc::boxed::Box;
+use alloc::vec::Vec;
+use core::cell::UnsafeCell;
+use core::ops::Range;
+use core::ptr;
+use core::sync::atomic::{AtomicBool, AtomicI32, AtomicPtr, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+
+use libmnos::process::{sys_spawn_thread, sys_vm_dirty, VM_DIRTY_MAX_PAGES};
+use libmnos::sched::sys_sched_pin;
+use libmnos::sync::{futex_wake, wait_while_equal, WAKE_ALL};
+use wasmi::{Engine, Linker, Memory, Module, Store, TypedFunc};
+
+use crate::{SCHED_SLOT, SELF_PROC_SLOT};
+
+/// Reset granularity (one x86 page).
+const RESET_PAGE: usize = 4096;
+
+/// Stack per worker thread. wasmi keeps Wasm values and frames on its own
+/// heap stacks; this only holds the host side of a call.
+const WORKER_STACK: usize = 128 * 1024;
+
+/// Most workers `start` will spawn.
+pub const MAX_WORKERS: usize = 8;
+
+/// Why a pool could not be built, started or called.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PoolError {
+    /// Linking or running the start function failed.
+    Instantiate,
+    /// The module exports no `memory`.
+    NoMemory,
+    /// The export is missing or not `(i32) -> i32`.
+    NoExport,
+    /// SYS_SPAWN_THREAD failed with this error code.
+    Spawn(u64),
+    /// Every instance was retired (re-instantiation ran out of memory).
+    Exhausted,
+}
+
+impl PoolError {
+    pub fn as_str(self) -> &'static [u8] {
+        match self {
+            PoolError::Instantiate => b"instantiation failed",
+            PoolError::NoMemory => b"no exported memory",
+            PoolError::NoExport => b"export missing or not (i32) -> i32",
+            PoolError::Spawn(_) => b"SYS_SPAWN_THREAD failed",
+            PoolError::Exhausted => b"every instance retired",
+        }
+    }
+}
+
+// =============================================================================
+// Slots
+// =============================================================================
+
+/// One live instance and the handles a call needs.
+struct Live {
+    store: Store<()>,
+    memory: Memory,
+    func: TypedFunc<i32, i32>,
+    /// Core whose SYS_VM_DIRTY call last cleared the memory's dirty bits,
+    /// or None if they say nothing yet.
+    tracked_on: Option<usize>,
+}
+
+impl Live {
+    fn new(
+        engine: &Engine,
+        linker: &Linker<()>,
+        module: &Module,
+        export: &str,
+    ) -> Result<Live, PoolError> {
+        let mut store = Store::new(engine, ());
+        let pre = linker.instantiate(&mut store, module).map_err(|_| PoolError::Instantiate)?;
+        let instance = pre.start(&mut store).map_err(|_| PoolError::Instantiate)?;
+        let memory = instance.get_memory(&store, "memory").ok_or(PoolError::NoMemory)?;
+        let func = instance
+            .get_typed_func::<i32, i32>(&store, export)
+            .map_err(|_| PoolError::NoExport)?;
+        Ok(Live { store, memory, func, tracked_on: None })
+    }
+}
+
+/// A pool entry; `busy` owns `live`.
+struct Slot {
+    busy: AtomicBool,
+    live: UnsafeCell<Live>,
+}
+
+/// A fixed set of instances of one module, each callable from any thread.
+pub struct Pool {
+    engine: Engine,
+    linker: Linker<()>,
+    module: Module,
+    export: &'static str,
+    /// Linear memory right after instantiation.
+    pristine: Vec<u8>,
+    slots: Vec<Slot>,
+    /// Pages copied back by resets.
+    pub pages_restored: AtomicU64,
+    /// Slots rebuilt after a trap or memory growth.
+    pub reinstantiated: AtomicU64,
+    /// Slots kept busy for good because they could not be rebuilt.
+    retired: AtomicUsize,
+}
+
+// SAFETY: a slot's Store is only touched by the thread that set its `busy`
+// flag; engine, linker, module and pristine are read-only after `new`.
+unsafe impl Sync for Pool {}
+unsafe impl Send for Pool {}
+
+impl Pool {
+    /// Instantiates `module` `size` times (at least once) and snapshots the
+    /// first instance's memory. `export` is the `(i32) -> i32` function
+    /// `call` runs.
+    pub fn new(
+        engine: &Engine,
+        linker: Linker<()>,
+        module: &Module,
+        export: &'static str,
+        size: usize,
+    ) -> Result<Pool, PoolError> {
+        let first = Live::new(engine, &linker, module, export)?;
+        let pristine = first.memory.data(&first.store).to_vec();
+
+        let mut slots = Vec::with_capacity(size.max(1));
+        slots.push(Slot { busy: AtomicBool::new(false), live: UnsafeCell::new(first) });
+        for _ in 1..size {
+            let live = Live::new(engine, &linker, module, export)?;
+            slots.push(Slot { busy: AtomicBool::new(false), live: UnsafeCell::new(live) });
+        }
+
+        Ok(Pool {
+            engine: engine.clone(),
+            linker,
+            module: module.clone(),
+            export,
+            pristine,
+            slots,
+            pages_restored: AtomicU64::new(0),
+            reinstantiated: AtomicU64::new(0),
+            retired: AtomicUsize::new(0),
+        })
+    }
+
+    /// Number of instances.
+    pub fn len(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Bytes of linear memory per instance.
+    pub fn memory_bytes(&self) -> usize {
+        self.pristine.len()
+    }
+
+    /// Runs the export with `arg` on a free instance and resets it; the
+    /// inner None means the call trapped. `hint` picks where the search for
+    /// a free slot starts (a worker's index), so workers with their own
+    /// slot never collide. `pinned` is the core the calling thread is
+    /// pinned to, if any.
+    pub fn call(&self, hint: usize, pinned: Option<usize>, arg: i32) -> Result<Option<i32>, PoolError> {
+        let slot = self.checkout(hint)?;
+        // SAFETY: `checkout` set `busy`; this thread owns the slot.
+        let live = unsafe { &mut *slot.live.get() };
+
+        let result = live.func.call(&mut live.store, arg).ok();
+        let grown = live.memory.data(&live.store).len() != self.pristine.len();
+        if result.is_some() && !grown {
+            self.reset(live, pinned);
+        } else {
+            match Live::new(&self.engine, &self.linker, &self.module, self.export) {
+                Ok(fresh) => {
+                    *live = fresh;
+                    self.reinstantiated.fetch_add(1, Ordering::Relaxed);
+                }
+                // Out of memory: keep the slot busy, i.e. retire it.
+                Err(_) => {
+                    self.retired.fetch_add(1, Ordering::Release);
+                    return Ok(result);
+                }
+            }
+        }
+
+        slot.busy.store(false, Ordering::Release);
+        Ok(result)
+    }
+
+    /// Claims a free slot, starting at `hint`; spins while all are busy,
+    /// and fails once all of them are retired.
+    fn checkout(&self, hint: usize) -> Result<&Slot, PoolError> {
+        let n = self.slots.len();
+        loop {
+            for i in 0..n {
+                let slot = &self.slots[(hint + i) % n];
+                if !slot.busy.load(Ordering::Relaxed)
+                    && slot.busy.compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed).is_ok()
+                {
+                    return Ok(slot);
+                }
+            }
+            if self.retired.load(Ordering::Acquire) == n {
+                return Err(PoolError::Exhausted);
+            }
+            core::hint::spin_loop();
+        }
+    }
+
+    /// Copies back the pages of `live`'s memory that differ from pristine:
+    /// the dirty ones if the bits were cleared on `pinned`, else all.
+    fn reset(&self, live: &mut Live, pinned: Option<usize>) {
+        let memory = live.memory.data_mut(&mut live.store);
+        let base = memory.as_ptr() as u64;
+        let whole = whole_pages(memory);
+        let mut restored = 0;
+
+        let mut tracked = pinned.is_some() && live.tracked_on == pinned;
+        if tracked {
+            // The partial pages at the ends are always compared. A page
+            // restored here reads as dirty once more next time.
+            restored += restore(memory, &self.pristine, 0..whole.start);
+            restored += restore(memory, &self.pristine, whole.end..memory.len());
+            tracked = take_dirty(base, whole.clone(), |range| {
+                restored += restore(memory, &self.pristine, range)
+            });
+        }
+        if !tracked {
+            // Untracked, or bits taken and lost by a failed call.
+            restored += restore(memory, &self.pristine, 0..memory.len());
+            // Clearing the bits starts tracking on this core.
+            tracked = pinned.is_some() && take_dirty(base, whole, |_| {});
+        }
+        live.tracked_on = if tracked { pinned } else { None };
+
+        if restored != 0 {
+            self.pages_restored.fetch_add(restored, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Byte range of `memory` made of whole pages (no other object shares them).
+fn whole_pages(memory: &[u8]) -> Range<usize> {
+    let base = memory.as_ptr() as usize;
+    let start = base.next_multiple_of(RESET_PAGE) - base;
+    let end = (base + memory.len()) / RESET_PAGE * RESET_PAGE - base;
+    if start < end { start..end } else { 0..0 }
+}
+
+/// Copies pristine over the pages of `memory[range]` that differ from it.
+/// Returns the number of pages copied.
+fn restore(memory: &mut [u8], pristine: &[u8], range: Range<usize>) -> u64 {
+    let mut restored = 0;
+    let (dirty, clean) = (&mut memory[range.clone()], &pristine[range]);
+    for (page, clean) in dirty.chunks_mut(RESET_PAGE).zip(clean.chunks(RESET_PAGE)) {
+        if page != clean {
+            page.copy_from_slice(clean);
+            restored += 1;
+        }
+    }
+    restored
+}
+
+/// Takes the dirty bits of the whole pages at byte offsets `pages` of the
+/// memory at `base` with SYS_VM_DIRTY, and calls `f` with each written
+/// page's byte range. Returns false if a call failed.
+fn take_dirty(base: u64, pages: Range<usize>, mut f: impl FnMut(Range<usize>)) -> bool {
+    let mut bitmap = [0u8; VM_DIRTY_MAX_PAGES / 8];
+    let mut at = pages.start;
+    while at < pages.end {
+        let n = ((pages.end - at) / RESET_PAGE).min(VM_DIRTY_MAX_PAGES);
+        if sys_vm_dirty(base + at as u64, n, &mut bitmap).is_err() {
+            return false;
+        }
+        for i in (0..n).filter(|i| bitmap[i / 8] & (1 << (i % 8)) != 0) {
+            let page = at + i * RESET_PAGE;
+            f(page..page + RESET_PAGE);
+        }
+        at += n * RESET_PAGE;
+    }
+    true
+}
+
+// =============================================================================
+// Workers
+// =============================================================================
+
+/// The current batch. `cursor` is `generation << 32 | next job`; the other
+/// fields are written before `cursor` publishes a new generation, and
+/// `epoch` (the generation's low 32 bits, a futex word) announces it.
+struct Batch {
+    cursor: AtomicU64,
+    epoch: AtomicU32,
+    total: AtomicU32,
+    arg: AtomicI32,
+    expect: AtomicI32,
+    /// Workers with an index below this take part.
+    active: AtomicU32,
+    done: AtomicU32,
+    mismatched: AtomicU32,
+}
+
+static BATCH: Batch = Batch {
+    cursor: AtomicU64::new(0),
+    epoch: AtomicU32::new(0),
+    total: AtomicU32::new(0),
+    arg: AtomicI32::new(0),
+    expect: AtomicI32::new(0),
+    active: AtomicU32::new(0),
+    done: AtomicU32::new(0),
+    mismatched: AtomicU32::new(0),
+};
+
+/// The pool the workers call into (leaked by `start`).
+static POOL: AtomicPtr<Pool> = AtomicPtr::new(ptr::null_mut());
+
+/// Workers that have started; also hands out worker indices.
+static READY: AtomicU32 = AtomicU32::new(0);
+
+/// Workers spawned by `start`.
+static SPAWNED: AtomicU32 = AtomicU32::new(0);
+
+/// Moves `pool` to the workers and spawns `workers` threads (at most
+/// MAX_WORKERS) in init's own process. Returns once all of them run.
+pub fn start(pool: Pool, workers: usize) -> Result<&'static Pool, PoolError> {
+    let pool: &'static Pool = Box::leak(Box::new(pool));
+    POOL.store(pool as *const Pool as *mut Pool, Ordering::Release);
+
+    for _ in 0..workers.clamp(1, MAX_WORKERS) {
+        let stack: &'static mut [u8] = Box::leak(alloc::vec![0u8; WORKER_STACK].into_boxed_slice());
+        let top = (stack.as_mut_ptr() as u64 + WORKER_STACK as u64) & !0xF;
+        // Entry RSP ≡ 8 (mod 16), as if `worker_entry` had been called.
+        sys_spawn_thread(SELF_PROC_SLOT, worker_entry as usize as u64, top - 8)
+            .map_err(|e| PoolError::Spawn(e.0))?;
+        SPAWNED.fetch_add(1, Ordering::Relaxed);
+    }
+
+    loop {
+        let ready = READY.load(Ordering::Acquire);
+        if ready >= SPAWNED.load(Ordering::Relaxed) {
+            break;
+        }
+        wait_while_equal(&READY, ready);
+    }
+    Ok(pool)
+}
+
+/// Number of running workers.
+pub fn workers() -> usize {
+    READY.load(Ordering::Acquire) as usize
+}
+
+/// Outcome of one batch.
+pub struct Report {
+    pub cycles: u64,
+    /// Calls that trapped or returned something other than `expect`.
+    pub mismatched: u32,
+}
+
+/// Runs `total` calls of the pool's export with `arg` on the first
+/// `active` workers and waits for them. Must not run concurrently with
+/// itself (init's main thread is the only caller).
+pub fn run(arg: i32, expect: i32, total: u32, active: usize) -> Report {
+    let b = &BATCH;
+    b.total.store(total, Ordering::Relaxed);
+    b.arg.store(arg, Ordering::Relaxed);
+    b.expect.store(expect, Ordering::Relaxed);
+    b.active.store(active as u32, Ordering::Relaxed);
+    b.done.store(0, Ordering::Relaxed);
+    b.mismatched.store(0, Ordering::Relaxed);
+
+    let generation = (b.cursor.load(Ordering::Relaxed) >> 32) + 1;
+    let t0 = crate::read_tsc();
+    b.cursor.store(generation << 32, Ordering::Release);
+    b.epoch.store(generation as u32, Ordering::Release);
+    futex_wake(&b.epoch, WAKE_ALL);
+    loop {
+        let done = b.done.load(Ordering::Acquire);
+        if done >= total {
+            break;
+        }
+        wait_while_equal(&b.done, done);
+    }
+    let cycles = crate::read_tsc() - t0;
+
+    Report { cycles, mismatched: b.mismatched.load(Ordering::Relaxed) }
+}
+
+/// Claims the next job of generation `generation`, if any is left.
+fn claim(generation: u64, total: u32) -> bool {
+    let mut cur = BATCH.cursor.load(Ordering::Relaxed);
+    loop {
+        if cur >> 32 != generation || cur as u32 >= total {
+            return false;
+        }
+        match BATCH.cursor.compare_exchange_weak(cur, cur + 1, Ordering::AcqRel, Ordering::Relaxed) {
+            Ok(_) => return true,
+            Err(seen) => cur = seen,
+        }
+    }
+}
+
+/// Worker thread: waits for a batch, runs jobs until none are left.
+extern "C" fn worker_entry() -> ! {
+    let id = READY.fetch_add(1, Ordering::AcqRel) as usize;
+    // Worker i stays on core i + 1, so its slot's dirty bits can be used
+    // (see RESET BETWEEN USES). Without a core it just compares more.
+    let pinned = sys_sched_pin(SCHED_SLOT, Some(id + 1), false).ok().map(|_| id + 1);
+    futex_wake(&READY, 1);
+    // SAFETY: `start` publishes the leaked pool before spawning workers.
+    let pool = unsafe { &*POOL.load(Ordering::Acquire) };
+    let mut seen = 0u64;
+
+    loop {
+        wait_while_equal(&BATCH.epoch, seen as u32);
+        seen = BATCH.cursor.load(Ordering::Acquire) >> 32;
+        if id >= BATCH.active.load(Ordering::Relaxed) as usize {
+            continue;
+        }
+
+        let total = BATCH.total.load(Ordering::Relaxed);
+        let arg = BATCH.arg.load(Ordering::Relaxed);
+        let expect = BATCH.expect.load(Ordering::Relaxed);
+        while claim(seen, total) {
+            if pool.call(id, pinned, arg) != Ok(Some(expect)) {
+                BATCH.mismatched.fetch_add(1, Ordering::Relaxed);
+            }
+            if BATCH.done.fetch_add(1, Ordering::Release) + 1 == total {
+                futex_wake(&BATCH.done, 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+// =============================================================================
+// libmnos — Native (AOT) Guest Boot ABI
+// =============================================================================
+//
+// init can run a Wasm guest compiled ahead of time to x86_64 from its
+// .wasm (tools/wasm_aot.py → user/hello_aot) as its own Ring 3 process
+// instead of interpreting the module under wasmi. SYS_SPAWN_THREAD only sets RIP and RSP, so init hands
+// the guest its parameters in one read-only page mapped at
+// GUEST_BOOT_VADDR:
+//
+//   init                                   native guest process
+//   ────                                   ────────────────────
+//   load ELF, map stack + boot page  ──→   _start reads GuestBoot
+//   delegate IoPort(COM1) to io_slot       host_print → SYS_PORT_WRITE
+//   SYS_SPAWN_THREAD(entry, stack)         run_guest(), compute() bench
+//
+// Both sides include this module, so the layout cannot drift.
+//
+// =============================================================================
+
+/// Where init maps the boot page in the guest's address space.
+pub const GUEST_BOOT_VADDR: u64 = 0x2000_0000;
+
+/// `GuestBoot::magic` ("MNGUEST1", little-endian).
+pub const GUEST_BOOT_MAGIC: u64 = u64::from_le_bytes(*b"MNGUEST1");
+
+/// Parameters init passes to a native guest.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct GuestBoot {
+    /// GUEST_BOOT_MAGIC.
+    pub magic: u64,
+    /// Guest CNode slot holding the IoPort capability for COM1
+    /// (backs the `host_print` import).
+    pub io_slot: u64,
+    /// Rounds of `compute()` to time and report (0 = skip the benchmark).
+    pub bench_iters: u64,
+}
+
+impl GuestBoot {
+    /// Reads the boot page, or None if its magic is wrong.
+    ///
+    /// # Safety
+    /// Only valid inside a guest process spawned by init (the page must
+    /// be mapped).
+    pub unsafe fn get() -> Option<&'static GuestBoot> {
+        let boot = unsafe { &*(GUEST_BOOT_VADDR as *const GuestBoot) };
+        if boot.magic == GUEST_BOOT_MAGIC { Some(boot) } else { None }
+    }
+}
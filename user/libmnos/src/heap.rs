@@ -6,27 +6,67 @@
 // from the kernel (via the PmmAllocator capability) and mapping them into the
 // caller's own address space (via the Process(self) capability).
 //
-// After mapping, the pages are fed to the `linked_list_allocator` LockedHeap
-// which provides the standard Rust `#[global_allocator]` interface.
+// After mapping, the pages are handed to the size-class allocator in
+// `malloc.rs`, which provides the standard Rust `#[global_allocator]`.
+//
+// GROWING ON DEMAND:
+//   `init_heap` only maps the initial `pages`. The capability slots are
+//   remembered, and when the allocator runs out it calls `grow()` to map
+//   more frames directly above the current top, up to `HEAP_RESERVE` bytes
+//   of virtual address space past `heap_base`:
+//
+//     heap_base                 top                      heap_base + RESERVE
+//     ├─────── mapped ──────────┤───── grown on demand ──→│
 //
 // CAPABILITY REQUIREMENTS:
 //   - `alloc_slot` must hold a PmmAllocator capability (typically Slot 1)
 //   - `proc_slot`  must hold a Process(self) capability (typically Slot 3)
-//   - `scratch_slot` is a temporary CNode slot for each allocated frame
+//   - `scratch_slot` is a temporary CNode slot for each allocated frame;
+//     it must stay free for the lifetime of the process (growth reuses it)
+//
+// PARTIAL FAILURE:
+//   Growth can stop halfway (the PMM runs dry, a mapping is refused).
+//   Pages mapped before that point are kept and handed to the allocator;
+//   a frame whose mapping failed stays in `scratch_slot` and is used by
+//   the next growth instead of allocating a new one. Dropping a frame
+//   cap does not return the frame to the PMM, so nothing is dropped
+//   until it has been mapped.
 //
 // =============================================================================
 
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
 use crate::process::{sys_alloc_memory, sys_drop_cap, sys_map_memory};
+use crate::syscall::SyscallError;
 use crate::HEAP;
 
-const PAGE_SIZE: u64 = 4096;
+pub const PAGE_SIZE: u64 = 4096;
+
+/// Virtual address space reserved for the heap above `heap_base` (1 GiB).
+pub const HEAP_RESERVE: u64 = 1 << 30;
+
+/// Capability slots remembered by `init_heap` for `grow()`.
+/// `u64::MAX` = heap not initialized, growth impossible.
+static ALLOC_SLOT: AtomicU64 = AtomicU64::new(u64::MAX);
+static PROC_SLOT: AtomicU64 = AtomicU64::new(u64::MAX);
+static SCRATCH_SLOT: AtomicU64 = AtomicU64::new(u64::MAX);
+
+/// First address past the reserved heap range.
+static LIMIT: AtomicU64 = AtomicU64::new(0);
+
+/// Bytes currently mapped for the heap (initial pages + growth).
+static MAPPED: AtomicU64 = AtomicU64::new(0);
+
+/// True while `SCRATCH_SLOT` holds a frame whose mapping failed.
+static SPARE_FRAME: AtomicBool = AtomicBool::new(false);
 
 /// Bootstraps the Ring 3 heap by allocating `pages` physical frames and
 /// mapping them contiguously starting at `heap_base`.
 ///
 /// # Arguments
 /// - `heap_base`:    Virtual address where the heap starts (must be page-aligned).
-/// - `pages`:        Number of 4 KiB pages to allocate.
+/// - `pages`:        Number of 4 KiB pages to map up front (the heap grows
+///                   past this on demand).
 /// - `alloc_slot`:   CNode slot holding the PmmAllocator capability.
 /// - `proc_slot`:    CNode slot holding the Process(self) capability.
 /// - `scratch_slot`: CNode slot used temporarily for each MemoryFrame.
@@ -40,30 +80,73 @@ pub fn init_heap(
     proc_slot: u64,
     scratch_slot: u64,
 ) {
+    ALLOC_SLOT.store(alloc_slot, Ordering::Relaxed);
+    PROC_SLOT.store(proc_slot, Ordering::Relaxed);
+    SCRATCH_SLOT.store(scratch_slot, Ordering::Relaxed);
+    LIMIT.store(heap_base + HEAP_RESERVE, Ordering::Relaxed);
+
+    if let Err((i, e)) = map_pages(heap_base, pages) {
+        panic!("heap: mapping page {} @ {:#x} failed: err={}", i, heap_base + i * PAGE_SIZE, e.0);
+    }
+
+    // Hand the entire region to the allocator
+    unsafe {
+        HEAP.init(heap_base as *mut u8, (pages * PAGE_SIZE) as usize);
+    }
+}
+
+/// Maps up to `bytes` (a multiple of PAGE_SIZE) of fresh frames at `top`,
+/// the current end of the heap. Returns the bytes actually mapped from
+/// `top` up: all of them, fewer if the kernel refused a frame part way,
+/// or 0 if the reserve is exhausted or the heap was never initialized.
+///
+/// Called by the allocator with its page lock held, which also serializes
+/// use of the scratch slot.
+pub(crate) fn grow(top: u64, bytes: u64) -> u64 {
+    if ALLOC_SLOT.load(Ordering::Relaxed) == u64::MAX
+        || top + bytes > LIMIT.load(Ordering::Relaxed)
+    {
+        return 0;
+    }
+    match map_pages(top, bytes / PAGE_SIZE) {
+        Ok(()) => bytes,
+        Err((mapped, _)) => mapped * PAGE_SIZE,
+    }
+}
+
+/// Bytes of physical memory mapped for the heap so far.
+pub fn mapped_bytes() -> u64 {
+    MAPPED.load(Ordering::Relaxed)
+}
+
+/// Allocates and maps `pages` frames at `base`. On failure returns the
+/// index of the page that failed (= pages mapped) and the kernel's error;
+/// the pages below it stay mapped.
+fn map_pages(base: u64, pages: u64) -> Result<(), (u64, SyscallError)> {
+    let alloc_slot = ALLOC_SLOT.load(Ordering::Relaxed);
+    let proc_slot = PROC_SLOT.load(Ordering::Relaxed);
+    let scratch_slot = SCRATCH_SLOT.load(Ordering::Relaxed);
+
     for i in 0..pages {
-        // 1. Allocate a zeroed physical frame into scratch_slot
-        match sys_alloc_memory(alloc_slot, scratch_slot) {
-            Ok(()) => {}
-            Err(e) => panic!("heap: alloc_memory failed on page {}: err={}", i, e.0),
+        // 1. Allocate a zeroed physical frame into scratch_slot, unless
+        //    an earlier failed mapping left one there
+        if !SPARE_FRAME.load(Ordering::Relaxed) {
+            sys_alloc_memory(alloc_slot, scratch_slot).map_err(|e| (i, e))?;
         }
 
-        // 2. Map it at heap_base + i * PAGE_SIZE (WRITABLE, no-exec)
-        let vaddr = heap_base + i * PAGE_SIZE;
+        // 2. Map it at base + i * PAGE_SIZE (WRITABLE, no-exec)
         // flags: bit 0 = WRITABLE
-        match sys_map_memory(proc_slot, scratch_slot, vaddr, 0x01) {
-            Ok(()) => {}
-            Err(e) => panic!("heap: map_memory failed on page {} @ {:#x}: err={}", i, vaddr, e.0),
+        if let Err(e) = sys_map_memory(proc_slot, scratch_slot, base + i * PAGE_SIZE, 0x01) {
+            // Keep the frame for the next attempt
+            SPARE_FRAME.store(true, Ordering::Relaxed);
+            return Err((i, e));
         }
+        SPARE_FRAME.store(false, Ordering::Relaxed);
 
         // 3. Drop the MemoryFrame cap so the scratch slot is free for reuse
         let _ = sys_drop_cap(scratch_slot);
 
-        // Next iteration re-uses the same slot number for the next frame.
-    }
-
-    // 4. Hand the entire region to the linked-list allocator
-    let heap_size = (pages * PAGE_SIZE) as usize;
-    unsafe {
-        HEAP.lock().init(heap_base as *mut u8, heap_size);
+        MAPPED.fetch_add(PAGE_SIZE, Ordering::Relaxed);
     }
+    Ok(())
 }
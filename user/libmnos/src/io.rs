@@ -2,7 +2,8 @@
 // libmnos — Port I/O Syscall Wrappers
 // =============================================================================
 //
-// Safe wrappers around SYS_PORT_OUT (3) and SYS_PORT_IN (4).
+// Safe wrappers around SYS_PORT_OUT (3), SYS_PORT_IN (4) and the batched
+// SYS_PORT_WRITE (17).
 //
 // Ring 3 code cannot execute IN/OUT instructions directly — the CPU raises
 // #GP. Instead, userspace drivers use these syscalls, which the kernel
@@ -13,6 +14,17 @@
 // access, and each driver only gets access to the specific port range it
 // needs (e.g., COM1 at 0x3F8-0x3FF).
 //
+// SYS_PORT_WRITE hands the kernel a buffer: it polls a status port once,
+// then reads one FIFO burst straight out of the caller's pages and emits
+// it. `sys_port_write` loops over the rest, so interrupts are taken
+// between bursts. Printing n bytes to a UART costs n/16 syscalls instead
+// of 2n.
+//
+// COM1's data register is special: the kernel owns that transmitter, and
+// writes to it are queued in the kernel's console ring (in order with
+// kernel log output) instead of racing it for the FIFO. Pacing is ignored
+// there.
+//
 // =============================================================================
 
 use crate::syscall::SyscallError;
@@ -23,6 +35,21 @@ const SYS_PORT_OUT: u64 = 3;
 /// Syscall number for port I/O read.
 const SYS_PORT_IN: u64 = 4;
 
+/// Syscall number for the batched buffer write.
+const SYS_PORT_WRITE: u64 = 17;
+
+/// Most bytes the kernel emits per SYS_PORT_WRITE: one 16550 FIFO burst
+/// (it runs with interrupts off). `sys_port_write` loops over longer
+/// buffers.
+pub const PORT_WRITE_MAX: usize = 16;
+
+/// Consecutive SYS_PORT_WRITE calls that may find the device busy (each
+/// after the kernel's own bounded poll) before `sys_port_write` gives up.
+pub const PORT_WRITE_RETRIES: u32 = 64;
+
+/// Error code: the device stayed busy for PORT_WRITE_RETRIES bursts.
+pub const PORT_WRITE_BUSY: SyscallError = SyscallError(u64::MAX - 6);
+
 /// Writes a byte to a hardware I/O port.
 ///
 /// # Arguments
@@ -144,3 +171,90 @@ pub fn sys_port_in_32(slot: u64, port: u16) -> Result<u32, SyscallError> {
     }
     if result == 0 { Ok(value as u32) } else { Err(SyscallError(result)) }
 }
+
+// =============================================================================
+// Batched Buffer Write
+// =============================================================================
+
+/// How SYS_PORT_WRITE paces a buffer into a FIFO device.
+///
+/// Before every `burst` bytes (one SYS_PORT_WRITE) the kernel polls
+/// `status_port` until `status & ready_mask != 0`. A `ready_mask` of 0
+/// disables polling and sends PORT_WRITE_MAX bytes per call.
+#[derive(Debug, Clone, Copy)]
+pub struct TxPacing {
+    pub status_port: u16,
+    pub ready_mask: u8,
+    pub burst: u8,
+}
+
+impl TxPacing {
+    /// No polling: bytes go out back to back.
+    pub const NONE: Self = Self { status_port: 0, ready_mask: 0, burst: 0 };
+
+    /// A 16550 UART: wait for LSR.THRE (bit 5, FIFO empty), then write
+    /// a full 16-byte FIFO.
+    pub const fn uart16550(lsr_port: u16) -> Self {
+        Self { status_port: lsr_port, ready_mask: 1 << 5, burst: 16 }
+    }
+}
+
+/// Writes `bytes` to a data port, paced by `pacing`.
+///
+/// The kernel reads the bytes directly from this buffer — no copy on
+/// either side. Each call emits one burst of at most PORT_WRITE_MAX
+/// bytes; this loops, advancing by the count the kernel reports. A burst
+/// the device never became ready for is retried, up to
+/// PORT_WRITE_RETRIES times in a row.
+///
+/// # Arguments
+/// - `slot`:   CNode slot index containing an IoPort capability with
+///             WRITE (and READ when polling).
+/// - `port`:   16-bit data port.
+/// - `bytes`:  Bytes to write.
+/// - `pacing`: Status polling and burst size.
+///
+/// # Returns
+/// `Ok(bytes.len())`, `Err(PORT_WRITE_BUSY)` if the device stopped taking
+/// bytes (everything before the failed burst was written), or another
+/// `Err(SyscallError)` on a capability or buffer violation. Writes to
+/// COM1's data register go to the kernel's console ring and are never
+/// busy.
+pub fn sys_port_write(slot: u64, port: u16, bytes: &[u8], pacing: TxPacing) -> Result<usize, SyscallError> {
+    let pacing_word = pacing.ready_mask as u64 | (pacing.burst as u64) << 8;
+    let mut total = 0;
+    let mut retries = 0;
+    while total < bytes.len() {
+        let chunk = &bytes[total..];
+        let result: u64;
+        let written: u64;
+        unsafe {
+            core::arch::asm!(
+                "syscall",
+                inlateout("rax") SYS_PORT_WRITE => result,
+                inlateout("rdi") slot => written,
+                inlateout("rsi") port as u64 => _,
+                inlateout("rdx") chunk.as_ptr() as u64 => _,
+                inlateout("r10") chunk.len() as u64 => _,
+                inlateout("r8") pacing.status_port as u64 => _,
+                inlateout("r9") pacing_word => _,
+                lateout("rcx") _,
+                lateout("r11") _,
+                options(nostack, readonly),
+            );
+        }
+        if result != 0 {
+            return Err(SyscallError(result));
+        }
+        if written == 0 {
+            retries += 1;
+            if retries == PORT_WRITE_RETRIES {
+                return Err(PORT_WRITE_BUSY);
+            }
+            continue;
+        }
+        retries = 0;
+        total += written as usize;
+    }
+    Ok(total)
+}
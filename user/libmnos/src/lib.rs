@@ -39,12 +39,15 @@ pub mod io;
 pub mod irq;
 pub mod process;
 pub mod heap;
+pub mod malloc;
+pub mod pmu;
+pub mod sched;
+pub mod guest;
+pub mod sync;
 
-use linked_list_allocator::LockedHeap;
-
-/// Ring 3 global allocator — fed by `init_heap()` at startup.
+/// Ring 3 global allocator — fed by `init_heap()` at startup, grows on demand.
 #[global_allocator]
-pub static HEAP: LockedHeap = LockedHeap::empty();
+pub static HEAP: malloc::MnosAlloc = malloc::MnosAlloc::new();
 
 /// Out-of-memory handler for the `alloc` crate.
 #[alloc_error_handler]
@@ -0,0 +1,291 @@
+// =============================================================================
+// libmnos — Size-Class Allocator (Ring 3 global allocator)
+// =============================================================================
+//
+// wasmi's parser and engine make huge numbers of small, short-lived
+// allocations. A single first-fit linked list under one lock walks the free
+// list on every call and serializes every thread. This allocator splits the
+// work in two tiers:
+//
+//   SMALL (≤ 2 KiB): power-of-two size classes 16, 32, … 2048
+//     ┌──────────── Cache (one of NUM_CACHES, own lock) ────────────┐
+//     │ class 0: free list → blk → blk        bump ──▶ │ end        │
+//     │ class 1: free list → blk              bump ──▶ │ end        │
+//     │ ...                                                         │
+//     └─────────────────────────────────────────────────────────────┘
+//       alloc:  pop the class free list, else bump inside the class's
+//               current 16 KiB chunk, else carve a new chunk from PAGES
+//       free:   push onto the class free list (O(1), no coalescing)
+//
+//   LARGE (> 2 KiB) and chunk refills: PAGES, a first-fit linked list
+//     (`linked_list_allocator::Heap`) over the mapped heap range. When it
+//     cannot satisfy a request it maps more pages above its top
+//     (`heap::grow`) and extends itself.
+//
+// CACHES WITHOUT TLS:
+//   Ring 3 has no thread-local storage yet, so "thread-local" caches are
+//   picked by stack address: each thread's stack lives in its own region,
+//   and `RSP >> 20` maps it to a home cache. A thread try-locks its home
+//   cache first and moves on to the next one if another thread holds it,
+//   so two threads only contend when every cache is busy. The locks are
+//   `sync::Mutex`es: a thread that does have to wait spins briefly, then
+//   sleeps in the kernel instead of burning its quantum.
+//
+//   Blocks of one class are interchangeable, so a block may be freed into a
+//   different cache than the one it came from — it simply migrates.
+//
+// ALIGNMENT:
+//   Chunks are page-aligned and blocks are carved at multiples of their
+//   class size, so every block is aligned to its (power-of-two) class. A
+//   layout is served from class max(size, align).
+//
+// Power-of-two classes waste up to half a block on awkward sizes; in
+// exchange the class of a pointer follows from its Layout alone, so no
+// per-block header is needed.
+//
+// =============================================================================
+
+use core::alloc::{GlobalAlloc, Layout};
+use core::ptr::{self, NonNull};
+
+use linked_list_allocator::Heap;
+
+use crate::heap::{self, PAGE_SIZE};
+use crate::sync::Mutex;
+
+/// The previous global allocator (one first-fit list under one lock).
+/// Kept as the baseline for the allocation benchmark.
+pub use linked_list_allocator::LockedHeap as LinkedListHeap;
+
+/// Smallest size class (log2): 16 bytes — room for a free-list link.
+const MIN_CLASS_SHIFT: u32 = 4;
+
+/// Largest size class (log2): 2 KiB. Anything larger goes to PAGES.
+const MAX_CLASS_SHIFT: u32 = 11;
+
+/// Number of small size classes.
+const NUM_CLASSES: usize = (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1) as usize;
+
+/// Largest request served from a size class.
+pub const MAX_SMALL: usize = 1 << MAX_CLASS_SHIFT;
+
+/// Bytes carved from PAGES whenever a class runs dry.
+const CHUNK_SIZE: usize = 16 * 1024;
+
+/// Number of caches threads spread over.
+const NUM_CACHES: usize = 4;
+
+/// Minimum heap growth, so a run of small refills doesn't map page by page.
+const MIN_GROW: usize = 64 * PAGE_SIZE as usize;
+
+// =============================================================================
+// Small-object cache
+// =============================================================================
+
+/// A free block, linked through its first word.
+struct FreeBlock {
+    next: *mut FreeBlock,
+}
+
+/// Per-class free lists plus a bump window into each class's chunk.
+struct Cache {
+    free: [*mut FreeBlock; NUM_CLASSES],
+    bump: [usize; NUM_CLASSES],
+    end: [usize; NUM_CLASSES],
+}
+
+// SAFETY: the raw pointers only refer to heap memory owned by the allocator.
+unsafe impl Send for Cache {}
+
+impl Cache {
+    const fn new() -> Self {
+        Self {
+            free: [ptr::null_mut(); NUM_CLASSES],
+            bump: [0; NUM_CLASSES],
+            end: [0; NUM_CLASSES],
+        }
+    }
+
+    /// Pops a block of `class`, bumping or refilling from `pages` if the
+    /// free list is empty. Null on OOM.
+    #[inline]
+    fn alloc(&mut self, class: usize, pages: &Mutex<Pages>) -> *mut u8 {
+        let head = self.free[class];
+        if !head.is_null() {
+            self.free[class] = unsafe { (*head).next };
+            return head as *mut u8;
+        }
+
+        let size = class_size(class);
+        if self.bump[class] == self.end[class] {
+            let chunk = pages.lock().alloc(Layout::from_size_align(CHUNK_SIZE, PAGE_SIZE as usize).unwrap());
+            if chunk.is_null() {
+                return ptr::null_mut();
+            }
+            self.bump[class] = chunk as usize;
+            self.end[class] = chunk as usize + CHUNK_SIZE;
+        }
+        let block = self.bump[class];
+        self.bump[class] += size;
+        block as *mut u8
+    }
+
+    /// Pushes a block back onto its class free list.
+    #[inline]
+    fn free(&mut self, class: usize, block: *mut u8) {
+        let block = block as *mut FreeBlock;
+        unsafe { (*block).next = self.free[class] };
+        self.free[class] = block;
+    }
+}
+
+// =============================================================================
+// Page heap (large objects + chunk refills)
+// =============================================================================
+
+/// The linked-list heap over the mapped range, grown on demand.
+struct Pages {
+    heap: Heap,
+}
+
+// SAFETY: the heap's hole list only points into memory owned by the allocator.
+unsafe impl Send for Pages {}
+
+impl Pages {
+    /// First-fit allocation; maps more pages above the top when it fails.
+    fn alloc(&mut self, layout: Layout) -> *mut u8 {
+        if let Ok(p) = self.heap.allocate_first_fit(layout) {
+            return p.as_ptr();
+        }
+
+        // Worst case the new block needs `align` bytes of padding at the
+        // old top; round up to whole pages and grow in big steps.
+        // A partial growth still extends the heap, so its pages aren't lost.
+        let need = (layout.size() + layout.align()).next_multiple_of(PAGE_SIZE as usize).max(MIN_GROW);
+        if self.heap.size() == 0 {
+            return ptr::null_mut();
+        }
+        let grown = heap::grow(self.heap.top() as u64, need as u64) as usize;
+        if grown == 0 {
+            return ptr::null_mut();
+        }
+        unsafe { self.heap.extend(grown) };
+
+        match self.heap.allocate_first_fit(layout) {
+            Ok(p) => p.as_ptr(),
+            Err(()) => ptr::null_mut(),
+        }
+    }
+
+    fn free(&mut self, block: *mut u8, layout: Layout) {
+        if let Some(p) = NonNull::new(block) {
+            unsafe { self.heap.deallocate(p, layout) };
+        }
+    }
+}
+
+// =============================================================================
+// Global allocator
+// =============================================================================
+
+/// Ring 3 global allocator: size-class caches over a growable page heap.
+pub struct MnosAlloc {
+    caches: [Mutex<Cache>; NUM_CACHES],
+    pages: Mutex<Pages>,
+}
+
+impl MnosAlloc {
+    pub const fn new() -> Self {
+        Self {
+            caches: [const { Mutex::new(Cache::new()) }; NUM_CACHES],
+            pages: Mutex::new(Pages { heap: Heap::empty() }),
+        }
+    }
+
+    /// Hands the initial mapped range to the page heap (see `heap::init_heap`).
+    ///
+    /// # Safety
+    /// `[base, base + size)` must be mapped, writable and otherwise unused.
+    pub unsafe fn init(&self, base: *mut u8, size: usize) {
+        unsafe { self.pages.lock().heap.init(base, size) };
+    }
+
+    /// Runs `f` on this thread's home cache, or the first free one.
+    #[inline]
+    fn with_cache<R>(&self, mut f: impl FnMut(&mut Cache) -> R) -> R {
+        let home = stack_hint() % NUM_CACHES;
+        for i in 0..NUM_CACHES {
+            if let Some(mut cache) = self.caches[(home + i) % NUM_CACHES].try_lock() {
+                return f(&mut cache);
+            }
+        }
+        f(&mut self.caches[home].lock())
+    }
+}
+
+unsafe impl GlobalAlloc for MnosAlloc {
+    #[inline]
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        match class_of(layout) {
+            Some(class) => self.with_cache(|c| c.alloc(class, &self.pages)),
+            None => self.pages.lock().alloc(layout),
+        }
+    }
+
+    #[inline]
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        match class_of(layout) {
+            Some(class) => self.with_cache(|c| c.free(class, ptr)),
+            None => self.pages.lock().free(ptr, layout),
+        }
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        // Resizing within one size class needs no copy: the block already
+        // has room for anything up to the class size.
+        let new_layout = unsafe { Layout::from_size_align_unchecked(new_size, layout.align()) };
+        if let (Some(old), Some(new)) = (class_of(layout), class_of(new_layout)) {
+            if old == new {
+                return ptr;
+            }
+        }
+
+        let new_ptr = unsafe { self.alloc(new_layout) };
+        if !new_ptr.is_null() {
+            unsafe {
+                ptr::copy_nonoverlapping(ptr, new_ptr, layout.size().min(new_size));
+                self.dealloc(ptr, layout);
+            }
+        }
+        new_ptr
+    }
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+/// Size class serving `layout`, or None if it belongs to the page heap.
+#[inline]
+fn class_of(layout: Layout) -> Option<usize> {
+    let size = layout.size().max(layout.align());
+    if size > MAX_SMALL {
+        return None;
+    }
+    let shift = size.next_power_of_two().trailing_zeros().max(MIN_CLASS_SHIFT);
+    Some((shift - MIN_CLASS_SHIFT) as usize)
+}
+
+/// Block size of `class`.
+#[inline]
+const fn class_size(class: usize) -> usize {
+    1 << (class as u32 + MIN_CLASS_SHIFT)
+}
+
+/// Cheap per-thread value: which 1 MiB region the stack pointer is in.
+#[inline(always)]
+fn stack_hint() -> usize {
+    let rsp: usize;
+    unsafe { core::arch::asm!("mov {}, rsp", out(reg) rsp, options(nomem, nostack, preserves_flags)) };
+    rsp >> 20
+}
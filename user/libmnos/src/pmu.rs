@@ -0,0 +1,186 @@
+// =============================================================================
+// libmnos — Performance Counter Syscall Wrappers
+// =============================================================================
+//
+// Safe wrappers around SYS_PMU_INFO (12), SYS_PMU_CONFIG (13) and
+// SYS_PMU_READ (14), all gated by a Pmu capability.
+//
+// Counters are per thread: the kernel saves and restores them on every
+// context switch, so a count only covers the thread that programmed it.
+// Once a thread has programmed a counter the kernel also sets CR4.PCE
+// while it runs, and `rdpmc()` reads the counter without a syscall.
+//
+// Without a hardware PMU (e.g. QEMU/TCG) every call returns
+// `Err(PMU_UNSUPPORTED)` — callers should fall back to `rdtsc`.
+//
+// =============================================================================
+
+use crate::syscall::SyscallError;
+
+/// Syscall number for PMU geometry query.
+const SYS_PMU_INFO: u64 = 12;
+
+/// Syscall number for counter programming.
+const SYS_PMU_CONFIG: u64 = 13;
+
+/// Syscall number for counter read.
+const SYS_PMU_READ: u64 = 14;
+
+/// Error code: no architectural PMU on this CPU.
+pub const PMU_UNSUPPORTED: SyscallError = SyscallError(u64::MAX - 5);
+
+/// Error code: SYS_PMU_READ before this thread programmed any counter.
+pub const PMU_NOT_CONFIGURED: SyscallError = SyscallError(u64::MAX - 6);
+
+/// EVTSEL.USR — count while in Ring 3.
+pub const USR: u64 = 1 << 16;
+
+/// EVTSEL.OS — count while in Ring 0.
+pub const OS: u64 = 1 << 17;
+
+/// Architectural event: unhalted core cycles.
+pub const EVENT_CYCLES: u64 = 0x003C;
+
+/// Architectural event: instructions retired.
+pub const EVENT_INSTRUCTIONS: u64 = 0x00C0;
+
+/// Architectural event: last-level cache references.
+pub const EVENT_LLC_REFERENCES: u64 = 0x4F2E;
+
+/// Architectural event: last-level cache misses.
+pub const EVENT_LLC_MISSES: u64 = 0x412E;
+
+/// Architectural event: branch instructions retired.
+pub const EVENT_BRANCHES: u64 = 0x00C4;
+
+/// Architectural event: branch mispredicts retired.
+pub const EVENT_BRANCH_MISSES: u64 = 0x00C5;
+
+/// Builds a raw event select from an event code and unit mask, for
+/// model-specific events (e.g. TLB page walks).
+#[inline(always)]
+pub const fn raw_event(event: u8, umask: u8) -> u64 {
+    event as u64 | (umask as u64) << 8
+}
+
+/// PMU geometry as reported by CPUID leaf 0x0A.
+#[derive(Debug, Clone, Copy)]
+pub struct PmuInfo {
+    /// Architectural PMU version.
+    pub version: u8,
+    /// Number of general-purpose counters.
+    pub counters: u8,
+    /// Counter width in bits.
+    pub width: u8,
+}
+
+/// Queries the PMU geometry.
+///
+/// # Arguments
+/// - `slot`: CNode slot index containing a Pmu capability with READ.
+#[inline(always)]
+pub fn sys_pmu_info(slot: u64) -> Result<PmuInfo, SyscallError> {
+    let result: u64;
+    let value: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_PMU_INFO => result,
+            inlateout("rdi") slot => value,
+            inlateout("rsi") 0u64 => _,
+            inlateout("rdx") 0u64 => _,
+            inlateout("r10") 0u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 {
+        Ok(PmuInfo {
+            version: value as u8,
+            counters: (value >> 8) as u8,
+            width: (value >> 16) as u8,
+        })
+    } else {
+        Err(SyscallError(result))
+    }
+}
+
+/// Programs counter `index` of the calling thread and resets it to zero.
+///
+/// # Arguments
+/// - `slot`:  CNode slot index containing a Pmu capability with WRITE.
+/// - `index`: Counter number (< `PmuInfo::counters`).
+/// - `event`: Event select, e.g. `EVENT_INSTRUCTIONS | USR`. 0 stops it.
+#[inline(always)]
+pub fn sys_pmu_config(slot: u64, index: u32, event: u64) -> Result<(), SyscallError> {
+    let result: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_PMU_CONFIG => result,
+            in("rdi") slot,
+            in("rsi") index as u64,
+            in("rdx") event,
+            in("r10") 0u64,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(()) } else { Err(SyscallError(result)) }
+}
+
+/// Reads counter `index` of the calling thread through the kernel, as a
+/// full 64-bit count.
+///
+/// # Arguments
+/// - `slot`:  CNode slot index containing a Pmu capability with READ.
+/// - `index`: Counter number.
+///
+/// # Errors
+/// `PMU_NOT_CONFIGURED` until the thread has called `sys_pmu_config`.
+#[inline(always)]
+pub fn sys_pmu_read(slot: u64, index: u32) -> Result<u64, SyscallError> {
+    let result: u64;
+    let value: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_PMU_READ => result,
+            inlateout("rdi") slot => value,
+            inlateout("rsi") index as u64 => _,
+            inlateout("rdx") 0u64 => _,
+            inlateout("r10") 0u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(value) } else { Err(SyscallError(result)) }
+}
+
+/// Reads counter `index` directly with RDPMC (no syscall).
+///
+/// On CPUs without full-width counter writes the kernel restores only the
+/// low 31 bits of a count at each context switch, so use the difference of
+/// two reads within a time slice, or `sys_pmu_read` for the whole count.
+///
+/// # Safety
+/// Only valid after a successful `sys_pmu_config` on this thread — otherwise
+/// CR4.PCE is clear and RDPMC raises #GP.
+#[inline(always)]
+pub unsafe fn rdpmc(index: u32) -> u64 {
+    let low: u32;
+    let high: u32;
+    unsafe {
+        core::arch::asm!(
+            "rdpmc",
+            in("ecx") index,
+            out("eax") low,
+            out("edx") high,
+            options(nomem, nostack, preserves_flags),
+        );
+    }
+    ((high as u64) << 32) | (low as u64)
+}
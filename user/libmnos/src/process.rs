@@ -9,6 +9,7 @@
 //   SYS_MAP_MEMORY    (8)  — Map a MemoryFrame into a process's address space
 //   SYS_DELEGATE      (9)  — Copy a capability to a target process's CNode
 //   SYS_SPAWN_THREAD  (10) — Create a Ring 3 thread in a target process
+//   SYS_VM_DIRTY      (22) — Report and clear the caller's page dirty bits
 //
 // These syscalls let the Init process (and any process with the right
 // capabilities) create child processes, allocate/map memory, delegate
@@ -25,6 +26,10 @@ const SYS_MAP_MEMORY: u64 = 8;
 const SYS_DELEGATE: u64 = 9;
 const SYS_SPAWN_THREAD: u64 = 10;
 const SYS_DROP_CAP: u64 = 11;
+const SYS_VM_DIRTY: u64 = 22;
+
+/// Most pages one `sys_vm_dirty` call covers.
+pub const VM_DIRTY_MAX_PAGES: usize = 4096;
 
 /// Creates a new process with an isolated PML4 and empty CNode.
 ///
@@ -167,3 +172,26 @@ pub fn sys_drop_cap(slot: u64) -> Result<(), SyscallError> {
         Err(SyscallError(result))
     }
 }
+
+/// Reports which of the caller's `pages` 4 KiB pages starting at `vaddr`
+/// were written since the previous call for them, and clears their dirty
+/// bits.
+///
+/// Bit i of `bitmap` (LSB first) is set if page i was written; `pages` is
+/// at most VM_DIRTY_MAX_PAGES and `bitmap.len() * 8`. The answer is only
+/// exact if the pages are written from nowhere but this thread's core, so
+/// the caller must be pinned (`sched::sys_sched_pin`).
+///
+/// # Returns
+/// `Ok(n)` — the number of pages written.
+/// `Err(SyscallError)` — bad range or bitmap, or the caller is not pinned.
+#[inline(always)]
+pub fn sys_vm_dirty(vaddr: u64, pages: usize, bitmap: &mut [u8]) -> Result<u64, SyscallError> {
+    let pages = pages.min(bitmap.len() * 8) as u64;
+    let result = unsafe { syscall4(SYS_VM_DIRTY, vaddr, pages, bitmap.as_mut_ptr() as u64, 0) };
+    if result < u64::MAX - 10 {
+        Ok(result)
+    } else {
+        Err(SyscallError(result))
+    }
+}
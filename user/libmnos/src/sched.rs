@@ -0,0 +1,259 @@
+// =============================================================================
+// libmnos — Scheduler Introspection Syscall Wrappers
+// =============================================================================
+//
+// Safe wrappers around SYS_THREAD_STATS (15), SYS_SCHED_HIST (16),
+// SYS_SCHED_PIN (20) and SYS_SCHED_SET (21), all gated by a Scheduler
+// capability.
+//
+// The kernel keeps TSC-based CPU accounting for every live thread (see
+// kernel/src/sched/stats.rs). A snapshot copies one `ThreadStat` per thread
+// into a caller-provided buffer. All times are raw TSC cycles; take two
+// snapshots and divide the deltas by the elapsed `tsc` to get CPU shares.
+//
+// SYS_SCHED_HIST copies per-core log2 histograms (wakeup latency, queued
+// latency, slice length, run-queue depth). Bucket 0 counts zeros, bucket b
+// counts values in [2^(b-1), 2^b). Each record also counts the wakeups
+// that core performed: cache-hot (back on the wakee's last core), pulled
+// next to an IPC partner, or migrated.
+//
+// SYS_SCHED_PIN pins the calling thread to a core. With `isolate`, the
+// core runs nothing else and drops its 10 ms preemption tick while the
+// thread is alone on it — a polling driver then sees no timer jitter.
+//
+// SYS_SCHED_SET sets the caller's scheduling context: a priority (higher
+// always runs first) and a time slice. A server needs no call of its own
+// to serve a high-priority client promptly: each IPC request lends it
+// the sender's context until it replies.
+//
+// =============================================================================
+
+use crate::syscall::SyscallError;
+
+/// Syscall number for the thread stats snapshot.
+const SYS_THREAD_STATS: u64 = 15;
+
+/// Syscall number for the per-core histogram copy.
+const SYS_SCHED_HIST: u64 = 16;
+
+/// Syscall number for CPU pinning / isolation.
+const SYS_SCHED_PIN: u64 = 20;
+
+/// Syscall number for setting the caller's scheduling context.
+const SYS_SCHED_SET: u64 = 21;
+
+/// Priority range for `sys_sched_set` (higher runs first).
+pub const PRIO_LOWEST: u8 = 0;
+pub const PRIO_DEFAULT: u8 = 3;
+pub const PRIO_HIGHEST: u8 = 7;
+
+/// Time slice range for `sys_sched_set`, microseconds.
+pub const QUANTUM_MIN_US: u32 = 1_000;
+pub const QUANTUM_DEFAULT_US: u32 = 10_000;
+pub const QUANTUM_MAX_US: u32 = 100_000;
+
+/// `sys_sched_pin` error: no such online core (or isolating core 0).
+pub const PIN_BAD_CORE: SyscallError = SyscallError(u64::MAX - 3);
+
+/// `sys_sched_pin` error: the core is isolated for another thread, or
+/// (isolating) another thread is pinned to it.
+pub const PIN_CORE_TAKEN: SyscallError = SyscallError(u64::MAX - 5);
+
+/// Buckets per histogram.
+pub const HIST_BUCKETS: usize = 64;
+
+/// Thread state values in `ThreadStat::state`.
+pub const STATE_READY: u64 = 0;
+pub const STATE_RUNNING: u64 = 1;
+pub const STATE_BLOCKED_SEND: u64 = 2;
+pub const STATE_BLOCKED_RECV: u64 = 3;
+pub const STATE_DEAD: u64 = 4;
+pub const STATE_BLOCKED_WAIT: u64 = 5;
+
+/// CPU accounting of one thread. Layout matches the kernel's
+/// `ThreadStatRecord`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ThreadStat {
+    pub tid: u64,
+    pub pid: u64,
+    /// First 16 bytes of the thread name, NUL-padded.
+    pub name: [u8; 16],
+    pub state: u64,
+    /// Cycles on a CPU (user + kernel).
+    pub run_tsc: u64,
+    /// Portion of `run_tsc` spent inside syscalls.
+    pub sys_tsc: u64,
+    /// Cycles spent Ready but waiting for a CPU.
+    pub wait_tsc: u64,
+    pub dispatches: u64,
+    pub preemptions: u64,
+    /// Voluntary switches (blocked in IPC or exited).
+    pub blocks: u64,
+    pub syscalls: u64,
+    pub ipc_sends: u64,
+    pub ipc_recvs: u64,
+}
+
+impl ThreadStat {
+    /// The thread name without NUL padding.
+    pub fn name(&self) -> &[u8] {
+        let len = self.name.iter().position(|&b| b == 0).unwrap_or(self.name.len());
+        &self.name[..len]
+    }
+}
+
+/// Result of a snapshot.
+#[derive(Debug, Clone, Copy)]
+pub struct Snapshot {
+    /// Records written to the buffer.
+    pub written: usize,
+    /// Live threads in the kernel (> `written` if the buffer was too small).
+    pub live: usize,
+    /// TSC at the time of the snapshot.
+    pub tsc: u64,
+}
+
+/// Snapshots the CPU accounting of every thread into `buf`.
+///
+/// # Arguments
+/// - `slot`: CNode slot index containing a Scheduler capability with READ.
+/// - `buf`:  Output records; must be mapped writable.
+#[inline(always)]
+pub fn sys_thread_stats(slot: u64, buf: &mut [ThreadStat]) -> Result<Snapshot, SyscallError> {
+    let result: u64;
+    let written: u64;
+    let live: u64;
+    let tsc: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_THREAD_STATS => result,
+            inlateout("rdi") slot => written,
+            inlateout("rsi") buf.as_mut_ptr() as u64 => live,
+            inlateout("rdx") buf.len() as u64 => tsc,
+            inlateout("r10") 0u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 {
+        Ok(Snapshot { written: written as usize, live: live as usize, tsc })
+    } else {
+        Err(SyscallError(result))
+    }
+}
+
+/// Scheduler histograms of one core. Layout matches the kernel's
+/// `SchedHistRecord`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct SchedHist {
+    pub core: u64,
+    /// IPC wakeup → run latency, TSC cycles.
+    pub wakeup: [u64; HIST_BUCKETS],
+    /// Preempted/new thread Ready → run latency, TSC cycles.
+    pub queued: [u64; HIST_BUCKETS],
+    /// Time slice actually used, TSC cycles.
+    pub slice: [u64; HIST_BUCKETS],
+    /// Run-queue depth at each `schedule()`.
+    pub rq_depth: [u64; HIST_BUCKETS],
+    /// Wakeups by this core that went back to the wakee's last core.
+    pub wake_hot: u64,
+    /// Wakeups that pulled the wakee next to its IPC partner on this core.
+    pub wake_pulled: u64,
+    /// Wakeups that moved the wakee to some other core.
+    pub wake_migrated: u64,
+}
+
+impl SchedHist {
+    /// An all-zero record (buffer initializer).
+    pub const EMPTY: Self = Self {
+        core: 0,
+        wakeup: [0; HIST_BUCKETS],
+        queued: [0; HIST_BUCKETS],
+        slice: [0; HIST_BUCKETS],
+        rq_depth: [0; HIST_BUCKETS],
+        wake_hot: 0,
+        wake_pulled: 0,
+        wake_migrated: 0,
+    };
+}
+
+/// Copies the histograms of every core that has scheduled into `buf`.
+///
+/// # Arguments
+/// - `slot`: CNode slot index containing a Scheduler capability with READ.
+/// - `buf`:  Output records, one per core; must be mapped writable.
+///
+/// # Returns
+/// `Ok(n)` — records written.
+#[inline(always)]
+pub fn sys_sched_hist(slot: u64, buf: &mut [SchedHist]) -> Result<usize, SyscallError> {
+    let result: u64;
+    let written: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_SCHED_HIST => result,
+            inlateout("rdi") slot => written,
+            inlateout("rsi") buf.as_mut_ptr() as u64 => _,
+            inlateout("rdx") buf.len() as u64 => _,
+            inlateout("r10") 0u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(written as usize) } else { Err(SyscallError(result)) }
+}
+
+/// Pins the calling thread to `core` (`None` unpins it). With `isolate`,
+/// the core is dedicated to this thread until it unpins or exits.
+///
+/// Returns once the thread runs on `core`.
+///
+/// # Arguments
+/// - `slot`: CNode slot index containing a Scheduler capability with WRITE.
+#[inline(always)]
+pub fn sys_sched_pin(slot: u64, core: Option<usize>, isolate: bool) -> Result<(), SyscallError> {
+    let core = core.map_or(u64::MAX, |c| c as u64);
+    let result: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_SCHED_PIN => result,
+            inlateout("rdi") slot => _,
+            inlateout("rsi") core => _,
+            inlateout("rdx") isolate as u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(()) } else { Err(SyscallError(result)) }
+}
+
+/// Sets the calling thread's priority (`PRIO_LOWEST..=PRIO_HIGHEST`) and
+/// time slice (`QUANTUM_MIN_US..=QUANTUM_MAX_US`).
+///
+/// # Arguments
+/// - `slot`: CNode slot index containing a Scheduler capability with WRITE.
+#[inline(always)]
+pub fn sys_sched_set(slot: u64, priority: u8, quantum_us: u32) -> Result<(), SyscallError> {
+    let result: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_SCHED_SET => result,
+            inlateout("rdi") slot => _,
+            inlateout("rsi") priority as u64 => _,
+            inlateout("rdx") quantum_us as u64 => _,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(()) } else { Err(SyscallError(result)) }
+}
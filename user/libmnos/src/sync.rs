@@ -0,0 +1,328 @@
+// =============================================================================
+// libmnos — Blocking Synchronization (Futex, Mutex, Condvar, Once)
+// =============================================================================
+//
+// Safe wrappers around SYS_FUTEX_WAIT (18) and SYS_FUTEX_WAKE (19), and the
+// locks built on them.
+//
+// A futex is any 4-byte aligned AtomicU32 in the process. The kernel keeps
+// no lock state — only a queue of threads sleeping on each address:
+//
+//   futex_wait(word, v):  sleep if *word == v (checked atomically with
+//                         queueing, so a wake in between is not lost)
+//   futex_wake(word, n):  wake up to n sleepers
+//
+// SPIN, THEN SLEEP:
+//   Every primitive first spins SPIN_LIMIT rounds in Ring 3: a lock held
+//   across a few instructions is released before a syscall would even
+//   return. Only then does the waiter sleep in the kernel, so a preempted
+//   holder no longer makes its waiters burn their whole 10 ms quantum.
+//
+// Mutex word (after Drepper, "Futexes Are Tricky"):
+//   0 = unlocked, 1 = locked, 2 = locked and someone may be sleeping.
+//   Unlock only makes a syscall when the word was 2.
+//
+// =============================================================================
+
+use core::cell::UnsafeCell;
+use core::ops::{Deref, DerefMut};
+use core::sync::atomic::{AtomicU32, Ordering};
+
+use crate::syscall::SyscallError;
+
+/// Syscall number for wait-if-equal.
+const SYS_FUTEX_WAIT: u64 = 18;
+
+/// Syscall number for wake-N.
+const SYS_FUTEX_WAKE: u64 = 19;
+
+/// `futex_wait` error: the word no longer held the expected value.
+pub const FUTEX_VALUE_CHANGED: SyscallError = SyscallError(u64::MAX - 7);
+
+/// `futex_wake` count that wakes every sleeper.
+pub const WAKE_ALL: u32 = u32::MAX;
+
+/// Spin rounds before a waiter sleeps in the kernel.
+const SPIN_LIMIT: u32 = 100;
+
+// =============================================================================
+// Futex syscalls
+// =============================================================================
+
+/// Sleeps while `word` holds `expected`.
+///
+/// # Returns
+/// `Ok(())` after a wakeup — which may be spurious or meant for another
+/// waiter, so callers re-check their condition. `Err(FUTEX_VALUE_CHANGED)`
+/// if the word had already changed (nothing slept).
+#[inline(always)]
+pub fn futex_wait(word: &AtomicU32, expected: u32) -> Result<(), SyscallError> {
+    let result: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_FUTEX_WAIT => result,
+            in("rdi") word.as_ptr() as u64,
+            in("rsi") expected as u64,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { Ok(()) } else { Err(SyscallError(result)) }
+}
+
+/// Wakes up to `count` threads sleeping on `word`.
+///
+/// # Returns
+/// The number of threads woken.
+#[inline(always)]
+pub fn futex_wake(word: &AtomicU32, count: u32) -> usize {
+    let result: u64;
+    let woken: u64;
+    unsafe {
+        core::arch::asm!(
+            "syscall",
+            inlateout("rax") SYS_FUTEX_WAKE => result,
+            inlateout("rdi") word.as_ptr() as u64 => woken,
+            in("rsi") count as u64,
+            lateout("rcx") _,
+            lateout("r11") _,
+            options(nostack),
+        );
+    }
+    if result == 0 { woken as usize } else { 0 }
+}
+
+/// Blocks until `word` no longer holds `value` — spinning briefly, then
+/// sleeping. Returns the new value.
+pub fn wait_while_equal(word: &AtomicU32, value: u32) -> u32 {
+    loop {
+        let now = spin_until(word, |v| v != value);
+        if now != value {
+            core::sync::atomic::fence(Ordering::Acquire);
+            return now;
+        }
+        let _ = futex_wait(word, value);
+    }
+}
+
+/// Spins until `done(word)` or SPIN_LIMIT rounds pass.
+#[inline]
+fn spin_until(word: &AtomicU32, done: impl Fn(u32) -> bool) -> u32 {
+    let mut value = word.load(Ordering::Relaxed);
+    for _ in 0..SPIN_LIMIT {
+        if done(value) {
+            break;
+        }
+        core::hint::spin_loop();
+        value = word.load(Ordering::Relaxed);
+    }
+    value
+}
+
+// =============================================================================
+// Mutex
+// =============================================================================
+
+const UNLOCKED: u32 = 0;
+const LOCKED: u32 = 1;
+const CONTENDED: u32 = 2;
+
+/// A mutual-exclusion lock that spins briefly, then sleeps.
+pub struct Mutex<T> {
+    state: AtomicU32,
+    value: UnsafeCell<T>,
+}
+
+// SAFETY: `value` is only reached through a guard, i.e. under the lock.
+unsafe impl<T: Send> Sync for Mutex<T> {}
+unsafe impl<T: Send> Send for Mutex<T> {}
+
+impl<T> Mutex<T> {
+    pub const fn new(value: T) -> Self {
+        Self { state: AtomicU32::new(UNLOCKED), value: UnsafeCell::new(value) }
+    }
+
+    /// Takes the lock if it is free right now.
+    #[inline]
+    pub fn try_lock(&self) -> Option<MutexGuard<'_, T>> {
+        self.state
+            .compare_exchange(UNLOCKED, LOCKED, Ordering::Acquire, Ordering::Relaxed)
+            .ok()
+            .map(|_| MutexGuard { mutex: self })
+    }
+
+    /// Takes the lock, sleeping in the kernel if it stays held.
+    #[inline]
+    pub fn lock(&self) -> MutexGuard<'_, T> {
+        if self.state.compare_exchange(UNLOCKED, LOCKED, Ordering::Acquire, Ordering::Relaxed).is_err() {
+            self.lock_contended();
+        }
+        MutexGuard { mutex: self }
+    }
+
+    #[cold]
+    fn lock_contended(&self) {
+        let state = spin_until(&self.state, |s| s == UNLOCKED);
+        if state == UNLOCKED
+            && self.state.compare_exchange(UNLOCKED, LOCKED, Ordering::Acquire, Ordering::Relaxed).is_ok()
+        {
+            return;
+        }
+        // Mark the lock contended before sleeping, so the holder's unlock
+        // wakes us; whoever swaps 0 out owns it (still marked 2, which
+        // costs one spare wake at worst).
+        while self.state.swap(CONTENDED, Ordering::Acquire) != UNLOCKED {
+            let _ = futex_wait(&self.state, CONTENDED);
+        }
+    }
+
+    #[inline]
+    fn unlock(&self) {
+        if self.state.swap(UNLOCKED, Ordering::Release) == CONTENDED {
+            futex_wake(&self.state, 1);
+        }
+    }
+}
+
+/// Holds a `Mutex` locked; unlocks on drop.
+pub struct MutexGuard<'a, T> {
+    mutex: &'a Mutex<T>,
+}
+
+impl<T> Deref for MutexGuard<'_, T> {
+    type Target = T;
+    fn deref(&self) -> &T {
+        unsafe { &*self.mutex.value.get() }
+    }
+}
+
+impl<T> DerefMut for MutexGuard<'_, T> {
+    fn deref_mut(&mut self) -> &mut T {
+        unsafe { &mut *self.mutex.value.get() }
+    }
+}
+
+impl<T> Drop for MutexGuard<'_, T> {
+    #[inline]
+    fn drop(&mut self) {
+        self.mutex.unlock();
+    }
+}
+
+// =============================================================================
+// Condvar
+// =============================================================================
+
+/// A condition variable for use with `Mutex`.
+///
+/// `seq` counts notifications. A waiter samples it before unlocking and
+/// sleeps only while it is unchanged, so a notify between the unlock and
+/// the sleep is not lost.
+pub struct Condvar {
+    seq: AtomicU32,
+}
+
+impl Condvar {
+    pub const fn new() -> Self {
+        Self { seq: AtomicU32::new(0) }
+    }
+
+    /// Unlocks `guard`, sleeps until notified, relocks. Wakeups may be
+    /// spurious: call it in a loop that re-checks the condition.
+    pub fn wait<'a, T>(&self, guard: MutexGuard<'a, T>) -> MutexGuard<'a, T> {
+        let mutex = guard.mutex;
+        let seq = self.seq.load(Ordering::Relaxed);
+        drop(guard);
+
+        let now = spin_until(&self.seq, |s| s != seq);
+        if now == seq {
+            let _ = futex_wait(&self.seq, seq);
+        }
+
+        // Other waiters may be woken by the same notify_all: relock as
+        // contended so our unlock passes the wakeup on.
+        while mutex.state.swap(CONTENDED, Ordering::Acquire) != UNLOCKED {
+            let _ = futex_wait(&mutex.state, CONTENDED);
+        }
+        MutexGuard { mutex }
+    }
+
+    /// Wakes one waiter.
+    pub fn notify_one(&self) {
+        self.seq.fetch_add(1, Ordering::Release);
+        futex_wake(&self.seq, 1);
+    }
+
+    /// Wakes every waiter.
+    pub fn notify_all(&self) {
+        self.seq.fetch_add(1, Ordering::Release);
+        futex_wake(&self.seq, WAKE_ALL);
+    }
+}
+
+// =============================================================================
+// Once
+// =============================================================================
+
+const INCOMPLETE: u32 = 0;
+const RUNNING: u32 = 1;
+const RUNNING_WAITERS: u32 = 2;
+const COMPLETE: u32 = 3;
+
+/// Runs an initializer exactly once; concurrent callers sleep until it
+/// has finished.
+pub struct Once {
+    state: AtomicU32,
+}
+
+impl Once {
+    pub const fn new() -> Self {
+        Self { state: AtomicU32::new(INCOMPLETE) }
+    }
+
+    /// True once an initializer has returned.
+    #[inline]
+    pub fn is_completed(&self) -> bool {
+        self.state.load(Ordering::Acquire) == COMPLETE
+    }
+
+    /// Runs `f` if no call has run it yet; returns after it has finished,
+    /// whichever thread ran it.
+    #[inline]
+    pub fn call_once(&self, f: impl FnOnce()) {
+        if self.is_completed() {
+            return;
+        }
+        self.call_once_slow(f);
+    }
+
+    #[cold]
+    fn call_once_slow(&self, f: impl FnOnce()) {
+        if self.state.compare_exchange(INCOMPLETE, RUNNING, Ordering::Acquire, Ordering::Acquire).is_ok() {
+            f();
+            if self.state.swap(COMPLETE, Ordering::Release) == RUNNING_WAITERS {
+                futex_wake(&self.state, WAKE_ALL);
+            }
+            return;
+        }
+
+        loop {
+            let state = spin_until(&self.state, |s| s == COMPLETE);
+            match state {
+                COMPLETE => {
+                    core::sync::atomic::fence(Ordering::Acquire);
+                    return;
+                }
+                RUNNING => {
+                    let _ = self.state.compare_exchange(RUNNING, RUNNING_WAITERS, Ordering::Relaxed, Ordering::Relaxed);
+                }
+                RUNNING_WAITERS => {
+                    let _ = futex_wait(&self.state, RUNNING_WAITERS);
+                }
+                _ => unreachable!(),
+            }
+        }
+    }
+}
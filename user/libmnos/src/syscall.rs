@@ -45,3 +45,15 @@ pub unsafe fn syscall4(number: u64, arg0: u64, arg1: u64, arg2: u64, arg3: u64)
     }
     result
 }
+
+/// SYS_NULL — does nothing in the kernel and returns 0.
+/// (must match kernel/src/arch/x86_64/syscall.rs)
+const SYS_NULL: u64 = 0;
+
+/// The cheapest possible kernel round trip: SYSCALL → dispatch → SYSRET.
+///
+/// Used as the baseline for measuring syscall entry/exit overhead.
+#[inline(always)]
+pub fn sys_null() -> u64 {
+    unsafe { syscall4(SYS_NULL, 0, 0, 0, 0) }
+}
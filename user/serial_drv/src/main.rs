@@ -6,26 +6,58 @@
 // Ring 3 (CPL=3) and drives the 16550 UART (COM1) using capability-gated
 // syscalls provided by libmnos.
 //
-// CAPABILITY LAYOUT (set up by the kernel before spawn):
+// CAPABILITY LAYOUT (set up by the spawner):
 //   Slot 0: IoPort { base: 0x3F8, size: 8 } — COM1 registers (READ | WRITE)
 //   Slot 1: Endpoint { id: 2 }              — Command channel (READ)
-//   Slot 2: Interrupt { irq: 4 }            — COM1 IRQ (optional, for RX)
+//   Slot 2: Interrupt { irq: 4 }            — COM1 IRQ (optional)
+//   Slot 3: Process (self)                  — spawn the IRQ thread (optional)
 //
 // ARCHITECTURE:
-//   1. On startup, writes a hello banner to COM1 via SYS_PORT_OUT
-//   2. Enters a command loop: receives IPC messages via SYS_RECV
-//   3. Each message carries a character to write to COM1
-//   4. Writes the character using the polled TX path
 //
-// This proves the full microkernel pipeline:
-//   Ring 3 user code → SYSCALL → capability validation → I/O port access
-//   Ring 3 user code → SYSCALL → capability validation → IPC receive
+//   clients ──IPC──→ main thread                RX thread
+//                    sys_recv loop              loop { sys_wait_irq(4) }
+//                      │                          │ RBR → rx ring → echo
+//                      ▼                          ▼
+//                    tx(): 16 bytes per SYS_PORT_WRITE
+//                      │
+//                      ▼
+//                    kernel console ring ──THRE IRQ──→ 16550 FIFO
+//
+//   The kernel is the only writer of COM1's transmitter (a second one
+//   could burst into a FIFO the first one just filled): SYS_PORT_WRITE to
+//   the data register queues behind kernel log output in the kernel's TX
+//   ring, which refills the FIFO on every THRE interrupt. So the driver
+//   keeps no TX ring of its own and never waits on LSR; one syscall
+//   moves a whole 16-byte client batch.
+//
+//   Receive is the driver's: the RX thread enables the RX interrupt,
+//   sleeps in SYS_WAIT_IRQ and drains RBR into the rx ring. IRQ 4 is
+//   shared with the kernel's THRE handling, so some wakeups find nothing
+//   to read.
+//
+// PROTOCOL (Endpoint slot 1):
+//   label 0x01 CMD_PRINT_CHAR  data0 = byte
+//   label 0x02 CMD_WRITE       label bits 8..15 = length (≤ 16),
+//                              data0/data1 = bytes, little-endian
+//
+// RX:
+//   Received bytes are queued in the rx ring and echoed (CR → CR LF), a
+//   minimal line discipline until a reader service exists. Bytes that
+//   arrive while the ring is full are dropped and counted.
+//
+// FAILURE:
+//   A missing capability never appears later, so instead of retrying in
+//   a loop the affected thread parks on a futex word nobody wakes.
 //
 // =============================================================================
 
 #![no_std]
 #![no_main]
 
+use core::sync::atomic::{AtomicU32, Ordering};
+
+use libmnos::sync::Mutex;
+
 // =============================================================================
 // Constants
 // =============================================================================
@@ -36,18 +68,98 @@ const IO_SLOT: u64 = 0;
 /// CNode slot 1: Endpoint capability for receiving commands.
 const EP_SLOT: u64 = 1;
 
+/// CNode slot 2: Interrupt capability for IRQ 4.
+const IRQ_SLOT: u64 = 2;
+
+/// CNode slot 3: Process capability (self) — for SYS_SPAWN_THREAD.
+const SELF_PROC_SLOT: u64 = 3;
+
 /// COM1 data register (Transmit Holding / Receive Buffer).
 const COM1_DATA: u16 = 0x3F8;
 
+/// COM1 Interrupt Enable Register.
+const COM1_IER: u16 = 0x3F9;
+
 /// COM1 Line Status Register.
 const COM1_LSR: u16 = 0x3FD;
 
-/// LSR bit 5: Transmit Holding Register Empty.
-const LSR_TX_EMPTY: u8 = 1 << 5;
+/// LSR bit 0: Data Ready (a received byte is waiting).
+const LSR_RX_READY: u8 = 1 << 0;
+
+/// IER bit 0: received data available interrupt.
+const IER_RX: u8 = 1 << 0;
+
+/// Receive ring size (power of two).
+const RX_RING_SIZE: usize = 1024;
 
 /// IPC label for "print character" command.
 const CMD_PRINT_CHAR: u64 = 0x01;
 
+/// IPC label for "write up to 16 bytes" (length in label bits 8..15).
+const CMD_WRITE: u64 = 0x02;
+
+/// Consecutive SYS_RECV failures before the main thread gives up.
+const RECV_RETRIES: u32 = 16;
+
+/// Stack for the RX thread (lives in .bss — the driver has no heap).
+const IRQ_STACK_SIZE: usize = 16 * 1024;
+
+// =============================================================================
+// Driver state
+// =============================================================================
+
+/// Byte ring: `[tail, head)` (mod N) is queued.
+struct Ring<const N: usize> {
+    buf: [u8; N],
+    head: usize,
+    tail: usize,
+}
+
+impl<const N: usize> Ring<N> {
+    const fn new() -> Self {
+        Self { buf: [0; N], head: 0, tail: 0 }
+    }
+
+    fn len(&self) -> usize {
+        self.head.wrapping_sub(self.tail)
+    }
+
+    /// Queues `byte`; false if the ring is full.
+    fn push(&mut self, byte: u8) -> bool {
+        if self.len() == N {
+            return false;
+        }
+        self.buf[self.head % N] = byte;
+        self.head = self.head.wrapping_add(1);
+        true
+    }
+
+    fn pop(&mut self) -> Option<u8> {
+        if self.len() == 0 {
+            return None;
+        }
+        let byte = self.buf[self.tail % N];
+        self.tail = self.tail.wrapping_add(1);
+        Some(byte)
+    }
+}
+
+/// Received bytes. A futex-backed lock, so a reader that loses the race
+/// to the RX thread sleeps instead of spinning through its quantum.
+static RX: Mutex<Ring<RX_RING_SIZE>> = Mutex::new(Ring::new());
+
+/// Bytes dropped because the rx ring was full.
+static RX_OVERRUNS: AtomicU32 = AtomicU32::new(0);
+
+/// Futex word a thread that can make no progress sleeps on. Nothing ever
+/// changes or wakes it.
+static PARK: AtomicU32 = AtomicU32::new(0);
+
+#[repr(C, align(16))]
+struct Stack([u8; IRQ_STACK_SIZE]);
+
+static mut IRQ_STACK: Stack = Stack([0; IRQ_STACK_SIZE]);
+
 // =============================================================================
 // Driver Entry Point
 // =============================================================================
@@ -59,38 +171,88 @@ const CMD_PRINT_CHAR: u64 = 0x01;
 #[unsafe(no_mangle)]
 #[unsafe(link_section = ".text.entry")]
 pub extern "C" fn _start() -> ! {
-    // Phase 1: Write hello banner to COM1 via capability-gated port I/O.
-    //
-    // This proves: Ring 3 → SYSCALL → IoPort capability → OUT instruction.
-    // Each character requires 2 syscalls: port_in (check LSR) + port_out (write).
-    let banner = b"\r\n[serial_drv] Hello from Ring 3 Serial Driver!\r\n";
-    for &byte in banner.iter() {
-        write_byte(byte);
+    // Phase 1: interrupt-driven receive if we were given IRQ 4 and ourselves.
+    let rx = start_irq_thread();
+
+    // Phase 2: Write hello banner to COM1 via capability-gated port I/O.
+    write_bytes(b"\r\n[serial_drv] Hello from Ring 3 Serial Driver!\r\n");
+    if rx {
+        write_bytes(b"[serial_drv] IRQ 4 driven receive, 1 KiB RX ring\r\n");
     }
 
-    // Phase 2: Enter the IPC command loop.
+    // Phase 3: Enter the IPC command loop.
     //
-    // This proves: Ring 3 IPC receive + port I/O in the same driver.
-    // The kernel (or another user thread) sends CMD_PRINT_CHAR messages
-    // with a character in data0. We write each character to COM1.
-    let entering = b"[serial_drv] Entering IPC command loop...\r\n";
-    for &byte in entering.iter() {
-        write_byte(byte);
-    }
+    // The kernel (or another user thread) sends CMD_PRINT_CHAR / CMD_WRITE
+    // messages; each one is a single SYS_PORT_WRITE.
+    write_bytes(b"[serial_drv] Entering IPC command loop...\r\n");
 
+    let mut failures = 0;
     loop {
         match libmnos::ipc::sys_recv(EP_SLOT) {
             Ok(msg) => {
-                if msg.label == CMD_PRINT_CHAR {
-                    write_byte(msg.data0 as u8);
+                failures = 0;
+                match msg.label & 0xFF {
+                    CMD_PRINT_CHAR => write_bytes(&[msg.data0 as u8]),
+                    CMD_WRITE => {
+                        let len = ((msg.label >> 8) & 0xFF).min(16) as usize;
+                        let mut bytes = [0u8; 16];
+                        bytes[..8].copy_from_slice(&msg.data0.to_le_bytes());
+                        bytes[8..].copy_from_slice(&msg.data1.to_le_bytes());
+                        write_bytes(&bytes[..len]);
+                    }
+                    _ => {} // Unknown labels are silently ignored
                 }
-                // Unknown labels are silently ignored
             }
             Err(_) => {
-                // Capability error — shouldn't happen if kernel set up correctly.
-                // Can't kprintln from Ring 3, so just continue.
+                // No (or a revoked) Endpoint cap: retrying cannot fix that.
+                failures += 1;
+                if failures == RECV_RETRIES {
+                    write_bytes(b"[serial_drv] SYS_RECV keeps failing, command loop parked\r\n");
+                    park();
+                }
+            }
+        }
+    }
+}
+
+/// Enables the RX interrupt and spawns the RX thread. Returns false, with
+/// IER untouched, if either optional capability is missing.
+fn start_irq_thread() -> bool {
+    let Ok(ier) = libmnos::io::sys_port_in(IO_SLOT, COM1_IER) else { return false };
+    let _ = libmnos::io::sys_port_out(IO_SLOT, COM1_IER, ier | IER_RX);
+
+    // Only the RX thread ever uses this stack.
+    let top = core::ptr::addr_of_mut!(IRQ_STACK) as u64 + IRQ_STACK_SIZE as u64;
+    // Entry RSP ≡ 8 (mod 16), as if `irq_thread` had been called.
+    match libmnos::process::sys_spawn_thread(SELF_PROC_SLOT, irq_thread as usize as u64, top - 8) {
+        Ok(_) => true,
+        Err(_) => {
+            // No Process cap: put IER back.
+            let _ = libmnos::io::sys_port_out(IO_SLOT, COM1_IER, ier);
+            false
+        }
+    }
+}
+
+/// RX thread: sleeps in SYS_WAIT_IRQ and services the receiver.
+extern "C" fn irq_thread() -> ! {
+    loop {
+        if libmnos::irq::sys_wait_irq(IRQ_SLOT).is_err() {
+            // No Interrupt cap after all: nothing will ever drain RBR, so
+            // stop asking for RX interrupts and sleep for good.
+            if let Ok(ier) = libmnos::io::sys_port_in(IO_SLOT, COM1_IER) {
+                let _ = libmnos::io::sys_port_out(IO_SLOT, COM1_IER, ier & !IER_RX);
             }
+            park();
         }
+        receive();
+    }
+}
+
+/// Blocks the calling thread forever without burning CPU.
+fn park() -> ! {
+    loop {
+        let _ = libmnos::sync::futex_wait(&PARK, 0);
     }
 }
 
@@ -98,25 +260,43 @@ pub extern "C" fn _start() -> ! {
 // Serial I/O Helpers
 // =============================================================================
 
-/// Writes a single byte to COM1 using the polled TX path.
-///
-/// 1. Spins until LSR bit 5 (TX empty) is set via SYS_PORT_IN
-/// 2. Writes the byte to the data register via SYS_PORT_OUT
-///
-/// Two syscalls per byte — correct for a capability-based microkernel.
-#[inline(always)]
-fn write_byte(byte: u8) {
-    // Wait for Transmit Holding Register Empty
-    loop {
-        match libmnos::io::sys_port_in(IO_SLOT, COM1_LSR) {
-            Ok(lsr) if lsr & LSR_TX_EMPTY != 0 => break,
-            Ok(_) => {} // Not ready yet, spin
-            Err(_) => return, // Shouldn't happen
+/// Hands `bytes` to the kernel console ring. The kernel paces the FIFO
+/// itself, so no THRE wait is requested.
+fn write_bytes(bytes: &[u8]) {
+    let _ = libmnos::io::sys_port_write(IO_SLOT, COM1_DATA, bytes, libmnos::io::TxPacing::NONE);
+}
+
+/// Drains the receive FIFO into the rx ring, then echoes the ring.
+fn receive() {
+    let mut rx = RX.lock();
+    while let Ok(lsr) = libmnos::io::sys_port_in(IO_SLOT, COM1_LSR) {
+        if lsr & LSR_RX_READY == 0 {
+            break;
+        }
+        let Ok(byte) = libmnos::io::sys_port_in(IO_SLOT, COM1_DATA) else { break };
+        if !rx.push(byte) {
+            // Drop the byte, as a FIFO overrun would, but keep the count.
+            RX_OVERRUNS.fetch_add(1, Ordering::Relaxed);
         }
     }
 
-    // Write the byte
-    let _ = libmnos::io::sys_port_out(IO_SLOT, COM1_DATA, byte);
+    // Until a reader service exists the echo is the ring's only consumer.
+    // CR becomes CR LF, so each byte needs at most two slots.
+    let mut echo = [0u8; 32];
+    let mut n = 0;
+    while let Some(byte) = rx.pop() {
+        echo[n] = byte;
+        n += 1;
+        if byte == b'\r' {
+            echo[n] = b'\n';
+            n += 1;
+        }
+        if n + 2 > echo.len() {
+            write_bytes(&echo[..n]);
+            n = 0;
+        }
+    }
+    write_bytes(&echo[..n]);
 }
 
 // =============================================================================